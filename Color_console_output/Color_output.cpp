@@ -0,0 +1,5 @@
+#include <stdarg.h>
+#include "Color_output.h"
+int color_fprintf(FILE* stream, Colors, Styles, const char* format, ...)
+{ va_list a; va_start(a, format); int r = vfprintf(stream, format, a); va_end(a); return r; }
+int color_putc(FILE* stream, Colors, Styles, char c) { return putc(c, stream); }
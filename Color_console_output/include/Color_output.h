@@ -0,0 +1,8 @@
+#ifndef COLOR_OUTPUT_H
+#define COLOR_OUTPUT_H
+#include <stdio.h>
+enum Colors { COLOR_DEFAULT, COLOR_RED, COLOR_GREEN, COLOR_YELLOW, COLOR_BLUE, COLOR_PURPLE, COLOR_CYAN, COLOR_WHITE };
+enum Styles { STYLE_DEFAULT, STYLE_BOLD, STYLE_UNDERLINED, STYLE_INVERT_C };
+int color_fprintf(FILE* stream, Colors color, Styles style, const char* format, ...) __attribute__((format(printf, 4, 5)));
+int color_putc(FILE* stream, Colors color, Styles style, char c);
+#endif
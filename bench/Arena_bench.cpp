@@ -0,0 +1,63 @@
+/**
+ * @file
+ * @brief Benchmark of short-lived stacks with heap and arena allocators
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+static double now_ms();
+static double churn(struct StackAllocator* allocator, size_t pushes);
+
+const size_t CHURN_STACKS = 1 << 18;
+
+int main()
+{
+    const size_t pushes[] = {8, 64, 1024};
+
+    printf("%-8s %12s %12s %12s\n", "pushes", "heap ms", "arena ms", "speedup");
+
+    for (size_t i = 0; i < sizeof(pushes) / sizeof(pushes[0]); i++)
+    {
+        StackArena arena = {};
+        stack_arena_ctor(&arena);
+
+        double heapMs  = churn(NULL, pushes[i]);
+        double arenaMs = churn(&arena.allocator, pushes[i]);
+
+        stack_arena_dtor(&arena);
+
+        printf("%-8lu %12.2f %12.2f %12.2f\n", pushes[i], heapMs, arenaMs, heapMs / arenaMs);
+    }
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+/// @brief Creates, fills and destructs CHURN_STACKS stacks one by one
+static double churn(struct StackAllocator* allocator, size_t pushes)
+{
+    double start = now_ms();
+
+    for (size_t i = 0; i < CHURN_STACKS / pushes; i++)
+    {
+        struct Stack stk = {};
+        STACK_CTOR_ALLOC(&stk, 1, PROTECTION_OFF, STORAGE_CONTIGUOUS, allocator);
+
+        for (size_t j = 0; j < pushes; j++) STACK_PUSH(&stk, (elem_t) j);
+
+        STACK_DTOR(&stk);
+    }
+
+    return now_ms() - start;
+}
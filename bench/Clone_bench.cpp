@@ -0,0 +1,71 @@
+/**
+ * @file
+ * @brief Cost of stack_clone against rebuilding stack by pushes, and of the first write that copies shared data
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+static double now_us();
+static void measure(enum storageMode storage, size_t count);
+
+const size_t CLONE_BENCH_MIN_COUNT = 1000;
+const size_t CLONE_BENCH_MAX_COUNT = 10000000;
+
+int main()
+{
+    printf("%-12s %10s %14s %14s %16s\n", "storage", "elements", "clone us", "rebuild us", "first write us");
+
+    for (size_t count = CLONE_BENCH_MIN_COUNT; count <= CLONE_BENCH_MAX_COUNT; count *= 10)
+    {
+        measure(STORAGE_CONTIGUOUS, count);
+        measure(STORAGE_SEGMENTED,  count);
+    }
+
+    return 0;
+}
+
+static double now_us()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e6 + (double) time.tv_nsec / 1e3;
+}
+
+static void measure(enum storageMode storage, size_t count)
+{
+    Stack stk = {};
+    STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, storage);
+
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+
+    Stack clone = {};
+
+    double start = now_us();
+    STACK_CLONE(&clone, &stk);
+    double cloneTime = now_us() - start;
+
+    // First write copies whole buffer of contiguous clone and only top chunk of segmented one
+    start = now_us();
+    STACK_PUSH(&clone, 0);
+    double writeTime = now_us() - start;
+
+    Stack rebuilt = {};
+
+    start = now_us();
+    STACK_CTOR_EX(&rebuilt, 1, PROTECTION_DEFAULT, storage);
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&rebuilt, (elem_t) i);
+    double rebuildTime = now_us() - start;
+
+    printf("%-12s %10lu %14.2f %14.1f %16.1f\n", (storage == STORAGE_SEGMENTED) ? "segmented" : "contiguous",
+           count, cloneTime, rebuildTime, writeTime);
+
+    STACK_DTOR(&rebuilt);
+    STACK_DTOR(&clone);
+    STACK_DTOR(&stk);
+}
@@ -0,0 +1,119 @@
+/**
+ * @file
+ * @brief Multi-threaded throughput of lock-free stack against mutex-wrapped struct Stack
+*/
+
+#include <stdio.h>
+#include <time.h>
+#include <mutex>
+#include <thread>
+
+#include "Color_output.h"
+#include "ConcurrentStack.h"
+#include "Stack.h"
+
+/// @brief struct Stack guarded by mutex, the way it is shared between threads without ConcurrentStack
+struct MutexStack
+{
+    std::mutex   mutex;     ///< Lock of every operation
+    struct Stack stack;     ///< Stack
+};
+
+static double now_ms();
+static void mutex_worker(MutexStack* stk, size_t ops);
+static void concurrent_worker(ConcurrentStack* stk, size_t ops);
+static double run_mutex(size_t threadsCount, enum protectionLevel protection);
+static double run_concurrent(size_t threadsCount);
+
+const size_t BENCH_MAX_THREADS = 16;
+const size_t BENCH_OPS         = 1 << 21;   ///< Push/pop pairs of all threads together
+
+int main()
+{
+    printf("%-8s %18s %18s %18s\n", "threads", "mutex OFF Mops/s", "mutex HASH Mops/s", "lock-free Mops/s");
+
+    for (size_t threadsCount = 1; threadsCount <= BENCH_MAX_THREADS; threadsCount *= 2)
+    {
+        double mutexOff  = run_mutex(threadsCount, PROTECTION_OFF);
+        double mutexHash = run_mutex(threadsCount, PROTECTION_DEFAULT);
+        double lockFree  = run_concurrent(threadsCount);
+
+        double ops = 2.0 * BENCH_OPS / 1e3;
+        printf("%-8lu %18.2f %18.2f %18.2f\n", threadsCount, ops / mutexOff, ops / mutexHash, ops / lockFree);
+    }
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+static void mutex_worker(MutexStack* stk, size_t ops)
+{
+    for (size_t i = 0; i < ops; i++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stk->mutex);
+            STACK_PUSH(&stk->stack, (elem_t) i);
+        }
+        {
+            std::lock_guard<std::mutex> lock(stk->mutex);
+            if (stk->stack.size) STACK_POP(&stk->stack);
+        }
+    }
+}
+
+static void concurrent_worker(ConcurrentStack* stk, size_t ops)
+{
+    elem_t value = 0;
+
+    for (size_t i = 0; i < ops; i++)
+    {
+        CSTACK_PUSH(stk, (elem_t) i);
+        CSTACK_POP(stk, &value);
+    }
+}
+
+static double run_mutex(size_t threadsCount, enum protectionLevel protection)
+{
+    MutexStack stk;
+    stk.stack = {};
+    STACK_CTOR_PROTECTED(&stk.stack, 1, protection);
+
+    std::thread threads[BENCH_MAX_THREADS];
+
+    double start = now_ms();
+
+    for (size_t i = 0; i < threadsCount; i++) threads[i] = std::thread(mutex_worker, &stk, BENCH_OPS / threadsCount);
+    for (size_t i = 0; i < threadsCount; i++) threads[i].join();
+
+    double time = now_ms() - start;
+
+    STACK_DTOR(&stk.stack);
+
+    return time;
+}
+
+static double run_concurrent(size_t threadsCount)
+{
+    ConcurrentStack stk = {};
+    CSTACK_CTOR(&stk);
+
+    std::thread threads[BENCH_MAX_THREADS];
+
+    double start = now_ms();
+
+    for (size_t i = 0; i < threadsCount; i++) threads[i] = std::thread(concurrent_worker, &stk, BENCH_OPS / threadsCount);
+    for (size_t i = 0; i < threadsCount; i++) threads[i].join();
+
+    double time = now_ms() - start;
+
+    CSTACK_DTOR(&stk);
+
+    return time;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file
+ * @brief Fork-join scaling of work-stealing deques against one stack under global lock
+*/
+
+#include <stdio.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "Color_output.h"
+#include "Stack.h"
+#include "WorkDeque.h"
+
+const size_t BENCH_MAX_WORKERS = 16;
+const elem_t TREE_DEPTH        = 18;    ///< Task tree has 2^TREE_DEPTH leaves
+const int    LEAF_WORK         = 200;   ///< Iterations of work in every leaf
+
+/// @brief Task pool of all workers
+struct ForkJoinPool
+{
+    WorkDeque               deques[BENCH_MAX_WORKERS];     ///< Deque of each worker(work-stealing variant)
+    size_t                  workersCount;   ///< Number of workers
+    std::mutex              mutex;          ///< Lock of global stack(global lock variant)
+    struct Stack            stack;          ///< Global stack(global lock variant)
+    std::atomic<long long>  pending;        ///< Tasks pushed and not finished yet
+    std::atomic<long long>  leaves;         ///< Finished leaf tasks
+};
+
+static double now_ms();
+static void leaf_work();
+static void deque_worker(ForkJoinPool* pool, size_t index);
+static void locked_worker(ForkJoinPool* pool);
+static double run_deques(ForkJoinPool* pool, size_t workersCount);
+static double run_locked(ForkJoinPool* pool, size_t workersCount);
+
+int main()
+{
+    static ForkJoinPool pool;
+
+    size_t cores = std::thread::hardware_concurrency();
+    printf("hardware threads: %lu, tree depth: %d\n", cores, TREE_DEPTH);
+    printf("%-8s %14s %14s %14s %14s\n", "workers", "deques ms", "speedup", "global lock ms", "speedup");
+
+    double dequesBase = 0;
+    double lockedBase = 0;
+
+    for (size_t workersCount = 1; workersCount <= BENCH_MAX_WORKERS; workersCount *= 2)
+    {
+        double deques = run_deques(&pool, workersCount);
+        double locked = run_locked(&pool, workersCount);
+
+        if (workersCount == 1)
+        {
+            dequesBase = deques;
+            lockedBase = locked;
+        }
+
+        printf("%-8lu %14.2f %14.2f %14.2f %14.2f\n", workersCount, deques, dequesBase / deques, locked, lockedBase / locked);
+    }
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+static void leaf_work()
+{
+    volatile unsigned value = 1;
+    for (int i = 0; i < LEAF_WORK; i++) value = value * 1664525u + 1013904223u;
+}
+
+/// @brief Runs tasks from own deque, steals from others when it is empty
+static void deque_worker(ForkJoinPool* pool, size_t index)
+{
+    WorkDeque* own    = &pool->deques[index];
+    unsigned   random = (unsigned) index * 2654435761u + 1;
+    elem_t     depth  = 0;
+
+    while (pool->pending.load(std::memory_order_acquire))
+    {
+        if (WDEQUE_POP(own, &depth))
+        {
+            random = random * 1664525u + 1013904223u;
+            if (WDEQUE_STEAL(&pool->deques[(random >> 8) % pool->workersCount], &depth)) continue;
+        }
+
+        if (depth > 0)
+        {
+            pool->pending.fetch_add(2, std::memory_order_relaxed);
+            WDEQUE_PUSH(own, depth - 1);
+            WDEQUE_PUSH(own, depth - 1);
+        }
+        else
+        {
+            leaf_work();
+            pool->leaves.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        pool->pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+/// @brief Runs tasks from global stack under mutex
+static void locked_worker(ForkJoinPool* pool)
+{
+    while (pool->pending.load(std::memory_order_acquire))
+    {
+        elem_t depth = -1;
+
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if (pool->stack.size) depth = STACK_POP(&pool->stack);
+        }
+
+        if (depth < 0) continue;
+
+        if (depth > 0)
+        {
+            pool->pending.fetch_add(2, std::memory_order_relaxed);
+
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            STACK_PUSH(&pool->stack, depth - 1);
+            STACK_PUSH(&pool->stack, depth - 1);
+        }
+        else
+        {
+            leaf_work();
+            pool->leaves.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        pool->pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+static double run_deques(ForkJoinPool* pool, size_t workersCount)
+{
+    pool->workersCount = workersCount;
+    for (size_t i = 0; i < workersCount; i++)
+        wdeque_ctor(&pool->deques[i], 64, PROTECTION_OFF, NULL, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+
+    pool->pending.store(1);
+    pool->leaves.store(0);
+    WDEQUE_PUSH(&pool->deques[0], TREE_DEPTH);
+
+    std::thread workers[BENCH_MAX_WORKERS];
+
+    double start = now_ms();
+
+    for (size_t i = 0; i < workersCount; i++) workers[i] = std::thread(deque_worker, pool, i);
+    for (size_t i = 0; i < workersCount; i++) workers[i].join();
+
+    double time = now_ms() - start;
+
+    if (pool->leaves.load() != (1ll << TREE_DEPTH)) fprintf(stderr, "Wrong number of leaves: %lld\n", pool->leaves.load());
+
+    for (size_t i = 0; i < workersCount; i++) WDEQUE_DTOR(&pool->deques[i]);
+
+    return time;
+}
+
+static double run_locked(ForkJoinPool* pool, size_t workersCount)
+{
+    pool->stack = {};
+    STACK_CTOR_PROTECTED(&pool->stack, 64, PROTECTION_OFF);
+
+    pool->pending.store(1);
+    pool->leaves.store(0);
+    STACK_PUSH(&pool->stack, TREE_DEPTH);
+
+    std::thread workers[BENCH_MAX_WORKERS];
+
+    double start = now_ms();
+
+    for (size_t i = 0; i < workersCount; i++) workers[i] = std::thread(locked_worker, pool);
+    for (size_t i = 0; i < workersCount; i++) workers[i].join();
+
+    double time = now_ms() - start;
+
+    if (pool->leaves.load() != (1ll << TREE_DEPTH)) fprintf(stderr, "Wrong number of leaves: %lld\n", pool->leaves.load());
+
+    STACK_DTOR(&pool->stack);
+
+    return time;
+}
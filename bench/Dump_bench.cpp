@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief Time faulting thread spends in stack_dump of big stack: text, JSON and binary formats, hand-off to logger thread
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Logger.h"
+#include "Stack.h"
+
+static double now_ms();
+static double dump_ms(FILE* stream, const struct Stack* stack, stackDumpMode mode, enum stackDumpFormat format);
+
+const size_t DUMP_BENCH_ELEMENTS = 1 << 20;
+const int    DUMP_BENCH_ROUNDS   = 5;
+
+int main()
+{
+    FILE* sink = fopen("/dev/null", "w");
+    if (!sink)
+    {
+        fprintf(stderr, "Can't open /dev/null\n");
+        return 1;
+    }
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+
+    for (size_t i = 0; i < DUMP_BENCH_ELEMENTS; i++) STACK_PUSH(&stk, (elem_t) i);
+
+    // Half of capacity above top is poison
+    for (size_t i = 0; i < DUMP_BENCH_ELEMENTS / 2; i++) STACK_POP(&stk);
+
+    printf("size = %lu, capacity = %lu\n", stk.size, stk.capacity);
+    printf("SHORT dump:             %.2f ms\n", dump_ms(sink, &stk, SHORT, DUMP_TEXT));
+    printf("FULL dump:              %.2f ms\n", dump_ms(sink, &stk, FULL, DUMP_TEXT));
+    printf("FULL dump(JSON):        %.2f ms\n", dump_ms(sink, &stk, FULL, DUMP_JSON));
+    printf("FULL dump(binary):      %.2f ms\n", dump_ms(sink, &stk, FULL, DUMP_BINARY));
+
+    const struct StackLoggerConfig config = {NULL};
+    if (!stack_logger_start(&config))
+    {
+        printf("FULL dump(logger):      %.2f ms\n", dump_ms(sink, &stk, FULL, DUMP_TEXT));
+        printf("FULL dump(binary, logger): %.2f ms\n", dump_ms(sink, &stk, FULL, DUMP_BINARY));
+
+        double start = now_ms();
+        stack_logger_stop();
+        printf("logger drain:           %.2f ms, %lu reports dropped\n", now_ms() - start, stack_logger_stats().dropped);
+    }
+
+    STACK_DTOR(&stk);
+    fclose(sink);
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+static double dump_ms(FILE* stream, const struct Stack* stack, stackDumpMode mode, enum stackDumpFormat format)
+{
+    double start = now_ms();
+
+    for (int i = 0; i < DUMP_BENCH_ROUNDS; i++) stack_dump(stream, stack, __FILE__, __PRETTY_FUNCTION__, __LINE__, mode, format);
+
+    return (now_ms() - start) / DUMP_BENCH_ROUNDS;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file
+ * @brief Benchmark of stack capacity strategies on oscillating and monotone traces
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+/// @brief Result of one trace run
+struct GrowthBenchResult
+{
+    size_t reallocs;    ///< Number of capacity changes
+    double timeMs;      ///< Run time in milliseconds
+};
+
+typedef void (*trace_t)(struct Stack* stack, size_t* reallocs);
+
+static double now_ms();
+static void count_realloc(const struct Stack* stack, size_t* capacity, size_t* reallocs);
+static void monotone_trace(struct Stack* stack, size_t* reallocs);
+static void oscillating_trace(struct Stack* stack, size_t* reallocs);
+static GrowthBenchResult run_trace(const struct GrowthStrategy* growth, trace_t trace);
+
+const size_t MONOTONE_SIZE      = 1 << 22;
+const size_t OSCILLATION_BORDER = 1 << 16;
+const size_t OSCILLATION_COUNT  = 1 << 16;
+
+int main()
+{
+    const struct GrowthStrategy  geometric3 = GROWTH_GEOMETRIC("geometric x3", 3, 1, 9);
+    const struct GrowthStrategy* strategies[] = {&GROWTH_DOUBLE, &GROWTH_ONE_AND_HALF, &GROWTH_HYSTERESIS,
+                                                 &GROWTH_NEVER_SHRINK, &GROWTH_TRIM_ONLY, &geometric3};
+
+    printf("%-14s %12s %12s %12s %12s\n", "strategy", "osc reallocs", "osc ms", "mono reallocs", "mono ms");
+
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++)
+    {
+        GrowthBenchResult oscillating = run_trace(strategies[i], oscillating_trace);
+        GrowthBenchResult monotone    = run_trace(strategies[i], monotone_trace);
+
+        printf("%-14s %12lu %12.2f %12lu %12.2f\n", strategies[i]->name,
+               oscillating.reallocs, oscillating.timeMs, monotone.reallocs, monotone.timeMs);
+    }
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+static void count_realloc(const struct Stack* stack, size_t* capacity, size_t* reallocs)
+{
+    if (stack->capacity != *capacity)
+    {
+        *capacity = stack->capacity;
+        (*reallocs)++;
+    }
+}
+
+static void monotone_trace(struct Stack* stack, size_t* reallocs)
+{
+    size_t capacity = stack->capacity;
+
+    for (size_t i = 0; i < MONOTONE_SIZE; i++)
+    {
+        STACK_PUSH(stack, (elem_t) i);
+        count_realloc(stack, &capacity, reallocs);
+    }
+
+    for (size_t i = 0; i < MONOTONE_SIZE; i++)
+    {
+        STACK_POP(stack);
+        count_realloc(stack, &capacity, reallocs);
+    }
+}
+
+static void oscillating_trace(struct Stack* stack, size_t* reallocs)
+{
+    size_t capacity = stack->capacity;
+
+    // Stack size walks around the power of two where default strategy reallocs
+    for (size_t i = 0; i + 1 < OSCILLATION_BORDER; i++) STACK_PUSH(stack, (elem_t) i);
+    count_realloc(stack, &capacity, reallocs);
+
+    for (size_t i = 0; i < OSCILLATION_COUNT; i++)
+    {
+        for (size_t j = 0; j < 4; j++)
+        {
+            STACK_PUSH(stack, (elem_t) j);
+            count_realloc(stack, &capacity, reallocs);
+        }
+
+        for (size_t j = 0; j < 4; j++)
+        {
+            STACK_POP(stack);
+            count_realloc(stack, &capacity, reallocs);
+        }
+    }
+
+    // Then the same around shrink border
+    while (stack->size > stack->shrinkSize + 8) STACK_POP(stack);
+    count_realloc(stack, &capacity, reallocs);
+
+    for (size_t i = 0; i < OSCILLATION_COUNT; i++)
+    {
+        for (size_t j = 0; j < 4; j++)
+        {
+            STACK_POP(stack);
+            count_realloc(stack, &capacity, reallocs);
+        }
+
+        for (size_t j = 0; j < 4; j++)
+        {
+            STACK_PUSH(stack, (elem_t) j);
+            count_realloc(stack, &capacity, reallocs);
+        }
+    }
+}
+
+static GrowthBenchResult run_trace(const struct GrowthStrategy* growth, trace_t trace)
+{
+    struct Stack stk = {};
+    STACK_CTOR_PROTECTED(&stk, 1, PROTECTION_CANARY);
+    stack_set_growth(&stk, growth);
+
+    GrowthBenchResult result = {};
+
+    double start = now_ms();
+    trace(&stk, &result.reallocs);
+    result.timeMs = now_ms() - start;
+
+    STACK_DTOR(&stk);
+
+    return result;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief Full verification of big stack hashed by calling thread only against hashing threads
+ * @details Usage: HashTree_bench [elements], default is 2^24. Verification recalculates every block of hash tree,
+ * threads take equal parts of blocks. Push + pop cost shows price of tree updates on hot path
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+const size_t HASH_TREE_BENCH_COUNT  = 1 << 24;
+const size_t HASH_TREE_BENCH_ROUNDS = 5;      ///< Best of rounds is printed
+
+static double now_ns();
+static double verify_best(struct Stack* stack);
+
+int main(int argc, const char* argv[])
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : HASH_TREE_BENCH_COUNT;
+
+    #ifndef USE_HASH_PROTECTION
+    printf("Warning: built without USE_HASH_PROTECTION, nothing to measure\n");
+    return 0;
+    #else
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+
+    double start = now_ns();
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+    double pushTime = now_ns() - start;
+
+    printf("%lu elements, %lu blocks of %lu elements, push %.1f ns\n", count, stk.hashLeaves, STACK_HASH_BLOCK,
+           pushTime / (double) count);
+    printf("%-12s %12s %12s\n", "threads", "verify ms", "GB/s");
+
+    const size_t threads[] = {0, 1, 3, STACK_HASH_THREADS_AUTO};
+
+    for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++)
+    {
+        size_t started = stack_hash_threads(threads[i]);
+        double time    = verify_best(&stk);
+
+        char name[32] = "";
+        snprintf(name, sizeof(name), (threads[i] == STACK_HASH_THREADS_AUTO) ? "auto(%lu)" : "%lu", started);
+
+        printf("%-12s %12.2f %12.2f\n", name, time / 1e6, (double) (count * sizeof(elem_t)) / time);
+    }
+
+    STACK_DTOR(&stk);
+
+    return 0;
+
+    #endif
+}
+
+static double now_ns()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static double verify_best(struct Stack* stack)
+{
+    double best = 0;
+
+    for (size_t round = 0; round < HASH_TREE_BENCH_ROUNDS; round++)
+    {
+        double start = now_ns();
+        STACK_VERIFY(stack);
+        double time = now_ns() - start;
+
+        if (round == 0 || time < best) best = time;
+    }
+
+    return best;
+}
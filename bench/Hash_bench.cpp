@@ -0,0 +1,97 @@
+/**
+ * @file
+ * @brief Throughput of hash backends in GB/s on buffers from 64 B to 1 GB
+ * @details Usage: Hash_bench [max buffer size in bytes], default is 1 GB
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+/// @brief Measured variant of hash backend
+struct HashBenchVariant
+{
+    enum hashBackend backend;   ///< Hash algorithm
+    bool             portable;  ///< Forced portable code instead of dispatched one
+};
+
+static double now_ms();
+static double run_variant(const struct HashBenchVariant* variant, const unsigned char* buffer, size_t size);
+
+const size_t HASH_BENCH_MIN_SIZE   = 64;
+const size_t HASH_BENCH_MAX_SIZE   = 1ul << 30;
+const size_t HASH_BENCH_SIZE_STEP  = 16;            ///< Next buffer size is HASH_BENCH_SIZE_STEP times bigger
+const size_t HASH_BENCH_BYTES      = 1ul << 28;     ///< Bytes hashed for every buffer size(at least one pass)
+
+volatile hash_t hashSink = 0;                       ///< Keeps hashes from being optimised out
+
+int main(int argc, const char* argv[])
+{
+    size_t maxSize = (argc > 1) ? strtoul(argv[1], NULL, 10) : HASH_BENCH_MAX_SIZE;
+
+    unsigned char* buffer = (unsigned char*) malloc(maxSize);
+    if (!buffer)
+    {
+        fprintf(stderr, "Can't allocate %lu bytes\n", maxSize);
+        return 1;
+    }
+
+    for (size_t i = 0; i < maxSize; i++) buffer[i] = (unsigned char) (i * 131 + (i >> 12));
+
+    const struct HashBenchVariant variants[] = {{HASH_DJB2, true}, {HASH_WIDE, true}, {HASH_WIDE, false},
+                                                {HASH_CRC32C, true}, {HASH_CRC32C, false}};
+    const size_t variantsCount = sizeof(variants) / sizeof(variants[0]);
+
+    printf("%-12s", "size");
+    for (size_t i = 0; i < variantsCount; i++)
+    {
+        hash_backend_portable(variants[i].portable);
+
+        char title[32] = "";
+        snprintf(title, sizeof(title), "%s/%s", hash_backend_name(variants[i].backend), hash_backend_isa(variants[i].backend));
+        printf(" %16s", title);
+    }
+    printf("   (GB/s)\n");
+
+    for (size_t size = HASH_BENCH_MIN_SIZE; size <= maxSize; size *= HASH_BENCH_SIZE_STEP)
+    {
+        printf("%-12lu", size);
+        for (size_t i = 0; i < variantsCount; i++) printf(" %16.2f", run_variant(&variants[i], buffer, size));
+        printf("\n");
+    }
+
+    hash_backend_portable(false);
+    free(buffer);
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+/// @brief Hashes HASH_BENCH_BYTES bytes in size-byte pieces and returns GB/s
+static double run_variant(const struct HashBenchVariant* variant, const unsigned char* buffer, size_t size)
+{
+    hash_backend_portable(variant->portable);
+
+    size_t passes = HASH_BENCH_BYTES / size;
+    if (!passes) passes = 1;
+
+    double start = now_ms();
+
+    for (size_t pass = 0; pass < passes; pass++) hashSink = hashSink + hash_bytes(variant->backend, buffer, size);
+
+    double time = now_ms() - start;
+
+    hash_backend_portable(false);
+
+    return (double) (passes * size) / (time * 1e6);
+}
@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Push and pop latency tails of contiguous stack against incremental one(resize moved across operations)
+ * @details Usage: Incremental_bench [elements], default is 2^24. Latencies are collected into log2 buckets
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+const size_t INCREMENTAL_BENCH_COUNT   = 1 << 24;
+const size_t INCREMENTAL_BENCH_BUCKETS = 40;
+
+/// @brief Log2 histogram of operation latencies
+struct LatencyHistogram
+{
+    size_t             count;                               ///< Number of operations
+    unsigned long long totalNs;                             ///< Sum of latencies
+    unsigned long long maxNs;                               ///< Largest latency
+    size_t             buckets[INCREMENTAL_BENCH_BUCKETS];  ///< Bucket i counts latencies in [2^i, 2^(i+1)) ns
+};
+
+static unsigned long long now_ns();
+static void record(struct LatencyHistogram* histogram, unsigned long long ns);
+static unsigned long long percentile(const struct LatencyHistogram* histogram, double fraction);
+static void print_histogram(const char* name, const char* operation, const struct LatencyHistogram* histogram);
+static void measure(const char* name, enum storageMode storage, enum protectionLevel protection, size_t count);
+
+int main(int argc, const char* argv[])
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : INCREMENTAL_BENCH_COUNT;
+
+    printf("%lu elements, p50/p99.9 are upper borders of log2 buckets\n", count);
+    printf("%-24s %-5s %10s %10s %12s %12s\n", "storage", "op", "total ms", "p50 ns", "p99.9 ns", "max ns");
+
+    measure("contiguous",          STORAGE_CONTIGUOUS,  PROTECTION_OFF,     count);
+    measure("incremental",         STORAGE_INCREMENTAL, PROTECTION_OFF,     count);
+    measure("contiguous + hash",   STORAGE_CONTIGUOUS,  PROTECTION_DEFAULT, count);
+    measure("incremental + hash",  STORAGE_INCREMENTAL, PROTECTION_DEFAULT, count);
+
+    return 0;
+}
+
+static unsigned long long now_ns()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (unsigned long long) time.tv_sec * 1000000000ull + (unsigned long long) time.tv_nsec;
+}
+
+static void record(struct LatencyHistogram* histogram, unsigned long long ns)
+{
+    size_t bucket = 0;
+    while (bucket + 1 < INCREMENTAL_BENCH_BUCKETS && (ns >> (bucket + 1))) bucket++;
+
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->totalNs += ns;
+
+    if (ns > histogram->maxNs) histogram->maxNs = ns;
+}
+
+static unsigned long long percentile(const struct LatencyHistogram* histogram, double fraction)
+{
+    size_t rank = (size_t) ((double) histogram->count * fraction);
+    size_t seen = 0;
+
+    for (size_t bucket = 0; bucket < INCREMENTAL_BENCH_BUCKETS; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+        if (seen > rank) return 2ull << bucket;
+    }
+
+    return histogram->maxNs;
+}
+
+static void print_histogram(const char* name, const char* operation, const struct LatencyHistogram* histogram)
+{
+    printf("%-24s %-5s %10.1f %10llu %12llu %12llu\n", name, operation, (double) histogram->totalNs / 1e6,
+           percentile(histogram, 0.5), percentile(histogram, 0.999), histogram->maxNs);
+}
+
+static void measure(const char* name, enum storageMode storage, enum protectionLevel protection, size_t count)
+{
+    static struct LatencyHistogram pushes = {};
+    static struct LatencyHistogram pops   = {};
+
+    pushes = {};
+    pops   = {};
+
+    Stack stk = {};
+    STACK_CTOR_EX(&stk, 1, protection, storage);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned long long start = now_ns();
+        STACK_PUSH(&stk, (elem_t) i);
+        record(&pushes, now_ns() - start);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned long long start = now_ns();
+        STACK_POP(&stk);
+        record(&pops, now_ns() - start);
+    }
+
+    STACK_DTOR(&stk);
+
+    print_histogram(name, "push", &pushes);
+    print_histogram(name, "pop",  &pops);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief Growth of large stacks: realloc-ed contiguous buffer against mapped storage(time and peak RSS)
+ * @details Usage: Mapped_bench [elements], default is 2^26. Every run is forked, so that peak RSS belongs to it only
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+/// @brief Measured storage configuration
+struct MappedBenchVariant
+{
+    const char*      name;          ///< Name in output
+    enum storageMode storage;       ///< Storage engine
+    bool             hugePages;     ///< Ask for transparent huge pages(mapped storage only)
+};
+
+static double now_ms();
+static void run_variant(const struct MappedBenchVariant* variant, size_t count);
+static void measure_variant(const struct MappedBenchVariant* variant, size_t count);
+
+const size_t MAPPED_BENCH_COUNT = 1 << 26;
+
+int main(int argc, const char* argv[])
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : MAPPED_BENCH_COUNT;
+
+    const struct MappedBenchVariant variants[] = {{"contiguous",    STORAGE_CONTIGUOUS, false},
+                                                  {"segmented",     STORAGE_SEGMENTED,  false},
+                                                  {"mapped",        STORAGE_MAPPED,     false},
+                                                  {"mapped + THP",  STORAGE_MAPPED,     true}};
+
+    printf("%lu elements(%lu MB)\n", count, count * sizeof(elem_t) >> 20);
+    printf("%-14s %12s %12s %14s\n", "storage", "push ms", "pop ms", "peak RSS MB");
+
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) run_variant(&variants[i], count);
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+static void run_variant(const struct MappedBenchVariant* variant, size_t count)
+{
+    fflush(stdout);
+
+    pid_t child = fork();
+
+    if (child < 0)
+    {
+        perror("fork");
+        exit(1);
+    }
+
+    if (child == 0)
+    {
+        measure_variant(variant, count);
+        exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) fprintf(stderr, "%s failed\n", variant->name);
+}
+
+static void measure_variant(const struct MappedBenchVariant* variant, size_t count)
+{
+    Stack stk = {};
+    STACK_CTOR_EX(&stk, 1, PROTECTION_OFF, variant->storage);
+
+    if (variant->hugePages && stack_set_huge_pages(&stk, true)) printf("(no THP) ");
+
+    double start = now_ms();
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+    double pushTime = now_ms() - start;
+
+    start = now_ms();
+    for (size_t i = 0; i < count; i++) STACK_POP(&stk);
+    double popTime = now_ms() - start;
+
+    STACK_DTOR(&stk);
+
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("%-14s %12.1f %12.1f %14ld\n", variant->name, pushTime, popTime, usage.ru_maxrss >> 10);
+}
@@ -0,0 +1,136 @@
+/**
+ * @file
+ * @brief Throughput of poison fill/scan kernels against scalar loops and cost of poison check on push/pop
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+static double now_ms();
+static void scalar_fill(elem_t* data, size_t count);
+static size_t scalar_find(const elem_t* data, size_t count);
+static double fill_gbs(void (*fill)(elem_t*, size_t), elem_t* data, size_t count);
+static double find_gbs(size_t (*find)(const elem_t*, size_t), const elem_t* data, size_t count);
+static double window_ns(const elem_t* data);
+static double push_pop_ns(enum protectionLevel protection);
+
+const size_t POISON_BENCH_MIN_COUNT = 1 << 8;
+const size_t POISON_BENCH_MAX_COUNT = 1 << 26;
+const size_t POISON_BENCH_ELEMENTS  = 1 << 28;  ///< Elements processed for every buffer size
+const size_t POISON_BENCH_OPS       = 1 << 22;
+
+volatile size_t poisonSink = 0;                 ///< Keeps scan results from being optimised out
+
+int main()
+{
+    elem_t* data = (elem_t*) calloc(POISON_BENCH_MAX_COUNT, sizeof(elem_t));
+    if (!data)
+    {
+        fprintf(stderr, "Can't allocate benchmark buffer\n");
+        return 1;
+    }
+
+    printf("%-10s %14s %14s %14s %14s   (GB/s)\n", "elements", "scalar fill", "poison_fill", "scalar find", "poison_find");
+
+    for (size_t count = POISON_BENCH_MIN_COUNT; count <= POISON_BENCH_MAX_COUNT; count *= 16)
+    {
+        double scalarFill = fill_gbs(scalar_fill, data, count);
+        double vectorFill = fill_gbs(poison_fill, data, count);
+        double scalarFind = find_gbs(scalar_find, data, count);
+        double vectorFind = find_gbs(poison_find, data, count);
+
+        printf("%-10lu %14.2f %14.2f %14.2f %14.2f\n", count, scalarFill, vectorFill, scalarFind, vectorFind);
+    }
+
+    printf("\nwindow scan(%lu elements): %.2f ns\n", POISON_CHECK_WINDOW, window_ns(data));
+    printf("push+pop OFF:    %.2f ns\n", push_pop_ns(PROTECTION_OFF));
+    printf("push+pop CANARY: %.2f ns\n", push_pop_ns(PROTECTION_CANARY));
+
+    free(data);
+
+    return 0;
+}
+
+static double now_ms()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e3 + (double) time.tv_nsec / 1e6;
+}
+
+// Loops the stack used before poison kernels, kept out of line so that they stay scalar
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static void scalar_fill(elem_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) data[i] = ELEM_T_POISON;
+}
+
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static size_t scalar_find(const elem_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (data[i] != ELEM_T_POISON) return i;
+    }
+
+    return count;
+}
+
+static double fill_gbs(void (*fill)(elem_t*, size_t), elem_t* data, size_t count)
+{
+    size_t passes = POISON_BENCH_ELEMENTS / count;
+
+    double start = now_ms();
+    for (size_t pass = 0; pass < passes; pass++) fill(data, count);
+    double time = now_ms() - start;
+
+    return (double) (passes * count * sizeof(elem_t)) / (time * 1e6);
+}
+
+static double find_gbs(size_t (*find)(const elem_t*, size_t), const elem_t* data, size_t count)
+{
+    size_t passes = POISON_BENCH_ELEMENTS / count;
+
+    double start = now_ms();
+    for (size_t pass = 0; pass < passes; pass++) poisonSink = poisonSink + find(data, count);
+    double time = now_ms() - start;
+
+    return (double) (passes * count * sizeof(elem_t)) / (time * 1e6);
+}
+
+/// @brief Cost of one poison_find over POISON_CHECK_WINDOW elements(what every push/pop adds)
+static double window_ns(const elem_t* data)
+{
+    double start = now_ms();
+    for (size_t op = 0; op < POISON_BENCH_OPS; op++) poisonSink = poisonSink + poison_find(data + op % 64, POISON_CHECK_WINDOW);
+    double time = now_ms() - start;
+
+    return time * 1e6 / (double) POISON_BENCH_OPS;
+}
+
+static double push_pop_ns(enum protectionLevel protection)
+{
+    Stack stk = {};
+    STACK_CTOR_PROTECTED(&stk, 1024, protection);
+
+    for (elem_t i = 0; i < 512; i++) STACK_PUSH(&stk, i);
+
+    double start = now_ms();
+
+    for (size_t op = 0; op < POISON_BENCH_OPS; op++)
+    {
+        STACK_PUSH(&stk, (elem_t) op);
+        poisonSink = poisonSink + (size_t) STACK_POP(&stk);
+    }
+
+    double time = now_ms() - start;
+
+    STACK_DTOR(&stk);
+
+    return time * 1e6 / (double) POISON_BENCH_OPS;
+}
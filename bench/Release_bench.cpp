@@ -0,0 +1,161 @@
+/**
+ * @file
+ * @brief Push/pop of release build(make bench_release: STACK_RELEASE, -O3, LTO) against std::vector<int>
+ * @details Usage: Release_bench [elements], default is 2^24. Stack uses GROWTH_NEVER_SHRINK, so that both containers
+ * keep their buffers on pops. Fill pushes all elements from empty container and pops them, steady pushes and pops
+ * short bursts on warm buffer. Sums of popped values are printed so that loops aren't optimised out
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+const size_t RELEASE_BENCH_COUNT  = 1 << 24;
+const size_t RELEASE_BENCH_BURST  = 64;     ///< Elements pushed and popped by one burst of steady workload
+const size_t RELEASE_BENCH_ROUNDS = 5;      ///< Best of rounds is printed
+
+static double now_ns();
+static double stack_fill(size_t count, long long* sum);
+static double vector_fill(size_t count, long long* sum);
+static double stack_steady(size_t count, long long* sum);
+static double vector_steady(size_t count, long long* sum);
+static void compare(const char* name, double (*stack_run)(size_t, long long*), double (*vector_run)(size_t, long long*), size_t count);
+
+int main(int argc, const char* argv[])
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : RELEASE_BENCH_COUNT;
+
+    #ifndef STACK_INLINE_FAST_PATH
+    printf("Warning: built without inline fast paths(use make bench_release)\n");
+    #endif
+
+    printf("%lu elements, best of %lu rounds, ns per push + pop\n", count, RELEASE_BENCH_ROUNDS);
+    printf("%-8s %10s %10s %8s %20s\n", "workload", "stack", "vector", "ratio", "checksum");
+
+    compare("fill",   stack_fill,   vector_fill,   count);
+    compare("steady", stack_steady, vector_steady, count);
+
+    return 0;
+}
+
+static double now_ns()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static double stack_fill(size_t count, long long* sum)
+{
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+    stack_set_growth(&stk, &GROWTH_NEVER_SHRINK);
+
+    long long popped = 0;
+    double    start  = now_ns();
+
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+    for (size_t i = 0; i < count; i++) popped += STACK_POP(&stk);
+
+    double time = now_ns() - start;
+    *sum += popped;
+
+    STACK_DTOR(&stk);
+
+    return time;
+}
+
+static double vector_fill(size_t count, long long* sum)
+{
+    std::vector<int> vec;
+
+    long long popped = 0;
+    double    start  = now_ns();
+
+    for (size_t i = 0; i < count; i++) vec.push_back((int) i);
+    for (size_t i = 0; i < count; i++)
+    {
+        popped += vec.back();
+        vec.pop_back();
+    }
+
+    double time = now_ns() - start;
+    *sum += popped;
+
+    return time;
+}
+
+static double stack_steady(size_t count, long long* sum)
+{
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+    stack_set_growth(&stk, &GROWTH_NEVER_SHRINK);
+
+    for (size_t i = 0; i < RELEASE_BENCH_BURST; i++) STACK_PUSH(&stk, (elem_t) i);
+    for (size_t i = 0; i < RELEASE_BENCH_BURST; i++) STACK_POP(&stk);
+
+    long long popped = 0;
+    double    start  = now_ns();
+
+    for (size_t burst = 0; burst < count / RELEASE_BENCH_BURST; burst++)
+    {
+        for (size_t i = 0; i < RELEASE_BENCH_BURST; i++) STACK_PUSH(&stk, (elem_t) (burst + i));
+        for (size_t i = 0; i < RELEASE_BENCH_BURST; i++) popped += STACK_POP(&stk);
+    }
+
+    double time = now_ns() - start;
+    *sum += popped;
+
+    STACK_DTOR(&stk);
+
+    return time;
+}
+
+static double vector_steady(size_t count, long long* sum)
+{
+    std::vector<int> vec;
+    vec.reserve(RELEASE_BENCH_BURST);
+
+    long long popped = 0;
+    double    start  = now_ns();
+
+    for (size_t burst = 0; burst < count / RELEASE_BENCH_BURST; burst++)
+    {
+        for (size_t i = 0; i < RELEASE_BENCH_BURST; i++) vec.push_back((int) (burst + i));
+        for (size_t i = 0; i < RELEASE_BENCH_BURST; i++)
+        {
+            popped += vec.back();
+            vec.pop_back();
+        }
+    }
+
+    double time = now_ns() - start;
+    *sum += popped;
+
+    return time;
+}
+
+static void compare(const char* name, double (*stack_run)(size_t, long long*), double (*vector_run)(size_t, long long*), size_t count)
+{
+    double    stackBest  = 0;
+    double    vectorBest = 0;
+    long long sum        = 0;
+
+    for (size_t round = 0; round < RELEASE_BENCH_ROUNDS; round++)
+    {
+        double stackTime  = stack_run(count, &sum);
+        double vectorTime = vector_run(count, &sum);
+
+        if (round == 0 || stackTime  < stackBest)  stackBest  = stackTime;
+        if (round == 0 || vectorTime < vectorBest) vectorBest = vectorTime;
+    }
+
+    double ops = (double) (count / RELEASE_BENCH_BURST * RELEASE_BENCH_BURST);
+
+    printf("%-8s %10.3f %10.3f %8.2f %20lld\n", name, stackBest / ops, vectorBest / ops, stackBest / vectorBest, sum);
+}
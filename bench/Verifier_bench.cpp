@@ -0,0 +1,84 @@
+/**
+ * @file
+ * @brief Push/pop of stack verified on every operation against stack watched by background verifier
+ * @details Usage: Verifier_bench [elements], default is 2^20. Built by make bench_verifier(USE_BACKGROUND_VERIFY).
+ * Verifier runs full check(data hash from the scratch) of watched stack every period, writers wait while it reads
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+#include "Verifier.h"
+
+const size_t   VERIFIER_BENCH_COUNT     = 1 << 20;
+const unsigned VERIFIER_BENCH_PERIODS[] = {100, 10, 1};    ///< Verifier periods in ms
+
+static double now_ns();
+static double run(enum protectionLevel protection, size_t count);
+
+int main(int argc, const char* argv[])
+{
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : VERIFIER_BENCH_COUNT;
+
+    #ifndef USE_BACKGROUND_VERIFY
+    printf("Warning: built without USE_BACKGROUND_VERIFY(use make bench_verifier), only hot checks are measured\n");
+    #endif
+
+    printf("%lu elements pushed and popped, ns per push + pop\n", count);
+    printf("%-28s %10s %10s %10s %10s\n", "mode", "ns", "passes", "checks", "busy");
+
+    printf("%-28s %10.1f\n", "no protection", run(PROTECTION_OFF, count));
+    printf("%-28s %10.1f\n", "hot checks", run(PROTECTION_DEFAULT, count));
+
+    #ifdef USE_BACKGROUND_VERIFY
+
+    for (size_t i = 0; i < sizeof(VERIFIER_BENCH_PERIODS) / sizeof(VERIFIER_BENCH_PERIODS[0]); i++)
+    {
+        const struct StackVerifierConfig config = {VERIFIER_BENCH_PERIODS[i], false, stderr, NULL, NULL};
+
+        if (stack_verifier_start(&config)) return 1;
+
+        double time = run(PROTECTION_DEFAULT, count);
+
+        stack_verifier_stop();
+
+        struct StackVerifierStats stats = stack_verifier_stats();
+
+        char mode[32] = "";
+        snprintf(mode, sizeof(mode), "background, %u ms", VERIFIER_BENCH_PERIODS[i]);
+
+        printf("%-28s %10.1f %10lu %10lu %10lu\n", mode, time, stats.passes, stats.checks, stats.busy);
+    }
+
+    #endif
+
+    return 0;
+}
+
+static double now_ns()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static double run(enum protectionLevel protection, size_t count)
+{
+    Stack stk = {};
+    STACK_CTOR_PROTECTED(&stk, 1, protection);
+
+    double start = now_ns();
+
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+    for (size_t i = 0; i < count; i++) STACK_POP(&stk);
+
+    double time = now_ns() - start;
+
+    STACK_DTOR(&stk);
+
+    return time / (double) count;
+}
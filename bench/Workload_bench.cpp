@@ -0,0 +1,329 @@
+/**
+ * @file
+ * @brief Standard stack workloads for regression tracking, run by make bench in every protection configuration
+ * @details Usage: Workload_bench <results.csv> [revision]. Every workload runs in forked process twice:
+ * untimed run gives ns/op, reallocs and peak RSS, run with timer around every operation gives latency percentiles.
+ * One CSV row per workload is appended to results file(header is written to empty file).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+/// @brief Counters of one workload run
+struct WorkloadRun
+{
+    double    startNs;      ///< Time when measured part of workload started(after its setup)
+    size_t    ops;          ///< Number of push and pop operations
+    size_t    reallocs;     ///< Number of capacity changes
+    unsigned* latencies;    ///< Latency of every operation in ns or NULL if not measured
+};
+
+typedef void (*workload_t)(struct Stack* stack, struct WorkloadRun* run);
+
+/// @brief Named workload
+struct Workload
+{
+    const char* name;       ///< Name in results
+    workload_t  function;   ///< Workload itself
+    size_t      maxOps;     ///< Upper bound of operations(size of latencies array)
+};
+
+static double now_ns();
+static unsigned timer_overhead();
+static void run_workload(const struct Workload* workload, FILE* results, const char* revision);
+static void measure_workload(const struct Workload* workload, FILE* results, const char* revision);
+static int compare_latencies(const void* first, const void* second);
+static unsigned percentile(const unsigned* sorted, size_t count, double fraction);
+
+static void push_only(struct Stack* stack, struct WorkloadRun* run);
+static void pop_only(struct Stack* stack, struct WorkloadRun* run);
+static void oscillating(struct Stack* stack, struct WorkloadRun* run);
+static void random_mix(struct Stack* stack, struct WorkloadRun* run);
+static void large_n(struct Stack* stack, struct WorkloadRun* run);
+
+const size_t WORKLOAD_N         = 1 << 20;  ///< Operations of small workloads
+const size_t WORKLOAD_LARGE_N   = 1 << 23;  ///< Elements of large-N workload
+const size_t OSCILLATION_BORDER = 1 << 12;  ///< Size where push reallocates in oscillating workload
+
+unsigned timerOverhead = 0;                 ///< Cost of two clock_gettime calls, subtracted from latencies
+
+/// Timed operation: latency is stored only when run has latencies array
+#define WORKLOAD_OP(run, operation) do{                                                     \
+    if ((run)->latencies)                                                                   \
+    {                                                                                       \
+        double start_ = now_ns();                                                           \
+        operation;                                                                          \
+        double time_  = now_ns() - start_ - timerOverhead;                                  \
+        (run)->latencies[(run)->ops] = (time_ > 0) ? (unsigned) time_ : 0;                  \
+    }                                                                                       \
+    else operation;                                                                         \
+    (run)->ops++;                                                                           \
+}while(0)
+
+/// Marks end of workload setup, time before it isn't counted in ns/op
+#define WORKLOAD_START(run) (run)->startNs = now_ns()
+
+/// Counts capacity change after operation
+#define WORKLOAD_COUNT_REALLOC(stack, run, capacity) do{                                    \
+    if ((stack)->capacity != (capacity))                                                    \
+    {                                                                                       \
+        (capacity) = (stack)->capacity;                                                     \
+        (run)->reallocs++;                                                                  \
+    }                                                                                       \
+}while(0)
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <results.csv> [revision]\n", argv[0]);
+        return 1;
+    }
+
+    FILE* results = fopen(argv[1], "a");
+    if (!results)
+    {
+        fprintf(stderr, "Can't open %s\n", argv[1]);
+        return 1;
+    }
+
+    if (ftell(results) == 0)
+    {
+        fprintf(results, "revision,canary,hash,nodebug,workload,ops,ns_per_op,p50_ns,p99_ns,p999_ns,reallocs,peak_rss_kb\n");
+    }
+    fflush(results);
+
+    const char* revision = (argc > 2) ? argv[2] : "unknown";
+
+    timerOverhead = timer_overhead();
+
+    const struct Workload workloads[] = {{"push_only",   push_only,   WORKLOAD_N},
+                                         {"pop_only",    pop_only,    WORKLOAD_N},
+                                         {"oscillating", oscillating, WORKLOAD_N},
+                                         {"random_mix",  random_mix,  WORKLOAD_N},
+                                         {"large_n",     large_n,     2 * WORKLOAD_LARGE_N}};
+
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) run_workload(&workloads[i], results, revision);
+
+    fclose(results);
+
+    return 0;
+}
+
+static double now_ns()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double) time.tv_sec * 1e9 + (double) time.tv_nsec;
+}
+
+static unsigned timer_overhead()
+{
+    double best = 1e9;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        double start = now_ns();
+        double time  = now_ns() - start;
+
+        if (time < best) best = time;
+    }
+
+    return (unsigned) best;
+}
+
+/// @brief Runs workload in child process, so that peak RSS belongs to this workload only
+static void run_workload(const struct Workload* workload, FILE* results, const char* revision)
+{
+    fflush(stdout);
+
+    pid_t child = fork();
+
+    if (child < 0)
+    {
+        perror("fork");
+        exit(1);
+    }
+
+    if (child == 0)
+    {
+        measure_workload(workload, results, revision);
+
+        fclose(results);
+        exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+    {
+        fprintf(stderr, "Workload %s failed\n", workload->name);
+        exit(1);
+    }
+}
+
+static void measure_workload(const struct Workload* workload, FILE* results, const char* revision)
+{
+    struct WorkloadRun run = {};
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+
+    run.startNs = now_ns();
+    workload->function(&stk, &run);
+    double time = now_ns() - run.startNs;
+
+    STACK_DTOR(&stk);
+
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    size_t ops      = run.ops;
+    size_t reallocs = run.reallocs;
+
+    run = {};
+    run.latencies = (unsigned*) calloc(workload->maxOps, sizeof(unsigned));
+    if (!run.latencies)
+    {
+        fprintf(stderr, "Can't allocate latencies of %s\n", workload->name);
+        exit(1);
+    }
+
+    stk = {};
+    STACK_CTOR(&stk, 1);
+    workload->function(&stk, &run);
+    STACK_DTOR(&stk);
+
+    qsort(run.latencies, run.ops, sizeof(unsigned), compare_latencies);
+
+    int canary = 0, hash = 0, nodebug = 0;
+
+    #ifdef USE_CANARY_PROTECTION
+    canary = 1;
+    #endif
+    #ifdef USE_HASH_PROTECTION
+    hash = 1;
+    #endif
+    #ifdef NO_DEBUG
+    nodebug = 1;
+    #endif
+
+    fprintf(results, "%s,%d,%d,%d,%s,%lu,%.2f,%u,%u,%u,%lu,%ld\n", revision, canary, hash, nodebug, workload->name, ops,
+            time / (double) ops, percentile(run.latencies, run.ops, 0.5), percentile(run.latencies, run.ops, 0.99),
+            percentile(run.latencies, run.ops, 0.999), reallocs, usage.ru_maxrss);
+
+    printf("canary=%d hash=%d nodebug=%d %-12s %8.2f ns/op  p50 %5u  p99 %6u  p999 %7u ns  %6lu reallocs  %8ld KB\n",
+           canary, hash, nodebug, workload->name, time / (double) ops, percentile(run.latencies, run.ops, 0.5),
+           percentile(run.latencies, run.ops, 0.99), percentile(run.latencies, run.ops, 0.999), reallocs, usage.ru_maxrss);
+
+    free(run.latencies);
+}
+
+static int compare_latencies(const void* first, const void* second)
+{
+    unsigned a = *(const unsigned*) first;
+    unsigned b = *(const unsigned*) second;
+
+    return (a > b) - (a < b);
+}
+
+static unsigned percentile(const unsigned* sorted, size_t count, double fraction)
+{
+    if (!count) return 0;
+
+    size_t index = (size_t) (fraction * (double) count);
+    if (index >= count) index = count - 1;
+
+    return sorted[index];
+}
+
+static void push_only(struct Stack* stack, struct WorkloadRun* run)
+{
+    size_t capacity = stack->capacity;
+
+    for (size_t i = 0; i < WORKLOAD_N; i++)
+    {
+        WORKLOAD_OP(run, STACK_PUSH(stack, (elem_t) i));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+    }
+}
+
+static void pop_only(struct Stack* stack, struct WorkloadRun* run)
+{
+    for (size_t i = 0; i < WORKLOAD_N; i++) STACK_PUSH(stack, (elem_t) i);
+
+    WORKLOAD_START(run);
+
+    size_t capacity = stack->capacity;
+
+    for (size_t i = 0; i < WORKLOAD_N; i++)
+    {
+        WORKLOAD_OP(run, STACK_POP(stack));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+    }
+}
+
+/// @brief Pushes and pops two elements over the size where push reallocates
+static void oscillating(struct Stack* stack, struct WorkloadRun* run)
+{
+    while (stack->size < OSCILLATION_BORDER - 1) STACK_PUSH(stack, 0);
+
+    WORKLOAD_START(run);
+
+    size_t capacity = stack->capacity;
+
+    for (size_t i = 0; i < WORKLOAD_N / 4; i++)
+    {
+        WORKLOAD_OP(run, STACK_PUSH(stack, (elem_t) i));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+        WORKLOAD_OP(run, STACK_PUSH(stack, (elem_t) i));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+        WORKLOAD_OP(run, STACK_POP(stack));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+        WORKLOAD_OP(run, STACK_POP(stack));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+    }
+}
+
+/// @brief Random pushes and pops with slight push bias, so stack grows and shrinks through several capacities
+static void random_mix(struct Stack* stack, struct WorkloadRun* run)
+{
+    size_t   capacity = stack->capacity;
+    unsigned random   = 12345;
+
+    for (size_t i = 0; i < WORKLOAD_N; i++)
+    {
+        random = random * 1664525u + 1013904223u;
+
+        if (stack->size && (random >> 16) % 100 < 48) WORKLOAD_OP(run, STACK_POP(stack));
+        else                                           WORKLOAD_OP(run, STACK_PUSH(stack, (elem_t) i));
+
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+    }
+}
+
+static void large_n(struct Stack* stack, struct WorkloadRun* run)
+{
+    size_t capacity = stack->capacity;
+
+    for (size_t i = 0; i < WORKLOAD_LARGE_N; i++)
+    {
+        WORKLOAD_OP(run, STACK_PUSH(stack, (elem_t) i));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+    }
+
+    for (size_t i = 0; i < WORKLOAD_LARGE_N; i++)
+    {
+        WORKLOAD_OP(run, STACK_POP(stack));
+        WORKLOAD_COUNT_REALLOC(stack, run, capacity);
+    }
+}
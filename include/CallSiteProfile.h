@@ -0,0 +1,148 @@
+/**
+ * @file
+ * @brief Call-site profile of stack operations(compiled only with USE_CALL_SITE_PROFILE)
+ * @details Public stack functions open profiling scope with file, line and function of their call site
+ * (the ones STACK_* macros pass for error printing). Outermost scope of thread adds its time, reallocations
+ * and verification time to table keyed by these pointers, nested calls(pop -> realloc -> resize) are
+ * attributed to the outer one. Table is shared by all threads without lock: slots are claimed by CAS and costs
+ * are atomic counters of slot.
+*/
+#ifndef CALL_SITE_PROFILE_H
+#define CALL_SITE_PROFILE_H
+
+#include <stdio.h>
+
+#include "Stack.h"
+
+#ifdef USE_CALL_SITE_PROFILE
+
+const size_t CALL_SITE_TABLE_SIZE = 4096;   ///< Slots of call-site table(power of two), sites over it are dropped
+
+/// @brief Stack function that opened profiling scope
+enum callSiteOp
+{
+    CALL_SITE_CTOR     = 0,
+    CALL_SITE_DTOR     = 1,
+    CALL_SITE_PUSH     = 2,
+    CALL_SITE_POP      = 3,
+    CALL_SITE_PUSH_N   = 4,
+    CALL_SITE_POP_N    = 5,
+    CALL_SITE_REALLOC  = 6,
+    CALL_SITE_RESIZE   = 7,
+    CALL_SITE_TRIM     = 8,
+    CALL_SITE_VERIFY   = 9,
+    CALL_SITE_CLONE    = 10
+};
+
+/// @brief Order of call-site report
+enum callSiteSort
+{
+    CALL_SITE_BY_TIME     = 0,  ///< Cumulative time of calls
+    CALL_SITE_BY_REALLOCS = 1,  ///< Reallocations(chunks taken or released by segmented stacks)
+    CALL_SITE_BY_VERIFY   = 2,  ///< Time spent in verification
+    CALL_SITE_BY_CALLS    = 3   ///< Number of calls
+};
+
+/// @brief Aggregated costs of one call site
+struct CallSite
+{
+    const char*        file;        ///< __FILE__ of call site(key)
+    const char*        func;        ///< __PRETTY_FUNCTION__ of call site(key)
+    int                line;        ///< __LINE__ of call site(key)
+    enum callSiteOp    op;          ///< Stack function called there
+    size_t             calls;       ///< Number of calls
+    unsigned long long totalNs;     ///< Cumulative time of calls
+    size_t             reallocs;    ///< Capacity changes caused by calls
+    unsigned long long reallocNs;   ///< Time of these capacity changes
+    unsigned long long verifyNs;    ///< Time of verification inside calls
+};
+
+/// @brief Profiling scope of one stack call, closed by call_site_leave when it goes out of scope
+struct CallSiteScope
+{
+    const char*        file;        ///< Call site file
+    const char*        func;        ///< Call site function
+    int                line;        ///< Call site line
+    enum callSiteOp    op;          ///< Called stack function
+    unsigned long long start;       ///< Time when scope was opened
+    bool               outer;       ///< Scope isn't nested into another one of this thread
+};
+
+/// Opens profiling scope closed automatically on every return of enclosing function
+#define CALL_SITE_SCOPE(op, file, line, func)                                                                   \
+    struct CallSiteScope callSiteScope_ __attribute__((cleanup(call_site_leave))) = call_site_enter((op), (file), (line), (func))
+
+#define CALL_SITE_TIMER(timer) unsigned long long timer = call_site_now()
+
+#define CALL_SITE_REALLOC(timer) call_site_add_realloc(timer)
+
+#define CALL_SITE_VERIFY(timer) call_site_add_verify(timer)
+
+/**
+ * @brief Function reads monotonic clock for call-site profile
+ * @return Time in ns
+*/
+unsigned long long call_site_now();
+
+/**
+ * @brief Function opens profiling scope(use CALL_SITE_SCOPE)
+ * @return Scope to pass to call_site_leave
+*/
+struct CallSiteScope call_site_enter(enum callSiteOp op, const char* file, int line, const char* func);
+
+/**
+ * @brief Function closes profiling scope, outermost scope adds its costs to call-site table
+ * @param [in] scope Pointer to scope
+*/
+void call_site_leave(struct CallSiteScope* scope);
+
+/**
+ * @brief Function attributes capacity change started at start to current scope of thread
+ * @param [in] start call_site_now() before capacity change
+*/
+void call_site_add_realloc(unsigned long long start);
+
+/**
+ * @brief Function attributes verification started at start to current scope of thread
+ * @param [in] start call_site_now() before verification
+*/
+void call_site_add_verify(unsigned long long start);
+
+/**
+ * @brief Function copies call sites sorted by decreasing cost
+ * @param [out] sites    Array for at least maxCount sites
+ * @param [in]  maxCount Size of sites array
+ * @param [in]  sort     Cost to sort by
+ * @return Number of copied sites
+*/
+size_t call_site_snapshot(struct CallSite* sites, size_t maxCount, enum callSiteSort sort);
+
+/**
+ * @brief Function prints sorted call-site report
+ * @param [in] stream Output stream
+ * @param [in] sort   Cost to sort by
+ * @param [in] limit  Maximum number of printed sites(0 - all)
+*/
+void call_site_report(FILE* stream, enum callSiteSort sort, size_t limit);
+
+/**
+ * @brief Function makes call_site_report(stream, sort, 0) run at process exit
+ * @param [in] stream Output stream(must stay open until exit)
+ * @param [in] sort   Cost to sort by
+*/
+void call_site_report_at_exit(FILE* stream, enum callSiteSort sort);
+
+/// @brief Function forgets all call sites(calls that finish meanwhile may keep part of their costs)
+void call_site_reset();
+
+#else
+
+// Compiled out: no scopes, no clock reads
+#define CALL_SITE_SCOPE(op, file, line, func)
+#define CALL_SITE_TIMER(timer)
+#define CALL_SITE_REALLOC(timer)    do{}while(0)
+#define CALL_SITE_VERIFY(timer)     do{}while(0)
+
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @file
+ * @brief Lock-free concurrent stack(Treiber stack with hazard pointers and elimination array)
+ * @details Every element is a heap node linked to the one below it. Push and pop CAS the top pointer;
+ * popped nodes are retired and freed only when no thread holds hazard pointer to them, so ABA is impossible.
+ * Under contention failed CAS goes to elimination array where push and pop meet and cancel without
+ * touching top. Struct canaries are checked, hashes are not maintained(they would serialise all operations).
+*/
+#ifndef CONCURRENT_STACK_H
+#define CONCURRENT_STACK_H
+
+#include <atomic>
+
+#include "Stack.h"
+
+const size_t CSTACK_CACHE_LINE       = 64;     ///< Alignment of fields written by different threads
+const size_t CSTACK_ELIMINATION_SIZE = 8;      ///< Number of elimination slots
+const size_t CSTACK_ELIMINATION_SPIN = 128;    ///< Iterations push waits in elimination slot for pop
+
+/// @brief Node of concurrent stack
+struct ConcurrentNode
+{
+    elem_t                              value;  ///< Element
+    std::atomic<struct ConcurrentNode*> next;   ///< Node below(reused as retired list link after pop, so racing pop may read it)
+};
+
+/// @brief Elimination slot: pushing thread puts its node here, popping thread takes it
+struct alignas(CSTACK_CACHE_LINE) EliminationSlot
+{
+    std::atomic<struct ConcurrentNode*> node;   ///< Offered node or NULL
+};
+
+/// @brief Concurrent stack struct
+struct ConcurrentStack
+{
+    #ifdef USE_CANARY_PROTECTION
+    canary_t leftCanary;                                                ///< Left protection canary
+    #endif
+
+    alignas(CSTACK_CACHE_LINE) std::atomic<struct ConcurrentNode*> top; ///< Top node or NULL
+    struct EliminationSlot elimination[CSTACK_ELIMINATION_SIZE];        ///< Elimination array
+
+    alignas(CSTACK_CACHE_LINE) std::atomic<int> stackErrors;            ///< Bits of enum errorCode
+    struct StackHomeland stackHomeland;                                 ///< Struct with information about position where stack was initialised
+
+    #ifdef USE_CANARY_PROTECTION
+    canary_t rightCanary;                                               ///< Right protection canary
+    #endif
+};
+
+#define CSTACK_CTOR(stack) do{                                                                  \
+                                                                                                \
+    if(!no_ptr(stderr, (stack), NO_STACK_PTR, __FILE__, __PRETTY_FUNCTION__, __LINE__))         \
+    {                                                                                           \
+        (stack)->stackHomeland = {#stack, __FILE__, __PRETTY_FUNCTION__, __LINE__};             \
+        cstack_ctor((stack), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);                  \
+    }                                                                                           \
+    else print_error(stderr, NO_STACK_PTR);                                                     \
+                                                                                                \
+}while(0)
+
+#define CSTACK_DTOR(stack) cstack_dtor((stack), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define CSTACK_VERIFY(stack) cstack_verify((stack), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define CSTACK_PUSH(stack, value) cstack_push((stack), value, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define CSTACK_POP(stack, value) cstack_pop((stack), (value), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define CSTACK_DUMP(stack) cstack_dump(stdout, (stack), __FILE__, __PRETTY_FUNCTION__, __LINE__)
+
+/**
+ * @brief Function initializes concurrent stack, must not race with other operations on it
+ * @param [out] stack Pointer to stack
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode cstack_ctor(struct ConcurrentStack* stack, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function frees all nodes of concurrent stack, must not race with other operations on it
+ * @details Retired nodes of calling thread and of exited threads are freed too
+ * @param [in] stack Pointer to stack
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode cstack_dtor(struct ConcurrentStack* stack, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function checks canaries and error bits of concurrent stack, safe to call concurrently
+ * @param [in] stack Pointer to stack
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode cstack_verify(struct ConcurrentStack* stack, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function puts value into concurrent stack, lock-free
+ * @param [in] stack Pointer to stack
+ * @param [in] value Value to push
+ * @return Error code and NO_ERRORS if everythind ok
+*/
+enum errorCode cstack_push(struct ConcurrentStack* stack, elem_t value, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function pulls top element from concurrent stack, lock-free
+ * @param [in]  stack Pointer to stack
+ * @param [out] value Popped value(ELEM_T_POISON if stack is empty)
+ * @return EMPTY_STACK if stack is empty, other error code or NO_ERRORS if everythind ok
+*/
+enum errorCode cstack_pop(struct ConcurrentStack* stack, elem_t* value, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function prints homeland, errors and elements of concurrent stack, must not race with push and pop
+ * @param [in] stream Output stream
+ * @param [in] stack  Pointer to stack
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode cstack_dump(FILE* stream, const struct ConcurrentStack* stack, const char* file, const char* func, int line);
+
+/**
+ * @brief Function frees retired nodes of calling thread that are not protected by hazard pointers
+*/
+void cstack_reclaim();
+
+/**
+ * @brief Function counts retired nodes waiting for free in hazard records of all threads
+ * @details Lists of other threads may change during the count, so it is exact only when no thread pops
+ * @return Number of retired nodes
+*/
+size_t cstack_retired_count();
+
+#endif
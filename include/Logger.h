@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @brief Background logger of stack reports
+ * @details While logger runs, stack_report_end hands rendered reports(stack_dump, background verifier failures) to
+ * logger thread through lock-free ring of STACK_LOGGER_RING slots instead of writing them, so faulting thread
+ * doesn't wait for output. Every slot has STACK_DUMP_BUFFER bytes allocated by the first start, report is copied into
+ * slot it claims without allocation. Report that finds ring full is dropped and counted. Streams reports go to must stay
+ * open until stack_logger_flush or stack_logger_stop returns
+*/
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+
+#include "Stack.h"
+
+/// @brief Settings of logger
+struct StackLoggerConfig
+{
+    FILE* stream;   ///< All reports are written here(NULL - every report goes to stream it was made for)
+};
+
+/// @brief Counters of logger since stack_logger_start
+struct StackLoggerStats
+{
+    size_t posted;      ///< Reports put into ring(report longer than STACK_DUMP_BUFFER takes several slots)
+    size_t written;     ///< Reports written by logger thread
+    size_t dropped;     ///< Reports lost because ring was full
+};
+
+/**
+ * @brief Function starts logger thread(running one is stopped first)
+ * @param [in] config Pointer to settings
+ * @return Error code(NO_MEMORY if thread or slots can't be allocated) or NO_ERRORS if everything ok
+*/
+enum errorCode stack_logger_start(const struct StackLoggerConfig* config);
+
+/// @brief Function stops logger thread after it writes all posted reports
+void stack_logger_stop();
+
+/// @brief Function waits until logger thread writes all reports posted before the call
+void stack_logger_flush();
+
+/**
+ * @brief Function returns counters of logger
+ * @return Counters since last start
+*/
+struct StackLoggerStats stack_logger_stats();
+
+/**
+ * @brief Function hands report to logger thread(used by stack_report_end)
+ * @param [in] stream Stream report was made for
+ * @param [in] text   Report, it is copied
+ * @param [in] length Length of report
+ * @return True if logger runs and took report(posted or dropped), false if caller has to write it
+*/
+bool stack_logger_post(FILE* stream, const char* text, size_t length);
+
+#endif
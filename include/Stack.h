@@ -8,8 +8,30 @@
 typedef int elem_t;
 const elem_t ELEM_T_POISON = 2147483647;
 
+// Release build(-D STACK_RELEASE, make release does so) has no protections and no verification
+#ifdef STACK_RELEASE
+#ifndef NO_DEBUG
+#define NO_DEBUG
+#endif
+#define NO_CANARY_PROTECTION
+#define NO_HASH_PROTECTION
+#endif
+
+// Protections can be switched off from compiler flags(-D NO_CANARY_PROTECTION, -D NO_HASH_PROTECTION), make bench does so
+#ifndef NO_CANARY_PROTECTION
 #define USE_CANARY_PROTECTION
+#endif
+#ifndef NO_HASH_PROTECTION
 #define USE_HASH_PROTECTION
+#endif
+#define USE_INCREMENTAL_HASH      ///< Data hash is updated per push/pop instead of full rehash (needs USE_HASH_PROTECTION)
+#define USE_INLINE_BUFFER         ///< Small contiguous stacks keep data inside struct Stack instead of heap
+#ifndef STACK_RELEASE
+#define USE_POISON_CHECK          ///< Verification checks that elements above top still hold ELEM_T_POISON
+#endif
+// #define USE_STACK_STATS        ///< Per-stack operation counters and latency histograms(stack_stats), make test_stats defines it
+// #define USE_CALL_SITE_PROFILE  ///< Costs of stack calls aggregated per call site(CallSiteProfile.h), make test_profile defines it
+// #define USE_BACKGROUND_VERIFY  ///< Registry of stacks checked by verifier thread(Verifier.h), make test_verifier and make bench_verifier define it
 
 #ifdef USE_CANARY_PROTECTION
 
@@ -19,15 +41,70 @@ const canary_t CANARY_T_POISON  = 18446744073709;
 
 #endif
 
+// Build without verification, protections and counters has nothing to do on push/pop besides element access,
+// so STACK_PUSH and STACK_POP use inline fast paths(stack_push_inline, stack_pop_inline)
+#if defined(NO_DEBUG) && !defined(USE_CANARY_PROTECTION) && !defined(USE_HASH_PROTECTION) && \
+    !defined(USE_STACK_STATS) && !defined(USE_CALL_SITE_PROFILE) && !defined(USE_BACKGROUND_VERIFY)
+#define STACK_INLINE_FAST_PATH
+#endif
+
 #ifdef USE_HASH_PROTECTION
 
 typedef unsigned long long hash_t;
 
+/// @brief Algorithm of byte hashes of stack(struct hash and non-incremental data hash), recorded in stack
+enum hashBackend
+{
+    HASH_DJB2   = 0,    ///< Byte-at-a-time djb2(reference)
+    HASH_WIDE   = 1,    ///< Four independent 64-bit lanes per 32-byte stripe(SSE2/AVX2 when CPU has them)
+    HASH_CRC32C = 2     ///< CRC32C(SSE4.2 crc32 instruction when CPU has it)
+};
+
+const size_t HASH_BACKEND_COUNT = 3;
+const size_t WIDE_HASH_LANES    = 4;    ///< 64-bit lanes of HASH_WIDE
+const size_t WIDE_HASH_STRIPE   = 32;   ///< Bytes consumed by all lanes of HASH_WIDE at once
+
+const size_t STACK_HASH_BLOCK        = 256;          ///< Elements of one data block, leaf of hash tree
+const size_t STACK_HASH_PARALLEL     = 64;           ///< Blocks from which full data hash is spread over hashing threads
+const size_t STACK_HASH_THREADS_MAX  = 16;           ///< Hashing threads besides the calling one
+const size_t STACK_HASH_THREADS_AUTO = (size_t) -1;  ///< stack_hash_threads: one less than hardware threads
+const size_t STACK_HASH_DUMP_BLOCKS  = 8;            ///< Corrupted blocks listed by stack_dump
+
+#else
+
+#undef USE_INCREMENTAL_HASH
+
 #endif
 
-const size_t REALLOC_COEF        = 2;
-const size_t SIZE_POISON_VAL     = 18446744073709;
-const size_t CAPACITY_POISON_VAL = 18446744073709;
+const size_t REALLOC_COEF         = 2;
+const size_t STACK_CHUNK_CAPACITY = 1024;   ///< Elements in one chunk of segmented stack
+const size_t STACK_INLINE_CAPACITY = 16;    ///< Elements in inline buffer of struct Stack
+const size_t STACK_MAPPED_RESERVE = 1ul << 34;   ///< Virtual range reserved by mapped stack(more if start capacity needs it)
+const size_t STACK_HUGE_PAGE_SIZE = 1ul << 21;   ///< Alignment of reserved range, so that transparent huge pages can back it
+const size_t STACK_GUARDED_REGISTRY = 256;      ///< Guarded stacks SIGSEGV handler can find(faults in others aren't dumped)
+const size_t STACK_GUARDED_MESSAGE  = 4096;     ///< Bytes of static buffer SIGSEGV handler formats its report in
+const size_t STACK_GUARDED_ELEMENTS = 16;       ///< Top elements SIGSEGV handler prints
+const size_t STACK_GUARDED_ALTSTACK = 1 << 16;  ///< Bytes of signal stack of every thread that creates guarded stack
+const size_t STACK_WATCH_REGISTRY   = 256;      ///< Stacks background verifier can watch(others keep only hot-path checks)
+const size_t STACK_VERIFY_SPIN      = 1000;     ///< Yields verifier waits for operation in progress before it skips stack
+const size_t STACK_DUMP_BUFFER      = 1 << 16;  ///< Bytes of per-thread buffer reports are rendered into before one write
+const size_t STACK_DUMP_REPEATS     = 64;       ///< Stacks whose repeated dumps rate limit remembers at once
+const size_t STACK_DUMP_POISON_RUN  = 4;        ///< Shortest run of POISON above top FULL dump prints as one line
+const size_t STACK_LOGGER_RING      = 256;      ///< Reports waiting for logger thread(more are dropped)
+const unsigned STACK_LOGGER_PERIOD_MS = 10;     ///< Longest sleep of logger thread with reports in ring
+const char STACK_SNAPSHOT_MAGIC[8]   = "STKSNAP";  ///< First bytes of snapshot file
+const unsigned STACK_SNAPSHOT_VERSION = 1;         ///< Snapshot format version, files of other versions are rejected
+const char STACK_DUMP_MAGIC[8]       = "STKDUMP";  ///< First bytes of binary dump record
+const unsigned STACK_DUMP_VERSION     = 1;         ///< Binary dump format version, records of other versions aren't decoded
+const unsigned long long STACK_DUMP_POISON_FLAG = 1ull << 63;  ///< Bit of run header: run of ELEM_T_POISON without elements
+const unsigned STACK_DUMP_CANARIES      = 1 << 0;  ///< StackDumpHeader::flags: struct canaries are filled
+const unsigned STACK_DUMP_DATA_CANARIES = 1 << 1;  ///< StackDumpHeader::flags: data canaries are filled
+const unsigned STACK_DUMP_HASHES        = 1 << 2;  ///< StackDumpHeader::flags: hash backend and hashes are filled
+const size_t STACK_MIGRATE_STEP   = 16;     ///< Least elements moved and poisoned by every push/pop of incremental stack during resize
+const size_t POISON_CHECK_WINDOW  = 16;     ///< Elements above top checked on push/pop(stack_verify checks all of them)
+const size_t POISON_INTACT        = (size_t) -1;    ///< stack_poison_find result when all checked elements are poison
+const size_t SIZE_POISON_VAL      = 18446744073709;
+const size_t CAPACITY_POISON_VAL  = 18446744073709;
 
 /// @brief enum with stack error codes
 enum errorCode
@@ -45,7 +122,10 @@ enum errorCode
     LEFT_DATA_CANARY_BAD_VALUE      = 1 << 9,   ///< Bad value of right canary
     RIGHT_DATA_CANARY_BAD_VALUE     = 1 << 10,  ///< Bad value of right canary
     BAD_STRUCT_HASH                 = 1 << 11,  ///< Bad struct hash
-    BAD_DATA_HASH                   = 1 << 12   ///< Bad data hash
+    BAD_DATA_HASH                   = 1 << 12,  ///< Bad data hash
+    BAD_HASH_BACKEND                = 1 << 13,  ///< Hash backend recorded in stack is unknown
+    POISON_OVERWRITTEN              = 1 << 14,  ///< Element above top of stack isn't ELEM_T_POISON
+    FILE_ERROR                      = 1 << 15   ///< Snapshot file or binary dump record can't be written or read, or has other format
 };
 
 /// @brief Struct with information about position where stack was initialised
@@ -57,11 +137,262 @@ struct StackHomeland
     int         line;             ///< Line of file where struvt was init
 };
 
+/// @brief Protection level of stack, chosen in stack_ctor. Every level includes all checks of lower levels
+/// @details Data hash covers elements [0, size) only: poison above top and data canaries are left to checks of
+/// PROTECTION_CANARY. With PROTECTION_HASH push and pop recheck only block of top before they change it, corruption of
+/// lower blocks is found by stack_verify, background verifier or PROTECTION_PARANOID
+enum protectionLevel
+{
+    PROTECTION_OFF      = 0,    ///< No verification, no canary checks, no hashes and no poison filling
+    PROTECTION_CANARY   = 1,    ///< Verification of pointers, size, canaries and poison filling
+    PROTECTION_HASH     = 2,    ///< Struct hash and (incremental) data hash maintenance, block of top is rechecked
+    PROTECTION_PARANOID = 3     ///< Data hash recalculated from the scratch on every operation
+};
+
+#if defined(USE_HASH_PROTECTION)
+const enum protectionLevel PROTECTION_DEFAULT = PROTECTION_HASH;
+#elif defined(USE_CANARY_PROTECTION)
+const enum protectionLevel PROTECTION_DEFAULT = PROTECTION_CANARY;
+#else
+const enum protectionLevel PROTECTION_DEFAULT = PROTECTION_OFF;
+#endif
+
+/// @brief Storage engine of stack, chosen in stack_ctor
+enum storageMode
+{
+    STORAGE_CONTIGUOUS = 0,     ///< One realloc-ed buffer between two data canaries
+    STORAGE_SEGMENTED  = 1,     ///< Linked list of fixed-size chunks, elements never move and push never copies
+    STORAGE_MAPPED     = 2,     ///< Reserved virtual range with pages committed on growth, buffer never moves and growth never copies
+    STORAGE_GUARDED    = 3,     ///< Elements fill whole pages between two PROT_NONE guard pages: overflow faults at once
+    STORAGE_SNAPSHOT   = 4,     ///< Private copy-on-write mapping of snapshot file(made by stack_load), first resize moves it to allocator
+    STORAGE_INCREMENTAL = 5     ///< Contiguous buffer whose growth and shrink move elements STACK_MIGRATE_STEP per operation
+};
+
+/**
+ * @brief Resize of incremental stack in progress
+ * @details Elements [0, pending) are still in old buffer, elements [pending, size) are in data. Tail of data
+ * [size, poisoned) is poison, the rest of it isn't filled yet. Without migration oldData is NULL, pending is 0
+ * and poisoned is capacity
+*/
+struct StackMigration
+{
+    elem_t* oldData;        ///< Old buffer with data canaries(NULL - all elements are moved)
+    size_t  oldCapacity;    ///< Capacity of old buffer
+    size_t  pending;        ///< Number of elements left in old buffer, steps move the top ones
+    size_t  poisoned;       ///< End of poisoned tail of data
+    size_t  step;           ///< Elements moved and poisoned per pushed or popped element, migration ends before next resize
+};
+
+/// @brief Fixed-size chunk of segmented stack
+struct StackChunk
+{
+    #ifdef USE_CANARY_PROTECTION
+    canary_t leftCanary;                    ///< Left chunk canary
+    #endif
+
+    struct StackChunk* prev;                ///< Chunk with lower elements
+    size_t refs;                            ///< References from stacks and from chunks above(clones share chunks)
+    elem_t data[STACK_CHUNK_CAPACITY];      ///< Elements
+
+    #ifdef USE_CANARY_PROTECTION
+    canary_t rightCanary;                   ///< Right chunk canary
+    #endif
+};
+
+/**
+ * @brief Allocator of stack buffers(contiguous data with data canaries and segmented chunks)
+ * @details Stack passes block sizes back on reallocation and free, so allocator doesn't need block headers
+*/
+struct StackAllocator
+{
+    const char* name;                                                                               ///< Allocator name for dumps
+    void* (*allocate)  (struct StackAllocator* allocator, size_t size);                             ///< New block(not zeroed) or NULL
+    void* (*reallocate)(struct StackAllocator* allocator, void* block, size_t oldSize, size_t size); ///< Moved block or NULL(old block stays valid)
+    void  (*deallocate)(struct StackAllocator* allocator, void* block, size_t size);                ///< Frees block of size bytes
+};
+
+extern struct StackAllocator STACK_HEAP_ALLOCATOR;     ///< calloc/realloc/free(default)
+
+const size_t ARENA_CLASS_COUNT = 10;        ///< Number of arena size classes
+const size_t ARENA_MIN_CLASS   = 32;        ///< Smallest size class in bytes, each next one is twice bigger
+const size_t ARENA_SLAB_SIZE   = 1 << 16;   ///< Size of memory block arena carves small blocks from
+
+/// @brief Header of arena slab or big block
+struct StackArenaBlock
+{
+    struct StackArenaBlock* prev;   ///< Previous block in list
+    struct StackArenaBlock* next;   ///< Next block in list
+};
+
+/**
+ * @brief Size-class pool of stack buffers, single-threaded
+ * @details Blocks up to ARENA_MIN_CLASS << (ARENA_CLASS_COUNT - 1) bytes are carved from slabs and reused
+ * through per-class free lists, bigger ones are taken from heap and linked into list. stack_arena_dtor releases
+ * memory of all stacks created in arena at once.
+*/
+struct StackArena
+{
+    struct StackAllocator   allocator;                      ///< Allocator of arena(must be first member)
+    struct StackArenaBlock* slabs;                          ///< List of slabs
+    struct StackArenaBlock* bigBlocks;                      ///< List of blocks bigger than size classes
+    char*                   slabTop;                        ///< Free part of current slab
+    char*                   slabEnd;                        ///< End of current slab
+    void*                   freeLists[ARENA_CLASS_COUNT];   ///< Freed blocks of each size class
+    size_t                  used;                           ///< Bytes given to stacks(rounded up to size classes)
+    size_t                  reserved;                       ///< Bytes taken from heap
+};
+
+/// @brief Capacity strategy of stack: decides how buffer grows on push and shrinks on pop
+struct GrowthStrategy
+{
+    const char* name;                                                               ///< Strategy name for dumps
+    size_t (*grow)       (const struct GrowthStrategy* strategy, size_t capacity);  ///< New capacity of full stack
+    size_t (*shrink_size)(const struct GrowthStrategy* strategy, size_t capacity);  ///< Pop shrinks buffer when size <= this value(0 - never)
+    size_t (*shrink)     (const struct GrowthStrategy* strategy, size_t capacity);  ///< New capacity after shrink
+    size_t numerator;                                                               ///< Growth factor numerator
+    size_t denominator;                                                             ///< Growth factor denominator
+    size_t shrinkDivisor;                                                           ///< Shrink when size <= capacity / shrinkDivisor(0 - no automatic shrink)
+    bool   allowTrim;                                                               ///< stack_trim may release memory
+};
+
+/// @brief Initializer of geometric strategy: capacity * numerator / denominator on growth, inverse on shrink
+#define GROWTH_GEOMETRIC(name, numerator, denominator, shrinkDivisor) \
+    {name, geometric_grow, geometric_shrink_size, geometric_shrink, numerator, denominator, shrinkDivisor, true}
+
+extern const struct GrowthStrategy GROWTH_DOUBLE;         ///< x2 growth, halve when size <= capacity / 4(default)
+extern const struct GrowthStrategy GROWTH_ONE_AND_HALF;   ///< x1.5 growth, shrink when size <= capacity / 3
+extern const struct GrowthStrategy GROWTH_HYSTERESIS;     ///< x2 growth, halve only when size <= capacity / 8
+extern const struct GrowthStrategy GROWTH_NEVER_SHRINK;   ///< x2 growth, capacity never decreases(even by stack_trim)
+extern const struct GrowthStrategy GROWTH_TRIM_ONLY;      ///< x2 growth, buffer shrinks only by stack_trim
+
+#ifdef USE_INLINE_BUFFER
+
+/// @brief Buffer embedded into struct Stack, laid out like heap buffer(data canaries around elements)
+struct StackInlineBuffer
+{
+    #ifdef USE_CANARY_PROTECTION
+    canary_t leftCanary;                    ///< Left data canary
+    #endif
+
+    elem_t data[STACK_INLINE_CAPACITY];     ///< Elements
+
+    #ifdef USE_CANARY_PROTECTION
+    canary_t rightCanary;                   ///< Right data canary
+    #endif
+};
+
+#ifdef USE_CANARY_PROTECTION
+static_assert((STACK_INLINE_CAPACITY * sizeof(elem_t)) % sizeof(canary_t) == 0, "Inline buffer must not need canary alignment");
+#endif
+
+#endif
+
 enum stackDumpMode {
     FULL,
     SHORT
 };
 
+/// @brief Output format of stack_dump
+enum stackDumpFormat {
+    DUMP_DEFAULT,   ///< Format set by stack_dump_format(TEXT unless changed), dumps made on verification errors use it
+    DUMP_TEXT,      ///< Colored text for terminal
+    DUMP_JSON,      ///< One JSON object per line
+    DUMP_BINARY     ///< Binary record(StackDumpHeader), stack_dump_decode prints it
+};
+
+#ifdef USE_STACK_STATS
+
+const size_t STACK_STATS_BUCKETS = 32;  ///< Latency histogram buckets, bucket i counts latencies in [2^i, 2^(i+1)) ns
+
+/// @brief Log-bucket latency histogram
+struct StackLatencyHistogram
+{
+    size_t             count;                           ///< Number of measured calls
+    unsigned long long totalNs;                         ///< Sum of latencies
+    unsigned long long maxNs;                           ///< Largest latency
+    size_t             buckets[STACK_STATS_BUCKETS];    ///< Bucket i counts latencies in [2^i, 2^(i+1)) ns(bucket 0 also counts 0 ns)
+};
+
+/// @brief Operation counters of stack, returned by stack_stats
+struct StackStats
+{
+    size_t pushes;                                  ///< Pushed elements(stack_push_n counts each of them)
+    size_t pops;                                    ///< Popped elements
+    size_t grows;                                   ///< Buffer reallocations to bigger capacity(chunks taken by segmented stack)
+    size_t shrinks;                                 ///< Buffer reallocations to smaller capacity(chunks released by segmented stack)
+    size_t verifies;                                ///< Verification calls
+    size_t hashedBytes;                             ///< Bytes passed through full struct and data hashes
+    size_t peakSize;                                ///< Largest size
+    size_t peakCapacity;                            ///< Largest capacity
+
+    struct StackLatencyHistogram verifyLatency;     ///< Latency of verification
+    struct StackLatencyHistogram hashLatency;       ///< Latency of full struct and data hashes
+    struct StackLatencyHistogram reallocLatency;    ///< Latency of buffer reallocation(chunk take/release for segmented stack)
+};
+
+#endif
+
+/**
+ * @brief Header of snapshot file written by stack_save
+ * @details Header is followed by buffer in contiguous layout(left data canary, capacity elements with poison above top,
+ * right data canary) at dataOffset, which is page-aligned so that stack_load can map it. Numbers are in byte order of writer.
+*/
+struct StackSnapshotHeader
+{
+    char               magic[8];        ///< STACK_SNAPSHOT_MAGIC
+    unsigned           version;         ///< STACK_SNAPSHOT_VERSION
+    unsigned           elemSize;        ///< sizeof(elem_t) of writer
+    unsigned           canarySize;      ///< sizeof(canary_t) of writer(0 - buffer has no data canaries)
+    unsigned           hashSize;        ///< sizeof(hash_t) of writer(0 - no hashes, file can't be verified)
+    unsigned           protection;      ///< Protection level of saved stack
+    unsigned           storage;         ///< Storage engine of saved stack(loaded one is always contiguous)
+    unsigned           hashBackend;     ///< Algorithm of stack hashes and of both file hashes
+    unsigned           padding;         ///< Zero
+    unsigned long long size;            ///< Number of elements
+    unsigned long long capacity;        ///< Elements in buffer
+    unsigned long long dataOffset;      ///< File offset of buffer(multiple of page size of writer)
+    unsigned long long dataBytes;       ///< stack_buffer_size(capacity)
+    unsigned long long dataHash;        ///< Hash of buffer bytes
+    unsigned long long headerHash;      ///< Hash of header with this field zeroed
+};
+
+/**
+ * @brief Header of binary dump record written by stack_dump
+ * @details Header is followed by stringBytes of five null-terminated strings(stack name, file and function of
+ * its initialisation, file and function of dump) and by runs that cover elements from the bottom. Run starts with
+ * unsigned long long count: with STACK_DUMP_POISON_FLAG it stands for count ELEM_T_POISON elements, otherwise
+ * count elements follow it. Numbers are in byte order of writer.
+*/
+struct StackDumpHeader
+{
+    char               magic[8];        ///< STACK_DUMP_MAGIC
+    unsigned           version;         ///< STACK_DUMP_VERSION
+    unsigned           elemSize;        ///< sizeof(elem_t) of writer
+    unsigned           mode;            ///< stackDumpMode of dump
+    unsigned           flags;           ///< STACK_DUMP_CANARIES, STACK_DUMP_DATA_CANARIES, STACK_DUMP_HASHES
+    unsigned           errors;          ///< stackErrors of stack
+    unsigned           protection;      ///< Protection level of stack
+    unsigned           storage;         ///< Storage engine of stack
+    unsigned           hashBackend;     ///< Algorithm of stack hashes
+    int                line;            ///< Line of dump
+    int                homelandLine;    ///< Line of stack initialisation
+    unsigned           stringBytes;     ///< Bytes of strings after header
+    unsigned           padding;         ///< Zero
+    unsigned long long recordBytes;     ///< Bytes of whole record(header, strings and runs)
+    unsigned long long stack;           ///< Address of stack
+    unsigned long long size;            ///< Number of elements
+    unsigned long long capacity;        ///< Capacity of stack
+    unsigned long long elements;        ///< Elements covered by runs
+    unsigned long long runs;            ///< Number of runs
+    unsigned long long suppressed;      ///< Dumps of stack skipped by rate limit before this one
+    unsigned long long leftCanary;      ///< Left struct canary
+    unsigned long long rightCanary;     ///< Right struct canary
+    unsigned long long leftDataCanary;  ///< Left data canary
+    unsigned long long rightDataCanary; ///< Right data canary
+    unsigned long long structHash;      ///< Struct hash
+    unsigned long long dataHash;        ///< Data hash(root of hash tree)
+};
+
 /// @brief Stack struct
 struct Stack
 {
@@ -73,15 +404,46 @@ struct Stack
     size_t  size;                         ///< Stack size(position of last element in array)
     size_t  capacity;                     ///< Capacity of stack(max length of stack array)
 
+    const struct GrowthStrategy* growth;  ///< Capacity strategy of stack
+    size_t  shrinkSize;                   ///< Pop shrinks buffer when size <= shrinkSize(cached from growth)
+
+    struct StackAllocator* allocator;     ///< Allocator of data buffer and chunks
+
+    struct StackChunk* topChunk;          ///< Chunk with top element(segmented storage only)
+    struct StackChunk* spareChunk;        ///< Cached empty chunk(segmented storage only)
+
+    size_t  reservedBytes;                ///< Size of reserved virtual range(mapped storage) or of file mapping(snapshot storage)
+    size_t* bufferRefs;                   ///< Number of clones sharing contiguous buffer(NULL - buffer is private)
+
+    struct StackMigration migration;      ///< Resize in progress(incremental storage only)
+
     enum errorCode stackErrors;           ///< Enum with all of stack errors
+    enum protectionLevel protection;      ///< Protection level of this stack
+    enum storageMode     storage;         ///< Storage engine of this stack
 
     #ifdef USE_HASH_PROTECTION
     hash_t structHash;
-    hash_t dataHash;
+    hash_t dataHash;                      ///< Root of hash tree
+    enum hashBackend hashBackend;         ///< Algorithm of struct hash and non-incremental data hash
+    struct HashTree* hashTree;            ///< Hash tree of data blocks(NULL - empty stack)
+    size_t  hashLeaves;                   ///< Leaves of hash tree(power of two), blocks above size hash to 0
+    size_t* hashTreeRefs;                 ///< Number of clones sharing hash tree(NULL - tree is private)
     #endif
 
     struct StackHomeland stackHomeland;   ///< Struct with information about position where stack was initialised
 
+    #ifdef USE_INLINE_BUFFER
+    struct StackInlineBuffer inlineBuffer;  ///< Data of small contiguous stack(data points here), covered by struct hash
+    #endif
+
+    #ifdef USE_STACK_STATS
+    struct StackStats* stats;             ///< Counters kept outside of struct, so that hashes don't cover them(NULL if not allocated)
+    #endif
+
+    #ifdef USE_BACKGROUND_VERIFY
+    struct StackWatch* watch;             ///< Slot in registry of background verifier(NULL - not watched), not covered by struct hash
+    #endif
+
     #ifdef USE_CANARY_PROTECTION
     canary_t rightCanary;                 ///< Right protection canary
     #endif
@@ -101,22 +463,104 @@ struct Stack
 
 #define STACK_VERIFY(stack) stack_verify((stack), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
 
-#define STACK_CTOR(stack, capacity) do{                                                         \
-                                                                                                \
-    if(!no_ptr(stderr, (stack), NO_STACK_PTR, __FILE__, __PRETTY_FUNCTION__, __LINE__))         \
-    {                                                                                           \
-        (stack)->stackHomeland = {#stack, __FILE__, __PRETTY_FUNCTION__, __LINE__};             \
-        stack_ctor((stack), capacity, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);         \
-    }                                                                                           \
-    else print_error(stderr, NO_STACK_PTR);                                                     \
-                                                                                                \
+#define STACK_CTOR_ALLOC(stack, capacity, protection, storage, allocator) do{                                            \
+                                                                                                                            \
+    if(!no_ptr(stderr, (stack), NO_STACK_PTR, __FILE__, __PRETTY_FUNCTION__, __LINE__))                                     \
+    {                                                                                                                       \
+        (stack)->stackHomeland = {#stack, __FILE__, __PRETTY_FUNCTION__, __LINE__};                                         \
+        stack_ctor((stack), capacity, protection, storage, allocator, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);     \
+    }                                                                                                                       \
+    else print_error(stderr, NO_STACK_PTR);                                                                                 \
+                                                                                                                            \
 }while(0)
 
+#define STACK_CTOR_EX(stack, capacity, protection, storage) STACK_CTOR_ALLOC(stack, capacity, protection, storage, NULL)
+
+#define STACK_CTOR_ARENA(stack, capacity, arena) STACK_CTOR_ALLOC(stack, capacity, PROTECTION_DEFAULT, STORAGE_CONTIGUOUS, &(arena)->allocator)
+
+#define STACK_CTOR_PROTECTED(stack, capacity, protection) STACK_CTOR_EX(stack, capacity, protection, STORAGE_CONTIGUOUS)
+
+#define STACK_CTOR(stack, capacity) STACK_CTOR_PROTECTED(stack, capacity, PROTECTION_DEFAULT)
+
+#ifdef STACK_INLINE_FAST_PATH
+
+#define STACK_PUSH(stack, value) stack_push_inline((stack), value)
+
+#define STACK_POP(stack) stack_pop_inline((stack))
+
+#else
+
 #define STACK_PUSH(stack, value) stack_push((stack), value, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
  
 #define STACK_POP(stack) stack_pop((stack), stdout, __FILE__, __LINE__, __PRETTY_FUNCTION__)
 
-#define STACK_DUMP(stack, mode) stack_dump(stdout, (stack), __FILE__, __PRETTY_FUNCTION__, __LINE__, mode)
+#endif
+
+#define STACK_PUSH_N(stack, values, count) stack_push_n((stack), (values), (count), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define STACK_POP_N(stack, values, count) stack_pop_n((stack), (values), (count), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define STACK_RESIZE(stack, capacity) stack_resize((stack), (capacity), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define STACK_TRIM(stack) stack_trim((stack), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define STACK_CLONE(clone, stack) do{                                                               \
+                                                                                                    \
+    if(!no_ptr(stderr, (clone), NO_STACK_PTR, __FILE__, __PRETTY_FUNCTION__, __LINE__))             \
+    {                                                                                               \
+        (clone)->stackHomeland = {#clone, __FILE__, __PRETTY_FUNCTION__, __LINE__};                 \
+        stack_clone((clone), (stack), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);             \
+    }                                                                                               \
+    else print_error(stderr, NO_STACK_PTR);                                                         \
+                                                                                                    \
+}while(0)
+
+#define STACK_SAVE(stack, path) stack_save((stack), (path), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define STACK_LOAD(stack, path) do{                                                                 \
+                                                                                                    \
+    if(!no_ptr(stderr, (stack), NO_STACK_PTR, __FILE__, __PRETTY_FUNCTION__, __LINE__))             \
+    {                                                                                               \
+        (stack)->stackHomeland = {#stack, __FILE__, __PRETTY_FUNCTION__, __LINE__};                 \
+        stack_load((stack), (path), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);               \
+    }                                                                                               \
+    else print_error(stderr, NO_STACK_PTR);                                                         \
+                                                                                                    \
+}while(0)
+
+#define STACK_SET_HASH(stack, backend) stack_set_hash_backend((stack), (backend), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#ifdef USE_STACK_STATS
+
+#define STACK_STATS_ADD(stack, counter, value) do{                                                   \
+    if ((stack)->stats) (stack)->stats->counter += (value);                                         \
+}while(0)
+
+#define STACK_STATS_PEAK(stack) do{                                                                  \
+    if ((stack)->stats)                                                                             \
+    {                                                                                               \
+        if ((stack)->size     > (stack)->stats->peakSize)     (stack)->stats->peakSize     = (stack)->size;     \
+        if ((stack)->capacity > (stack)->stats->peakCapacity) (stack)->stats->peakCapacity = (stack)->capacity; \
+    }                                                                                               \
+}while(0)
+
+#define STACK_STATS_TIMER(timer) unsigned long long timer = stack_stats_now()
+
+#define STACK_STATS_LATENCY(stack, histogram, timer) do{                                             \
+    if ((stack)->stats) stack_stats_record(&(stack)->stats->histogram, (timer));                    \
+}while(0)
+
+#else
+
+// Compiled out: no counters, no clock reads
+#define STACK_STATS_ADD(stack, counter, value)          do{}while(0)
+#define STACK_STATS_PEAK(stack)                         do{}while(0)
+#define STACK_STATS_TIMER(timer)
+#define STACK_STATS_LATENCY(stack, histogram, timer)    do{}while(0)
+
+#endif
+
+#define STACK_DUMP(stack, mode) stack_dump(stdout, (stack), __FILE__, __PRETTY_FUNCTION__, __LINE__, mode, DUMP_DEFAULT)
 
 /**
  * @brief Verification function for stack - check all stack data is valid
@@ -125,13 +569,38 @@ struct Stack
 */
 enum errorCode stack_verify(struct Stack* stack, FILE* stream, const char* file, int line, const char* func);
 
+/**
+ * @brief Function runs checks of stack_verify without printing(used by background verifier on copy of stack)
+ * @param [in] stack     Pointer to stack, its stackErrors and hashes are updated
+ * @param [in] checkData Recalculate data hash and check whole poisoned tail
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_check_errors(struct Stack* stack, bool checkData);
+
 /**
  * @brief Function initializes stack
- * @param [out] stack     Pointer to stack
- * @param [in]  capacity  Start capacity of stack  
+ * @param [out] stack      Pointer to stack
+ * @param [in]  capacity   Start capacity of stack(segmented stack always starts with one chunk,
+ *                         capacity up to STACK_INLINE_CAPACITY uses inline buffer)
+ * @param [in]  protection Protection level of stack(hash levels fall back to PROTECTION_CANARY without USE_HASH_PROTECTION)
+ * @param [in]  storage    Storage engine of stack
+ * @param [in]  allocator  Allocator of stack buffers(must live longer than stack) or NULL for STACK_HEAP_ALLOCATOR
  * @return Error code or NO_ERRORS if everything ok
 */
-enum errorCode stack_ctor(struct Stack* stack, size_t capacity, FILE* stream, const char* file, int line, const char* func);
+enum errorCode stack_ctor(struct Stack* stack, size_t capacity, enum protectionLevel protection, enum storageMode storage,
+                          struct StackAllocator* allocator, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function constructs copy-on-write clone of stack in O(1)
+ * @details Contiguous clone shares buffer with original through reference count, the first write to either of them
+ * copies it. Segmented clone shares chunks, write copies only the top chunk it touches. Small inline buffer is copied,
+ * mapped, guarded and incremental stacks are copied into new buffer of the same storage, snapshot one into contiguous buffer.
+ * Clone has its own canaries, hashes and stats. Clones of one stack must be used from one thread
+ * @param [out] clone  Pointer to unconstructed stack(homeland is set by STACK_CLONE)
+ * @param [in]  stack  Pointer to original stack(its struct hash is updated, buffer reference count lives there)
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_clone(struct Stack* clone, struct Stack* stack, FILE* stream, const char* file, int line, const char* func);
 
 /**
  * @brief Function destruct stack
@@ -147,6 +616,97 @@ enum errorCode stack_dtor(struct Stack* stack, FILE* stream, const char* file, i
 */
 enum errorCode stack_realloc(struct Stack* stack, FILE* stream, const char* file, int line, const char* func);
 
+/**
+ * @brief Function sets capacity of stack buffer(not less than size + 1)
+ * @details Capacity up to STACK_INLINE_CAPACITY moves data into inline buffer, larger one moves it to heap
+ * @param [in] stack    Pointer to stack
+ * @param [in] capacity New capacity
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_resize(struct Stack* stack, size_t capacity, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function shrinks stack buffer to size + 1 if growth strategy allows trim
+ * @param [in] stack Pointer to stack
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_trim(struct Stack* stack, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function initializes empty arena
+ * @param [out] arena Pointer to arena
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_arena_ctor(struct StackArena* arena);
+
+/**
+ * @brief Function releases all memory of arena
+ * @details Buffers of all stacks created in arena are freed, such stacks must not be used or destructed after it
+ * @param [in] arena Pointer to arena
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_arena_dtor(struct StackArena* arena);
+
+/**
+ * @brief Function calculates size of contiguous buffer with data canaries
+ * @param [in] capacity Number of elements
+ * @return Size in bytes
+*/
+size_t stack_buffer_size(size_t capacity);
+
+/**
+ * @brief Function returns size of memory page(granularity of mapped and guarded storages)
+ * @return Page size in bytes
+*/
+size_t stack_page_size();
+
+/**
+ * @brief Function checks that stack data lives in inline buffer of struct Stack
+ * @param [in] stack Pointer to stack
+ * @return True if data is inline
+*/
+bool stack_data_inline(const struct Stack* stack);
+
+/**
+ * @brief Function fills elements with ELEM_T_POISON(SSE2/AVX2 when CPU has them)
+ * @param [out] data  Pointer to elements
+ * @param [in]  count Number of elements
+*/
+void poison_fill(elem_t* data, size_t count);
+
+/**
+ * @brief Function finds first element that isn't ELEM_T_POISON(SSE2/AVX2 when CPU has them)
+ * @param [in] data  Pointer to elements
+ * @param [in] count Number of elements
+ * @return Index of element or count if all elements are poison
+*/
+size_t poison_find(const elem_t* data, size_t count);
+
+/**
+ * @brief Function finds first element above top of stack that isn't ELEM_T_POISON
+ * @param [in] stack Pointer to stack with valid size and capacity
+ * @param [in] full  Check all elements above top, otherwise only POISON_CHECK_WINDOW of them
+ * @return Index of element or POISON_INTACT if all checked elements are poison
+*/
+size_t stack_poison_find(const struct Stack* stack, bool full);
+
+/**
+ * @brief Function sets capacity strategy of stack
+ * @param [in] stack  Pointer to stack
+ * @param [in] growth Pointer to strategy(must live longer than stack) or NULL for GROWTH_DOUBLE
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_set_growth(struct Stack* stack, const struct GrowthStrategy* growth);
+
+/// @brief Geometric growth: capacity * numerator / denominator(at least capacity + 1)
+size_t geometric_grow(const struct GrowthStrategy* strategy, size_t capacity);
+
+/// @brief Geometric shrink border: capacity / shrinkDivisor or 0 if shrinkDivisor is 0
+size_t geometric_shrink_size(const struct GrowthStrategy* strategy, size_t capacity);
+
+/// @brief Geometric shrink: capacity * denominator / numerator(at least 1)
+size_t geometric_shrink(const struct GrowthStrategy* strategy, size_t capacity);
+
 /**
  * @brief Function puts value into stack
  * @param [in] stack Pointer to stack
@@ -163,6 +723,91 @@ enum errorCode stack_push(struct Stack* stack, elem_t value, FILE* stream, const
 */
 elem_t stack_pop(struct Stack* stack, FILE* stream, const char* file, int line, const char* func);
 
+#ifdef STACK_INLINE_FAST_PATH
+
+/**
+ * @brief Out-of-line push of inline fast path: growth, buffer shared with clones and other storages
+ * @details Kept out of callers, so that their loops hold fields of stack in registers. Errors are printed to stderr
+ * without place of call
+ * @param [in] stack Pointer to stack
+ * @param [in] value Value to push
+ * @return Error code and NO_ERRORS if everythind ok
+*/
+__attribute__((noinline, cold)) enum errorCode stack_push_slow(struct Stack* stack, elem_t value);
+
+/**
+ * @brief Out-of-line pop of inline fast path: shrink, empty stack, buffer shared with clones and other storages
+ * @param [in] stack Pointer to stack
+ * @return Value of last element from stack
+*/
+__attribute__((noinline, cold)) elem_t stack_pop_slow(struct Stack* stack);
+
+/**
+ * @brief Inline push of build without protections: element is written in place when contiguous stack has free slot
+ * @details Slow path may change any field of stack, so loops of pushes and pops store size back on every call instead of
+ * keeping it in register like end pointer of std::vector: short bursts on warm buffer stay about 2.5 times slower than
+ * vector(make bench_release), long fills and drains are on par
+ * @param [in] stack Pointer to stack
+ * @param [in] value Value to push
+ * @return Error code and NO_ERRORS if everythind ok
+*/
+inline enum errorCode stack_push_inline(struct Stack* stack, elem_t value)
+{
+    size_t size = stack->size;
+
+    if (__builtin_expect(size + 1 < stack->capacity && stack->storage == STORAGE_CONTIGUOUS && !stack->bufferRefs, 1))
+    {
+        stack->data[size] = value;
+        stack->size       = size + 1;
+
+        return NO_ERRORS;
+    }
+
+    return stack_push_slow(stack, value);
+}
+
+/**
+ * @brief Inline pop of build without protections: top element is taken in place when contiguous stack needn't shrink
+ * @details Build without protections has no poisoned tail, so the slot is left as it is
+ * @param [in] stack Pointer to stack
+ * @return Value of last element from stack
+*/
+inline elem_t stack_pop_inline(struct Stack* stack)
+{
+    size_t size = stack->size;
+
+    if (__builtin_expect(size > stack->shrinkSize && stack->storage == STORAGE_CONTIGUOUS && !stack->bufferRefs, 1))
+    {
+        stack->size = size - 1;
+
+        return stack->data[size - 1];
+    }
+
+    return stack_pop_slow(stack);
+}
+
+#endif
+
+/**
+ * @brief Function puts count values into stack with one realloc, verify and hash update per batch
+ * @param [in] stack  Pointer to stack
+ * @param [in] values Array of values, values[0] is pushed first
+ * @param [in] count  Number of values
+ * @return Error code and NO_ERRORS if everythind ok
+*/
+enum errorCode stack_push_n(struct Stack* stack, const elem_t* values, size_t count, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function pulls count last elements from stack with one verify and hash update per batch
+ * @details Elements keep stack order: values[count - 1] is the former top, so stack_pop_n reverts stack_push_n.
+ * If stack has less than count elements nothing is popped and EMPTY_STACK is returned
+ * @param [in]  stack  Pointer to stack
+ * @param [out] values Array for at least count elements
+ * @param [in]  count  Number of elements
+ * @return Error code and NO_ERRORS if everythind ok
+*/
+enum errorCode stack_pop_n(struct Stack* stack, elem_t* values, size_t count, FILE* stream, const char* file, int line, const char* func);
+
 /**
  * @brief Print all information about stack in stream
  * @param [in] stream Output stream
@@ -186,6 +831,15 @@ void print_error(FILE* stream, enum errorCode error);
 */
 enum errorCode print_stack_homeland(FILE* stream, const struct Stack* stack);
 
+/**
+ * @brief Function prints homeland of any stack type
+ * @param [in] stream   Output stream
+ * @param [in] stack    Pointer to stack(only printed)
+ * @param [in] homeland Pointer to homeland of stack
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode print_homeland(FILE* stream, const void* stack, const struct StackHomeland* homeland);
+
 /**
  * @brief Function print stack homeland print all of errors in stack and dumps stack information
  * @param [in] stream Output stream
@@ -193,9 +847,100 @@ enum errorCode print_stack_homeland(FILE* stream, const struct Stack* stack);
  * @param [in] file   File name 
  * @param [in] func   Function name
  * @param [in] line   Line number
+ * @param [in] mode   FULL(whole buffer and protection fields) or SHORT(elements up to top)
+ * @param [in] format Output format
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_dump(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                          enum stackDumpFormat format);
+
+/**
+ * @brief Function sets format of dumps made with DUMP_DEFAULT(dumps on verification errors among them)
+ * @param [in] format Format(DUMP_DEFAULT - DUMP_TEXT)
+*/
+void stack_dump_format(enum stackDumpFormat format);
+
+/**
+ * @brief Function prints stack as one JSON object line, runs of ELEM_T_POISON are printed as {"poison": count}
+ * @param [in] stream     Output stream
+ * @param [in] stack      Pointer to stack
+ * @param [in] file       File name
+ * @param [in] func       Function name
+ * @param [in] line       Line number
+ * @param [in] mode       FULL or SHORT
+ * @param [in] suppressed Dumps of stack skipped by rate limit before this one
  * @return Error code or NO_ERRORS if everything ok
 */
-enum errorCode stack_dump(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode);
+enum errorCode stack_dump_json(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                               size_t suppressed);
+
+/**
+ * @brief Function writes stack as binary record(StackDumpHeader, strings and runs of elements)
+ * @details Elements are written as they lie in memory, STACK_DUMP_POISON_RUN and more ELEM_T_POISON in a row take
+ * one run header, so FULL record of stack with big capacity stays small
+ * @param [in] stream     Output stream
+ * @param [in] stack      Pointer to stack
+ * @param [in] file       File name
+ * @param [in] func       Function name
+ * @param [in] line       Line number
+ * @param [in] mode       FULL or SHORT
+ * @param [in] suppressed Dumps of stack skipped by rate limit before this one
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_dump_binary(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                                 size_t suppressed);
+
+/**
+ * @brief Function prints binary dump records as text dumps
+ * @param [in] in  Stream with records(read up to end)
+ * @param [in] out Output stream
+ * @return FILE_ERROR if record is truncated or has other format, NO_MEMORY or NO_ERRORS if everything ok
+*/
+enum errorCode stack_dump_decode(FILE* in, FILE* out);
+
+/**
+ * @brief Function prints elements first..first + count - 1 of stack with size elements, in FULL mode
+ * STACK_DUMP_POISON_RUN and more ELEM_T_POISON in a row above top take one line
+ * @param [in] stream Output stream
+ * @param [in] values Pointer to elements
+ * @param [in] first  Index of values[0]
+ * @param [in] count  Number of elements
+ * @param [in] size   Size of stack
+ * @param [in] mode   FULL or SHORT
+*/
+void print_elements(FILE* stream, const elem_t* values, size_t first, size_t count, size_t size, stackDumpMode mode);
+
+/**
+ * @brief Function prints run of ELEM_T_POISON as one line
+ * @param [in] stream Output stream
+ * @param [in] first  Index of first element of run
+ * @param [in] count  Number of elements
+*/
+void print_poison_run(FILE* stream, size_t first, size_t count);
+
+/**
+ * @brief Function sets rate limit of dumps of stacks with errors
+ * @details Dump of stack with the same errors as its last printed dump is skipped during periodMs after it,
+ * the next printed one tells how many were skipped
+ * @param [in] periodMs Period(0 - every dump is printed)
+*/
+void stack_dump_limit(unsigned periodMs);
+
+/**
+ * @brief Function opens report: output to returned stream is rendered into per-thread buffer
+ * @details Report is written to stream by one write(or handed to logger thread, see Logger.h) in stack_report_end,
+ * so that it isn't interleaved with output of other threads. Report bigger than STACK_DUMP_BUFFER is written in parts.
+ * Report opened inside other report goes straight to the outer one
+ * @param [in] stream Output stream
+ * @return Stream to print report to(stream itself if buffer can't be made)
+*/
+FILE* stack_report_begin(FILE* stream);
+
+/**
+ * @brief Function closes report and writes it out
+ * @param [in] report Stream returned by stack_report_begin
+*/
+void stack_report_end(FILE* report);
 
 /**
  * @brief Function checks that pointer isn't null
@@ -208,6 +953,284 @@ enum errorCode stack_dump(FILE* stream, const struct Stack* stack, const char* f
 */
 enum errorCode no_ptr(FILE* stream, const void* ptr, enum errorCode error, const char* file, const char* func, int line);
 
+/**
+ * @brief Function allocates first chunk of segmented stack
+ * @param [in] stack Pointer to stack with filled protection
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode segmented_ctor(struct Stack* stack);
+
+/**
+ * @brief Function frees all chunks of segmented stack
+ * @param [in] stack Pointer to stack
+*/
+void segmented_dtor(struct Stack* stack);
+
+/**
+ * @brief Function puts value on top of segmented stack, takes spare or new chunk on chunk border
+ * @param [in] stack Pointer to stack
+ * @param [in] value Value to push
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode segmented_push(struct Stack* stack, elem_t value);
+
+/**
+ * @brief Function pulls top element of not empty segmented stack, emptied chunk becomes spare
+ * @param [in] stack Pointer to stack
+ * @return Value of top element
+*/
+elem_t segmented_pop(struct Stack* stack);
+
+/**
+ * @brief Function copies count values on top of segmented stack chunk by chunk
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode segmented_push_n(struct Stack* stack, const elem_t* values, size_t count);
+
+/**
+ * @brief Function copies count top elements of segmented stack(count <= size) chunk by chunk and removes them
+*/
+void segmented_pop_n(struct Stack* stack, elem_t* values, size_t count);
+
+/**
+ * @brief Function frees spare chunk of segmented stack
+ * @param [in] stack Pointer to stack
+*/
+void segmented_trim(struct Stack* stack);
+
+/**
+ * @brief Function finds first element above top of segmented stack that isn't ELEM_T_POISON(spare chunk included)
+ * @param [in] stack Pointer to stack
+ * @param [in] full  Check top chunk tail and spare chunk, otherwise only POISON_CHECK_WINDOW elements above top
+ * @return Index of element(spare chunk continues top chunk) or POISON_INTACT if all checked elements are poison
+*/
+size_t segmented_poison_find(const struct Stack* stack, bool full);
+
+/**
+ * @brief Function reserves virtual range of mapped stack and commits pages for capacity elements
+ * @details Data pointer of stack is set to start of range or NULL if it can't be reserved.
+ * Stack allocator isn't used by mapped storage
+ * @param [in] stack    Pointer to stack
+ * @param [in] capacity Start capacity
+ * @return Capacity of committed pages(at least capacity) or 0 if range can't be reserved
+*/
+size_t mapped_ctor(struct Stack* stack, size_t capacity);
+
+/**
+ * @brief Function unmaps whole reserved range of mapped stack
+ * @param [in] stack Pointer to stack
+*/
+void mapped_dtor(struct Stack* stack);
+
+/**
+ * @brief Function commits pages for capacity elements or releases pages above them(MADV_DONTNEED), buffer doesn't move
+ * @param [in] stack    Pointer to stack with old capacity
+ * @param [in] capacity New capacity(clamped by reserved range)
+ * @return Capacity of committed pages or 0 if reserved range is too small or pages can't be committed
+*/
+size_t mapped_commit(struct Stack* stack, size_t capacity);
+
+/**
+ * @brief Function calculates how many elements pages committed for capacity elements hold
+ * @param [in] capacity  Number of elements
+ * @param [in] roundDown Round to lower page border(as shrink does), otherwise to upper one(as growth does)
+ * @return Capacity of committed pages
+*/
+size_t mapped_fit_capacity(size_t capacity, bool roundDown);
+
+/**
+ * @brief Function asks kernel to back reserved range of mapped stack with transparent huge pages(or stop it)
+ * @param [in] stack  Pointer to stack(other storages are left as is)
+ * @param [in] enable Use huge pages
+ * @return Error code(NO_MEMORY if kernel refused, e.g. without THP support) or NO_ERRORS if everything ok
+*/
+enum errorCode stack_set_huge_pages(struct Stack* stack, bool enable);
+
+/**
+ * @brief Function maps guarded buffer for capacity elements and registers it for SIGSEGV handler
+ * @details Elements start right after left guard page and end right before right guard page. Data pointer keeps
+ * layout of contiguous buffer(data canary slots lie on guard pages and aren't accessed). First call installs
+ * SIGSEGV handler that prints homeland and dump of stack whose guard page was hit, then passes fault to previous handler.
+ * Stack struct must not move while buffer is registered
+ * @param [in] stack    Pointer to stack
+ * @param [in] capacity Start capacity
+ * @return Capacity of mapped pages(at least capacity) or 0 if buffer can't be mapped(data pointer is NULL then)
+*/
+size_t guarded_ctor(struct Stack* stack, size_t capacity);
+
+/**
+ * @brief Function unregisters and unmaps guarded buffer
+ * @param [in] stack Pointer to stack
+*/
+void guarded_dtor(struct Stack* stack);
+
+/**
+ * @brief Function moves elements of guarded stack into new guarded buffer(old one is unmapped)
+ * @param [in]     stack    Pointer to stack with old capacity
+ * @param [in,out] capacity New capacity, rounded up to whole pages
+ * @return New data pointer or NULL if buffer can't be mapped(old one stays valid)
+*/
+elem_t* guarded_resize(struct Stack* stack, size_t* capacity);
+
+/**
+ * @brief Function calculates how many elements whole pages for capacity elements hold
+ * @param [in] capacity Number of elements
+ * @return Capacity of guarded buffer
+*/
+size_t guarded_fit_capacity(size_t capacity);
+
+/**
+ * @brief Function writes binary snapshot of stack(StackSnapshotHeader and contiguous buffer) to file
+ * @details Stack is verified first. Segmented, guarded and incremental stacks are written in contiguous layout too
+ * @param [in] stack  Pointer to stack
+ * @param [in] path   Path of snapshot file(rewritten)
+ * @param [in] stream Output stream for errors
+ * @param [in] file   Call file
+ * @param [in] line   Call line
+ * @param [in] func   Call function
+ * @return Error code(FILE_ERROR if file can't be written) or NO_ERRORS if everything ok
+*/
+enum errorCode stack_save(struct Stack* stack, const char* path, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function constructs stack from snapshot file written by stack_save
+ * @details File is mapped privately without copying(STORAGE_SNAPSHOT): pages are shared with page cache and copied
+ * by kernel on first write into them, first resize moves buffer to allocator. Header and data hashes are checked
+ * before stack is constructed, so corrupted snapshots are rejected(files of builds without hashes aren't checked).
+ * @param [out] stack  Pointer to unconstructed stack(homeland is set by STACK_LOAD)
+ * @param [in]  path   Path of snapshot file
+ * @param [in]  stream Output stream for errors
+ * @param [in]  file   Call file
+ * @param [in]  line   Call line
+ * @param [in]  func   Call function
+ * @return Error code(FILE_ERROR if file can't be read or has other format, BAD_DATA_HASH if it is corrupted) or NO_ERRORS
+*/
+enum errorCode stack_load(struct Stack* stack, const char* path, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function unmaps buffer of snapshot stack
+ * @param [in] stack Pointer to stack
+*/
+void snapshot_dtor(struct Stack* stack);
+
+/**
+ * @brief Function starts resize of incremental stack: allocates buffer with data canaries, elements stay in old one
+ * @details Previous migration must be completed(push and pop steps guarantee it before the next resize). Every later
+ * pushed or popped element moves and poisons migration.step elements: STACK_MIGRATE_STEP or more, so that migration
+ * ends within the pushes left before the next growth. Geometric growth keeps the step O(1)
+ * @param [in] stack    Pointer to stack
+ * @param [in] capacity New capacity(not less than size + 1)
+ * @return Error code(NO_MEMORY if buffer can't be allocated, old one stays valid) or NO_ERRORS if everything ok
+*/
+enum errorCode incremental_start(struct Stack* stack, size_t capacity);
+
+/**
+ * @brief Function moves up to count top elements left in old buffer and poisons up to count elements of new tail
+ * @details Old buffer is freed when it is emptied
+ * @param [in] stack Pointer to stack
+ * @param [in] count Number of elements
+*/
+void incremental_step(struct Stack* stack, size_t count);
+
+/**
+ * @brief Function completes migration of incremental stack at once(stack_resize and copies of stack use it)
+ * @param [in] stack Pointer to stack
+*/
+void incremental_finish(struct Stack* stack);
+
+/**
+ * @brief Function frees old buffer of incremental stack(data buffer is freed by stack_dtor)
+ * @param [in] stack Pointer to stack
+*/
+void incremental_dtor(struct Stack* stack);
+
+/**
+ * @brief Function puts value on top of incremental stack, full stack starts growth migration
+ * @param [in] stack Pointer to stack
+ * @param [in] value Value to push
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode incremental_push(struct Stack* stack, elem_t value);
+
+/**
+ * @brief Function pulls top element of not empty incremental stack, starts shrink migration when size falls to shrinkSize
+ * @details Shrink is skipped while previous migration isn't completed or if new buffer can't be allocated
+ * @param [in] stack Pointer to stack
+ * @return Value of top element
+*/
+elem_t incremental_pop(struct Stack* stack);
+
+/**
+ * @brief Function copies count values on top of incremental stack, migration makes count * migration.step steps
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode incremental_push_n(struct Stack* stack, const elem_t* values, size_t count);
+
+/**
+ * @brief Function copies count top elements of incremental stack(count <= size) from both buffers and removes them
+*/
+void incremental_pop_n(struct Stack* stack, elem_t* values, size_t count);
+
+/**
+ * @brief Function copies elements of incremental stack from both buffers in stack order
+ * @param [in]  stack  Pointer to stack
+ * @param [out] values Array for size elements
+*/
+void incremental_gather(const struct Stack* stack, elem_t* values);
+
+/**
+ * @brief Function checks migration bounds and data canaries of old buffer of incremental stack
+ * @param [in] stack Pointer to stack
+ * @return Found errors or NO_ERRORS
+*/
+enum errorCode incremental_check(const struct Stack* stack);
+
+/**
+ * @brief Function makes copied struct of segmented stack reference its chunks
+ * @param [in] clone Pointer to struct copied from original stack
+*/
+void segmented_clone(struct Stack* clone);
+
+/**
+ * @brief Function checks chunk list and chunk canaries of segmented stack
+ * @param [in] stack Pointer to stack
+ * @param [in] full  Check every chunk, otherwise only top one
+ * @return Found errors or NO_ERRORS
+*/
+enum errorCode segmented_check(const struct Stack* stack, bool full);
+
+#ifdef USE_STACK_STATS
+
+/**
+ * @brief Function copies operation counters of stack
+ * @param [in]  stack Pointer to stack
+ * @param [out] stats Pointer to counters
+ * @return Error code or NO_ERRORS if everything ok(NO_MEMORY and zero counters if stack couldn't allocate them)
+*/
+enum errorCode stack_stats(const struct Stack* stack, struct StackStats* stats);
+
+/**
+ * @brief Function reads monotonic clock for latency histograms
+ * @return Time in ns
+*/
+unsigned long long stack_stats_now();
+
+/**
+ * @brief Function adds latency of call started at start to histogram
+ * @param [out] histogram Pointer to histogram
+ * @param [in]  start     stack_stats_now() at start of call
+*/
+void stack_stats_record(struct StackLatencyHistogram* histogram, unsigned long long start);
+
+/**
+ * @brief Function prints counters and non-empty histogram buckets
+ * @param [in] stream Output stream
+ * @param [in] stats  Pointer to counters
+*/
+void print_stack_stats(FILE* stream, const struct StackStats* stats);
+
+#endif
+
 /**
  * @brief Function testing all struct functions
  * @param [in] steram Message output stream
@@ -225,6 +1248,153 @@ enum errorCode test_driver(FILE* stream);
 */
 hash_t jdb2_hash(const void* ptr, size_t objectSize);
 
+/**
+ * @brief Function calculating hash of bytes with chosen backend
+ * @param [in] backend Hash algorithm
+ * @param [in] ptr     Pointer to bytes
+ * @param [in] size    Number of bytes
+ * @return Hash or 0 if backend is unknown
+*/
+hash_t hash_bytes(enum hashBackend backend, const void* ptr, size_t size);
+
+/**
+ * @brief Function returns backend new stacks are hashed with
+ * @return Hash backend
+*/
+enum hashBackend hash_backend_default();
+
+/**
+ * @brief Function returns name of hash backend
+ * @param [in] backend Hash algorithm
+ * @return Name or NULL if backend is unknown
+*/
+const char* hash_backend_name(enum hashBackend backend);
+
+/**
+ * @brief Function returns instruction set hash_bytes uses for backend on this CPU
+ * @param [in] backend Hash algorithm
+ * @return "portable", "sse2", "avx2", "sse4.2" or NULL if backend is unknown
+*/
+const char* hash_backend_isa(enum hashBackend backend);
+
+/**
+ * @brief Function switches all backends to portable code without SSE/AVX(for tests and benchmarks, not thread-safe)
+ * @details Every backend gives the same hashes with portable and accelerated code
+ * @param [in] portable Use portable code
+*/
+void hash_backend_portable(bool portable);
+
+/**
+ * @brief Function changes hash backend of stack and rehashes it
+ * @param [in] stack   Pointer to stack
+ * @param [in] backend New hash algorithm
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode stack_set_hash_backend(struct Stack* stack, enum hashBackend backend, FILE* stream, const char* file, int line, const char* func);
+
+#ifdef USE_INCREMENTAL_HASH
+
+/**
+ * @brief Function calculating hash of one element on its position in stack
+ * @details Data hash is a sum of element hashes, so push adds and pop subtracts one term
+ * @param [in] value Element value
+ * @param [in] index Element position in stack
+ * @return Element hash
+*/
+hash_t elem_hash(elem_t value, size_t index);
+
+/**
+ * @brief Function calculating sum of element hashes of consecutive elements
+ * @param [in] values Elements
+ * @param [in] first  Position of values[0] in stack
+ * @param [in] count  Number of elements
+ * @return Sum of element hashes
+*/
+hash_t elem_range_hash(const elem_t* values, size_t first, size_t count);
+
+#endif
+
+/**
+ * @brief Function recalculate only struct hash of stack(data hash keeps its value)
+ * @param [in] stack Pointer to stack
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode calculate_struct_hash(struct Stack* stack);
+
+/**
+ * @brief Function calculating hash tree of stack data from the scratch, data hash becomes its root
+ * @details Blocks of big stack are hashed by hashing threads(stack_hash_threads)
+ * @param [in] stack Pointer to stack
+ * @return Error code(NO_MEMORY if tree can't be allocated) or NO_ERRORS if everything ok
+*/
+enum errorCode hash_tree_build(struct Stack* stack);
+
+#ifdef USE_INCREMENTAL_HASH
+
+/**
+ * @brief Function adds element hash to its block and to path from block to root(pop adds negated hash)
+ * @param [in] stack Pointer to stack
+ * @param [in] index Element position in stack
+ * @param [in] delta Element hash
+ * @return Error code(NO_MEMORY if tree can't grow) or NO_ERRORS if everything ok
+*/
+enum errorCode hash_tree_add(struct Stack* stack, size_t index, hash_t delta);
+
+#else
+
+/**
+ * @brief Function rehashes blocks with elements [from, to) and their paths to root
+ * @param [in] stack Pointer to stack
+ * @param [in] from  First changed element
+ * @param [in] to    End of changed elements(may be above size after pop)
+ * @return Error code(NO_MEMORY if tree can't grow) or NO_ERRORS if everything ok
+*/
+enum errorCode hash_tree_rehash(struct Stack* stack, size_t from, size_t to);
+
+#endif
+
+/**
+ * @brief Function recalculates block hashes from the scratch and compares them with hash tree, tree isn't changed
+ * @param [in]  stack     Pointer to stack
+ * @param [out] corrupted Number of blocks whose hash doesn't match
+ * @param [out] blocks    Indexes of first corrupted blocks(may be NULL)
+ * @param [in]  maxBlocks Size of blocks array
+ * @return BAD_DATA_HASH if block or root doesn't match, NO_MEMORY or NO_ERRORS if everything ok
+*/
+enum errorCode hash_tree_verify(const struct Stack* stack, size_t* corrupted, size_t* blocks, size_t maxBlocks);
+
+/**
+ * @brief Function recalculates hash of one block from the scratch and compares it with its leaf
+ * @details Root isn't compared, so that check stays O(STACK_HASH_BLOCK)
+ * @param [in] stack Pointer to stack
+ * @param [in] block Block number(element index / STACK_HASH_BLOCK)
+ * @return BAD_DATA_HASH if block doesn't match or NO_ERRORS if everything ok
+*/
+enum errorCode hash_tree_verify_block(const struct Stack* stack, size_t block);
+
+/**
+ * @brief Function shares hash tree of stack with its clone, the first write through either of them copies it
+ * @param [in] clone Pointer to clone(copy of stack struct)
+ * @param [in] stack Pointer to cloned stack
+ * @return Error code(NO_MEMORY) or NO_ERRORS if everything ok
+*/
+enum errorCode hash_tree_clone(struct Stack* clone, struct Stack* stack);
+
+/**
+ * @brief Function drops reference of stack to its hash tree, the last reference frees it
+ * @param [in] stack Pointer to stack
+*/
+void hash_tree_dtor(struct Stack* stack);
+
+/**
+ * @brief Function sets number of threads hashing blocks of big stacks together with calling thread
+ * @details One full hash runs on threads at a time, the others are hashed by their calling threads only
+ * @param [in] threads Number of threads(0 - none, STACK_HASH_THREADS_AUTO - one less than hardware threads),
+ * more than STACK_HASH_THREADS_MAX are cut
+ * @return Number of started threads
+*/
+size_t stack_hash_threads(size_t threads);
+
 #endif
 
 /**
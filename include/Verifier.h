@@ -0,0 +1,162 @@
+/**
+ * @file
+ * @brief Background verifier of stacks(compiled only with USE_BACKGROUND_VERIFY)
+ * @details While verifier runs, stack_ctor registers stacks in global registry and stack_dtor removes them.
+ * Verifier thread walks registry every periodMs and runs full verification(canaries, struct hash, data hash
+ * recalculated from the scratch, whole poisoned tail) on copy of each struct. Every public stack function that
+ * changes stack runs in write scope of its watch slot: sequence counter is odd while scope is open. Verifier is seqlock
+ * reader: it copies struct when counter is even, checks the copy and retries if counter changed meanwhile, so writers
+ * never wait for it. Verifier marks slot as being read, writer that sees the mark retires blocks and mappings it
+ * releases(STACK_RETIRE_BLOCK, STACK_RETIRE_MAP) instead of freeing them, and they are freed by its first write scope
+ * after verifier is gone, so verifier never reads freed memory. With hotChecks off push and pop of watched stacks skip
+ * their own verification.
+*/
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <stdio.h>
+
+#include "Stack.h"
+
+#ifdef USE_BACKGROUND_VERIFY
+
+/**
+ * @brief Function called by verifier thread when it finds new errors of stack
+ * @details Writers of stack don't wait for callback, so stack may change meanwhile, callback must not call stack functions on it
+ * @param [in] stack    Pointer to failed stack
+ * @param [in] errors   All errors of this check(including already reported ones)
+ * @param [in] homeland Position where stack was initialised
+ * @param [in] context  Context pointer of StackVerifierConfig
+*/
+typedef void (*stackVerifierCallback)(const struct Stack* stack, enum errorCode errors, const struct StackHomeland* homeland,
+                                      void* context);
+
+/// @brief Settings of background verifier
+struct StackVerifierConfig
+{
+    unsigned              periodMs;     ///< Pause between passes over registry(0 - passes go one after another)
+    bool                  hotChecks;    ///< Push and pop of watched stacks keep their own verification
+    FILE*                 stream;       ///< Failures are printed here(NULL - not printed)
+    stackVerifierCallback callback;     ///< Called on failures(NULL - none)
+    void*                 context;      ///< Passed to callback
+};
+
+/// @brief Counters of background verifier since stack_verifier_start
+struct StackVerifierStats
+{
+    size_t passes;      ///< Completed passes over registry
+    size_t checks;      ///< Verified stacks
+    size_t busy;        ///< Stacks skipped because their operation didn't end in STACK_VERIFY_SPIN yields(checked on next pass)
+    size_t failures;    ///< Checks that found new errors
+};
+
+/// @brief Watch slot of registered stack
+struct StackWatch;
+
+/// @brief Write scope of stack, closed by stack_write_leave when it goes out of scope
+struct StackWriteScope
+{
+    struct StackWatch* watch;   ///< Slot of stack(NULL - stack isn't watched)
+};
+
+/// Opens write scope closed automatically on every return of enclosing function
+#define STACK_WRITE_SCOPE(stack) \
+    struct StackWriteScope stackWriteScope_ __attribute__((cleanup(stack_write_leave))) = stack_write_enter(stack)
+
+/// Registers stack being constructed, its write scope is open until enclosing function returns
+#define STACK_REGISTER_SCOPE(stack) \
+    struct StackWriteScope stackRegisterScope_ __attribute__((cleanup(stack_write_leave))) = stack_watch_register(stack)
+
+#define STACK_UNREGISTER(stack) stack_watch_unregister(stack)
+
+/// Frees block of allocator or keeps it until verifier stops reading stack
+#define STACK_RETIRE_BLOCK(stack, allocator, block, size) stack_retire((stack), (allocator), (block), (size))
+
+/// Unmaps pages or keeps them until verifier stops reading stack
+#define STACK_RETIRE_MAP(stack, map, bytes) stack_retire((stack), NULL, (map), (bytes))
+
+/// Release of memory is deferred, so that buffers are copied instead of reallocated and mapped pages are kept
+#define STACK_DEFERS_RELEASE(stack) stack_defers_release(stack)
+
+/**
+ * @brief Function starts verifier thread(running one is stopped first)
+ * @details Stacks constructed from now on are registered, earlier ones aren't watched
+ * @param [in] config Pointer to settings
+ * @return Error code(NO_MEMORY if thread can't be started) or NO_ERRORS if everything ok
+*/
+enum errorCode stack_verifier_start(const struct StackVerifierConfig* config);
+
+/// @brief Function stops verifier thread and waits for it, registered stacks stay watched until their dtor
+void stack_verifier_stop();
+
+/**
+ * @brief Function returns counters of verifier
+ * @return Counters since last start
+*/
+struct StackVerifierStats stack_verifier_stats();
+
+/**
+ * @brief Function tells if push and pop of stack may skip their verification
+ * @param [in] stack Pointer to stack
+ * @return True if stack is watched by running verifier without hot checks
+*/
+bool stack_watched(const struct Stack* stack);
+
+/**
+ * @brief Function opens write scope of stack(use STACK_WRITE_SCOPE), waits while verifier reads stack
+ * @param [in] stack Pointer to stack(may be NULL)
+ * @return Scope to pass to stack_write_leave
+*/
+struct StackWriteScope stack_write_enter(struct Stack* stack);
+
+/**
+ * @brief Function closes write scope, outermost scope makes sequence counter even and frees retired blocks
+ * if verifier doesn't read stack
+ * @param [in] scope Pointer to scope
+*/
+void stack_write_leave(struct StackWriteScope* scope);
+
+/**
+ * @brief Function tells if open write scope of stack must retire memory instead of releasing it
+ * @param [in] stack Pointer to stack
+ * @return True if verifier could read stack when scope was opened
+*/
+bool stack_defers_release(const struct Stack* stack);
+
+/**
+ * @brief Function releases memory of stack(use STACK_RETIRE_BLOCK, STACK_RETIRE_MAP) or keeps it until
+ * verifier stops reading stack
+ * @param [in] stack     Pointer to stack
+ * @param [in] allocator Allocator of block(NULL - block is mapping and is unmapped)
+ * @param [in] block     Block or mapping(NULL - nothing to release)
+ * @param [in] size      Size of block in bytes
+*/
+void stack_retire(struct Stack* stack, struct StackAllocator* allocator, void* block, size_t size);
+
+/**
+ * @brief Function gives stack watch slot if verifier runs(use STACK_REGISTER_SCOPE), sets stack->watch
+ * @param [in] stack Pointer to stack under construction
+ * @return Open write scope of new slot
+*/
+struct StackWriteScope stack_watch_register(struct Stack* stack);
+
+/**
+ * @brief Function frees watch slot of stack and blocks retired by it, waits while verifier checks stack
+ * @param [in] stack Pointer to stack(may be NULL)
+*/
+void stack_watch_unregister(struct Stack* stack);
+
+#else
+
+// Compiled out: no registry, no write scopes
+#define STACK_WRITE_SCOPE(stack)
+#define STACK_REGISTER_SCOPE(stack)
+#define STACK_UNREGISTER(stack)     do{}while(0)
+
+#define STACK_RETIRE_BLOCK(stack, allocator, block, size)   (allocator)->deallocate((allocator), (block), (size))
+#define STACK_RETIRE_MAP(stack, map, bytes)                 munmap((map), (bytes))
+#define STACK_DEFERS_RELEASE(stack)                         false
+
+#endif
+
+#endif
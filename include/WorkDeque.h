@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @brief Chase-Lev work-stealing deque on canary-guarded stack buffer
+ * @details Owner thread pushes and pops at the top like struct Stack, other threads steal from the bottom.
+ * Owner push is plain stores and release fence, owner pop needs CAS only when it races for the last element.
+ * Buffer is circular, laid out like buffer of contiguous struct Stack(data canaries around elements) and
+ * grows with GrowthStrategy of deque. Thieves may still read old buffer, so replaced buffers are freed in dtor.
+*/
+#ifndef WORK_DEQUE_H
+#define WORK_DEQUE_H
+
+#include <atomic>
+
+#include "Stack.h"
+
+const size_t WDEQUE_CACHE_LINE = 64;    ///< Alignment of indexes written by different threads
+
+/// @brief Circular buffer of deque, header is followed by canary-guarded elements
+struct DequeBuffer
+{
+    size_t              capacity;   ///< Power of two
+    struct DequeBuffer* prev;       ///< Replaced buffer(freed in dtor)
+};
+
+/// @brief Work-stealing deque struct
+struct WorkDeque
+{
+    #ifdef USE_CANARY_PROTECTION
+    canary_t leftCanary;                                                    ///< Left protection canary
+    #endif
+
+    alignas(WDEQUE_CACHE_LINE) std::atomic<long long> top;                  ///< Index after top element(written by owner)
+    alignas(WDEQUE_CACHE_LINE) std::atomic<long long> bottom;               ///< Index of bottom element(written by thieves)
+    alignas(WDEQUE_CACHE_LINE) std::atomic<struct DequeBuffer*> buffer;     ///< Current buffer
+
+    const struct GrowthStrategy* growth;    ///< Capacity strategy of buffer(shrink is not used)
+    struct StackAllocator*       allocator; ///< Allocator of buffers
+    enum protectionLevel         protection;///< PROTECTION_OFF or PROTECTION_CANARY(hash levels work as canary)
+
+    std::atomic<int>     stackErrors;       ///< Bits of enum errorCode
+    struct StackHomeland stackHomeland;     ///< Struct with information about position where deque was initialised
+
+    #ifdef USE_CANARY_PROTECTION
+    canary_t rightCanary;                                                   ///< Right protection canary
+    #endif
+};
+
+#define WDEQUE_CTOR(deque, capacity) do{                                                                \
+                                                                                                        \
+    if(!no_ptr(stderr, (deque), NO_STACK_PTR, __FILE__, __PRETTY_FUNCTION__, __LINE__))                 \
+    {                                                                                                   \
+        (deque)->stackHomeland = {#deque, __FILE__, __PRETTY_FUNCTION__, __LINE__};                     \
+        wdeque_ctor((deque), capacity, PROTECTION_DEFAULT, NULL, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);  \
+    }                                                                                                   \
+    else print_error(stderr, NO_STACK_PTR);                                                             \
+                                                                                                        \
+}while(0)
+
+#define WDEQUE_DTOR(deque) wdeque_dtor((deque), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define WDEQUE_VERIFY(deque) wdeque_verify((deque), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define WDEQUE_PUSH(deque, value) wdeque_push((deque), value, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define WDEQUE_POP(deque, value) wdeque_pop((deque), (value), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define WDEQUE_STEAL(deque, value) wdeque_steal((deque), (value), stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__)
+
+#define WDEQUE_DUMP(deque) wdeque_dump(stdout, (deque), __FILE__, __PRETTY_FUNCTION__, __LINE__)
+
+/**
+ * @brief Function initializes deque, must not race with other operations on it
+ * @param [out] deque      Pointer to deque
+ * @param [in]  capacity   Start capacity(rounded up to power of two)
+ * @param [in]  protection Protection level(hash levels work as PROTECTION_CANARY)
+ * @param [in]  allocator  Allocator of buffers or NULL for STACK_HEAP_ALLOCATOR
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode wdeque_ctor(struct WorkDeque* deque, size_t capacity, enum protectionLevel protection, struct StackAllocator* allocator,
+                           FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function frees all buffers of deque, must not race with other operations on it
+ * @param [in] deque Pointer to deque
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode wdeque_dtor(struct WorkDeque* deque, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function checks struct and buffer canaries of deque, safe to call from any thread
+ * @param [in] deque Pointer to deque
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode wdeque_verify(struct WorkDeque* deque, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function puts value on top of deque, owner thread only
+ * @param [in] deque Pointer to deque
+ * @param [in] value Value to push
+ * @return Error code and NO_ERRORS if everythind ok
+*/
+enum errorCode wdeque_push(struct WorkDeque* deque, elem_t value, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function pulls top element of deque, owner thread only
+ * @param [in]  deque Pointer to deque
+ * @param [out] value Popped value(ELEM_T_POISON if deque is empty)
+ * @return EMPTY_STACK if deque is empty, other error code or NO_ERRORS if everythind ok
+*/
+enum errorCode wdeque_pop(struct WorkDeque* deque, elem_t* value, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function pulls bottom element of deque, any thread
+ * @param [in]  deque Pointer to deque
+ * @param [out] value Stolen value(ELEM_T_POISON if deque is empty)
+ * @return EMPTY_STACK if deque is empty, other error code or NO_ERRORS if everythind ok
+*/
+enum errorCode wdeque_steal(struct WorkDeque* deque, elem_t* value, FILE* stream, const char* file, int line, const char* func);
+
+/**
+ * @brief Function prints homeland, errors and elements of deque, must not race with other operations
+ * @param [in] stream Output stream
+ * @param [in] deque  Pointer to deque
+ * @return Error code or NO_ERRORS if everything ok
+*/
+enum errorCode wdeque_dump(FILE* stream, const struct WorkDeque* deque, const char* file, const char* func, int line);
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * @file
+ * @brief Allocators of stack buffers: heap and size-class arena
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Stack.h"
+
+static void* heap_allocate(struct StackAllocator* allocator, size_t size);
+static void* heap_reallocate(struct StackAllocator* allocator, void* block, size_t oldSize, size_t size);
+static void  heap_deallocate(struct StackAllocator* allocator, void* block, size_t size);
+
+static void* arena_allocate(struct StackAllocator* allocator, size_t size);
+static void* arena_reallocate(struct StackAllocator* allocator, void* block, size_t oldSize, size_t size);
+static void  arena_deallocate(struct StackAllocator* allocator, void* block, size_t size);
+
+static size_t arena_class(size_t size);
+static bool   arena_new_slab(struct StackArena* arena);
+static void*  arena_big_allocate(struct StackArena* arena, size_t size);
+static void   arena_relink(struct StackArena* arena, struct StackArenaBlock* block);
+static void   free_block_list(struct StackArenaBlock* block);
+
+struct StackAllocator STACK_HEAP_ALLOCATOR = {"heap", heap_allocate, heap_reallocate, heap_deallocate};
+
+static void* heap_allocate(struct StackAllocator* allocator, size_t size)
+{
+    (void) allocator;
+
+    return calloc(size, sizeof(char));
+}
+
+static void* heap_reallocate(struct StackAllocator* allocator, void* block, size_t oldSize, size_t size)
+{
+    (void) allocator;
+    (void) oldSize;
+
+    return realloc(block, size);
+}
+
+static void heap_deallocate(struct StackAllocator* allocator, void* block, size_t size)
+{
+    (void) allocator;
+    (void) size;
+
+    free(block);
+}
+
+enum errorCode stack_arena_ctor(struct StackArena* arena)
+{
+    if (no_ptr(stderr, arena, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    arena->allocator = {"arena", arena_allocate, arena_reallocate, arena_deallocate};
+    arena->slabs     = NULL;
+    arena->bigBlocks = NULL;
+    arena->slabTop   = NULL;
+    arena->slabEnd   = NULL;
+    arena->used      = 0;
+    arena->reserved  = 0;
+
+    for (size_t i = 0; i < ARENA_CLASS_COUNT; i++) arena->freeLists[i] = NULL;
+
+    return NO_ERRORS;
+}
+
+enum errorCode stack_arena_dtor(struct StackArena* arena)
+{
+    if (no_ptr(stderr, arena, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    free_block_list(arena->slabs);
+    free_block_list(arena->bigBlocks);
+
+    return stack_arena_ctor(arena);
+}
+
+static void* arena_allocate(struct StackAllocator* allocator, size_t size)
+{
+    struct StackArena* arena = (struct StackArena*) allocator;
+
+    size_t index = arena_class(size);
+    if (index == ARENA_CLASS_COUNT) return arena_big_allocate(arena, size);
+
+    size_t classSize = ARENA_MIN_CLASS << index;
+    void*  block     = arena->freeLists[index];
+
+    if (block)
+    {
+        arena->freeLists[index] = *((void**) block);
+    }
+    else
+    {
+        if ((size_t) (arena->slabEnd - arena->slabTop) < classSize && !arena_new_slab(arena)) return NULL;
+
+        block           = arena->slabTop;
+        arena->slabTop += classSize;
+    }
+
+    arena->used += classSize;
+
+    return block;
+}
+
+static void* arena_reallocate(struct StackAllocator* allocator, void* block, size_t oldSize, size_t size)
+{
+    struct StackArena* arena = (struct StackArena*) allocator;
+
+    size_t oldIndex = arena_class(oldSize);
+    size_t index    = arena_class(size);
+
+    if (index == oldIndex && index != ARENA_CLASS_COUNT) return block;
+
+    // Last block carved from slab grows and shrinks in place
+    if (index != ARENA_CLASS_COUNT && oldIndex != ARENA_CLASS_COUNT &&
+        (char*) block + (ARENA_MIN_CLASS << oldIndex) == arena->slabTop &&
+        (size_t) (arena->slabEnd - (char*) block) >= (ARENA_MIN_CLASS << index))
+    {
+        arena->slabTop = (char*) block + (ARENA_MIN_CLASS << index);
+        arena->used    = arena->used - (ARENA_MIN_CLASS << oldIndex) + (ARENA_MIN_CLASS << index);
+
+        return block;
+    }
+
+    if (index == ARENA_CLASS_COUNT && oldIndex == ARENA_CLASS_COUNT)
+    {
+        struct StackArenaBlock* header = (struct StackArenaBlock*) block - 1;
+        struct StackArenaBlock* moved  = (struct StackArenaBlock*) realloc(header, sizeof(struct StackArenaBlock) + size);
+        if (!moved) return NULL;
+
+        arena_relink(arena, moved);
+        arena->used     += size - oldSize;
+        arena->reserved += size - oldSize;
+
+        return moved + 1;
+    }
+
+    void* newBlock = arena_allocate(allocator, size);
+    if (!newBlock) return NULL;
+
+    memcpy(newBlock, block, oldSize < size ? oldSize : size);
+    arena_deallocate(allocator, block, oldSize);
+
+    return newBlock;
+}
+
+static void arena_deallocate(struct StackAllocator* allocator, void* block, size_t size)
+{
+    struct StackArena* arena = (struct StackArena*) allocator;
+
+    if (!block) return;
+
+    size_t index = arena_class(size);
+
+    if (index == ARENA_CLASS_COUNT)
+    {
+        struct StackArenaBlock* header = (struct StackArenaBlock*) block - 1;
+
+        if (header->prev) header->prev->next = header->next;
+        else              arena->bigBlocks   = header->next;
+
+        if (header->next) header->next->prev = header->prev;
+
+        arena->used     -= size;
+        arena->reserved -= sizeof(struct StackArenaBlock) + size;
+
+        free(header);
+        return;
+    }
+
+    *((void**) block)       = arena->freeLists[index];
+    arena->freeLists[index] = block;
+    arena->used            -= ARENA_MIN_CLASS << index;
+}
+
+/// @brief Index of smallest size class not less than size or ARENA_CLASS_COUNT for big blocks
+static size_t arena_class(size_t size)
+{
+    size_t index     = 0;
+    size_t classSize = ARENA_MIN_CLASS;
+
+    while (classSize < size && index < ARENA_CLASS_COUNT)
+    {
+        classSize <<= 1;
+        index++;
+    }
+
+    return index;
+}
+
+/// @brief Takes new slab from heap, rest of current slab goes to free lists
+static bool arena_new_slab(struct StackArena* arena)
+{
+    for (size_t index = ARENA_CLASS_COUNT; index-- > 0; )
+    {
+        size_t classSize = ARENA_MIN_CLASS << index;
+
+        while ((size_t) (arena->slabEnd - arena->slabTop) >= classSize)
+        {
+            *((void**) arena->slabTop) = arena->freeLists[index];
+            arena->freeLists[index]    = arena->slabTop;
+            arena->slabTop            += classSize;
+        }
+    }
+
+    struct StackArenaBlock* slab = (struct StackArenaBlock*) malloc(ARENA_SLAB_SIZE);
+    if (!slab) return false;
+
+    slab->prev   = NULL;
+    slab->next   = arena->slabs;
+    arena->slabs = slab;
+
+    arena->slabTop   = (char*) (slab + 1);
+    arena->slabEnd   = (char*) slab + ARENA_SLAB_SIZE;
+    arena->reserved += ARENA_SLAB_SIZE;
+
+    return true;
+}
+
+static void* arena_big_allocate(struct StackArena* arena, size_t size)
+{
+    struct StackArenaBlock* block = (struct StackArenaBlock*) malloc(sizeof(struct StackArenaBlock) + size);
+    if (!block) return NULL;
+
+    block->prev = NULL;
+    block->next = arena->bigBlocks;
+
+    if (arena->bigBlocks) arena->bigBlocks->prev = block;
+    arena->bigBlocks = block;
+
+    arena->used     += size;
+    arena->reserved += sizeof(struct StackArenaBlock) + size;
+
+    return block + 1;
+}
+
+/// @brief Fixes list neighbours of big block moved by realloc
+static void arena_relink(struct StackArena* arena, struct StackArenaBlock* block)
+{
+    if (block->prev) block->prev->next = block;
+    else             arena->bigBlocks  = block;
+
+    if (block->next) block->next->prev = block;
+}
+
+static void free_block_list(struct StackArenaBlock* block)
+{
+    while (block)
+    {
+        struct StackArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+}
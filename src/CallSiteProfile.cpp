@@ -0,0 +1,358 @@
+/**
+ * @file
+ * @brief Call-site profile of stack operations: open-addressing table keyed by file/line/function pointers
+*/
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "CallSiteProfile.h"
+
+#ifdef USE_CALL_SITE_PROFILE
+
+/// @brief Costs collected by current outermost scope of thread
+struct CallSiteThread
+{
+    unsigned           depth;       ///< Number of open scopes
+    size_t             reallocs;    ///< Capacity changes in outermost scope
+    unsigned long long reallocNs;   ///< Their time
+    unsigned long long verifyNs;    ///< Verification time in outermost scope
+};
+
+/// @brief State of call-site table slot
+enum callSiteSlotState
+{
+    SLOT_EMPTY    = 0,
+    SLOT_CLAIMED  = 1,  ///< Key is being written by thread that claimed slot
+    SLOT_READY    = 2
+};
+
+/// @brief Slot of call-site table: key is written once by thread that claims slot, costs are atomic counters
+struct CallSiteSlot
+{
+    std::atomic<int>                state;
+    const char*                     file;
+    const char*                     func;
+    int                             line;
+    enum callSiteOp                 op;
+    std::atomic<size_t>             calls;
+    std::atomic<unsigned long long> totalNs;
+    std::atomic<size_t>             reallocs;
+    std::atomic<unsigned long long> reallocNs;
+    std::atomic<unsigned long long> verifyNs;
+};
+
+static thread_local struct CallSiteThread callSiteThread = {};
+
+static std::atomic<struct CallSiteSlot*> callSiteTable   = {}; ///< CALL_SITE_TABLE_SIZE slots, allocated by first call
+static std::atomic<size_t>               callSiteCount   = {}; ///< Claimed slots
+static std::atomic<size_t>               callSiteDropped = {}; ///< Calls of sites that didn't fit into table
+
+static FILE*             callSiteExitStream = NULL;           ///< Stream of report at exit
+static enum callSiteSort callSiteExitSort   = CALL_SITE_BY_TIME;
+
+/// Table is never filled over this number of sites, so that probing stays short
+static const size_t CALL_SITE_MAX_COUNT = CALL_SITE_TABLE_SIZE / 4 * 3;
+
+static struct CallSiteSlot* call_site_table();
+static struct CallSiteSlot* call_site_find(const char* file, int line, const char* func, enum callSiteOp op);
+static size_t call_site_merge(struct CallSite* sites, size_t count, const struct CallSiteSlot* slot);
+static unsigned long long call_site_cost(const struct CallSite* site, enum callSiteSort sort);
+static void call_site_sort(struct CallSite* sites, size_t count, enum callSiteSort sort);
+static const char* call_site_op_name(enum callSiteOp op);
+static void call_site_exit_report();
+
+unsigned long long call_site_now()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (unsigned long long) time.tv_sec * 1000000000ull + (unsigned long long) time.tv_nsec;
+}
+
+struct CallSiteScope call_site_enter(enum callSiteOp op, const char* file, int line, const char* func)
+{
+    struct CallSiteScope scope = {file, func, line, op, call_site_now(), callSiteThread.depth == 0};
+
+    if (scope.outer)
+    {
+        callSiteThread.reallocs  = 0;
+        callSiteThread.reallocNs = 0;
+        callSiteThread.verifyNs  = 0;
+    }
+
+    callSiteThread.depth++;
+
+    return scope;
+}
+
+void call_site_leave(struct CallSiteScope* scope)
+{
+    callSiteThread.depth--;
+
+    if (!scope->outer) return;
+
+    unsigned long long time = call_site_now() - scope->start;
+
+    struct CallSiteSlot* site = call_site_find(scope->file, scope->line, scope->func, scope->op);
+
+    if (site)
+    {
+        site->calls.fetch_add(1, std::memory_order_relaxed);
+        site->totalNs.fetch_add(time, std::memory_order_relaxed);
+
+        if (callSiteThread.reallocs)
+        {
+            site->reallocs.fetch_add(callSiteThread.reallocs, std::memory_order_relaxed);
+            site->reallocNs.fetch_add(callSiteThread.reallocNs, std::memory_order_relaxed);
+        }
+
+        if (callSiteThread.verifyNs) site->verifyNs.fetch_add(callSiteThread.verifyNs, std::memory_order_relaxed);
+    }
+    else callSiteDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void call_site_add_realloc(unsigned long long start)
+{
+    if (!callSiteThread.depth) return;
+
+    callSiteThread.reallocs++;
+    callSiteThread.reallocNs += call_site_now() - start;
+}
+
+void call_site_add_verify(unsigned long long start)
+{
+    if (!callSiteThread.depth) return;
+
+    callSiteThread.verifyNs += call_site_now() - start;
+}
+
+size_t call_site_snapshot(struct CallSite* sites, size_t maxCount, enum callSiteSort sort)
+{
+    if (!sites || !maxCount) return 0;
+
+    struct CallSite* all = (struct CallSite*) calloc(CALL_SITE_TABLE_SIZE, sizeof(struct CallSite));
+    if (!all) return 0;
+
+    size_t count = 0;
+
+    const struct CallSiteSlot* table = callSiteTable.load(std::memory_order_acquire);
+
+    for (size_t i = 0; table && i < CALL_SITE_TABLE_SIZE; i++)
+    {
+        if (table[i].state.load(std::memory_order_acquire) == SLOT_READY) count = call_site_merge(all, count, &table[i]);
+    }
+
+    call_site_sort(all, count, sort);
+
+    if (count > maxCount) count = maxCount;
+    for (size_t i = 0; i < count; i++) sites[i] = all[i];
+
+    free(all);
+
+    return count;
+}
+
+void call_site_report(FILE* stream, enum callSiteSort sort, size_t limit)
+{
+    static const char* const sortNames[] = {"time", "reallocs", "verify time", "calls"};
+
+    struct CallSite* sites = (struct CallSite*) calloc(CALL_SITE_TABLE_SIZE, sizeof(struct CallSite));
+    if (no_ptr(stream, sites, NO_MEMORY, __FILE__, __func__, __LINE__)) return;
+
+    size_t count = call_site_snapshot(sites, CALL_SITE_TABLE_SIZE, sort);
+    if (limit && count > limit) count = limit;
+
+    size_t dropped = callSiteDropped.load(std::memory_order_relaxed);
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "call-site profile");
+    fprintf(stream, "(sorted by %s, %lu sites shown, %lu calls dropped):\n",
+            ((unsigned) sort <= CALL_SITE_BY_CALLS) ? sortNames[sort] : "time", count, dropped);
+    fprintf(stream, "%10s %12s %10s %9s %12s %12s  %-8s %s\n",
+            "calls", "total us", "avg ns", "reallocs", "realloc us", "verify us", "op", "site");
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const struct CallSite* site = &sites[i];
+
+        fprintf(stream, "%10lu %12.1f %10llu %9lu %12.1f %12.1f  %-8s %s:%d %s\n", site->calls,
+                (double) site->totalNs / 1e3, site->totalNs / site->calls, site->reallocs,
+                (double) site->reallocNs / 1e3, (double) site->verifyNs / 1e3, call_site_op_name(site->op),
+                site->file, site->line, site->func);
+    }
+
+    free(sites);
+}
+
+void call_site_report_at_exit(FILE* stream, enum callSiteSort sort)
+{
+    static bool registered = false;
+
+    callSiteExitStream = stream;
+    callSiteExitSort   = sort;
+
+    if (!registered) registered = (atexit(call_site_exit_report) == 0);
+}
+
+void call_site_reset()
+{
+    struct CallSiteSlot* table = callSiteTable.load(std::memory_order_acquire);
+
+    for (size_t i = 0; table && i < CALL_SITE_TABLE_SIZE; i++)
+    {
+        table[i].state.store(SLOT_EMPTY, std::memory_order_relaxed);
+        table[i].calls.store(0, std::memory_order_relaxed);
+        table[i].totalNs.store(0, std::memory_order_relaxed);
+        table[i].reallocs.store(0, std::memory_order_relaxed);
+        table[i].reallocNs.store(0, std::memory_order_relaxed);
+        table[i].verifyNs.store(0, std::memory_order_relaxed);
+    }
+
+    callSiteCount.store(0, std::memory_order_relaxed);
+    callSiteDropped.store(0, std::memory_order_relaxed);
+}
+
+/// @brief Table allocated by first call, thread that loses race of allocation frees its copy
+static struct CallSiteSlot* call_site_table()
+{
+    struct CallSiteSlot* table = callSiteTable.load(std::memory_order_acquire);
+    if (table) return table;
+
+    struct CallSiteSlot* fresh = (struct CallSiteSlot*) calloc(CALL_SITE_TABLE_SIZE, sizeof(struct CallSiteSlot));
+    if (!fresh) return NULL;
+
+    if (callSiteTable.compare_exchange_strong(table, fresh, std::memory_order_acq_rel)) return fresh;
+
+    free(fresh);
+
+    return table;
+}
+
+/**
+ * @brief Finds slot of call site or claims empty one, NULL if table is full
+ * @details Lock-free: slot is claimed by CAS of its state, key is published by release store of SLOT_READY.
+ * Slots that are still being claimed are skipped, so two threads calling new site at once may claim two slots
+ * for it, call_site_snapshot merges them
+*/
+static struct CallSiteSlot* call_site_find(const char* file, int line, const char* func, enum callSiteOp op)
+{
+    struct CallSiteSlot* table = call_site_table();
+    if (!table) return NULL;
+
+    uint64_t key = ((uint64_t) file * 0x9E3779B97F4A7C15ull) ^ ((uint64_t) func * 0xC2B2AE3D27D4EB4Full)
+                 ^ (uint64_t) (unsigned) line;
+    key ^= key >> 29;
+
+    for (size_t probe = 0; probe < CALL_SITE_TABLE_SIZE; probe++)
+    {
+        struct CallSiteSlot* site  = &table[(key + probe) & (CALL_SITE_TABLE_SIZE - 1)];
+        int                  state = site->state.load(std::memory_order_acquire);
+
+        if (state == SLOT_READY && site->file == file && site->line == line && site->func == func) return site;
+
+        if (state != SLOT_EMPTY) continue;
+
+        if (callSiteCount.load(std::memory_order_relaxed) >= CALL_SITE_MAX_COUNT) return NULL;
+
+        if (!site->state.compare_exchange_strong(state, SLOT_CLAIMED, std::memory_order_acquire)) continue;
+
+        callSiteCount.fetch_add(1, std::memory_order_relaxed);
+
+        site->file = file;
+        site->line = line;
+        site->func = func;
+        site->op   = op;
+
+        site->state.store(SLOT_READY, std::memory_order_release);
+
+        return site;
+    }
+
+    return NULL;
+}
+
+/// @brief Adds costs of slot to site with the same key or appends new site, returns new number of sites(few, linear search)
+static size_t call_site_merge(struct CallSite* sites, size_t count, const struct CallSiteSlot* slot)
+{
+    // Slot just claimed by another thread has no calls yet
+    size_t calls = slot->calls.load(std::memory_order_relaxed);
+    if (!calls) return count;
+
+    size_t i = 0;
+    while (i < count && !(sites[i].file == slot->file && sites[i].line == slot->line && sites[i].func == slot->func)) i++;
+
+    if (i == count)
+    {
+        sites[i]      = {};
+        sites[i].file = slot->file;
+        sites[i].func = slot->func;
+        sites[i].line = slot->line;
+        sites[i].op   = slot->op;
+
+        count++;
+    }
+
+    sites[i].calls     += calls;
+    sites[i].totalNs   += slot->totalNs.load(std::memory_order_relaxed);
+    sites[i].reallocs  += slot->reallocs.load(std::memory_order_relaxed);
+    sites[i].reallocNs += slot->reallocNs.load(std::memory_order_relaxed);
+    sites[i].verifyNs  += slot->verifyNs.load(std::memory_order_relaxed);
+
+    return count;
+}
+
+static unsigned long long call_site_cost(const struct CallSite* site, enum callSiteSort sort)
+{
+    switch (sort)
+    {
+        case CALL_SITE_BY_REALLOCS: return site->reallocs;
+        case CALL_SITE_BY_VERIFY:   return site->verifyNs;
+        case CALL_SITE_BY_CALLS:    return site->calls;
+        case CALL_SITE_BY_TIME:
+        default:                    return site->totalNs;
+    }
+}
+
+/// @brief Insertion sort by decreasing cost, ties keep table order(table holds few sites)
+static void call_site_sort(struct CallSite* sites, size_t count, enum callSiteSort sort)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        struct CallSite    site = sites[i];
+        unsigned long long cost = call_site_cost(&site, sort);
+
+        size_t j = i;
+        for (; j > 0 && call_site_cost(&sites[j - 1], sort) < cost; j--) sites[j] = sites[j - 1];
+
+        sites[j] = site;
+    }
+}
+
+static const char* call_site_op_name(enum callSiteOp op)
+{
+    switch (op)
+    {
+        case CALL_SITE_CTOR:    return "ctor";
+        case CALL_SITE_DTOR:    return "dtor";
+        case CALL_SITE_PUSH:    return "push";
+        case CALL_SITE_POP:     return "pop";
+        case CALL_SITE_PUSH_N:  return "push_n";
+        case CALL_SITE_POP_N:   return "pop_n";
+        case CALL_SITE_REALLOC: return "realloc";
+        case CALL_SITE_RESIZE:  return "resize";
+        case CALL_SITE_TRIM:    return "trim";
+        case CALL_SITE_VERIFY:  return "verify";
+        case CALL_SITE_CLONE:   return "clone";
+        default:                return "unknown";
+    }
+}
+
+static void call_site_exit_report()
+{
+    if (callSiteExitStream) call_site_report(callSiteExitStream, callSiteExitSort, 0);
+}
+
+#endif
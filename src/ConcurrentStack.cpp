@@ -0,0 +1,423 @@
+/**
+ * @file
+ * @brief Lock-free concurrent stack functions source
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Color_output.h"
+#include "ConcurrentStack.h"
+
+const size_t HAZARD_SCAN_MIN = 64;      ///< Retired nodes of thread are scanned when there are 2 * records + this many
+
+/// @brief Hazard pointer record of one thread, records are never freed and are reused by new threads
+struct HazardRecord
+{
+    std::atomic<struct ConcurrentNode*> hazard;         ///< Node the thread is reading now
+    std::atomic<bool>                   active;         ///< Record is owned by a thread
+    struct HazardRecord*                next;           ///< Next record(immutable after record is published)
+    struct ConcurrentNode*              retired;        ///< Popped nodes waiting for free
+    size_t                              retiredCount;   ///< Length of retired list
+};
+
+/// @brief Thread-local owner of hazard record, releases it on thread exit
+struct HazardRecordOwner
+{
+    struct HazardRecord* record;
+
+    HazardRecordOwner() : record(NULL) {}
+    HazardRecordOwner(const HazardRecordOwner&) = delete;
+    HazardRecordOwner& operator=(const HazardRecordOwner&) = delete;
+
+    ~HazardRecordOwner();
+};
+
+static std::atomic<struct HazardRecord*> hazardRecords(NULL);
+static std::atomic<size_t>               hazardRecordCount(0);
+
+static thread_local struct HazardRecordOwner threadRecord;
+static thread_local unsigned                 threadRandom = 0;
+
+static struct HazardRecord* hazard_record();
+static void retire(struct HazardRecord* record, struct ConcurrentNode* node);
+static void scan(struct HazardRecord* record);
+static void scan_released();
+static bool hazardous(const struct ConcurrentNode* node);
+
+static struct EliminationSlot* elimination_slot(struct ConcurrentStack* stack);
+static bool eliminate_push(struct ConcurrentStack* stack, struct ConcurrentNode* node);
+static bool eliminate_pop(struct ConcurrentStack* stack, elem_t* value);
+
+static void cstack_set_error(struct ConcurrentStack* stack, enum errorCode error);
+static void cstack_print_header(FILE* stream, const struct ConcurrentStack* stack, const char* file, const char* func, int line);
+
+enum errorCode cstack_ctor(struct ConcurrentStack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    stack->top.store(NULL, std::memory_order_relaxed);
+    stack->stackErrors.store(NO_ERRORS, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < CSTACK_ELIMINATION_SIZE; i++)
+    {
+        stack->elimination[i].node.store(NULL, std::memory_order_relaxed);
+    }
+
+    #ifdef USE_CANARY_PROTECTION
+
+    stack->leftCanary  = CANARY_T_DEFAULT;
+    stack->rightCanary = CANARY_T_DEFAULT;
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+enum errorCode cstack_dtor(struct ConcurrentStack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (cstack_verify(stack, stream, file, line, func) == NO_STACK_PTR) return NO_STACK_PTR;
+
+    #endif
+
+    struct ConcurrentNode* node = stack->top.exchange(NULL);
+    while (node)
+    {
+        struct ConcurrentNode* next = node->next.load(std::memory_order_relaxed);
+        free(node);
+        node = next;
+    }
+
+    for (size_t i = 0; i < CSTACK_ELIMINATION_SIZE; i++)
+    {
+        free(stack->elimination[i].node.exchange(NULL));
+    }
+
+    // Nodes popped by threads that have exited wait in released records until new thread takes them
+    cstack_reclaim();
+    scan_released();
+
+    stack->stackHomeland.stackName = NULL;
+    stack->stackHomeland.file      = NULL;
+    stack->stackHomeland.function  = NULL;
+    stack->stackHomeland.line      = -1;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    stack->leftCanary  = CANARY_T_POISON;
+    stack->rightCanary = CANARY_T_POISON;
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+enum errorCode cstack_verify(struct ConcurrentStack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    if (stack->leftCanary  != CANARY_T_DEFAULT) cstack_set_error(stack, LEFT_CANARY_BAD_VALUE);
+    if (stack->rightCanary != CANARY_T_DEFAULT) cstack_set_error(stack, RIGHT_CANARY_BAD_VALUE);
+
+    #endif
+
+    enum errorCode errors = (errorCode) stack->stackErrors.load(std::memory_order_relaxed);
+
+    // Elements may be changed by other threads, so only header is printed
+    if (errors) cstack_print_header(stream, stack, file, func, line);
+
+    return errors;
+}
+
+enum errorCode cstack_push(struct ConcurrentStack* stack, elem_t value, FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (cstack_verify(stack, stream, file, line, func)) return (errorCode) stack->stackErrors.load(std::memory_order_relaxed);
+
+    #endif
+
+    struct ConcurrentNode* node = (struct ConcurrentNode*) calloc(1, sizeof(struct ConcurrentNode));
+    if (!node)
+    {
+        cstack_set_error(stack, NO_MEMORY);
+
+        #ifndef NO_DEBUG
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, NO_MEMORY);
+        #endif
+
+        return NO_MEMORY;
+    }
+
+    struct ConcurrentNode* top = stack->top.load(std::memory_order_relaxed);
+
+    node->value = value;
+    node->next.store(top, std::memory_order_relaxed);
+
+    while (!stack->top.compare_exchange_weak(top, node, std::memory_order_release, std::memory_order_relaxed))
+    {
+        if (eliminate_push(stack, node)) return NO_ERRORS;
+
+        node->next.store(top, std::memory_order_relaxed);
+    }
+
+    return NO_ERRORS;
+}
+
+enum errorCode cstack_pop(struct ConcurrentStack* stack, elem_t* value, FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, value, NO_STACK_DATA_PTR, file, func, line)) return NO_STACK_DATA_PTR;
+
+    if (cstack_verify(stack, stream, file, line, func)) return (errorCode) stack->stackErrors.load(std::memory_order_relaxed);
+
+    #endif
+
+    *value = ELEM_T_POISON;
+
+    struct HazardRecord* record = hazard_record();
+    if (!record)
+    {
+        cstack_set_error(stack, NO_MEMORY);
+        return NO_MEMORY;
+    }
+
+    struct ConcurrentNode* node = NULL;
+
+    while (true)
+    {
+        node = stack->top.load(std::memory_order_acquire);
+        if (!node) break;
+
+        // Node can't be freed after hazard is published and top still points to it
+        record->hazard.store(node);
+        if (stack->top.load() != node) continue;
+
+        struct ConcurrentNode* next = node->next.load(std::memory_order_relaxed);
+        if (stack->top.compare_exchange_strong(node, next, std::memory_order_acq_rel, std::memory_order_relaxed)) break;
+
+        record->hazard.store(NULL, std::memory_order_release);
+
+        if (eliminate_pop(stack, value)) return NO_ERRORS;
+    }
+
+    record->hazard.store(NULL, std::memory_order_release);
+
+    if (!node) return EMPTY_STACK;
+
+    *value = node->value;
+    retire(record, node);
+
+    return NO_ERRORS;
+}
+
+enum errorCode cstack_dump(FILE* stream, const struct ConcurrentStack* stack, const char* file, const char* func, int line)
+{
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    cstack_print_header(stream, stack, file, func, line);
+
+    size_t index = 0;
+    for (const struct ConcurrentNode* node = stack->top.load(std::memory_order_acquire); node;
+         node = node->next.load(std::memory_order_relaxed), index++)
+    {
+        color_putc(stream, COLOR_CYAN, STYLE_BOLD, index ? '*' : '>');
+        color_putc(stream, COLOR_YELLOW, STYLE_BOLD, '[');
+        fprintf(stream, "top - %lu", index);
+        color_putc(stream, COLOR_YELLOW, STYLE_BOLD, ']');
+        fprintf(stream, " = %d\n", node->value);
+    }
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "size");
+    fprintf(stream, " = %lu\n", index);
+
+    return NO_ERRORS;
+}
+
+void cstack_reclaim()
+{
+    if (threadRecord.record) scan(threadRecord.record);
+}
+
+size_t cstack_retired_count()
+{
+    size_t count = 0;
+
+    for (struct HazardRecord* record = hazardRecords.load(std::memory_order_acquire); record; record = record->next)
+    {
+        count += record->retiredCount;
+    }
+
+    return count;
+}
+
+HazardRecordOwner::~HazardRecordOwner()
+{
+    if (!record) return;
+
+    // Retired nodes are freed before record is released, the ones still hazardous wait for the next owner
+    record->hazard.store(NULL);
+    scan(record);
+
+    record->active.store(false, std::memory_order_release);
+}
+
+/// @brief Record of calling thread, takes free record or publishes new one on first call
+static struct HazardRecord* hazard_record()
+{
+    if (threadRecord.record) return threadRecord.record;
+
+    for (struct HazardRecord* record = hazardRecords.load(std::memory_order_acquire); record; record = record->next)
+    {
+        bool expected = false;
+        if (!record->active.load(std::memory_order_relaxed) &&
+            record->active.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            threadRecord.record = record;
+            return record;
+        }
+    }
+
+    struct HazardRecord* record = (struct HazardRecord*) calloc(1, sizeof(struct HazardRecord));
+    if (!record) return NULL;
+
+    record->hazard.store(NULL, std::memory_order_relaxed);
+    record->active.store(true, std::memory_order_relaxed);
+    record->next = hazardRecords.load(std::memory_order_relaxed);
+
+    while (!hazardRecords.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed)) {}
+
+    hazardRecordCount.fetch_add(1, std::memory_order_relaxed);
+
+    threadRecord.record = record;
+    return record;
+}
+
+static void retire(struct HazardRecord* record, struct ConcurrentNode* node)
+{
+    node->next.store(record->retired, std::memory_order_relaxed);
+    record->retired = node;
+    record->retiredCount++;
+
+    if (record->retiredCount >= 2 * hazardRecordCount.load(std::memory_order_relaxed) + HAZARD_SCAN_MIN) scan(record);
+}
+
+/// @brief Frees retired nodes of record that are not hazard of any thread
+static void scan(struct HazardRecord* record)
+{
+    struct ConcurrentNode* node = record->retired;
+
+    record->retired      = NULL;
+    record->retiredCount = 0;
+
+    while (node)
+    {
+        struct ConcurrentNode* next = node->next.load(std::memory_order_relaxed);
+
+        if (hazardous(node))
+        {
+            node->next.store(record->retired, std::memory_order_relaxed);
+            record->retired = node;
+            record->retiredCount++;
+        }
+        else free(node);
+
+        node = next;
+    }
+}
+
+/// @brief Frees retired nodes of records that no thread owns, record is taken for the scan like by new thread
+static void scan_released()
+{
+    for (struct HazardRecord* record = hazardRecords.load(std::memory_order_acquire); record; record = record->next)
+    {
+        bool expected = false;
+        if (record->active.load(std::memory_order_relaxed) ||
+            !record->active.compare_exchange_strong(expected, true, std::memory_order_acquire)) continue;
+
+        scan(record);
+
+        record->active.store(false, std::memory_order_release);
+    }
+}
+
+static bool hazardous(const struct ConcurrentNode* node)
+{
+    for (struct HazardRecord* record = hazardRecords.load(std::memory_order_acquire); record; record = record->next)
+    {
+        if (record->hazard.load() == node) return true;
+    }
+
+    return false;
+}
+
+static struct EliminationSlot* elimination_slot(struct ConcurrentStack* stack)
+{
+    // xorshift with per-thread state, seeded by address of thread-local variable
+    if (!threadRandom) threadRandom = (unsigned) (size_t) &threadRandom | 1;
+
+    threadRandom ^= threadRandom << 13;
+    threadRandom ^= threadRandom >> 17;
+    threadRandom ^= threadRandom << 5;
+
+    return &stack->elimination[threadRandom % CSTACK_ELIMINATION_SIZE];
+}
+
+/// @brief Offers node in elimination slot, true if pop has taken it
+static bool eliminate_push(struct ConcurrentStack* stack, struct ConcurrentNode* node)
+{
+    struct EliminationSlot* slot = elimination_slot(stack);
+
+    struct ConcurrentNode* expected = NULL;
+    if (!slot->node.compare_exchange_strong(expected, node, std::memory_order_release, std::memory_order_relaxed)) return false;
+
+    for (size_t i = 0; i < CSTACK_ELIMINATION_SPIN; i++)
+    {
+        if (slot->node.load(std::memory_order_relaxed) != node) return true;
+    }
+
+    expected = node;
+    return !slot->node.compare_exchange_strong(expected, NULL, std::memory_order_relaxed, std::memory_order_relaxed);
+}
+
+/// @brief Takes node offered by push, true on success
+static bool eliminate_pop(struct ConcurrentStack* stack, elem_t* value)
+{
+    struct EliminationSlot* slot = elimination_slot(stack);
+
+    // Node isn't read before it is taken, and taken node is linked nowhere, so ABA in slot is harmless
+    struct ConcurrentNode* node = slot->node.load(std::memory_order_relaxed);
+    if (!node || !slot->node.compare_exchange_strong(node, NULL, std::memory_order_acquire, std::memory_order_relaxed)) return false;
+
+    *value = node->value;
+    free(node);
+
+    return true;
+}
+
+static void cstack_set_error(struct ConcurrentStack* stack, enum errorCode error)
+{
+    stack->stackErrors.fetch_or(error, std::memory_order_relaxed);
+}
+
+static void cstack_print_header(FILE* stream, const struct ConcurrentStack* stack, const char* file, const char* func, int line)
+{
+    PRINT_LINE(stream, file, func, line);
+    print_error(stream, (errorCode) stack->stackErrors.load(std::memory_order_relaxed));
+    print_homeland(stream, stack, &stack->stackHomeland);
+
+    #ifdef USE_CANARY_PROTECTION
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "left canary");
+    fprintf(stream, " = %llx\n", stack->leftCanary);
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "right canary");
+    fprintf(stream, " = %llx\n", stack->rightCanary);
+
+    #endif
+}
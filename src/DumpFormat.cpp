@@ -0,0 +1,549 @@
+/**
+ * @file
+ * @brief Machine-readable dumps: JSON objects and binary records with compressed runs of poison, decoder of binary records
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+/// @brief Receiver of runs: count elements at values, poison - all of them are ELEM_T_POISON
+typedef void (*dumpRunVisitor)(void* context, const elem_t* values, size_t count, bool poison);
+
+/// @brief State of binary record runs: counted in first pass(stream is NULL), written in second
+struct DumpRunWriter
+{
+    FILE*  stream;      ///< Output stream(NULL - runs are only counted)
+    size_t runs;        ///< Runs visited
+    size_t elements;    ///< Elements covered by runs
+    size_t literals;    ///< Elements stored after run headers
+    bool   written;     ///< All writes succeeded
+};
+
+/// @brief State of JSON elements array
+struct DumpJsonWriter
+{
+    FILE* stream;   ///< Output stream
+    bool  empty;    ///< Nothing printed into array yet
+};
+
+const size_t DUMP_DECODE_BLOCK   = 1024;    ///< Elements decoder reads at once
+const size_t DUMP_DECODE_STRINGS = 5;       ///< Strings after header of binary record
+
+static const char* const protectionNames[] = {"OFF", "CANARY", "HASH", "PARANOID"};
+static const char* const storageNames[]    = {"CONTIGUOUS", "SEGMENTED", "MAPPED", "GUARDED", "SNAPSHOT", "INCREMENTAL"};
+
+/// @brief Names of errorCode bits, name i is of bit 1 << i
+static const char* const errorNames[] = {
+    "NO_STACK_PTR", "NO_STACK_DATA_PTR", "SIZE_OUT_OF_CAPACITY", "SIZE_NOT_VALID", "CAPACITY_NOT_VALID", "NO_MEMORY",
+    "EMPTY_STACK", "LEFT_CANARY_BAD_VALUE", "RIGHT_CANARY_BAD_VALUE", "LEFT_DATA_CANARY_BAD_VALUE", "RIGHT_DATA_CANARY_BAD_VALUE",
+    "BAD_STRUCT_HASH", "BAD_DATA_HASH", "BAD_HASH_BACKEND", "POISON_OVERWRITTEN", "FILE_ERROR"
+};
+
+static enum errorCode walk_runs(const struct Stack* stack, stackDumpMode mode, dumpRunVisitor visit, void* context);
+static enum errorCode walk_chunks(const struct Stack* stack, stackDumpMode mode, dumpRunVisitor visit, void* context);
+static void split_runs(const elem_t* values, size_t count, dumpRunVisitor visit, void* context);
+#ifdef USE_CANARY_PROTECTION
+static bool data_canaries(const struct Stack* stack, unsigned long long* left, unsigned long long* right);
+#endif
+
+static void binary_run(void* context, const elem_t* values, size_t count, bool poison);
+static void json_run(void* context, const elem_t* values, size_t count, bool poison);
+static void json_string(FILE* stream, const char* text);
+
+static enum errorCode decode_record(FILE* in, FILE* out, const struct StackDumpHeader* header);
+static enum errorCode decode_runs(FILE* in, FILE* out, const struct StackDumpHeader* header);
+static void decode_poison_run(FILE* out, size_t first, size_t count, size_t size);
+
+enum errorCode stack_dump_binary(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                                 size_t suppressed)
+{
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    const char* strings[DUMP_DECODE_STRINGS] = {stack->stackHomeland.stackName, stack->stackHomeland.file,
+                                                stack->stackHomeland.function, file, func};
+    size_t stringBytes = 0;
+
+    for (size_t i = 0; i < DUMP_DECODE_STRINGS; i++)
+    {
+        if (!strings[i]) strings[i] = "";
+        stringBytes += strlen(strings[i]) + 1;
+    }
+
+    // Runs are counted first, so that header tells length of record before they are written
+    struct DumpRunWriter counter = {NULL, 0, 0, 0, true};
+    if (walk_runs(stack, mode, binary_run, &counter) == NO_MEMORY) return NO_MEMORY;
+
+    struct StackDumpHeader header = {};
+
+    memcpy(header.magic, STACK_DUMP_MAGIC, sizeof(header.magic));
+    header.version      = STACK_DUMP_VERSION;
+    header.elemSize     = sizeof(elem_t);
+    header.mode         = (unsigned) mode;
+    header.errors       = (unsigned) stack->stackErrors;
+    header.protection   = (unsigned) stack->protection;
+    header.storage      = (unsigned) stack->storage;
+    header.line         = line;
+    header.homelandLine = stack->stackHomeland.line;
+    header.stringBytes  = (unsigned) stringBytes;
+    header.recordBytes  = sizeof(header) + stringBytes + counter.runs * sizeof(unsigned long long) + counter.literals * sizeof(elem_t);
+    header.stack        = (unsigned long long) (uintptr_t) stack;
+    header.size         = stack->size;
+    header.capacity     = stack->capacity;
+    header.elements     = counter.elements;
+    header.runs         = counter.runs;
+    header.suppressed   = suppressed;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    header.flags      |= STACK_DUMP_CANARIES;
+    header.leftCanary  = stack->leftCanary;
+    header.rightCanary = stack->rightCanary;
+
+    if (data_canaries(stack, &header.leftDataCanary, &header.rightDataCanary)) header.flags |= STACK_DUMP_DATA_CANARIES;
+
+    #endif
+
+    #ifdef USE_HASH_PROTECTION
+
+    header.flags      |= STACK_DUMP_HASHES;
+    header.hashBackend = (unsigned) stack->hashBackend;
+    header.structHash  = stack->structHash;
+    header.dataHash    = stack->dataHash;
+
+    #endif
+
+    struct DumpRunWriter writer = {stream, 0, 0, 0, fwrite(&header, sizeof(header), 1, stream) == 1};
+
+    for (size_t i = 0; i < DUMP_DECODE_STRINGS && writer.written; i++)
+    {
+        size_t bytes = strlen(strings[i]) + 1;
+        writer.written = fwrite(strings[i], 1, bytes, stream) == bytes;
+    }
+
+    if (writer.written) walk_runs(stack, mode, binary_run, &writer);
+
+    return writer.written ? NO_ERRORS : FILE_ERROR;
+}
+
+enum errorCode stack_dump_json(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                               size_t suppressed)
+{
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    fprintf(stream, "{\"stack\": \"%p\", \"name\": ", (const void*) stack);
+    json_string(stream, stack->stackHomeland.stackName);
+    fprintf(stream, ", \"file\": ");
+    json_string(stream, stack->stackHomeland.file);
+    fprintf(stream, ", \"function\": ");
+    json_string(stream, stack->stackHomeland.function);
+    fprintf(stream, ", \"line\": %d, \"dump\": {\"file\": ", stack->stackHomeland.line);
+    json_string(stream, file);
+    fprintf(stream, ", \"function\": ");
+    json_string(stream, func);
+    fprintf(stream, ", \"line\": %d}, \"mode\": \"%s\"", line, (mode == FULL) ? "FULL" : "SHORT");
+
+    fprintf(stream, ", \"errorMask\": %u, \"errors\": [", (unsigned) stack->stackErrors);
+
+    bool empty = true;
+    for (size_t i = 0; i < sizeof(errorNames) / sizeof(errorNames[0]); i++)
+    {
+        if (!((unsigned) stack->stackErrors & (1u << i))) continue;
+
+        fprintf(stream, "%s\"%s\"", empty ? "" : ", ", errorNames[i]);
+        empty = false;
+    }
+
+    fprintf(stream, "], \"suppressed\": %lu", suppressed);
+
+    if ((unsigned) stack->protection <= PROTECTION_PARANOID) fprintf(stream, ", \"protection\": \"%s\"", protectionNames[stack->protection]);
+    else                                                     fprintf(stream, ", \"protection\": %d", (int) stack->protection);
+
+    if ((unsigned) stack->storage <= STORAGE_INCREMENTAL) fprintf(stream, ", \"storage\": \"%s\"", storageNames[stack->storage]);
+    else                                                  fprintf(stream, ", \"storage\": %d", (int) stack->storage);
+
+    #ifdef USE_HASH_PROTECTION
+
+    fprintf(stream, ", \"hash\": {\"backend\": ");
+    if (hash_backend_name(stack->hashBackend)) fprintf(stream, "\"%s\"", hash_backend_name(stack->hashBackend));
+    else                                       fprintf(stream, "%d", (int) stack->hashBackend);
+    fprintf(stream, ", \"struct\": \"%llx\", \"data\": \"%llx\"}", stack->structHash, stack->dataHash);
+
+    #endif
+
+    #ifdef USE_CANARY_PROTECTION
+
+    fprintf(stream, ", \"canaries\": {\"left\": \"%llx\", \"right\": \"%llx\"", stack->leftCanary, stack->rightCanary);
+
+    unsigned long long leftData  = 0;
+    unsigned long long rightData = 0;
+
+    if (data_canaries(stack, &leftData, &rightData)) fprintf(stream, ", \"leftData\": \"%llx\", \"rightData\": \"%llx\"", leftData, rightData);
+
+    fprintf(stream, "}");
+
+    #endif
+
+    fprintf(stream, ", \"size\": %lu, \"capacity\": %lu, \"elements\": [", stack->size, stack->capacity);
+
+    struct DumpJsonWriter writer = {stream, true};
+    enum errorCode error = walk_runs(stack, mode, json_run, &writer);
+
+    fprintf(stream, "]}\n");
+
+    return (error == NO_MEMORY) ? NO_MEMORY : NO_ERRORS;
+}
+
+enum errorCode stack_dump_decode(FILE* in, FILE* out)
+{
+    if (no_ptr(stderr, in,  FILE_ERROR, __FILE__, __func__, __LINE__)) return FILE_ERROR;
+    if (no_ptr(stderr, out, FILE_ERROR, __FILE__, __func__, __LINE__)) return FILE_ERROR;
+
+    while (true)
+    {
+        struct StackDumpHeader header = {};
+
+        size_t read = fread(&header, 1, sizeof(header), in);
+        if (!read && feof(in)) return NO_ERRORS;
+
+        if (read != sizeof(header) || memcmp(header.magic, STACK_DUMP_MAGIC, sizeof(header.magic)) ||
+            header.version != STACK_DUMP_VERSION || header.elemSize != sizeof(elem_t) || header.mode > SHORT ||
+            header.stringBytes > STACK_DUMP_BUFFER) return FILE_ERROR;
+
+        enum errorCode error = decode_record(in, out, &header);
+        if (error) return error;
+    }
+}
+
+/// @brief Visits elements of stack from the bottom as runs(capacity of them in FULL mode, size in SHORT one)
+static enum errorCode walk_runs(const struct Stack* stack, stackDumpMode mode, dumpRunVisitor visit, void* context)
+{
+    if (stack->storage == STORAGE_SEGMENTED) return walk_chunks(stack, mode, visit, context);
+
+    // Capacity which can't be trusted doesn't bound buffer
+    if (!stack->data || (stack->stackErrors & CAPACITY_NOT_VALID)) return NO_STACK_DATA_PTR;
+
+    size_t count = (mode == FULL || stack->size > stack->capacity) ? stack->capacity : stack->size;
+
+    // Tail of incremental stack above poisoned isn't filled yet
+    if (stack->storage == STORAGE_INCREMENTAL && count > stack->migration.poisoned) count = stack->migration.poisoned;
+
+    #ifdef USE_CANARY_PROTECTION
+    const elem_t* data = (const elem_t*) ((const canary_t*) stack->data + 1);
+    #else
+    const elem_t* data = stack->data;
+    #endif
+
+    // Elements below pending are still in old buffer of incremental stack
+    size_t pending = stack->migration.pending;
+
+    if (pending && stack->migration.oldData)
+    {
+        #ifdef USE_CANARY_PROTECTION
+        const elem_t* oldData = (const elem_t*) ((const canary_t*) stack->migration.oldData + 1);
+        #else
+        const elem_t* oldData = stack->migration.oldData;
+        #endif
+
+        split_runs(oldData, (pending < count) ? pending : count, visit, context);
+    }
+    else pending = 0;
+
+    if (count > pending) split_runs(data + pending, count - pending, visit, context);
+
+    return NO_ERRORS;
+}
+
+static enum errorCode walk_chunks(const struct Stack* stack, stackDumpMode mode, dumpRunVisitor visit, void* context)
+{
+    if (!stack->topChunk) return NO_STACK_DATA_PTR;
+
+    // Chunks are linked downwards only, they are collected to be visited from the bottom
+    size_t chunkCount = 0;
+    for (const struct StackChunk* chunk = stack->topChunk; chunk; chunk = chunk->prev) chunkCount++;
+
+    const struct StackChunk** chunks = (const struct StackChunk**) calloc(chunkCount, sizeof(const struct StackChunk*));
+    if (!chunks) return NO_MEMORY;
+
+    size_t slot = chunkCount;
+    for (const struct StackChunk* chunk = stack->topChunk; chunk; chunk = chunk->prev) chunks[--slot] = chunk;
+
+    size_t index = 0;
+    for (size_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++, index += STACK_CHUNK_CAPACITY)
+    {
+        size_t count = STACK_CHUNK_CAPACITY;
+
+        if (mode == SHORT)
+        {
+            if (index >= stack->size) break;
+            if (stack->size - index < count) count = stack->size - index;
+        }
+
+        split_runs(chunks[chunkIndex]->data, count, visit, context);
+    }
+
+    free(chunks);
+
+    return NO_ERRORS;
+}
+
+/// @brief Splits elements into literal runs and runs of STACK_DUMP_POISON_RUN and more ELEM_T_POISON
+static void split_runs(const elem_t* values, size_t count, dumpRunVisitor visit, void* context)
+{
+    size_t literal = 0;
+    size_t i = 0;
+
+    while (i < count)
+    {
+        if (values[i] != ELEM_T_POISON)
+        {
+            i++;
+            continue;
+        }
+
+        size_t run = poison_find(values + i, count - i);
+
+        if (run >= STACK_DUMP_POISON_RUN)
+        {
+            if (i > literal) visit(context, values + literal, i - literal, false);
+            visit(context, values + i, run, true);
+
+            literal = i + run;
+        }
+
+        i += run;
+    }
+
+    if (count > literal) visit(context, values + literal, count - literal, false);
+}
+
+#ifdef USE_CANARY_PROTECTION
+
+/// @brief Reads data canaries of buffer that has them(not of segmented and guarded stacks)
+static bool data_canaries(const struct Stack* stack, unsigned long long* left, unsigned long long* right)
+{
+    if (!stack->data || stack->storage == STORAGE_SEGMENTED || stack->storage == STORAGE_GUARDED ||
+        (stack->stackErrors & CAPACITY_NOT_VALID)) return false;
+
+    *left  = *((const canary_t*) stack->data);
+    *right = *((const canary_t*) ((const elem_t*) ((const canary_t*) stack->data + 1) + stack->capacity));
+
+    return true;
+}
+
+#endif
+
+static void binary_run(void* context, const elem_t* values, size_t count, bool poison)
+{
+    struct DumpRunWriter* writer = (struct DumpRunWriter*) context;
+
+    writer->runs++;
+    writer->elements += count;
+    if (!poison) writer->literals += count;
+
+    if (!writer->stream || !writer->written) return;
+
+    unsigned long long run = count | (poison ? STACK_DUMP_POISON_FLAG : 0);
+
+    writer->written = fwrite(&run, sizeof(run), 1, writer->stream) == 1 &&
+                      (poison || fwrite(values, sizeof(elem_t), count, writer->stream) == count);
+}
+
+static void json_run(void* context, const elem_t* values, size_t count, bool poison)
+{
+    struct DumpJsonWriter* writer = (struct DumpJsonWriter*) context;
+
+    if (poison)
+    {
+        fprintf(writer->stream, "%s{\"poison\": %lu}", writer->empty ? "" : ", ", count);
+        writer->empty = false;
+
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        fprintf(writer->stream, "%s%d", writer->empty ? "" : ", ", values[i]);
+        writer->empty = false;
+    }
+}
+
+static void json_string(FILE* stream, const char* text)
+{
+    if (!text)
+    {
+        fprintf(stream, "null");
+        return;
+    }
+
+    putc('"', stream);
+
+    for (const char* symbol = text; *symbol; symbol++)
+    {
+        if (*symbol == '"' || *symbol == '\\')
+        {
+            putc('\\', stream);
+            putc(*symbol, stream);
+        }
+        else if ((unsigned char) *symbol < 0x20) fprintf(stream, "\\u%04x", (unsigned) (unsigned char) *symbol);
+        else putc(*symbol, stream);
+    }
+
+    putc('"', stream);
+}
+
+static enum errorCode decode_record(FILE* in, FILE* out, const struct StackDumpHeader* header)
+{
+    // Extra null keeps strings terminated whatever file holds
+    char* strings = (char*) calloc(header->stringBytes + 1, 1);
+    if (no_ptr(stderr, strings, NO_MEMORY, __FILE__, __func__, __LINE__)) return NO_MEMORY;
+
+    if (fread(strings, 1, header->stringBytes, in) != header->stringBytes)
+    {
+        free(strings);
+        return FILE_ERROR;
+    }
+
+    const char* fields[DUMP_DECODE_STRINGS] = {};
+    const char* field = strings;
+
+    for (size_t i = 0; i < DUMP_DECODE_STRINGS; i++)
+    {
+        if (field >= strings + header->stringBytes)
+        {
+            free(strings);
+            return FILE_ERROR;
+        }
+
+        fields[i] = field;
+        field += strlen(field) + 1;
+    }
+
+    PRINT_LINE(out, fields[3], fields[4], header->line);
+    print_error(out, (enum errorCode) (header->errors & ((unsigned) FILE_ERROR * 2 - 1)));
+
+    const struct StackHomeland homeland = {fields[0], fields[1], fields[2], header->homelandLine};
+    print_homeland(out, (const void*) (uintptr_t) header->stack, &homeland);
+
+    if (header->suppressed) color_fprintf(out, COLOR_RED, STYLE_BOLD, "%llu identical dumps of this stack suppressed\n", header->suppressed);
+
+    color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "protection");
+    if (header->protection <= PROTECTION_PARANOID) fprintf(out, " = %s\n", protectionNames[header->protection]);
+    else                                           fprintf(out, " = %u(invalid)\n", header->protection);
+
+    color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "storage");
+    if (header->storage <= STORAGE_INCREMENTAL) fprintf(out, " = %s\n", storageNames[header->storage]);
+    else                                        fprintf(out, " = %u(invalid)\n", header->storage);
+
+    if (header->flags & STACK_DUMP_HASHES)
+    {
+        const char* backend = NULL;
+
+        #ifdef USE_HASH_PROTECTION
+        if (header->hashBackend <= HASH_CRC32C) backend = hash_backend_name((enum hashBackend) header->hashBackend);
+        #endif
+
+        color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "hash");
+        if (backend) fprintf(out, " = %s\n", backend);
+        else         fprintf(out, " = %u\n", header->hashBackend);
+
+        color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "struct hash");
+        fprintf(out, " = %llx\n", header->structHash);
+
+        color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "data hash");
+        fprintf(out, " = %llx\n", header->dataHash);
+    }
+
+    if (header->flags & STACK_DUMP_CANARIES)
+    {
+        color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "left canary");
+        fprintf(out, " = %llx\n", header->leftCanary);
+
+        color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "right canary");
+        fprintf(out, " = %llx\n", header->rightCanary);
+    }
+
+    color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "size");
+    fprintf(out, " = %llu\n", header->size);
+
+    color_fprintf(out, COLOR_PURPLE, STYLE_BOLD, "capacity");
+    fprintf(out, " = %llu\n", header->capacity);
+
+    if (header->flags & STACK_DUMP_DATA_CANARIES)
+    {
+        color_fprintf(out, COLOR_YELLOW, STYLE_BOLD, "left data canary");
+        fprintf(out, " = %llx\n", header->leftDataCanary);
+    }
+
+    enum errorCode error = decode_runs(in, out, header);
+
+    if (!error && (header->flags & STACK_DUMP_DATA_CANARIES))
+    {
+        color_fprintf(out, COLOR_YELLOW, STYLE_BOLD, "right data canary");
+        fprintf(out, " = %llx\n", header->rightDataCanary);
+    }
+
+    free(strings);
+
+    return error;
+}
+
+static enum errorCode decode_runs(FILE* in, FILE* out, const struct StackDumpHeader* header)
+{
+    elem_t values[DUMP_DECODE_BLOCK] = {};
+    stackDumpMode mode = (header->mode == FULL) ? FULL : SHORT;
+
+    size_t index = 0;
+
+    for (unsigned long long run = 0; run < header->runs; run++)
+    {
+        unsigned long long count = 0;
+        if (fread(&count, sizeof(count), 1, in) != 1) return FILE_ERROR;
+
+        bool poison = count & STACK_DUMP_POISON_FLAG;
+        count &= ~STACK_DUMP_POISON_FLAG;
+
+        if (count > header->elements - index) return FILE_ERROR;
+
+        if (poison)
+        {
+            decode_poison_run(out, index, count, header->size);
+            index += count;
+
+            continue;
+        }
+
+        while (count)
+        {
+            size_t part = (count < DUMP_DECODE_BLOCK) ? count : DUMP_DECODE_BLOCK;
+            if (fread(values, sizeof(elem_t), part, in) != part) return FILE_ERROR;
+
+            print_elements(out, values, index, part, header->size, mode);
+
+            index += part;
+            count -= part;
+        }
+    }
+
+    return (index == header->elements) ? NO_ERRORS : FILE_ERROR;
+}
+
+/// @brief Prints run of poison like text dump does: elements up to top one by one, the rest in one line
+static void decode_poison_run(FILE* out, size_t first, size_t count, size_t size)
+{
+    const elem_t poison = ELEM_T_POISON;
+    const size_t end    = first + count;
+
+    size_t index = first;
+
+    while (index < end && (index <= size || end - index < STACK_DUMP_POISON_RUN))
+    {
+        print_elements(out, &poison, index, 1, size, FULL);
+        index++;
+    }
+
+    if (index < end) print_poison_run(out, index, end - index);
+}
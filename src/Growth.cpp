@@ -0,0 +1,34 @@
+/**
+ * @file
+ * @brief Built-in capacity strategies of stack
+*/
+#include <stdio.h>
+
+#include "Stack.h"
+
+const struct GrowthStrategy GROWTH_DOUBLE       = GROWTH_GEOMETRIC("double",       REALLOC_COEF, 1, 2 * REALLOC_COEF);
+const struct GrowthStrategy GROWTH_ONE_AND_HALF = GROWTH_GEOMETRIC("one and half", 3,            2, 3);
+const struct GrowthStrategy GROWTH_HYSTERESIS   = GROWTH_GEOMETRIC("hysteresis",   2,            1, 8);
+const struct GrowthStrategy GROWTH_TRIM_ONLY    = GROWTH_GEOMETRIC("trim only",    2,            1, 0);
+const struct GrowthStrategy GROWTH_NEVER_SHRINK = {"never shrink", geometric_grow, geometric_shrink_size, geometric_shrink, 2, 1, 0, false};
+
+size_t geometric_grow(const struct GrowthStrategy* strategy, size_t capacity)
+{
+    size_t newCapacity = capacity * strategy->numerator / strategy->denominator;
+
+    return (newCapacity > capacity) ? newCapacity : capacity + 1;
+}
+
+size_t geometric_shrink_size(const struct GrowthStrategy* strategy, size_t capacity)
+{
+    if (!strategy->shrinkDivisor) return 0;
+
+    return capacity / strategy->shrinkDivisor;
+}
+
+size_t geometric_shrink(const struct GrowthStrategy* strategy, size_t capacity)
+{
+    size_t newCapacity = capacity * strategy->denominator / strategy->numerator;
+
+    return newCapacity ? newCapacity : 1;
+}
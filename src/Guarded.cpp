@@ -0,0 +1,400 @@
+/**
+ * @file
+ * @brief Guarded storage of stack: elements between two PROT_NONE pages and SIGSEGV handler that dumps owning stack
+*/
+#include <atomic>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Stack.h"
+#include "Verifier.h"
+
+/// @brief Guarded buffer known to SIGSEGV handler
+struct GuardedRange
+{
+    const struct Stack* stack;      ///< Owner(NULL - free slot)
+    uintptr_t           low;        ///< Start of left guard page
+    uintptr_t           high;       ///< End of right guard page
+};
+
+/// @brief Signal stack of thread, so that handler runs even if fault comes with thread stack exhausted
+struct GuardedAltStack
+{
+    void* memory;   ///< Mapping(NULL - thread had no guarded stacks or already had its own signal stack)
+
+    GuardedAltStack() : memory(NULL) {}
+    GuardedAltStack(const GuardedAltStack&) = delete;
+    GuardedAltStack& operator=(const GuardedAltStack&) = delete;
+
+    ~GuardedAltStack()
+    {
+        if (!memory) return;
+
+        stack_t disabled = {};
+        disabled.ss_flags = SS_DISABLE;
+
+        sigaltstack(&disabled, NULL);
+        munmap(memory, STACK_GUARDED_ALTSTACK);
+    }
+};
+
+/// @brief Report of SIGSEGV handler: only write(2) is used, so text is formatted by hand
+struct GuardedMessage
+{
+    char*  text;
+    size_t length;
+};
+
+static struct GuardedRange guardedRegistry[STACK_GUARDED_REGISTRY] = {};
+static std::atomic_flag    guardedLock      = ATOMIC_FLAG_INIT;   ///< Guards registry against register/unregister
+static struct sigaction    guardedOldAction = {};                 ///< Handler fault is passed to
+static bool                guardedInstalled = false;
+static size_t              guardedPage      = 0;                  ///< Page size read before handler needs it
+
+static char             guardedText[STACK_GUARDED_MESSAGE] = {};
+static std::atomic_flag guardedTextBusy = ATOMIC_FLAG_INIT;       ///< Second thread faulting at once doesn't report
+
+static thread_local struct GuardedAltStack guardedAltStack;
+
+static char* guarded_map(size_t capacity);
+static void guarded_unmap(struct Stack* stack);
+static size_t guarded_bytes(size_t capacity);
+static void guarded_register(const struct Stack* stack, const char* elements, size_t bytes);
+static void guarded_unregister(const struct Stack* stack);
+static void guarded_handler(int signal, siginfo_t* info, void* context);
+static void guarded_install_handler();
+static void guarded_install_altstack();
+static void message_string(struct GuardedMessage* message, const char* string);
+static void message_number(struct GuardedMessage* message, unsigned long long number, unsigned base);
+static void message_element(struct GuardedMessage* message, elem_t value);
+static void message_write(const struct GuardedMessage* message);
+
+size_t guarded_ctor(struct Stack* stack, size_t capacity)
+{
+    stack->data = NULL;
+
+    capacity = guarded_fit_capacity(capacity);
+
+    char* elements = guarded_map(capacity);
+    if (!elements) return 0;
+
+    guarded_install_handler();
+    guarded_install_altstack();
+    guarded_register(stack, elements, guarded_bytes(capacity));
+
+    #ifdef USE_CANARY_PROTECTION
+
+    // Data canary slots lie on guard pages, data + 1 is the first element as in contiguous buffer
+    stack->data = (elem_t*) ((canary_t*) elements - 1);
+
+    #else
+
+    stack->data = (elem_t*) elements;
+
+    #endif
+
+    return capacity;
+}
+
+void guarded_dtor(struct Stack* stack)
+{
+    if (stack->data)
+    {
+        guarded_unregister(stack);
+        guarded_unmap(stack);
+    }
+
+    stack->data = NULL;
+}
+
+elem_t* guarded_resize(struct Stack* stack, size_t* capacity)
+{
+    *capacity = guarded_fit_capacity(*capacity);
+    if (*capacity == stack->capacity) return stack->data;
+
+    char* elements = guarded_map(*capacity);
+    if (!elements) return NULL;
+
+    #ifdef USE_CANARY_PROTECTION
+    const char* oldElements = (const char*) ((canary_t*) stack->data + 1);
+    #else
+    const char* oldElements = (const char*) stack->data;
+    #endif
+
+    memcpy(elements, oldElements, stack->size * sizeof(elem_t));
+
+    guarded_unregister(stack);
+    guarded_unmap(stack);
+    guarded_register(stack, elements, guarded_bytes(*capacity));
+
+    #ifdef USE_CANARY_PROTECTION
+    return (elem_t*) ((canary_t*) elements - 1);
+    #else
+    return (elem_t*) elements;
+    #endif
+}
+
+size_t guarded_fit_capacity(size_t capacity)
+{
+    if (!capacity) capacity = 1;
+
+    return guarded_bytes(capacity) / sizeof(elem_t);
+}
+
+/// @brief Maps guard page, element pages and guard page, returns start of elements or NULL
+static char* guarded_map(size_t capacity)
+{
+    size_t page  = stack_page_size();
+    size_t bytes = guarded_bytes(capacity);
+
+    char* map = (char*) mmap(NULL, bytes + 2 * page, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) return NULL;
+
+    if (mprotect(map + page, bytes, PROT_READ | PROT_WRITE))
+    {
+        munmap(map, bytes + 2 * page);
+        return NULL;
+    }
+
+    return map + page;
+}
+
+static void guarded_unmap(struct Stack* stack)
+{
+    size_t page = stack_page_size();
+
+    #ifdef USE_CANARY_PROTECTION
+    char* elements = (char*) ((canary_t*) stack->data + 1);
+    #else
+    char* elements = (char*) stack->data;
+    #endif
+
+    STACK_RETIRE_MAP(stack, elements - page, guarded_bytes(stack->capacity) + 2 * page);
+}
+
+/// @brief Element bytes rounded up to whole pages
+static size_t guarded_bytes(size_t capacity)
+{
+    size_t page = stack_page_size();
+
+    return (capacity * sizeof(elem_t) + page - 1) / page * page;
+}
+
+static void guarded_register(const struct Stack* stack, const char* elements, size_t bytes)
+{
+    size_t page = stack_page_size();
+
+    while (guardedLock.test_and_set(std::memory_order_acquire)) {}
+
+    for (size_t i = 0; i < STACK_GUARDED_REGISTRY; i++)
+    {
+        if (guardedRegistry[i].stack) continue;
+
+        guardedRegistry[i] = {stack, (uintptr_t) elements - page, (uintptr_t) elements + bytes + page};
+        break;
+    }
+
+    guardedLock.clear(std::memory_order_release);
+}
+
+static void guarded_unregister(const struct Stack* stack)
+{
+    while (guardedLock.test_and_set(std::memory_order_acquire)) {}
+
+    for (size_t i = 0; i < STACK_GUARDED_REGISTRY; i++)
+    {
+        if (guardedRegistry[i].stack == stack) guardedRegistry[i] = {};
+    }
+
+    guardedLock.clear(std::memory_order_release);
+}
+
+static void guarded_install_handler()
+{
+    while (guardedLock.test_and_set(std::memory_order_acquire)) {}
+
+    if (!guardedInstalled)
+    {
+        struct sigaction action = {};
+
+        action.sa_sigaction = guarded_handler;
+        action.sa_flags     = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+
+        guardedPage      = stack_page_size();
+        guardedInstalled = (sigaction(SIGSEGV, &action, &guardedOldAction) == 0);
+    }
+
+    guardedLock.clear(std::memory_order_release);
+}
+
+/// @brief Gives calling thread signal stack unless it already has one
+static void guarded_install_altstack()
+{
+    if (guardedAltStack.memory) return;
+
+    stack_t current = {};
+    if (sigaltstack(NULL, &current) || !(current.ss_flags & SS_DISABLE)) return;
+
+    void* memory = mmap(NULL, STACK_GUARDED_ALTSTACK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return;
+
+    stack_t altStack = {};
+    altStack.ss_sp   = memory;
+    altStack.ss_size = STACK_GUARDED_ALTSTACK;
+
+    if (sigaltstack(&altStack, NULL))
+    {
+        munmap(memory, STACK_GUARDED_ALTSTACK);
+        return;
+    }
+
+    guardedAltStack.memory = memory;
+}
+
+/// @brief Dumps stack whose guard page was hit, then restores previous handler and lets fault repeat there
+/// @details Only async-signal-safe calls are made: report is formatted into static buffer and written by write(2)
+static void guarded_handler(int signal, siginfo_t* info, void* context)
+{
+    (void) signal;
+    (void) context;
+
+    int       savedErrno = errno;
+    uintptr_t address    = (uintptr_t) info->si_addr;
+    size_t    page       = guardedPage;
+
+    // Registry isn't locked: fault may happen while faulting thread holds the lock
+    for (size_t i = 0; i < STACK_GUARDED_REGISTRY; i++)
+    {
+        const struct GuardedRange range = guardedRegistry[i];
+
+        if (!range.stack || address < range.low || address >= range.high) continue;
+        if (guardedTextBusy.test_and_set()) break;
+
+        struct GuardedMessage message = {guardedText, 0};
+        bool inside = false;
+
+        message_string(&message, "Guard page hit: ");
+
+        if (address < range.low + page)
+        {
+            message_string(&message, "underflow at ");
+            message_number(&message, range.low + page - address, 10);
+            message_string(&message, " bytes before elements\n");
+        }
+        else if (address >= range.high - page)
+        {
+            message_string(&message, "overflow at ");
+            message_number(&message, address - (range.high - page), 10);
+            message_string(&message, " bytes past elements\n");
+        }
+        else
+        {
+            message_string(&message, "fault inside elements\n");
+            inside = true;
+        }
+
+        const struct StackHomeland* homeland = &range.stack->stackHomeland;
+
+        message_string(&message, "Stack: [0x");
+        message_number(&message, (uintptr_t) range.stack, 16);
+        message_string(&message, "] \"");
+        message_string(&message, homeland->stackName);
+        message_string(&message, "\" initialised in file: ");
+        message_string(&message, homeland->file);
+        message_string(&message, " function: ");
+        message_string(&message, homeland->function);
+        message_string(&message, "(");
+        message_number(&message, (unsigned long long) homeland->line, 10);
+        message_string(&message, ")\n");
+
+        // Elements are taken from registered range, struct may be in the middle of resize
+        const elem_t* elements = (const elem_t*) (range.low + page);
+        size_t capacity = (range.high - page - (range.low + page)) / sizeof(elem_t);
+        size_t size     = (range.stack->size < capacity) ? range.stack->size : capacity;
+
+        message_string(&message, "size = ");
+        message_number(&message, range.stack->size, 10);
+        message_string(&message, ", capacity = ");
+        message_number(&message, capacity, 10);
+        message_string(&message, "\n");
+
+        // Fault inside elements means they can't be read either
+        for (size_t index = size; !inside && index > 0 && size - index < STACK_GUARDED_ELEMENTS; index--)
+        {
+            message_string(&message, "    [");
+            message_number(&message, index - 1, 10);
+            message_string(&message, "] = ");
+            message_element(&message, elements[index - 1]);
+            message_string(&message, "\n");
+        }
+
+        message_write(&message);
+        guardedTextBusy.clear();
+
+        break;
+    }
+
+    sigaction(SIGSEGV, &guardedOldAction, NULL);
+    guardedInstalled = false;
+
+    errno = savedErrno;
+}
+
+/// @brief Appends string to handler report, the tail that doesn't fit is cut
+static void message_string(struct GuardedMessage* message, const char* string)
+{
+    if (!string) string = "NULL";
+
+    while (*string && message->length < STACK_GUARDED_MESSAGE) message->text[message->length++] = *string++;
+}
+
+/// @brief Appends number in base 10 or 16 to handler report
+static void message_number(struct GuardedMessage* message, unsigned long long number, unsigned base)
+{
+    char digits[24] = {};
+    size_t count = sizeof(digits) - 1;
+
+    do
+    {
+        digits[--count] = "0123456789abcdef"[number % base];
+        number /= base;
+    }
+    while (number);
+
+    message_string(message, digits + count);
+}
+
+/// @brief Appends element or POISON to handler report
+static void message_element(struct GuardedMessage* message, elem_t value)
+{
+    if (value == ELEM_T_POISON)
+    {
+        message_string(message, "POISON");
+        return;
+    }
+
+    if (value < 0) message_string(message, "-");
+
+    message_number(message, (value < 0) ? 0ull - (unsigned long long) (long long) value : (unsigned long long) value, 10);
+}
+
+/// @brief Writes handler report to stderr
+static void message_write(const struct GuardedMessage* message)
+{
+    size_t written = 0;
+
+    while (written < message->length)
+    {
+        ssize_t result = write(STDERR_FILENO, message->text + written, message->length - written);
+
+        if (result > 0) written += (size_t) result;
+        else if (result < 0 && errno == EINTR) continue;
+        else break;
+    }
+}
@@ -1,9 +1,13 @@
 #include <stdio.h>
 
+#include "Color_output.h"
 #include "Stack.h"
+#include "Verifier.h"
 
 #ifdef USE_HASH_PROTECTION
 
+static void hash_struct(struct Stack* stack);
+
 hash_t jdb2_hash(const void* ptr, size_t objectSize)
 {
     const char* pointer = (const char*) ptr;
@@ -19,32 +23,115 @@ hash_t jdb2_hash(const void* ptr, size_t objectSize)
     return hash;
 }
 
+#ifdef USE_INCREMENTAL_HASH
+
+hash_t elem_hash(elem_t value, size_t index)
+{
+    // Position goes to high half and value to low half, so (value, index) pairs don't collide before mixing
+    hash_t hash = ((hash_t) index << 32) ^ (unsigned) value;
+
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+
+    return hash;
+}
+
+hash_t elem_range_hash(const elem_t* values, size_t first, size_t count)
+{
+    hash_t hash = 0;
+
+    for (size_t i = 0; i < count; i++) hash += elem_hash(values[i], first + i);
+
+    return hash;
+}
+
+#endif
+
+enum errorCode calculate_struct_hash(struct Stack* stack)
+{
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    STACK_STATS_TIMER(hashStart);
+
+    hash_struct(stack);
+
+    STACK_STATS_LATENCY(stack, hashLatency, hashStart);
+
+    return NO_ERRORS;
+}
+
 enum errorCode calculate_hash(struct Stack* stack)
 {
     if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
 
+    // Tree and struct hash are one sample of hashLatency
+    STACK_STATS_TIMER(hashStart);
+
+    enum errorCode error = hash_tree_build(stack);
+
+    if (!error) hash_struct(stack);
+
+    STACK_STATS_LATENCY(stack, hashLatency, hashStart);
+
+    return error;
+}
+
+/// @brief Rehashes struct with its data hash and watch slot left out, latency is recorded by caller
+static void hash_struct(struct Stack* stack)
+{
+    hash_t dataHash = stack->dataHash;
+
     stack->structHash = 0;
     stack->dataHash   = 0;
 
-    #ifdef USE_CANARY_PROTECTION
+    #ifdef USE_BACKGROUND_VERIFY
+
+    // Watch slot is taken and given back without rehashing(stack_dtor drops it before verification)
+    struct StackWatch* watch = stack->watch;
+    stack->watch = NULL;
 
-    size_t stackSize = sizeof(elem_t*) + 2*sizeof(size_t) + sizeof(errorCode) + 2*sizeof(hash_t) + sizeof(StackHomeland) +2*sizeof(canary_t);
-    size_t dataSize  = stack->capacity*sizeof(elem_t) + 2*sizeof(canary_t);
+    #endif
+
+    stack->structHash = hash_bytes(stack->hashBackend, stack, sizeof(struct Stack));
+    stack->dataHash   = dataHash;
 
-    #else
+    #ifdef USE_BACKGROUND_VERIFY
+    stack->watch = watch;
+    #endif
 
-    size_t stackSize = sizeof(elem_t*) + 2*sizeof(size_t) + sizeof(errorCode) + 2*sizeof(hash_t) + sizeof(StackHomeland);
-    size_t dataSize  = stack->capacity*sizeof(elem_t);
+    STACK_STATS_ADD(stack, hashedBytes, sizeof(struct Stack));
+}
+
+enum errorCode stack_set_hash_backend(struct Stack* stack, enum hashBackend backend, FILE* stream, const char* file, int line, const char* func)
+{
+    STACK_WRITE_SCOPE(stack);
+
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    if ((unsigned) backend >= HASH_BACKEND_COUNT)
+    {
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, BAD_HASH_BACKEND);
+        return BAD_HASH_BACKEND;
+    }
+
+    if (stack->protection != PROTECTION_OFF)
+    {
+        if (stack_verify(stack, stream, file, line, func)) return stack->stackErrors;
+    }
 
     #endif
 
-    hash_t structHashData = jdb2_hash(stack, stackSize);
-    hash_t dataHashData   = jdb2_hash(stack->data, dataSize);
+    stack->hashBackend = backend;
 
-    stack->structHash = structHashData;
-    stack->dataHash   = dataHashData;
+    if (stack->protection >= PROTECTION_HASH) return calculate_hash(stack);
 
     return NO_ERRORS;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,359 @@
+/**
+ * @file
+ * @brief Byte hash backends of stack(wide multi-lane hash and CRC32C) and their runtime CPU dispatch
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Stack.h"
+
+#ifdef USE_HASH_PROTECTION
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HASH_X86
+#include <immintrin.h>
+#endif
+
+typedef hash_t (*hash_function_t)(const void* ptr, size_t size);
+
+/// @brief Implementations chosen for CPU of this process
+struct HashDispatch
+{
+    hash_function_t wide;       ///< Implementation of HASH_WIDE
+    const char*     wideIsa;    ///< Instruction set of HASH_WIDE implementation
+    hash_function_t crc32c;     ///< Implementation of HASH_CRC32C
+    const char*     crc32cIsa;  ///< Instruction set of HASH_CRC32C implementation
+};
+
+/// @brief Table of CRC32C(Castagnoli, reflected) remainders of every byte
+struct Crc32cTable
+{
+    uint32_t entries[256];
+};
+
+static const struct HashDispatch* hash_dispatch();
+static struct HashDispatch hash_dispatch_select();
+
+static hash_t wide_hash_portable(const void* ptr, size_t size);
+static hash_t wide_finish(const uint64_t lanes[WIDE_HASH_LANES], size_t size);
+static hash_t crc32c_hash_portable(const void* ptr, size_t size);
+static constexpr struct Crc32cTable crc32c_make_table();
+
+#ifdef HASH_X86
+static hash_t wide_hash_sse2(const void* ptr, size_t size);
+static hash_t wide_hash_avx2(const void* ptr, size_t size);
+static hash_t crc32c_hash_sse42(const void* ptr, size_t size);
+#endif
+
+/// Per-lane keys of HASH_WIDE, odd so that lane products never lose low bits
+static const uint64_t WIDE_KEYS[WIDE_HASH_LANES] = {0x9E3779B185EBCA87ULL, 0xC2B2AE3D27D4EB4FULL,
+                                                    0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL};
+static const uint64_t WIDE_PRIME  = 0x9FB21C651E98DF25ULL;
+static const int      WIDE_ROTATE = 23;
+
+/// Set by hash_backend_portable(), switches dispatch to code without SSE/AVX
+static bool hashPortable = false;
+
+hash_t hash_bytes(enum hashBackend backend, const void* ptr, size_t size)
+{
+    switch (backend)
+    {
+        case HASH_DJB2:     return jdb2_hash(ptr, size);
+        case HASH_WIDE:     return hashPortable ? wide_hash_portable(ptr, size)   : hash_dispatch()->wide(ptr, size);
+        case HASH_CRC32C:   return hashPortable ? crc32c_hash_portable(ptr, size) : hash_dispatch()->crc32c(ptr, size);
+        default:            return 0;
+    }
+}
+
+enum hashBackend hash_backend_default()
+{
+    return HASH_WIDE;
+}
+
+const char* hash_backend_name(enum hashBackend backend)
+{
+    switch (backend)
+    {
+        case HASH_DJB2:     return "djb2";
+        case HASH_WIDE:     return "wide";
+        case HASH_CRC32C:   return "crc32c";
+        default:            return NULL;
+    }
+}
+
+const char* hash_backend_isa(enum hashBackend backend)
+{
+    switch (backend)
+    {
+        case HASH_DJB2:     return "portable";
+        case HASH_WIDE:     return hashPortable ? "portable" : hash_dispatch()->wideIsa;
+        case HASH_CRC32C:   return hashPortable ? "portable" : hash_dispatch()->crc32cIsa;
+        default:            return NULL;
+    }
+}
+
+void hash_backend_portable(bool portable)
+{
+    hashPortable = portable;
+}
+
+static const struct HashDispatch* hash_dispatch()
+{
+    static const struct HashDispatch dispatch = hash_dispatch_select();
+
+    return &dispatch;
+}
+
+static struct HashDispatch hash_dispatch_select()
+{
+    struct HashDispatch dispatch = {wide_hash_portable, "portable", crc32c_hash_portable, "portable"};
+
+    #ifdef HASH_X86
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        dispatch.wide    = wide_hash_avx2;
+        dispatch.wideIsa = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        dispatch.wide    = wide_hash_sse2;
+        dispatch.wideIsa = "sse2";
+    }
+
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        dispatch.crc32c    = crc32c_hash_sse42;
+        dispatch.crc32cIsa = "sse4.2";
+    }
+
+    #endif
+
+    return dispatch;
+}
+
+//-----------------------------------------------------------------------------
+// HASH_WIDE: every 32-byte stripe is split into WIDE_HASH_LANES 64-bit words d,
+// lane = rotl(lane, WIDE_ROTATE) + lo32(d ^ key) * hi32(d ^ key) + d.
+// Lanes have no dependency on each other, so SIMD code updates all of them at once.
+// Rotation makes lanes depend on stripe order. Tail is zero-padded to full stripe.
+//-----------------------------------------------------------------------------
+
+static hash_t wide_hash_portable(const void* ptr, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) ptr;
+
+    uint64_t lanes[WIDE_HASH_LANES] = {};
+    unsigned char tail[WIDE_HASH_STRIPE] = {};
+
+    size_t stripes = size / WIDE_HASH_STRIPE;
+    size_t rest    = size % WIDE_HASH_STRIPE;
+
+    for (size_t stripe = 0; stripe <= stripes; stripe++)
+    {
+        const unsigned char* block = bytes + stripe * WIDE_HASH_STRIPE;
+
+        if (stripe == stripes)
+        {
+            if (!rest) break;
+
+            memcpy(tail, block, rest);
+            block = tail;
+        }
+
+        for (size_t lane = 0; lane < WIDE_HASH_LANES; lane++)
+        {
+            uint64_t word = 0;
+            memcpy(&word, block + lane * sizeof(uint64_t), sizeof(uint64_t));
+
+            uint64_t keyed = word ^ WIDE_KEYS[lane];
+
+            lanes[lane] = ((lanes[lane] << WIDE_ROTATE) | (lanes[lane] >> (64 - WIDE_ROTATE)))
+                        + (keyed & 0xFFFFFFFFULL) * (keyed >> 32) + word;
+        }
+    }
+
+    return wide_finish(lanes, size);
+}
+
+static hash_t wide_finish(const uint64_t lanes[WIDE_HASH_LANES], size_t size)
+{
+    uint64_t hash = size * WIDE_PRIME;
+
+    for (size_t lane = 0; lane < WIDE_HASH_LANES; lane++)
+    {
+        hash ^= lanes[lane] + WIDE_KEYS[lane];
+        hash *= WIDE_PRIME;
+        hash ^= hash >> 29;
+    }
+
+    hash ^= hash >> 32;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+#ifdef HASH_X86
+
+__attribute__((target("sse2")))
+static hash_t wide_hash_sse2(const void* ptr, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) ptr;
+    unsigned char tail[WIDE_HASH_STRIPE] = {};
+
+    const __m128i keysLow  = _mm_loadu_si128((const __m128i*) WIDE_KEYS);
+    const __m128i keysHigh = _mm_loadu_si128((const __m128i*) (WIDE_KEYS + 2));
+
+    __m128i low  = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+
+    size_t stripes = size / WIDE_HASH_STRIPE;
+    size_t rest    = size % WIDE_HASH_STRIPE;
+
+    for (size_t stripe = 0; stripe <= stripes; stripe++)
+    {
+        const unsigned char* block = bytes + stripe * WIDE_HASH_STRIPE;
+
+        if (stripe == stripes)
+        {
+            if (!rest) break;
+
+            memcpy(tail, block, rest);
+            block = tail;
+        }
+
+        __m128i wordsLow  = _mm_loadu_si128((const __m128i*) block);
+        __m128i wordsHigh = _mm_loadu_si128((const __m128i*) (block + 16));
+
+        __m128i keyedLow  = _mm_xor_si128(wordsLow,  keysLow);
+        __m128i keyedHigh = _mm_xor_si128(wordsHigh, keysHigh);
+
+        low  = _mm_or_si128(_mm_slli_epi64(low,  WIDE_ROTATE), _mm_srli_epi64(low,  64 - WIDE_ROTATE));
+        high = _mm_or_si128(_mm_slli_epi64(high, WIDE_ROTATE), _mm_srli_epi64(high, 64 - WIDE_ROTATE));
+
+        low  = _mm_add_epi64(low,  _mm_add_epi64(_mm_mul_epu32(keyedLow,  _mm_srli_epi64(keyedLow,  32)), wordsLow));
+        high = _mm_add_epi64(high, _mm_add_epi64(_mm_mul_epu32(keyedHigh, _mm_srli_epi64(keyedHigh, 32)), wordsHigh));
+    }
+
+    uint64_t lanes[WIDE_HASH_LANES] = {};
+    _mm_storeu_si128((__m128i*) lanes,       low);
+    _mm_storeu_si128((__m128i*) (lanes + 2), high);
+
+    return wide_finish(lanes, size);
+}
+
+__attribute__((target("avx2")))
+static hash_t wide_hash_avx2(const void* ptr, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) ptr;
+    unsigned char tail[WIDE_HASH_STRIPE] = {};
+
+    const __m256i keys = _mm256_loadu_si256((const __m256i*) WIDE_KEYS);
+
+    __m256i lanes = _mm256_setzero_si256();
+
+    size_t stripes = size / WIDE_HASH_STRIPE;
+    size_t rest    = size % WIDE_HASH_STRIPE;
+
+    for (size_t stripe = 0; stripe <= stripes; stripe++)
+    {
+        const unsigned char* block = bytes + stripe * WIDE_HASH_STRIPE;
+
+        if (stripe == stripes)
+        {
+            if (!rest) break;
+
+            memcpy(tail, block, rest);
+            block = tail;
+        }
+
+        __m256i words = _mm256_loadu_si256((const __m256i*) block);
+        __m256i keyed = _mm256_xor_si256(words, keys);
+
+        lanes = _mm256_or_si256(_mm256_slli_epi64(lanes, WIDE_ROTATE), _mm256_srli_epi64(lanes, 64 - WIDE_ROTATE));
+        lanes = _mm256_add_epi64(lanes, _mm256_add_epi64(_mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32)), words));
+    }
+
+    uint64_t result[WIDE_HASH_LANES] = {};
+    _mm256_storeu_si256((__m256i*) result, lanes);
+
+    return wide_finish(result, size);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// HASH_CRC32C: CRC-32C(Castagnoli) with ~0 start value and final inversion,
+// the same as SSE4.2 crc32 instruction computes.
+//-----------------------------------------------------------------------------
+
+static constexpr struct Crc32cTable crc32c_make_table()
+{
+    struct Crc32cTable table = {};
+
+    for (uint32_t byte = 0; byte < 256; byte++)
+    {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78U : 0);
+
+        table.entries[byte] = crc;
+    }
+
+    return table;
+}
+
+static constexpr struct Crc32cTable CRC32C_TABLE = crc32c_make_table();
+
+static hash_t crc32c_hash_portable(const void* ptr, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) ptr;
+    uint32_t crc = 0xFFFFFFFFU;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = (crc >> 8) ^ CRC32C_TABLE.entries[(crc ^ bytes[i]) & 0xFF];
+    }
+
+    return (hash_t) ~crc;
+}
+
+#ifdef HASH_X86
+
+__attribute__((target("sse4.2")))
+static hash_t crc32c_hash_sse42(const void* ptr, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*) ptr;
+    size_t i = 0;
+
+    #ifdef __x86_64__
+
+    uint64_t crc = 0xFFFFFFFFU;
+
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, sizeof(uint64_t));
+
+        crc = _mm_crc32_u64(crc, word);
+    }
+
+    uint32_t crc32 = (uint32_t) crc;
+
+    #else
+
+    uint32_t crc32 = 0xFFFFFFFFU;
+
+    #endif
+
+    for (; i < size; i++) crc32 = _mm_crc32_u8(crc32, bytes[i]);
+
+    return (hash_t) ~crc32;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,737 @@
+/**
+ * @file
+ * @brief Hash tree of stack data: blocks of STACK_HASH_BLOCK elements are its leaves, data hash is its root
+ * @details Push and pop change hashes of their blocks and of paths from them to root only. Tree grows by one level
+ * at a time: tree over blocks [0, 2^p) is root above tree over [0, 2^(p-1)) and new piece over [2^(p-1), 2^p), so
+ * that nodes never move and growth allocates piece without filling it. Nodes of blocks above those ever touched are
+ * read as 0 and are set when the first of their blocks is touched. Full hash and verification hash blocks of big
+ * stack on pool of hashing threads, verification compares every block with its leaf, so that corrupted elements are
+ * found up to block
+*/
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <system_error>
+#include <thread>
+
+#include "Stack.h"
+#include "Verifier.h"
+
+#ifdef USE_HASH_PROTECTION
+
+// Block never lies in two chunks of segmented stack
+static_assert(STACK_CHUNK_CAPACITY % STACK_HASH_BLOCK == 0, "hash block must divide chunk of segmented stack");
+
+/// @brief Levels tree can grow to(one per bit of block number)
+static const size_t TREE_LEVELS = 8 * sizeof(size_t);
+
+/// @brief Hash tree of stack, piece p > 0 is perfect tree over blocks [2^(p-1), 2^p) whose node i combines nodes
+/// 2i and 2i+1, so that block b is its node b
+struct HashTree
+{
+    size_t  clean;                  ///< Nodes of blocks [0, clean) are set, nodes of upper blocks only are read as 0
+    hash_t  roots[TREE_LEVELS];     ///< roots[p] - root of tree over blocks [0, 2^p), roots[0] is hash of block 0
+    hash_t* pieces[TREE_LEVELS];    ///< pieces[p] - 2^p nodes(node 0 isn't used), NULL above levels of tree
+};
+
+/// @brief Place blocks of stack are read from
+struct BlockCursor
+{
+    bool                     segmented;     ///< Elements are in chunks
+    const elem_t*            data;          ///< Elements of buffer or of current chunk(NULL - no elements)
+    const elem_t*            oldData;       ///< Old buffer of incremental stack, holds elements below pending
+    const struct StackChunk* chunk;         ///< Chunk of current block(segmented stack only)
+    size_t                   chunkStart;    ///< Position of first element of data
+};
+
+/// @brief Full hash of blocks shared by hashing threads
+struct HashJob
+{
+    const struct Stack* stack;      ///< Hashed stack
+    hash_t*             hashes;     ///< Block b gets hashes[b]
+    size_t              first;      ///< First block
+    size_t              last;       ///< End of blocks
+    size_t              parts;      ///< Blocks are cut into equal parts, part 0 is hashed by calling thread
+};
+
+static std::mutex              poolLock;                ///< Held while job runs on pool and while pool is changed
+static std::mutex              jobLock;                 ///< Guards poolJob, jobGeneration, jobRunning and poolStop
+static std::condition_variable jobWake;                 ///< Wakes hashing threads on new job and on stop
+static std::condition_variable jobDone;                 ///< Wakes calling thread when hashing threads finish
+static std::thread             poolThreads[STACK_HASH_THREADS_MAX];
+static size_t                  poolSize       = 0;      ///< Started hashing threads
+static bool                    poolStarted    = false;  ///< Pool was set up(first full hash sets it up with automatic size)
+static bool                    poolStopAtExit = false;
+
+static struct HashJob     poolJob       = {};
+static unsigned long long jobGeneration = 0;    ///< Number of jobs given to pool
+static size_t             jobRunning    = 0;    ///< Hashing threads that haven't finished current job
+static bool               poolStop      = false;
+
+static size_t tree_blocks(size_t size);
+static size_t tree_leaves(size_t blocks);
+static size_t tree_width(size_t value);
+static hash_t tree_combine(hash_t left, hash_t right);
+static void   tree_fold(hash_t* nodes, size_t leaves);
+static hash_t tree_node(const struct HashTree* tree, size_t piece, size_t node);
+static hash_t tree_leaf(const struct Stack* stack, size_t block);
+static void   tree_clean(struct HashTree* tree, size_t blocks);
+static void   tree_roots(struct Stack* stack, size_t piece);
+static void   tree_free(struct Stack* stack, struct HashTree* tree);
+static enum errorCode tree_fit(struct Stack* stack, size_t blocks);
+static enum errorCode tree_own(struct Stack* stack);
+
+static void   cursor_init(const struct Stack* stack, struct BlockCursor* cursor);
+static void   cursor_seek(struct BlockCursor* cursor, size_t block);
+static hash_t block_hash(const struct Stack* stack, const struct BlockCursor* cursor, size_t block);
+static void   hash_block_range(const struct Stack* stack, hash_t* hashes, size_t first, size_t last);
+static void   hash_blocks(const struct Stack* stack, hash_t* hashes, size_t first, size_t last);
+static void   hash_job_part(const struct HashJob* job, size_t part);
+
+static void pool_start(size_t threads);
+static void pool_stop();
+static void pool_stop_at_exit();
+static void pool_worker(size_t part, unsigned long long generation);
+
+enum errorCode hash_tree_build(struct Stack* stack)
+{
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    size_t blocks = tree_blocks(stack->size);
+
+    // Tree is cut to stack, so that shrunk stack doesn't keep leaves of its peak
+    if (!blocks || tree_leaves(blocks) != stack->hashLeaves) hash_tree_dtor(stack);
+
+    stack->dataHash = 0;
+
+    if (!blocks) return NO_ERRORS;
+
+    if (tree_own(stack) || tree_fit(stack, blocks)) return NO_MEMORY;
+
+    struct HashTree* tree = stack->hashTree;
+
+    tree->clean = 0;
+    tree_clean(tree, blocks);
+
+    hash_blocks(stack, tree->roots, 0, 1);
+
+    for (size_t piece = 1; piece < TREE_LEVELS && tree->pieces[piece]; piece++)
+    {
+        size_t first = (size_t) 1 << (piece - 1);
+        size_t last  = (blocks < 2 * first) ? blocks : 2 * first;
+
+        if (first >= last) break;
+
+        hash_t* nodes = tree->pieces[piece];
+
+        hash_blocks(stack, nodes, first, last);
+
+        // Nodes of untouched blocks get 0 here and are set again when their first block is touched
+        for (size_t node = first - 1; node; node--)
+        {
+            nodes[node] = tree_combine(tree_node(tree, piece, 2*node), tree_node(tree, piece, 2*node + 1));
+        }
+    }
+
+    tree_roots(stack, 1);
+
+    STACK_STATS_ADD(stack, hashedBytes, stack->size * sizeof(elem_t));
+
+    return NO_ERRORS;
+}
+
+#ifdef USE_INCREMENTAL_HASH
+
+enum errorCode hash_tree_add(struct Stack* stack, size_t index, hash_t delta)
+{
+    size_t block = index / STACK_HASH_BLOCK;
+
+    if (tree_own(stack) || tree_fit(stack, block + 1)) return NO_MEMORY;
+
+    struct HashTree* tree = stack->hashTree;
+
+    tree_clean(tree, block + 1);
+
+    // Every node is sum of its leaves, so element hash goes to all nodes of one path
+    size_t piece = tree_width(block);
+
+    if (piece) for (size_t node = block; node; node /= 2) tree->pieces[piece][node] += delta;
+    else       tree->roots[0] += delta;
+
+    tree_roots(stack, piece);
+
+    return NO_ERRORS;
+}
+
+#else
+
+enum errorCode hash_tree_rehash(struct Stack* stack, size_t from, size_t to)
+{
+    if (from >= to) return NO_ERRORS;
+
+    size_t first = from / STACK_HASH_BLOCK;
+    size_t last  = (to - 1) / STACK_HASH_BLOCK + 1;
+
+    if (tree_own(stack) || tree_fit(stack, last)) return NO_MEMORY;
+
+    struct HashTree* tree = stack->hashTree;
+
+    tree_clean(tree, last);
+
+    if (!first) hash_block_range(stack, tree->roots, 0, 1);
+
+    for (size_t piece = tree_width(first); piece <= tree_width(last - 1); piece++)
+    {
+        if (!piece) continue;
+
+        size_t low  = (first > ((size_t) 1 << (piece - 1))) ? first : (size_t) 1 << (piece - 1);
+        size_t high = (last < ((size_t) 1 << piece)) ? last : (size_t) 1 << piece;
+
+        hash_t* nodes = tree->pieces[piece];
+
+        hash_block_range(stack, nodes, low, high);
+
+        // Parents of changed blocks form one range on every level
+        for (low /= 2, high = (high - 1) / 2; low; low /= 2, high /= 2)
+        {
+            for (size_t node = low; node <= high; node++)
+            {
+                nodes[node] = tree_combine(tree_node(tree, piece, 2*node), tree_node(tree, piece, 2*node + 1));
+            }
+        }
+    }
+
+    tree_roots(stack, tree_width(first));
+
+    STACK_STATS_ADD(stack, hashedBytes, (last - first) * STACK_HASH_BLOCK * sizeof(elem_t));
+
+    return NO_ERRORS;
+}
+
+#endif
+
+enum errorCode hash_tree_verify(const struct Stack* stack, size_t* corrupted, size_t* blocks, size_t maxBlocks)
+{
+    if (no_ptr(stderr, stack,     NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+    if (no_ptr(stderr, corrupted, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    *corrupted = 0;
+
+    size_t count = tree_blocks(stack->size);
+
+    if (!count && !stack->hashLeaves) return stack->dataHash ? BAD_DATA_HASH : NO_ERRORS;
+
+    // Tree that doesn't cover all blocks is compared as if missing leaves were 0
+    size_t leaves = tree_leaves(count);
+    if (leaves < stack->hashLeaves) leaves = stack->hashLeaves;
+
+    hash_t* nodes = (hash_t*) calloc(2 * leaves, sizeof(hash_t));
+    if (!nodes) return NO_MEMORY;
+
+    hash_blocks(stack, nodes + leaves, 0, count);
+
+    for (size_t block = 0; block < leaves; block++)
+    {
+        if (nodes[leaves + block] == tree_leaf(stack, block)) continue;
+
+        if (blocks && *corrupted < maxBlocks) blocks[*corrupted] = block;
+        ++*corrupted;
+    }
+
+    tree_fold(nodes, leaves);
+
+    hash_t root = nodes[1];
+
+    free(nodes);
+
+    STACK_STATS_ADD(stack, hashedBytes, stack->size * sizeof(elem_t));
+
+    return (*corrupted || root != stack->dataHash) ? BAD_DATA_HASH : NO_ERRORS;
+}
+
+enum errorCode hash_tree_verify_block(const struct Stack* stack, size_t block)
+{
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    struct BlockCursor cursor = {};
+    cursor_init(stack, &cursor);
+    cursor_seek(&cursor, block);
+
+    STACK_STATS_ADD(stack, hashedBytes, STACK_HASH_BLOCK * sizeof(elem_t));
+
+    return (block_hash(stack, &cursor, block) == tree_leaf(stack, block)) ? NO_ERRORS : BAD_DATA_HASH;
+}
+
+enum errorCode hash_tree_clone(struct Stack* clone, struct Stack* stack)
+{
+    if (no_ptr(stderr, clone, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    if (!stack->hashTree) return NO_ERRORS;
+
+    if (!stack->hashTreeRefs)
+    {
+        stack->hashTreeRefs = (size_t*) stack->allocator->allocate(stack->allocator, sizeof(size_t));
+
+        if (!stack->hashTreeRefs)
+        {
+            clone->hashTree   = NULL;
+            clone->hashLeaves = 0;
+
+            return NO_MEMORY;
+        }
+
+        *stack->hashTreeRefs = 1;
+    }
+
+    ++*stack->hashTreeRefs;
+
+    clone->hashTreeRefs = stack->hashTreeRefs;
+
+    return NO_ERRORS;
+}
+
+void hash_tree_dtor(struct Stack* stack)
+{
+    if (stack->hashTreeRefs)
+    {
+        size_t refs = --*stack->hashTreeRefs;
+
+        if (!refs) STACK_RETIRE_BLOCK(stack, stack->allocator, stack->hashTreeRefs, sizeof(size_t));
+        stack->hashTreeRefs = NULL;
+
+        if (refs) stack->hashTree = NULL;
+    }
+
+    if (stack->hashTree) tree_free(stack, stack->hashTree);
+
+    stack->hashTree   = NULL;
+    stack->hashLeaves = 0;
+}
+
+size_t stack_hash_threads(size_t threads)
+{
+    std::lock_guard<std::mutex> lock(poolLock);
+
+    pool_stop();
+    pool_start(threads);
+
+    return poolSize;
+}
+
+static size_t tree_blocks(size_t size)
+{
+    return (size + STACK_HASH_BLOCK - 1) / STACK_HASH_BLOCK;
+}
+
+static size_t tree_leaves(size_t blocks)
+{
+    size_t leaves = 1;
+    while (leaves < blocks) leaves *= 2;
+
+    return leaves;
+}
+
+/// @brief Number of significant bits of value, it is piece of block value and level above tree of value leaves
+static size_t tree_width(size_t value)
+{
+    return value ? TREE_LEVELS - (size_t) __builtin_clzl(value) : 0;
+}
+
+static hash_t tree_combine(hash_t left, hash_t right)
+{
+    #ifdef USE_INCREMENTAL_HASH
+
+    // Node is sum of its leaves, so root is sum of all element hashes
+    return left + right;
+
+    #else
+
+    return ((left << 5) + left) + right;
+
+    #endif
+}
+
+/// @brief Function recalculates internal nodes of tree from its leaves
+static void tree_fold(hash_t* nodes, size_t leaves)
+{
+    for (size_t node = leaves - 1; node; node--) nodes[node] = tree_combine(nodes[2*node], nodes[2*node + 1]);
+}
+
+/// @brief Node of piece, node whose blocks are all untouched is 0
+static hash_t tree_node(const struct HashTree* tree, size_t piece, size_t node)
+{
+    // The lowest block of node is its leftmost leaf
+    size_t block = node << (piece - tree_width(node));
+
+    return (block < tree->clean) ? tree->pieces[piece][node] : 0;
+}
+
+/// @brief Leaf of block stored in tree, block tree doesn't cover is 0
+static hash_t tree_leaf(const struct Stack* stack, size_t block)
+{
+    const struct HashTree* tree = stack->hashTree;
+
+    if (!tree || block >= stack->hashLeaves || block >= tree->clean) return 0;
+
+    return block ? tree->pieces[tree_width(block)][block] : tree->roots[0];
+}
+
+/// @brief Function sets nodes of blocks [clean, blocks) to 0, every block clears nodes it is the lowest block of
+static void tree_clean(struct HashTree* tree, size_t blocks)
+{
+    for (size_t block = tree->clean; block < blocks; block++)
+    {
+        if (!block)
+        {
+            tree->roots[0] = 0;
+            continue;
+        }
+
+        hash_t* nodes = tree->pieces[tree_width(block)];
+
+        size_t node = block;
+        nodes[node] = 0;
+
+        // Left child has the same lowest block as its parent
+        while (node % 2 == 0 && node > 1)
+        {
+            node /= 2;
+            nodes[node] = 0;
+        }
+    }
+
+    if (blocks > tree->clean) tree->clean = blocks;
+}
+
+/// @brief Function recalculates roots of levels from piece up to the top, data hash becomes the top one
+static void tree_roots(struct Stack* stack, size_t piece)
+{
+    struct HashTree* tree = stack->hashTree;
+
+    size_t top = tree_width(stack->hashLeaves) - 1;
+
+    for (size_t level = piece ? piece : 1; level <= top; level++)
+    {
+        tree->roots[level] = tree_combine(tree->roots[level - 1], tree_node(tree, level, 1));
+    }
+
+    stack->dataHash = tree->roots[top];
+}
+
+static void tree_free(struct Stack* stack, struct HashTree* tree)
+{
+    for (size_t piece = 1; piece < TREE_LEVELS && tree->pieces[piece]; piece++)
+    {
+        STACK_RETIRE_BLOCK(stack, stack->allocator, tree->pieces[piece], ((size_t) 1 << piece) * sizeof(hash_t));
+    }
+
+    STACK_RETIRE_BLOCK(stack, stack->allocator, tree, sizeof(struct HashTree));
+}
+
+/// @brief Function gives tree at least blocks leaves by adding levels on top of it, nodes of new levels aren't set
+static enum errorCode tree_fit(struct Stack* stack, size_t blocks)
+{
+    if (blocks <= stack->hashLeaves) return NO_ERRORS;
+
+    if (!stack->hashTree)
+    {
+        stack->hashTree = (struct HashTree*) stack->allocator->allocate(stack->allocator, sizeof(struct HashTree));
+        if (!stack->hashTree) return NO_MEMORY;
+
+        *stack->hashTree  = {};
+        stack->hashLeaves = 1;
+    }
+
+    struct HashTree* tree = stack->hashTree;
+
+    // Tree that can't get all levels keeps those it has
+    while (stack->hashLeaves < blocks)
+    {
+        size_t piece = tree_width(stack->hashLeaves);
+
+        tree->pieces[piece] = (hash_t*) stack->allocator->allocate(stack->allocator, ((size_t) 1 << piece) * sizeof(hash_t));
+        if (!tree->pieces[piece]) return NO_MEMORY;
+
+        stack->hashLeaves *= 2;
+    }
+
+    return NO_ERRORS;
+}
+
+/// @brief Function gives stack private copy of hash tree it shares with clones before tree is changed
+static enum errorCode tree_own(struct Stack* stack)
+{
+    if (!stack->hashTreeRefs) return NO_ERRORS;
+
+    // The last holder keeps tree, only reference count goes away
+    if (*stack->hashTreeRefs == 1)
+    {
+        STACK_RETIRE_BLOCK(stack, stack->allocator, stack->hashTreeRefs, sizeof(size_t));
+        stack->hashTreeRefs = NULL;
+
+        return NO_ERRORS;
+    }
+
+    struct HashTree* tree = (struct HashTree*) stack->allocator->allocate(stack->allocator, sizeof(struct HashTree));
+    if (!tree) return NO_MEMORY;
+
+    *tree = {};
+    tree->clean = stack->hashTree->clean;
+
+    memcpy(tree->roots, stack->hashTree->roots, sizeof(tree->roots));
+
+    for (size_t piece = 1; piece < TREE_LEVELS && stack->hashTree->pieces[piece]; piece++)
+    {
+        size_t bytes = ((size_t) 1 << piece) * sizeof(hash_t);
+
+        tree->pieces[piece] = (hash_t*) stack->allocator->allocate(stack->allocator, bytes);
+
+        if (!tree->pieces[piece])
+        {
+            tree_free(stack, tree);
+            return NO_MEMORY;
+        }
+
+        memcpy(tree->pieces[piece], stack->hashTree->pieces[piece], bytes);
+    }
+
+    --*stack->hashTreeRefs;
+    stack->hashTreeRefs = NULL;
+    stack->hashTree     = tree;
+
+    return NO_ERRORS;
+}
+
+static void cursor_init(const struct Stack* stack, struct BlockCursor* cursor)
+{
+    *cursor = {};
+
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        // Top chunk holds elements [capacity - STACK_CHUNK_CAPACITY, capacity)
+        cursor->segmented  = true;
+        cursor->chunk      = stack->topChunk;
+        cursor->chunkStart = stack->capacity - STACK_CHUNK_CAPACITY;
+
+        return;
+    }
+
+    if (!stack->data) return;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    cursor->data = (const elem_t*) ((const canary_t*) stack->data + 1);
+
+    if (stack->migration.oldData) cursor->oldData = (const elem_t*) ((const canary_t*) stack->migration.oldData + 1);
+
+    #else
+
+    cursor->data    = stack->data;
+    cursor->oldData = stack->migration.oldData;
+
+    #endif
+}
+
+/// @brief Function moves cursor of segmented stack down to chunk of block(blocks are visited from the top)
+static void cursor_seek(struct BlockCursor* cursor, size_t block)
+{
+    if (!cursor->segmented) return;
+
+    while (cursor->chunk && block * STACK_HASH_BLOCK < cursor->chunkStart)
+    {
+        cursor->chunk       = cursor->chunk->prev;
+        cursor->chunkStart -= STACK_CHUNK_CAPACITY;
+    }
+
+    cursor->data = cursor->chunk ? cursor->chunk->data : NULL;
+}
+
+static hash_t block_hash(const struct Stack* stack, const struct BlockCursor* cursor, size_t block)
+{
+    size_t from = block * STACK_HASH_BLOCK;
+    size_t to   = from + STACK_HASH_BLOCK;
+
+    // Damaged size isn't followed out of buffer
+    if (to > stack->size)     to = stack->size;
+    if (to > stack->capacity) to = stack->capacity;
+
+    if (from >= to || !cursor->data) return 0;
+
+    // Elements [from, split) are still in old buffer of incremental stack(pending is 0 for other storages)
+    size_t split = stack->migration.pending;
+
+    if (split < from) split = from;
+    if (split > to)   split = to;
+
+    if (split > from && !cursor->oldData) return 0;
+
+    // Elements below chunkStart are in lower chunks
+    const elem_t* data = cursor->data + (split - cursor->chunkStart);
+
+    #ifdef USE_INCREMENTAL_HASH
+
+    hash_t hash = (split > from) ? elem_range_hash(cursor->oldData + from, from, split - from) : 0;
+
+    return hash + elem_range_hash(data, split, to - split);
+
+    #else
+
+    if (split == from) return hash_bytes(stack->hashBackend, data, (to - from) * sizeof(elem_t));
+    if (split == to)   return hash_bytes(stack->hashBackend, cursor->oldData + from, (to - from) * sizeof(elem_t));
+
+    // Block is hashed as one piece, so that its hash doesn't change while migration moves it
+    elem_t elements[STACK_HASH_BLOCK] = {};
+
+    memcpy(elements, cursor->oldData + from, (split - from) * sizeof(elem_t));
+    memcpy(elements + (split - from), data, (to - split) * sizeof(elem_t));
+
+    return hash_bytes(stack->hashBackend, elements, (to - from) * sizeof(elem_t));
+
+    #endif
+}
+
+static void hash_block_range(const struct Stack* stack, hash_t* hashes, size_t first, size_t last)
+{
+    struct BlockCursor cursor = {};
+    cursor_init(stack, &cursor);
+
+    for (size_t block = last; block-- > first; )
+    {
+        cursor_seek(&cursor, block);
+        hashes[block] = block_hash(stack, &cursor, block);
+    }
+}
+
+static void hash_blocks(const struct Stack* stack, hash_t* hashes, size_t first, size_t last)
+{
+    if (last - first < STACK_HASH_PARALLEL)
+    {
+        hash_block_range(stack, hashes, first, last);
+        return;
+    }
+
+    // Pool busy with other stack(verifier thread, other writer) isn't waited for
+    std::unique_lock<std::mutex> pool(poolLock, std::try_to_lock);
+
+    if (pool.owns_lock() && !poolStarted) pool_start(STACK_HASH_THREADS_AUTO);
+
+    if (!pool.owns_lock() || !poolSize)
+    {
+        hash_block_range(stack, hashes, first, last);
+        return;
+    }
+
+    struct HashJob job = {stack, hashes, first, last, poolSize + 1};
+
+    {
+        std::lock_guard<std::mutex> lock(jobLock);
+
+        poolJob    = job;
+        jobRunning = poolSize;
+        jobGeneration++;
+    }
+
+    jobWake.notify_all();
+
+    hash_job_part(&job, 0);
+
+    std::unique_lock<std::mutex> wait(jobLock);
+    jobDone.wait(wait, []{ return jobRunning == 0; });
+}
+
+static void hash_job_part(const struct HashJob* job, size_t part)
+{
+    size_t blocks = job->last - job->first;
+
+    size_t first = job->first + blocks * part       / job->parts;
+    size_t last  = job->first + blocks * (part + 1) / job->parts;
+
+    if (first < last) hash_block_range(job->stack, job->hashes, first, last);
+}
+
+/// @brief Function starts hashing threads(called under poolLock)
+static void pool_start(size_t threads)
+{
+    if (threads == STACK_HASH_THREADS_AUTO)
+    {
+        unsigned hardware = std::thread::hardware_concurrency();
+        threads = (hardware > 1) ? hardware - 1 : 0;
+    }
+
+    if (threads > STACK_HASH_THREADS_MAX) threads = STACK_HASH_THREADS_MAX;
+
+    // Joinable threads left at exit would terminate process
+    if (!poolStopAtExit) poolStopAtExit = !atexit(pool_stop_at_exit);
+
+    poolStarted = true;
+
+    unsigned long long generation = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(jobLock);
+
+        poolStop   = false;
+        generation = jobGeneration;
+    }
+
+    // Pool that can't start all threads works with those it has
+    for (poolSize = 0; poolSize < threads; poolSize++)
+    {
+        try
+        {
+            poolThreads[poolSize] = std::thread(pool_worker, poolSize + 1, generation);
+        }
+        catch (const std::system_error&)
+        {
+            break;
+        }
+    }
+}
+
+/// @brief Function stops hashing threads and waits for them(called under poolLock)
+static void pool_stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobLock);
+        poolStop = true;
+    }
+
+    jobWake.notify_all();
+
+    for (size_t i = 0; i < poolSize; i++) poolThreads[i].join();
+
+    poolSize = 0;
+}
+
+static void pool_stop_at_exit()
+{
+    std::lock_guard<std::mutex> lock(poolLock);
+
+    pool_stop();
+}
+
+static void pool_worker(size_t part, unsigned long long generation)
+{
+    std::unique_lock<std::mutex> wait(jobLock);
+
+    while (true)
+    {
+        jobWake.wait(wait, [generation]{ return poolStop || jobGeneration != generation; });
+
+        if (poolStop) return;
+
+        generation = jobGeneration;
+        struct HashJob job = poolJob;
+
+        wait.unlock();
+        hash_job_part(&job, part);
+        wait.lock();
+
+        if (--jobRunning == 0) jobDone.notify_one();
+    }
+}
+
+#endif
@@ -0,0 +1,294 @@
+/**
+ * @file
+ * @brief Incremental storage of stack: contiguous buffer whose resize is spread over later operations
+ * @details Resize allocates new buffer and leaves elements in old one. Every push and pop moves migration.step
+ * top elements left in old buffer and poisons migration.step elements of new tail. Step is chosen at start, so that
+ * pushes left before the next growth complete migration, and it stays STACK_MIGRATE_STEP with geometric growth,
+ * so no operation copies more than constant number of elements and no resize waits for previous one.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "CallSiteProfile.h"
+#include "Stack.h"
+#include "Verifier.h"
+
+static elem_t* buffer_elements(elem_t* buffer);
+static size_t incremental_fit_capacity(const struct Stack* stack, size_t capacity);
+static void incremental_shrink(struct Stack* stack);
+static size_t incremental_step_size(const struct Stack* stack);
+
+enum errorCode incremental_start(struct Stack* stack, size_t capacity)
+{
+    capacity = incremental_fit_capacity(stack, capacity);
+    if (capacity == stack->capacity) return NO_ERRORS;
+
+    STACK_STATS_TIMER(startTime);
+    CALL_SITE_TIMER(startSiteTime);
+
+    elem_t* buffer = (elem_t*) stack->allocator->allocate(stack->allocator, stack_buffer_size(capacity));
+    if (!buffer) return NO_MEMORY;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    *((canary_t*) buffer) = CANARY_T_DEFAULT;
+    *((canary_t*) (buffer_elements(buffer) + capacity)) = CANARY_T_DEFAULT;
+
+    #endif
+
+    if (capacity > stack->capacity) STACK_STATS_ADD(stack, grows,   1);
+    else                            STACK_STATS_ADD(stack, shrinks, 1);
+
+    stack->migration.oldData     = stack->data;
+    stack->migration.oldCapacity = stack->capacity;
+    stack->migration.pending     = stack->size;
+    stack->migration.poisoned    = (stack->protection >= PROTECTION_CANARY) ? stack->size : capacity;
+
+    stack->data       = buffer;
+    stack->capacity   = capacity;
+    stack->shrinkSize = stack->growth->shrink_size(stack->growth, capacity);
+
+    stack->migration.step = incremental_step_size(stack);
+
+    // Old buffer of empty stack has nothing to move, it is freed at once
+    if (!stack->size) incremental_step(stack, 0);
+
+    STACK_STATS_LATENCY(stack, reallocLatency, startTime);
+    CALL_SITE_REALLOC(startSiteTime);
+    STACK_STATS_PEAK(stack);
+
+    return NO_ERRORS;
+}
+
+void incremental_step(struct Stack* stack, size_t count)
+{
+    struct StackMigration* migration = &stack->migration;
+
+    if (migration->oldData)
+    {
+        size_t part = (migration->pending < count) ? migration->pending : count;
+
+        migration->pending -= part;
+
+        memcpy(buffer_elements(stack->data) + migration->pending, buffer_elements(migration->oldData) + migration->pending,
+               part * sizeof(elem_t));
+
+        if (!migration->pending)
+        {
+            STACK_RETIRE_BLOCK(stack, stack->allocator, migration->oldData, stack_buffer_size(migration->oldCapacity));
+
+            migration->oldData     = NULL;
+            migration->oldCapacity = 0;
+        }
+    }
+
+    if (migration->poisoned < stack->capacity)
+    {
+        size_t part = stack->capacity - migration->poisoned;
+        if (part > count) part = count;
+
+        poison_fill(buffer_elements(stack->data) + migration->poisoned, part);
+        migration->poisoned += part;
+    }
+}
+
+void incremental_finish(struct Stack* stack)
+{
+    // Both old elements and unpoisoned tail are shorter than capacity
+    incremental_step(stack, stack->capacity);
+}
+
+void incremental_dtor(struct Stack* stack)
+{
+    if (stack->migration.oldData)
+    {
+        STACK_RETIRE_BLOCK(stack, stack->allocator, stack->migration.oldData, stack_buffer_size(stack->migration.oldCapacity));
+    }
+
+    stack->migration = {};
+}
+
+enum errorCode incremental_push(struct Stack* stack, elem_t value)
+{
+    if (stack->size + 1 == stack->capacity)
+    {
+        if (incremental_start(stack, stack->growth->grow(stack->growth, stack->capacity))) return NO_MEMORY;
+    }
+
+    incremental_step(stack, stack->migration.step);
+
+    buffer_elements(stack->data)[stack->size++] = value;
+
+    if (stack->migration.poisoned < stack->size) stack->migration.poisoned = stack->size;
+
+    return NO_ERRORS;
+}
+
+elem_t incremental_pop(struct Stack* stack)
+{
+    stack->size--;
+
+    elem_t* data = buffer_elements(stack->data);
+    elem_t  ret  = ELEM_T_POISON;
+
+    if (stack->size < stack->migration.pending)
+    {
+        ret = buffer_elements(stack->migration.oldData)[stack->size];
+        stack->migration.pending = stack->size;
+    }
+    else ret = data[stack->size];
+
+    // Slot of element popped from old buffer isn't filled in data yet, it joins poisoned tail too
+    if (stack->protection >= PROTECTION_CANARY) data[stack->size] = ELEM_T_POISON;
+
+    incremental_step(stack, stack->migration.step);
+    incremental_shrink(stack);
+
+    return ret;
+}
+
+enum errorCode incremental_push_n(struct Stack* stack, const elem_t* values, size_t count)
+{
+    // Count isn't less than pushes left before growth, so steps of current migration complete it
+    incremental_step(stack, count * stack->migration.step);
+
+    if (stack->size + count >= stack->capacity)
+    {
+        size_t capacity = stack->capacity;
+        while (stack->size + count >= capacity) capacity = stack->growth->grow(stack->growth, capacity);
+
+        if (incremental_start(stack, capacity)) return NO_MEMORY;
+
+        incremental_step(stack, count * stack->migration.step);
+    }
+
+    memcpy(buffer_elements(stack->data) + stack->size, values, count * sizeof(elem_t));
+
+    stack->size += count;
+
+    if (stack->migration.poisoned < stack->size) stack->migration.poisoned = stack->size;
+
+    return NO_ERRORS;
+}
+
+void incremental_pop_n(struct Stack* stack, elem_t* values, size_t count)
+{
+    elem_t* data    = buffer_elements(stack->data);
+    size_t  size    = stack->size - count;
+    size_t  pending = stack->migration.pending;
+
+    // Elements above pending are in data, the ones below it are still in old buffer
+    size_t from = (size > pending) ? size : pending;
+
+    memcpy(values + (from - size), data + from, (stack->size - from) * sizeof(elem_t));
+
+    if (size < pending)
+    {
+        memcpy(values, buffer_elements(stack->migration.oldData) + size, (pending - size) * sizeof(elem_t));
+        stack->migration.pending = size;
+    }
+
+    if (stack->protection >= PROTECTION_CANARY) poison_fill(data + size, count);
+
+    stack->size = size;
+
+    incremental_step(stack, count * stack->migration.step);
+    incremental_shrink(stack);
+}
+
+void incremental_gather(const struct Stack* stack, elem_t* values)
+{
+    size_t pending = stack->migration.pending;
+
+    if (pending) memcpy(values, buffer_elements(stack->migration.oldData), pending * sizeof(elem_t));
+
+    memcpy(values + pending, buffer_elements(stack->data) + pending, (stack->size - pending) * sizeof(elem_t));
+}
+
+enum errorCode incremental_check(const struct Stack* stack)
+{
+    const struct StackMigration* migration = &stack->migration;
+
+    int errors = NO_ERRORS;
+
+    if (migration->pending && !migration->oldData) errors |= NO_STACK_DATA_PTR;
+
+    if (migration->pending > stack->size || migration->poisoned < stack->size || migration->poisoned > stack->capacity ||
+        (migration->oldData && migration->pending >= migration->oldCapacity)) errors |= SIZE_OUT_OF_CAPACITY;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    if (stack->protection >= PROTECTION_CANARY && migration->oldData && !(errors & SIZE_OUT_OF_CAPACITY))
+    {
+        if (*((const canary_t*) migration->oldData) != CANARY_T_DEFAULT) errors |= LEFT_DATA_CANARY_BAD_VALUE;
+
+        if (*((const canary_t*) (buffer_elements(migration->oldData) + migration->oldCapacity)) != CANARY_T_DEFAULT)
+        {
+            errors |= RIGHT_DATA_CANARY_BAD_VALUE;
+        }
+    }
+
+    #endif
+
+    return (errorCode) errors;
+}
+
+/// @brief Elements of buffer with data canaries
+static elem_t* buffer_elements(elem_t* buffer)
+{
+    #ifdef USE_CANARY_PROTECTION
+    return (elem_t*) ((canary_t*) buffer + 1);
+    #else
+    return buffer;
+    #endif
+}
+
+/// @brief Capacity not less than size + 1 that keeps right data canary aligned
+static size_t incremental_fit_capacity(const struct Stack* stack, size_t capacity)
+{
+    if (capacity <= stack->size) capacity = stack->size + 1;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    while ((capacity * sizeof(elem_t)) % (sizeof(canary_t)) != 0) capacity++;
+
+    #endif
+
+    return capacity;
+}
+
+/**
+ * @brief Step of migration just started: elements left to move or poison spread over pushes left before growth
+ * @details Pops only lower pending elements and shrink waits for migration, so growth is the only resize that could
+ * find migration unfinished
+*/
+static size_t incremental_step_size(const struct Stack* stack)
+{
+    const struct StackMigration* migration = &stack->migration;
+
+    size_t work     = (migration->pending > stack->capacity - migration->poisoned) ? migration->pending
+                                                                                 : stack->capacity - migration->poisoned;
+    size_t headroom = stack->capacity - 1 - stack->size;
+
+    size_t step = headroom ? (work + headroom - 1) / headroom : work;
+
+    return (step > STACK_MIGRATE_STEP) ? step : STACK_MIGRATE_STEP;
+}
+
+/// @brief Starts shrink migration when size fell to shrinkSize and previous migration is completed
+static void incremental_shrink(struct Stack* stack)
+{
+    if (stack->size > stack->shrinkSize || stack->migration.oldData || stack->migration.poisoned < stack->capacity) return;
+
+    size_t capacity = stack->capacity;
+    while (stack->size <= stack->growth->shrink_size(stack->growth, capacity))
+    {
+        size_t shrunk = stack->growth->shrink(stack->growth, capacity);
+        if (shrunk >= capacity) break;
+
+        capacity = shrunk;
+    }
+
+    // Failed shrink keeps bigger buffer, stack stays valid
+    incremental_start(stack, capacity);
+}
@@ -0,0 +1,231 @@
+/**
+ * @file
+ * @brief Background logger: bounded lock-free ring of rendered reports and thread writing them out
+*/
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <system_error>
+#include <thread>
+
+#include "Logger.h"
+#include "Stack.h"
+
+/// @brief Slot of ring: sequence equals position when slot is free for it and position + 1 when report is ready
+struct LogCell
+{
+    std::atomic<size_t> sequence;
+    FILE*               stream;     ///< Stream report was made for
+    size_t              length;     ///< Length of report in text of slot
+};
+
+static struct LogCell      logRing[STACK_LOGGER_RING];
+static char*               logTexts = NULL;     ///< STACK_DUMP_BUFFER bytes of text for every slot, allocated by first start
+static std::atomic<size_t> logHead(0);          ///< Next position posting threads reserve
+static size_t              logTail = 0;         ///< Next position logger thread reads
+
+static std::thread             loggerThread;
+static std::mutex              loggerLock;          ///< Guards loggerStop
+static std::condition_variable loggerWake;          ///< Wakes logger on new report and on stop
+static bool                    loggerStop = false;
+static bool                    loggerStopAtExit = false;
+
+static struct StackLoggerConfig loggerConfig = {};
+
+static std::atomic<bool>   loggerRunning(false);    ///< Reports are posted to ring
+static std::atomic<size_t> loggerPosting(0);        ///< Threads inside stack_logger_post
+static std::atomic<size_t> loggerPosted(0);
+static std::atomic<size_t> loggerWritten(0);
+static std::atomic<size_t> loggerDropped(0);
+
+static bool ring_push(FILE* stream, const char* text, size_t length);
+static struct LogCell* ring_peek();
+static void ring_release(struct LogCell* cell);
+static void logger_loop();
+static void logger_drain();
+
+enum errorCode stack_logger_start(const struct StackLoggerConfig* config)
+{
+    if (no_ptr(stderr, config, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    stack_logger_stop();
+
+    // Joinable thread left at exit would terminate process, reports posted before exit are written
+    if (!loggerStopAtExit) loggerStopAtExit = !atexit(stack_logger_stop);
+
+    // Nobody posts while logger is stopped, so ring is set up without races. Texts stay allocated for later starts
+    if (!logTexts)
+    {
+        logTexts = (char*) calloc(STACK_LOGGER_RING, STACK_DUMP_BUFFER);
+        if (no_ptr(stderr, logTexts, NO_MEMORY, __FILE__, __func__, __LINE__)) return NO_MEMORY;
+
+        for (size_t i = 0; i < STACK_LOGGER_RING; i++) logRing[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    loggerConfig = *config;
+    loggerStop   = false;
+
+    loggerPosted.store(0);
+    loggerWritten.store(0);
+    loggerDropped.store(0);
+
+    loggerRunning.store(true);
+
+    try
+    {
+        loggerThread = std::thread(logger_loop);
+    }
+    catch (const std::system_error&)
+    {
+        loggerRunning.store(false);
+
+        print_error(stderr, NO_MEMORY);
+        return NO_MEMORY;
+    }
+
+    return NO_ERRORS;
+}
+
+void stack_logger_stop()
+{
+    if (!loggerThread.joinable()) return;
+
+    loggerRunning.store(false);
+
+    // Reports being posted get into ring before logger drains it for the last time
+    while (loggerPosting.load()) std::this_thread::yield();
+
+    {
+        std::lock_guard<std::mutex> lock(loggerLock);
+        loggerStop = true;
+    }
+
+    loggerWake.notify_all();
+    loggerThread.join();
+}
+
+void stack_logger_flush()
+{
+    size_t posted = loggerPosted.load();
+
+    loggerWake.notify_all();
+
+    while (loggerThread.joinable() && loggerWritten.load() < posted) std::this_thread::yield();
+}
+
+struct StackLoggerStats stack_logger_stats()
+{
+    return {loggerPosted.load(), loggerWritten.load(), loggerDropped.load()};
+}
+
+bool stack_logger_post(FILE* stream, const char* text, size_t length)
+{
+    loggerPosting.fetch_add(1);
+
+    if (!loggerRunning.load())
+    {
+        loggerPosting.fetch_sub(1);
+        return false;
+    }
+
+    // Text longer than slot(stdio writes it past full buffer) takes several slots
+    for (size_t part = 0; part < length; part += STACK_DUMP_BUFFER)
+    {
+        size_t partLength = (length - part < STACK_DUMP_BUFFER) ? length - part : STACK_DUMP_BUFFER;
+
+        if (ring_push(stream, text + part, partLength))
+        {
+            loggerPosted.fetch_add(1);
+            loggerWake.notify_one();
+        }
+        else loggerDropped.fetch_add(1);
+    }
+
+    loggerPosting.fetch_sub(1);
+
+    return true;
+}
+
+/// @brief Function reserves next position and copies report into its slot, fails without waiting if ring is full
+static bool ring_push(FILE* stream, const char* text, size_t length)
+{
+    size_t position = logHead.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        struct LogCell* cell = &logRing[position % STACK_LOGGER_RING];
+
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+
+        if (sequence == position)
+        {
+            if (logHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell->stream = stream;
+                cell->length = length;
+                memcpy(logTexts + (position % STACK_LOGGER_RING) * STACK_DUMP_BUFFER, text, length);
+
+                cell->sequence.store(position + 1, std::memory_order_release);
+
+                return true;
+            }
+        }
+        // Slot still holds message of previous lap
+        else if (sequence < position) return false;
+        else position = logHead.load(std::memory_order_relaxed);
+    }
+}
+
+/// @brief Function returns ready slot at tail or NULL(logger thread only)
+static struct LogCell* ring_peek()
+{
+    struct LogCell* cell = &logRing[logTail % STACK_LOGGER_RING];
+
+    return (cell->sequence.load(std::memory_order_acquire) == logTail + 1) ? cell : NULL;
+}
+
+/// @brief Function gives slot at tail back to posting threads after its text is written(logger thread only)
+static void ring_release(struct LogCell* cell)
+{
+    cell->sequence.store(logTail + STACK_LOGGER_RING, std::memory_order_release);
+
+    logTail++;
+}
+
+static void logger_loop()
+{
+    std::unique_lock<std::mutex> wait(loggerLock);
+
+    while (true)
+    {
+        wait.unlock();
+        logger_drain();
+        wait.lock();
+
+        if (loggerStop) break;
+
+        // Posting threads don't take lock, missed wake up is caught by timeout
+        loggerWake.wait_for(wait, std::chrono::milliseconds(STACK_LOGGER_PERIOD_MS), []{ return loggerStop; });
+    }
+}
+
+static void logger_drain()
+{
+    struct LogCell* cell = NULL;
+
+    while ((cell = ring_peek()))
+    {
+        FILE* stream = loggerConfig.stream ? loggerConfig.stream : cell->stream;
+
+        fwrite(logTexts + (logTail % STACK_LOGGER_RING) * STACK_DUMP_BUFFER, 1, cell->length, stream);
+        fflush(stream);
+
+        ring_release(cell);
+
+        loggerWritten.fetch_add(1);
+    }
+}
@@ -0,0 +1,157 @@
+/**
+ * @file
+ * @brief Mapped storage of stack: reserved virtual range, pages committed by mprotect and released by madvise
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "Stack.h"
+#include "Verifier.h"
+
+static size_t mapped_round(size_t bytes);
+static size_t mapped_round_down(size_t bytes);
+static size_t mapped_bytes_capacity(size_t bytes);
+
+size_t mapped_ctor(struct Stack* stack, size_t capacity)
+{
+    stack->data          = NULL;
+    stack->reservedBytes = 0;
+
+    size_t reserve = STACK_MAPPED_RESERVE;
+    size_t commit  = mapped_round(stack_buffer_size(capacity));
+
+    if (commit > reserve) reserve = (commit + STACK_HUGE_PAGE_SIZE - 1) / STACK_HUGE_PAGE_SIZE * STACK_HUGE_PAGE_SIZE;
+
+    // Range is over-reserved by one huge page and trimmed, so that it starts on huge page border
+    size_t span = reserve + STACK_HUGE_PAGE_SIZE;
+
+    char* map = (char*) mmap(NULL, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) return 0;
+
+    char* base = (char*) (((uintptr_t) map + STACK_HUGE_PAGE_SIZE - 1) & ~(STACK_HUGE_PAGE_SIZE - 1));
+
+    if (base > map) munmap(map, (size_t) (base - map));
+
+    size_t tail = (size_t) (map + span - (base + reserve));
+    if (tail) munmap(base + reserve, tail);
+
+    if (mprotect(base, commit, PROT_READ | PROT_WRITE))
+    {
+        munmap(base, reserve);
+        return 0;
+    }
+
+    stack->data          = (elem_t*) base;
+    stack->reservedBytes = reserve;
+
+    return mapped_bytes_capacity(commit);
+}
+
+void mapped_dtor(struct Stack* stack)
+{
+    if (stack->data) munmap(stack->data, stack->reservedBytes);
+
+    stack->data          = NULL;
+    stack->reservedBytes = 0;
+}
+
+size_t mapped_commit(struct Stack* stack, size_t capacity)
+{
+    size_t maxCapacity = mapped_bytes_capacity(stack->reservedBytes);
+
+    if (capacity > maxCapacity) capacity = maxCapacity;
+    if (capacity <= stack->size) return 0;
+
+    char*  base     = (char*) stack->data;
+    size_t oldBytes = mapped_round(stack_buffer_size(stack->capacity));
+    size_t newBytes = mapped_round(stack_buffer_size(capacity));
+
+    // Shrink rounds down, otherwise halved capacity a bit over page border would keep all pages
+    if (capacity < stack->capacity)
+    {
+        size_t minBytes = mapped_round(stack_buffer_size(stack->size + 1));
+
+        newBytes = mapped_round_down(stack_buffer_size(capacity));
+        if (newBytes < minBytes) newBytes = minBytes;
+    }
+
+    if (newBytes > oldBytes)
+    {
+        if (mprotect(base + oldBytes, newBytes - oldBytes, PROT_READ | PROT_WRITE)) return 0;
+    }
+    else if (newBytes < oldBytes)
+    {
+        // Verifier may read pages of old capacity, shrink waits for the next scope
+        if (STACK_DEFERS_RELEASE(stack)) return stack->capacity;
+
+        // Released pages read as zeros when committed again, stack poisons them anew
+        madvise(base + newBytes, oldBytes - newBytes, MADV_DONTNEED);
+        mprotect(base + newBytes, oldBytes - newBytes, PROT_NONE);
+    }
+
+    return mapped_bytes_capacity(newBytes);
+}
+
+size_t mapped_fit_capacity(size_t capacity, bool roundDown)
+{
+    size_t bytes = roundDown ? mapped_round_down(stack_buffer_size(capacity)) : mapped_round(stack_buffer_size(capacity));
+
+    return mapped_bytes_capacity(bytes);
+}
+
+enum errorCode stack_set_huge_pages(struct Stack* stack, bool enable)
+{
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    if (stack->storage != STORAGE_MAPPED || !stack->data) return NO_ERRORS;
+
+    #if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+
+    if (madvise(stack->data, stack->reservedBytes, enable ? MADV_HUGEPAGE : MADV_NOHUGEPAGE)) return NO_MEMORY;
+
+    return NO_ERRORS;
+
+    #else
+
+    return enable ? NO_MEMORY : NO_ERRORS;
+
+    #endif
+}
+
+size_t stack_page_size()
+{
+    static const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+
+    return pageSize;
+}
+
+static size_t mapped_round(size_t bytes)
+{
+    size_t page = stack_page_size();
+
+    return (bytes + page - 1) / page * page;
+}
+
+/// @brief Rounds down to page border, but not below one page
+static size_t mapped_round_down(size_t bytes)
+{
+    size_t page = stack_page_size();
+
+    return (bytes < page) ? page : bytes / page * page;
+}
+
+/// @brief Elements that fit into bytes of buffer together with data canaries
+static size_t mapped_bytes_capacity(size_t bytes)
+{
+    size_t capacity = (bytes - stack_buffer_size(0)) / sizeof(elem_t);
+
+    #ifdef USE_CANARY_PROTECTION
+
+    while ((capacity * sizeof(elem_t)) % (sizeof(canary_t)) != 0) capacity--;
+
+    #endif
+
+    return capacity;
+}
@@ -3,16 +3,114 @@
  * @brief Functions? that output smth to display like error message or stack dump
 */
 
+#include <atomic>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdio_ext.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "Color_output.h"
+#include "Logger.h"
 #include "Stack.h"
 
-enum errorCode stack_dump(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode)
+/// @brief Per-thread report: stream whose buffer collects output and is written out to target at once
+struct ReportBuffer
+{
+    FILE*  cookie;  ///< Stream reports are printed to(NULL until first report of thread)
+    char*  text;    ///< Buffer of cookie
+    FILE*  target;  ///< Stream open report goes to
+    size_t depth;   ///< Reports opened and not closed yet
+
+    ReportBuffer() : cookie(NULL), text(NULL), target(NULL), depth(0) {}
+    ReportBuffer(const ReportBuffer&) = delete;
+    ReportBuffer& operator=(const ReportBuffer&) = delete;
+
+    ~ReportBuffer()
+    {
+        if (cookie) fclose(cookie);
+        free(text);
+    }
+};
+
+/// @brief Last printed dump of stack with errors
+/// @details Timestamp and counter live in one word updated by CAS. Stack and errors change only while word holds
+/// DUMP_REPEAT_CLAIMED, so successful CAS of word read before them proves they belong to it
+struct DumpRepeat
+{
+    std::atomic<uint64_t>            state;     ///< lastMs << DUMP_REPEAT_COUNT_BITS | dumps skipped since lastMs
+    std::atomic<const struct Stack*> stack;
+    std::atomic<int>                 errors;
+};
+
+const unsigned DUMP_REPEAT_COUNT_BITS = 24;
+const uint64_t DUMP_REPEAT_COUNT_MAX  = (1ull << DUMP_REPEAT_COUNT_BITS) - 1;   ///< Counter saturates here
+const uint64_t DUMP_REPEAT_CLAIMED    = UINT64_MAX;                             ///< Slot is being taken by other stack
+
+static thread_local struct ReportBuffer threadReport;
+
+static struct DumpRepeat     dumpRepeats[STACK_DUMP_REPEATS];
+static std::atomic<unsigned> dumpLimitMs(0);
+static std::atomic<int>      dumpFormat(DUMP_TEXT);
+
+static ssize_t report_write(void* cookie, const char* text, size_t size);
+static bool dump_suppressed(const struct Stack* stack, size_t* suppressed);
+
+static enum errorCode text_dump(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                                size_t suppressed);
+static enum errorCode segmented_data_dump(FILE* stream, const struct Stack* stack, stackDumpMode mode);
+static void print_element(FILE* stream, size_t index, size_t size, elem_t value);
+
+#ifdef USE_HASH_PROTECTION
+
+/// @brief Prints blocks whose hashes don't match hash tree and their element ranges
+static void print_corrupted_blocks(FILE* stream, const struct Stack* stack);
+
+#endif
+
+enum errorCode stack_dump(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                          enum stackDumpFormat format)
 {
     if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
 
+    size_t suppressed = 0;
+    if (dump_suppressed(stack, &suppressed)) return NO_ERRORS;
+
+    if (format == DUMP_DEFAULT) format = (enum stackDumpFormat) dumpFormat.load(std::memory_order_relaxed);
+
+    FILE* report = stack_report_begin(stream);
+    enum errorCode error = NO_ERRORS;
+
+    switch (format)
+    {
+        case DUMP_JSON:
+            error = stack_dump_json(report, stack, file, func, line, mode, suppressed);
+            break;
+
+        case DUMP_BINARY:
+            error = stack_dump_binary(report, stack, file, func, line, mode, suppressed);
+            break;
+
+        case DUMP_DEFAULT:
+        case DUMP_TEXT:
+        default:
+            error = text_dump(report, stack, file, func, line, mode, suppressed);
+            break;
+    }
+
+    stack_report_end(report);
+
+    return error;
+}
+
+void stack_dump_format(enum stackDumpFormat format)
+{
+    dumpFormat.store((format == DUMP_DEFAULT) ? DUMP_TEXT : format);
+}
+
+static enum errorCode text_dump(FILE* stream, const struct Stack* stack, const char* file, const char* func, int line, stackDumpMode mode,
+                                size_t suppressed)
+{
     if (mode == FULL)
     {
         PRINT_LINE(stream, file, func, line);
@@ -20,17 +118,208 @@ enum errorCode stack_dump(FILE* stream, const struct Stack* stack, const char* f
         if (print_stack_homeland(stream, stack)) return NO_STACK_PTR;
     }
 
+    if (suppressed) color_fprintf(stream, COLOR_RED, STYLE_BOLD, "%lu identical dumps of this stack suppressed\n", suppressed);
+
     if (stack_data_dump(stream, stack, mode)) return NO_STACK_PTR;
 
     return NO_ERRORS;
 }
 
+void stack_dump_limit(unsigned periodMs)
+{
+    dumpLimitMs.store(periodMs);
+
+    for (size_t i = 0; i < STACK_DUMP_REPEATS; i++)
+    {
+        dumpRepeats[i].state.store(DUMP_REPEAT_CLAIMED);
+        dumpRepeats[i].stack.store(NULL, std::memory_order_relaxed);
+        dumpRepeats[i].errors.store(NO_ERRORS, std::memory_order_relaxed);
+        dumpRepeats[i].state.store(0, std::memory_order_release);
+    }
+}
+
+FILE* stack_report_begin(FILE* stream)
+{
+    struct ReportBuffer* report = &threadReport;
+
+    if (report->depth)
+    {
+        // Report inside report of the same thread goes to the outer one, report to other stream isn't buffered
+        if (stream != report->cookie) return stream;
+
+        report->depth++;
+        return stream;
+    }
+
+    if (!report->cookie)
+    {
+        report->text = (char*) malloc(STACK_DUMP_BUFFER);
+        if (!report->text) return stream;
+
+        cookie_io_functions_t functions = {NULL, report_write, NULL, NULL};
+
+        report->cookie = fopencookie(report, "w", functions);
+        if (!report->cookie || setvbuf(report->cookie, report->text, _IOFBF, STACK_DUMP_BUFFER))
+        {
+            if (report->cookie) fclose(report->cookie);
+            free(report->text);
+
+            report->cookie = NULL;
+            report->text   = NULL;
+
+            return stream;
+        }
+
+        // Only owning thread prints to its report, stdio needn't lock it on every call
+        __fsetlocking(report->cookie, FSETLOCKING_BYCALLER);
+    }
+
+    report->target = stream;
+    report->depth  = 1;
+
+    return report->cookie;
+}
+
+void stack_report_end(FILE* report)
+{
+    struct ReportBuffer* buffer = &threadReport;
+
+    if (!buffer->depth || report != buffer->cookie) return;
+
+    if (--buffer->depth) return;
+
+    fflush(buffer->cookie);
+    buffer->target = NULL;
+}
+
+/// @brief Writes filled part of report buffer to target stream or hands it to logger thread
+static ssize_t report_write(void* cookie, const char* text, size_t size)
+{
+    struct ReportBuffer* report = (struct ReportBuffer*) cookie;
+
+    if (!report->target) return (ssize_t) size;
+
+    if (!stack_logger_post(report->target, text, size))
+    {
+        fwrite(text, 1, size, report->target);
+        fflush(report->target);
+    }
+
+    return (ssize_t) size;
+}
+
+/// @brief Decides whether dump of stack with the same errors as its last printed one is skipped
+static bool dump_suppressed(const struct Stack* stack, size_t* suppressed)
+{
+    unsigned periodMs = dumpLimitMs.load(std::memory_order_relaxed);
+
+    if (!periodMs || !stack->stackErrors) return false;
+
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    uint64_t now = (uint64_t) time.tv_sec * 1000ull + (uint64_t) time.tv_nsec / 1000000ull;
+
+    struct DumpRepeat* repeat = &dumpRepeats[((uintptr_t) stack >> 4) % STACK_DUMP_REPEATS];
+    uint64_t state = repeat->state.load(std::memory_order_acquire);
+
+    while (true)
+    {
+        // Other stack is taking the slot: print rather than wait for it
+        if (state == DUMP_REPEAT_CLAIMED) return false;
+
+        uint64_t lastMs = state >> DUMP_REPEAT_COUNT_BITS;
+        uint64_t count  = state & DUMP_REPEAT_COUNT_MAX;
+
+        const struct Stack* owner = repeat->stack.load(std::memory_order_relaxed);
+        bool sameErrors = (repeat->errors.load(std::memory_order_relaxed) == stack->stackErrors);
+
+        if (owner == stack && sameErrors && now < lastMs + periodMs)
+        {
+            if (repeat->state.compare_exchange_weak(state, state + (count < DUMP_REPEAT_COUNT_MAX)))
+                return true;
+
+            continue;
+        }
+
+        // Timestamp never goes back, so word can't return to value other thread read before the slot changed hands
+        if (owner == stack && sameErrors)
+        {
+            if (repeat->state.compare_exchange_weak(state, ((now > lastMs) ? now : lastMs) << DUMP_REPEAT_COUNT_BITS))
+            {
+                *suppressed = count;
+                return false;
+            }
+
+            continue;
+        }
+
+        if (repeat->state.compare_exchange_weak(state, DUMP_REPEAT_CLAIMED))
+        {
+            repeat->stack.store(stack, std::memory_order_relaxed);
+            repeat->errors.store(stack->stackErrors, std::memory_order_relaxed);
+            repeat->state.store(((now > lastMs) ? now : lastMs + 1) << DUMP_REPEAT_COUNT_BITS, std::memory_order_release);
+
+            *suppressed = (owner == stack) ? count : 0;
+            return false;
+        }
+    }
+}
+
 enum errorCode stack_data_dump(FILE* stream, const struct Stack* stack, stackDumpMode mode)
 {
     if (no_ptr(stream, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
 
     if (mode == FULL)
     {
+        static const char* const protectionNames[] = {"OFF", "CANARY", "HASH", "PARANOID"};
+
+        color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "protection");
+        if ((unsigned) stack->protection <= PROTECTION_PARANOID)
+            fprintf(stream, " = %s\n", protectionNames[stack->protection]);
+        else
+            fprintf(stream, " = %d(invalid)\n", (int) stack->protection);
+
+        #ifdef USE_HASH_PROTECTION
+
+        color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "hash");
+        if (hash_backend_name(stack->hashBackend))
+            fprintf(stream, " = %s(%s)\n", hash_backend_name(stack->hashBackend), hash_backend_isa(stack->hashBackend));
+        else
+            fprintf(stream, " = %d(invalid)\n", (int) stack->hashBackend);
+
+        #endif
+
+        color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "growth");
+        fprintf(stream, " = %s\n", (stack->growth && stack->growth->name) ? stack->growth->name : "NULL");
+
+        color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "allocator");
+        fprintf(stream, " = %s", (stack->allocator && stack->allocator->name) ? stack->allocator->name : "NULL");
+        color_putc(stream, COLOR_BLUE, STYLE_BOLD, '[');
+        color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%p", (void*) stack->allocator);
+        color_putc(stream, COLOR_BLUE, STYLE_BOLD, ']');
+        fprintf(stream, "\n");
+
+        if (stack->storage == STORAGE_MAPPED)
+        {
+            color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "reserved");
+            fprintf(stream, " = %lu bytes\n", stack->reservedBytes);
+        }
+        else if (stack->storage == STORAGE_SNAPSHOT)
+        {
+            color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "snapshot mapping");
+            fprintf(stream, " = %lu bytes(copy-on-write)\n", stack->reservedBytes);
+        }
+        else if (stack->storage == STORAGE_INCREMENTAL)
+        {
+            color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "migration");
+            fprintf(stream, " = %lu elements in old buffer", stack->migration.pending);
+            color_putc(stream, COLOR_BLUE, STYLE_BOLD, '[');
+            color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%p", (void*) stack->migration.oldData);
+            color_putc(stream, COLOR_BLUE, STYLE_BOLD, ']');
+            fprintf(stream, "(capacity %lu), poisoned up to %lu\n", stack->migration.oldCapacity, stack->migration.poisoned);
+        }
+
         #ifdef USE_CANARY_PROTECTION
 
         color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "left canary");
@@ -40,6 +329,12 @@ enum errorCode stack_data_dump(FILE* stream, const struct Stack* stack, stackDum
         fprintf(stream, " = %llx\n", stack->rightCanary);
 
         #endif
+
+        #ifdef USE_STACK_STATS
+
+        if (stack->stats) print_stack_stats(stream, stack->stats);
+
+        #endif
     }
 
     color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "size");
@@ -48,6 +343,27 @@ enum errorCode stack_data_dump(FILE* stream, const struct Stack* stack, stackDum
     color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "capacity");
     fprintf(stream, " = %lu\n", stack->capacity);
 
+    #ifdef USE_POISON_CHECK
+
+    if (mode == FULL && (stack->stackErrors & POISON_OVERWRITTEN))
+    {
+        size_t index = stack_poison_find(stack, true);
+
+        color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "first non-poison above top");
+        if (index != POISON_INTACT) fprintf(stream, " = [%lu]\n", index);
+        else                        fprintf(stream, " = none(restored)\n");
+    }
+
+    #endif
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (mode == FULL && (stack->stackErrors & BAD_DATA_HASH)) print_corrupted_blocks(stream, stack);
+
+    #endif
+
+    if (stack->storage == STORAGE_SEGMENTED) return segmented_data_dump(stream, stack, mode);
+
     color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "data");
     color_putc(stream, COLOR_BLUE, STYLE_BOLD, '[');
     if (!stack->data) 
@@ -59,6 +375,8 @@ enum errorCode stack_data_dump(FILE* stream, const struct Stack* stack, stackDum
     }
     color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%p", stack->data);
     color_putc(stream, COLOR_BLUE, STYLE_BOLD, ']');
+    if (stack_data_inline(stack)) color_fprintf(stream, COLOR_CYAN, STYLE_BOLD, " inline");
+    if (stack->bufferRefs) color_fprintf(stream, COLOR_CYAN, STYLE_BOLD, " shared(%lu references)", *stack->bufferRefs);
     fprintf(stream, "\n");
 
     if (mode == FULL)
@@ -66,7 +384,8 @@ enum errorCode stack_data_dump(FILE* stream, const struct Stack* stack, stackDum
         #ifdef USE_CANARY_PROTECTION
 
         color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, "left data canary");
-        fprintf(stream, " = %llx\n", *((canary_t*) stack->data));
+        if (stack->storage == STORAGE_GUARDED) fprintf(stream, " = guard page\n");
+        else                                   fprintf(stream, " = %llx\n", *((canary_t*) stack->data));
 
         #endif
     }
@@ -75,61 +394,226 @@ enum errorCode stack_data_dump(FILE* stream, const struct Stack* stack, stackDum
     if (mode == FULL) outputSize = stack->capacity;
     else outputSize = stack->size;
 
-    for (size_t i = 0; i < outputSize; i++)
+    // Tail of incremental stack above poisoned isn't filled yet
+    if (stack->storage == STORAGE_INCREMENTAL && outputSize > stack->migration.poisoned) outputSize = stack->migration.poisoned;
+
+    #ifdef USE_CANARY_PROTECTION
+    const elem_t* data = (const elem_t*) ((const canary_t*) stack->data + 1);
+    #else
+    const elem_t* data = stack->data;
+    #endif
+
+    // Elements below pending are still in old buffer of incremental stack
+    size_t pending = stack->migration.pending;
+
+    if (pending && stack->migration.oldData)
     {
-        if (i < stack->size) 
-        {
-            color_putc(stream, COLOR_CYAN, STYLE_BOLD, '*');
-        }
-        else if (i == stack->size)
-        {
-            color_putc(stream, COLOR_CYAN, STYLE_BOLD, '>');
-        }
-        else
-            putc(' ', stream);
-        color_putc(stream, COLOR_YELLOW, STYLE_BOLD, '[');
-        fprintf(stream, "%lu", i);
-        color_putc(stream, COLOR_YELLOW, STYLE_BOLD, ']');
-        fprintf(stream, " = ");
-        
         #ifdef USE_CANARY_PROTECTION
+        const elem_t* oldData = (const elem_t*) ((const canary_t*) stack->migration.oldData + 1);
+        #else
+        const elem_t* oldData = stack->migration.oldData;
+        #endif
 
-        if (((elem_t*) ((canary_t*) stack->data + 1))[i] == ELEM_T_POISON)
-        {
-            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "POISON\n");
-        }
-        else
+        print_elements(stream, oldData, 0, (pending < outputSize) ? pending : outputSize, stack->size, mode);
+    }
+    else pending = 0;
+
+    if (outputSize > pending) print_elements(stream, data + pending, pending, outputSize - pending, stack->size, mode);
+    
+    if (mode == FULL)
+    {
+        #ifdef USE_CANARY_PROTECTION
+
+        color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, "right data canary");
+        if (stack->storage == STORAGE_GUARDED) fprintf(stream, " = guard page\n");
+        else fprintf(stream, " = %llx\n", *((canary_t*) (((elem_t*) ((canary_t*) stack->data + 1)) + stack->capacity)));
+
+        #endif
+    }
+
+    return NO_ERRORS;
+}
+
+static enum errorCode segmented_data_dump(FILE* stream, const struct Stack* stack, stackDumpMode mode)
+{
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "chunks");
+    fprintf(stream, " = %lu", stack->capacity / STACK_CHUNK_CAPACITY);
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, " spare");
+    color_putc(stream, COLOR_BLUE, STYLE_BOLD, '[');
+    color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%p", (void*) stack->spareChunk);
+    color_putc(stream, COLOR_BLUE, STYLE_BOLD, ']');
+    fprintf(stream, "\n");
+
+    if (!stack->topChunk) 
+    {
+        color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "top chunk");
+        color_putc(stream, COLOR_BLUE, STYLE_BOLD, '[');
+        color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "NULL");
+        color_putc(stream, COLOR_BLUE, STYLE_BOLD, ']');
+        fprintf(stream, "\n");
+        return NO_STACK_DATA_PTR;
+    }
+
+    // Chunks are linked downwards only, they are collected to be printed from the bottom
+    size_t chunkCount = 0;
+    for (const struct StackChunk* chunk = stack->topChunk; chunk; chunk = chunk->prev) chunkCount++;
+
+    const struct StackChunk** chunks = (const struct StackChunk**) calloc(chunkCount, sizeof(const struct StackChunk*));
+    if (no_ptr(stream, chunks, NO_MEMORY, __FILE__, __func__, __LINE__)) return NO_MEMORY;
+
+    size_t slot = chunkCount;
+    for (const struct StackChunk* chunk = stack->topChunk; chunk; chunk = chunk->prev) chunks[--slot] = chunk;
+
+    size_t index = 0;
+    for (size_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+    {
+        const struct StackChunk* chunk = chunks[chunkIndex];
+
+        if (mode == SHORT && index >= stack->size) break;
+
+        color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "chunk");
+        color_putc(stream, COLOR_BLUE, STYLE_BOLD, '[');
+        color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%p", (const void*) chunk);
+        color_putc(stream, COLOR_BLUE, STYLE_BOLD, ']');
+        if (mode == FULL && chunk->refs > 1) fprintf(stream, " shared(%lu references)", chunk->refs);
+        fprintf(stream, "\n");
+
+        #ifdef USE_CANARY_PROTECTION
+
+        if (mode == FULL)
         {
-            fprintf(stream, "%d\n", ((elem_t*) ((canary_t*) stack->data + 1))[i]);
+            color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, "left chunk canary");
+            fprintf(stream, " = %llx\n", chunk->leftCanary);
         }
 
-        #else
+        #endif
+
+        size_t count = STACK_CHUNK_CAPACITY;
+        if (mode == SHORT && stack->size - index < count) count = stack->size - index;
+
+        print_elements(stream, chunk->data, index, count, stack->size, mode);
+        index += STACK_CHUNK_CAPACITY;
+
+        #ifdef USE_CANARY_PROTECTION
 
-        if (stack->data[i] == ELEM_T_POISON)
+        if (mode == FULL)
         {
-            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "POISON\n");
+            color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, "right chunk canary");
+            fprintf(stream, " = %llx\n", chunk->rightCanary);
         }
-        else
+
+        #endif
+    }
+
+    free(chunks);
+
+    return NO_ERRORS;
+}
+
+void print_elements(FILE* stream, const elem_t* values, size_t first, size_t count, size_t size, stackDumpMode mode)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t index = first + i;
+
+        if (mode == FULL && index > size && values[i] == ELEM_T_POISON)
         {
-            fprintf(stream, "%d\n", stack->data[i]);
+            size_t run = 1;
+            while (i + run < count && values[i + run] == ELEM_T_POISON) run++;
+
+            if (run >= STACK_DUMP_POISON_RUN)
+            {
+                print_poison_run(stream, index, run);
+
+                i += run - 1;
+                continue;
+            }
         }
 
-        #endif
+        print_element(stream, index, size, values[i]);
     }
-    
-    if (mode == FULL)
+}
+
+void print_poison_run(FILE* stream, size_t first, size_t count)
+{
+    putc(' ', stream);
+    color_putc(stream, COLOR_YELLOW, STYLE_BOLD, '[');
+    fprintf(stream, "%lu..%lu", first, first + count - 1);
+    color_putc(stream, COLOR_YELLOW, STYLE_BOLD, ']');
+    fprintf(stream, " = ");
+    color_fprintf(stream, COLOR_RED, STYLE_BOLD, "POISON");
+    fprintf(stream, "(%lu elements)\n", count);
+}
+
+static void print_element(FILE* stream, size_t index, size_t size, elem_t value)
+{
+    if (index < size) 
     {
-        #ifdef USE_CANARY_PROTECTION
+        color_putc(stream, COLOR_CYAN, STYLE_BOLD, '*');
+    }
+    else if (index == size)
+    {
+        color_putc(stream, COLOR_CYAN, STYLE_BOLD, '>');
+    }
+    else
+        putc(' ', stream);
+    color_putc(stream, COLOR_YELLOW, STYLE_BOLD, '[');
+    fprintf(stream, "%lu", index);
+    color_putc(stream, COLOR_YELLOW, STYLE_BOLD, ']');
+    fprintf(stream, " = ");
 
-        color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, "right data canary");
-        fprintf(stream, " = %llx\n", *((canary_t*) (((elem_t*) ((canary_t*) stack->data + 1)) + stack->capacity)));
+    if (value == ELEM_T_POISON)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "POISON\n");
+    }
+    else
+    {
+        fprintf(stream, "%d\n", value);
+    }
+}
 
-        #endif
+#ifdef USE_HASH_PROTECTION
+
+static void print_corrupted_blocks(FILE* stream, const struct Stack* stack)
+{
+    size_t blocks[STACK_HASH_DUMP_BLOCKS] = {};
+    size_t corrupted = 0;
+
+    enum errorCode verdict = hash_tree_verify(stack, &corrupted, blocks, STACK_HASH_DUMP_BLOCKS);
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "corrupted blocks");
+
+    if (verdict == NO_MEMORY)
+    {
+        fprintf(stream, " = unknown(no memory for block hashes)\n");
+        return;
     }
 
-    return NO_ERRORS;
+    if (!corrupted)
+    {
+        if (verdict) fprintf(stream, " = none(hash tree root or data hash is damaged)\n");
+        else         fprintf(stream, " = none(restored)\n");
+
+        return;
+    }
+
+    fprintf(stream, " = %lu of %lu(%lu elements each)\n", corrupted, stack->hashLeaves, STACK_HASH_BLOCK);
+
+    for (size_t i = 0; i < corrupted && i < STACK_HASH_DUMP_BLOCKS; i++)
+    {
+        size_t from = blocks[i] * STACK_HASH_BLOCK;
+        size_t to   = from + STACK_HASH_BLOCK;
+
+        if (to > stack->size && from < stack->size) to = stack->size;
+
+        fprintf(stream, "    block %lu: elements [%lu, %lu)%s\n", blocks[i], from, to, (from >= stack->size) ? " above top" : "");
+    }
+
+    if (corrupted > STACK_HASH_DUMP_BLOCKS) fprintf(stream, "    ...\n");
 }
 
+#endif
+
 void print_error(FILE* stream, enum errorCode error) //TODO assert
 {
     #define PRINT_ERROR(error, errorCod, message) do{                   \
@@ -153,6 +637,9 @@ void print_error(FILE* stream, enum errorCode error) //TODO assert
     PRINT_ERROR(error, RIGHT_DATA_CANARY_BAD_VALUE,         "Right data canary has a bad value!\n");
     PRINT_ERROR(error, BAD_STRUCT_HASH,                     "Bad struct hash!\n");
     PRINT_ERROR(error, BAD_DATA_HASH,                       "Bad data hash!\n");
+    PRINT_ERROR(error, BAD_HASH_BACKEND,                    "Unknown hash backend!\n");
+    PRINT_ERROR(error, POISON_OVERWRITTEN,                  "Element above top of stack was overwritten!\n");
+    PRINT_ERROR(error, FILE_ERROR,                          "Snapshot file or dump record can't be written or read(or has other format)!\n");
 
     #undef PRINT_ERROR
 }
@@ -173,19 +660,26 @@ enum errorCode print_stack_homeland(FILE* stream, const struct Stack* stack)
 { 
     if (no_ptr(stream, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
 
+    return print_homeland(stream, stack, &stack->stackHomeland);
+}
+
+enum errorCode print_homeland(FILE* stream, const void* stack, const struct StackHomeland* homeland)
+{
+    if (no_ptr(stream, homeland, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
     color_fprintf(stream, COLOR_BLUE, STYLE_BOLD, "Stack: ");
 
     color_putc(stream, COLOR_YELLOW, STYLE_BOLD, '[');
     color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%p", stack);
     color_putc(stream, COLOR_YELLOW, STYLE_BOLD, ']');
 
-    fprintf(stream, " \"%s\" initialised in file: ", stack->stackHomeland.stackName);
+    fprintf(stream, " \"%s\" initialised in file: ", homeland->stackName);
     
-    color_fprintf(stream, COLOR_BLUE, STYLE_BOLD, "%s ", stack->stackHomeland.file);
+    color_fprintf(stream, COLOR_BLUE, STYLE_BOLD, "%s ", homeland->file);
     fprintf(stream, "function: ");
-    color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, "%s(", stack->stackHomeland.function);
-    color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%d", stack->stackHomeland.line);
+    color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, "%s(", homeland->function);
+    color_fprintf(stream, COLOR_DEFAULT, STYLE_INVERT_C, "%d", homeland->line);
     color_fprintf(stream, COLOR_YELLOW, STYLE_BOLD, ")\n");
 
     return NO_ERRORS;
-}
\ No newline at end of file
+}
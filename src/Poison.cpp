@@ -0,0 +1,205 @@
+/**
+ * @file
+ * @brief Poison fill and poison scan kernels of stack data(SSE2/AVX2 with runtime dispatch)
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "Stack.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define POISON_X86
+#include <immintrin.h>
+#endif
+
+/// Shorter ranges don't fill one vector and are handled by plain loop
+static const size_t POISON_VECTOR_MIN = 32 / sizeof(elem_t);
+
+typedef void   (*poison_fill_t)(elem_t* data, size_t count);
+typedef size_t (*poison_find_t)(const elem_t* data, size_t count);
+
+/// @brief Kernels chosen for CPU of this process
+struct PoisonDispatch
+{
+    poison_fill_t fill;     ///< Implementation of poison_fill
+    poison_find_t find;     ///< Implementation of poison_find
+};
+
+static const struct PoisonDispatch* poison_dispatch();
+static struct PoisonDispatch poison_dispatch_select();
+
+static void   poison_fill_portable(elem_t* data, size_t count);
+static size_t poison_find_portable(const elem_t* data, size_t count);
+
+#ifdef POISON_X86
+
+// Vector kernels compare bytes against ELEM_T_POISON repeated over whole vector
+static_assert(32 % sizeof(elem_t) == 0, "vector poison kernels need elem_t size dividing 32 bytes");
+
+/// @brief ELEM_T_POISON repeated over one AVX2 vector(SSE2 kernels use its first half)
+struct PoisonPattern
+{
+    elem_t elements[32 / sizeof(elem_t)];
+};
+
+static constexpr struct PoisonPattern poison_make_pattern();
+
+static void   poison_fill_sse2(elem_t* data, size_t count);
+static size_t poison_find_sse2(const elem_t* data, size_t count);
+static void   poison_fill_avx2(elem_t* data, size_t count);
+static size_t poison_find_avx2(const elem_t* data, size_t count);
+
+#endif
+
+void poison_fill(elem_t* data, size_t count)
+{
+    if (count < POISON_VECTOR_MIN) poison_fill_portable(data, count);
+    else                           poison_dispatch()->fill(data, count);
+}
+
+size_t poison_find(const elem_t* data, size_t count)
+{
+    if (count < POISON_VECTOR_MIN) return poison_find_portable(data, count);
+
+    return poison_dispatch()->find(data, count);
+}
+
+static const struct PoisonDispatch* poison_dispatch()
+{
+    static const struct PoisonDispatch dispatch = poison_dispatch_select();
+
+    return &dispatch;
+}
+
+static struct PoisonDispatch poison_dispatch_select()
+{
+    struct PoisonDispatch dispatch = {poison_fill_portable, poison_find_portable};
+
+    #ifdef POISON_X86
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        dispatch.fill = poison_fill_avx2;
+        dispatch.find = poison_find_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        dispatch.fill = poison_fill_sse2;
+        dispatch.find = poison_find_sse2;
+    }
+
+    #endif
+
+    return dispatch;
+}
+
+static void poison_fill_portable(elem_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) data[i] = ELEM_T_POISON;
+}
+
+static size_t poison_find_portable(const elem_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (data[i] != ELEM_T_POISON) return i;
+    }
+
+    return count;
+}
+
+#ifdef POISON_X86
+
+static constexpr struct PoisonPattern poison_make_pattern()
+{
+    struct PoisonPattern pattern = {};
+
+    for (size_t i = 0; i < sizeof(pattern.elements) / sizeof(elem_t); i++) pattern.elements[i] = ELEM_T_POISON;
+
+    return pattern;
+}
+
+static constexpr struct PoisonPattern POISON_PATTERN = poison_make_pattern();
+
+__attribute__((target("sse2")))
+static void poison_fill_sse2(elem_t* data, size_t count)
+{
+    const size_t step = sizeof(__m128i) / sizeof(elem_t);
+
+    const __m128i poison = _mm_loadu_si128((const __m128i*) POISON_PATTERN.elements);
+
+    size_t i = 0;
+    for (; i + step <= count; i += step) _mm_storeu_si128((__m128i*) (data + i), poison);
+
+    poison_fill_portable(data + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static size_t poison_find_sse2(const elem_t* data, size_t count)
+{
+    const size_t step = sizeof(__m128i) / sizeof(elem_t);
+
+    const __m128i poison = _mm_loadu_si128((const __m128i*) POISON_PATTERN.elements);
+
+    // Vector loop only skips all-poison blocks, first bad element is found by the scalar tail
+    size_t i = 0;
+    for (; i + step <= count; i += step)
+    {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (data + i)), poison);
+        if (_mm_movemask_epi8(equal) != 0xFFFF) break;
+    }
+
+    // Tail shorter than vector is checked by last vector of range(overlapping checked part)
+    if (i < count && count - i < step && count >= step)
+    {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (data + count - step)), poison);
+        if (_mm_movemask_epi8(equal) == 0xFFFF) return count;
+    }
+
+    return i + poison_find_portable(data + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void poison_fill_avx2(elem_t* data, size_t count)
+{
+    const size_t step = sizeof(__m256i) / sizeof(elem_t);
+
+    const __m256i poison = _mm256_loadu_si256((const __m256i*) POISON_PATTERN.elements);
+
+    size_t i = 0;
+    for (; i + step <= count; i += step) _mm256_storeu_si256((__m256i*) (data + i), poison);
+
+    poison_fill_portable(data + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static size_t poison_find_avx2(const elem_t* data, size_t count)
+{
+    const size_t step = sizeof(__m256i) / sizeof(elem_t);
+
+    const __m256i poison = _mm256_loadu_si256((const __m256i*) POISON_PATTERN.elements);
+
+    size_t i = 0;
+    for (; i + 2 * step <= count; i += 2 * step)
+    {
+        __m256i equal = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (data + i)),        poison),
+                                         _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (data + i + step)), poison));
+        if (_mm256_movemask_epi8(equal) != -1) break;
+    }
+
+    // Tail shorter than two vectors is checked by first and last vectors of it(overlapping each other or checked part)
+    if (i < count && count - i < 2 * step && count >= step)
+    {
+        const elem_t* first = (count - i >= step) ? data + i : data + count - step;
+
+        __m256i equal = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) first),               poison),
+                                         _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (data + count - step)), poison));
+        if (_mm256_movemask_epi8(equal) == -1) return count;
+    }
+
+    return i + poison_find_portable(data + i, count - i);
+}
+
+#endif
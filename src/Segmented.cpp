@@ -0,0 +1,304 @@
+/**
+ * @file
+ * @brief Segmented storage of stack: linked list of fixed-size chunks
+ * @details Chunks are linked downwards only and counted by references(stack top pointers and prev pointers of chunks
+ * above), so that clones share them as persistent list. Chunk that is about to be written is copied if it is shared.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CallSiteProfile.h"
+#include "Stack.h"
+#include "Verifier.h"
+
+static struct StackChunk* chunk_alloc(const struct Stack* stack);
+static struct StackChunk* chunk_take(struct Stack* stack);
+static void chunk_release(struct Stack* stack);
+static void chunk_free(struct Stack* stack, struct StackChunk* chunk);
+static struct StackChunk* chunk_own_top(struct Stack* stack);
+
+enum errorCode segmented_ctor(struct Stack* stack)
+{
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    stack->data       = NULL;
+    stack->spareChunk = NULL;
+    stack->topChunk   = chunk_alloc(stack);
+
+    if (!stack->topChunk) return NO_MEMORY;
+
+    stack->capacity = STACK_CHUNK_CAPACITY;
+
+    return NO_ERRORS;
+}
+
+void segmented_dtor(struct Stack* stack)
+{
+    // Chunks below the first one still referenced by another stack belong to it too
+    struct StackChunk* chunk = stack->topChunk;
+    while (chunk && --chunk->refs == 0)
+    {
+        struct StackChunk* prev = chunk->prev;
+        chunk_free(stack, chunk);
+        chunk = prev;
+    }
+
+    chunk_free(stack, stack->spareChunk);
+
+    stack->topChunk   = NULL;
+    stack->spareChunk = NULL;
+}
+
+enum errorCode segmented_push(struct Stack* stack, elem_t value)
+{
+    size_t position = stack->size % STACK_CHUNK_CAPACITY;
+
+    if (position == 0 && stack->size != 0)
+    {
+        if (!chunk_take(stack)) return NO_MEMORY;
+    }
+    else if (!chunk_own_top(stack)) return NO_MEMORY;
+
+    stack->topChunk->data[position] = value;
+    stack->size++;
+
+    return NO_ERRORS;
+}
+
+elem_t segmented_pop(struct Stack* stack)
+{
+    stack->size--;
+
+    size_t position = stack->size % STACK_CHUNK_CAPACITY;
+
+    elem_t ret = stack->topChunk->data[position];
+
+    if (stack->protection >= PROTECTION_CANARY)
+    {
+        // Without own copy of shared chunk element stays unpoisoned and verification reports it
+        if (chunk_own_top(stack)) stack->topChunk->data[position] = ELEM_T_POISON;
+        else                      stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
+    }
+
+    if (position == 0 && stack->size != 0) chunk_release(stack);
+
+    return ret;
+}
+
+enum errorCode segmented_push_n(struct Stack* stack, const elem_t* values, size_t count)
+{
+    while (count)
+    {
+        size_t position = stack->size % STACK_CHUNK_CAPACITY;
+
+        if (position == 0 && stack->size != 0)
+        {
+            if (!chunk_take(stack)) return NO_MEMORY;
+        }
+        else if (!chunk_own_top(stack)) return NO_MEMORY;
+
+        size_t part = STACK_CHUNK_CAPACITY - position;
+        if (part > count) part = count;
+
+        memcpy(stack->topChunk->data + position, values, part * sizeof(elem_t));
+
+        stack->size += part;
+        values      += part;
+        count       -= part;
+    }
+
+    return NO_ERRORS;
+}
+
+void segmented_pop_n(struct Stack* stack, elem_t* values, size_t count)
+{
+    // Elements are copied from the top, so values are filled from the end
+    while (count)
+    {
+        size_t position = (stack->size - 1) % STACK_CHUNK_CAPACITY;
+
+        size_t part = position + 1;
+        if (part > count) part = count;
+
+        stack->size -= part;
+        count       -= part;
+
+        memcpy(values + count, stack->topChunk->data + position + 1 - part, part * sizeof(elem_t));
+
+        if (stack->protection >= PROTECTION_CANARY)
+        {
+            if (chunk_own_top(stack)) poison_fill(stack->topChunk->data + position + 1 - part, part);
+            else                      stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
+        }
+
+        if (stack->size % STACK_CHUNK_CAPACITY == 0 && stack->size != 0) chunk_release(stack);
+    }
+}
+
+void segmented_trim(struct Stack* stack)
+{
+    chunk_free(stack, stack->spareChunk);
+    stack->spareChunk = NULL;
+}
+
+void segmented_clone(struct Stack* clone)
+{
+    // Clone references top chunk, chunks below are referenced by it already
+    if (clone->topChunk) clone->topChunk->refs++;
+
+    clone->spareChunk = NULL;
+}
+
+enum errorCode segmented_check(const struct Stack* stack, bool full)
+{
+    int errors = NO_ERRORS;
+
+    if (!stack->topChunk) return NO_STACK_DATA_PTR;
+
+    if (stack->size > stack->capacity) errors |= SIZE_OUT_OF_CAPACITY;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    if (stack->protection >= PROTECTION_CANARY)
+    {
+        for (const struct StackChunk* chunk = stack->topChunk; chunk; chunk = full ? chunk->prev : NULL)
+        {
+            if (chunk->leftCanary  != CANARY_T_DEFAULT) errors |= LEFT_DATA_CANARY_BAD_VALUE;
+            if (chunk->rightCanary != CANARY_T_DEFAULT) errors |= RIGHT_DATA_CANARY_BAD_VALUE;
+        }
+    }
+
+    #else
+
+    (void) full;
+
+    #endif
+
+    return (errorCode) errors;
+}
+
+size_t segmented_poison_find(const struct Stack* stack, bool full)
+{
+    // Top chunk holds elements [capacity - STACK_CHUNK_CAPACITY, capacity)
+    size_t position = stack->size - (stack->capacity - STACK_CHUNK_CAPACITY);
+
+    size_t count = STACK_CHUNK_CAPACITY - position;
+    if (!full && count > POISON_CHECK_WINDOW) count = POISON_CHECK_WINDOW;
+
+    size_t index = poison_find(stack->topChunk->data + position, count);
+    if (index != count) return stack->size + index;
+
+    if (full && stack->spareChunk)
+    {
+        index = poison_find(stack->spareChunk->data, STACK_CHUNK_CAPACITY);
+        if (index != STACK_CHUNK_CAPACITY) return stack->capacity + index;
+    }
+
+    return POISON_INTACT;
+}
+
+static struct StackChunk* chunk_alloc(const struct Stack* stack)
+{
+    struct StackChunk* chunk = (struct StackChunk*) stack->allocator->allocate(stack->allocator, sizeof(struct StackChunk));
+    if (!chunk) return NULL;
+
+    chunk->prev = NULL;
+    chunk->refs = 1;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    chunk->leftCanary  = CANARY_T_DEFAULT;
+    chunk->rightCanary = CANARY_T_DEFAULT;
+
+    #endif
+
+    if (stack->protection >= PROTECTION_CANARY) poison_fill(chunk->data, STACK_CHUNK_CAPACITY);
+
+    return chunk;
+}
+
+/// @brief Links spare or new chunk over top chunk
+static struct StackChunk* chunk_take(struct Stack* stack)
+{
+    STACK_STATS_TIMER(takeStart);
+    CALL_SITE_TIMER(takeSiteStart);
+
+    struct StackChunk* chunk = stack->spareChunk;
+
+    if (chunk) stack->spareChunk = NULL;
+    else       chunk = chunk_alloc(stack);
+
+    if (!chunk) return NULL;
+
+    // Reference of stack to old top chunk moves to new one
+    chunk->prev = stack->topChunk;
+    chunk->refs = 1;
+
+    stack->topChunk  = chunk;
+    stack->capacity += STACK_CHUNK_CAPACITY;
+
+    STACK_STATS_ADD(stack, grows, 1);
+    STACK_STATS_LATENCY(stack, reallocLatency, takeStart);
+    CALL_SITE_REALLOC(takeSiteStart);
+    STACK_STATS_PEAK(stack);
+
+    return chunk;
+}
+
+/// @brief Unlinks empty top chunk, it becomes spare(previous spare is freed) unless another stack references it
+static void chunk_release(struct Stack* stack)
+{
+    STACK_STATS_TIMER(releaseStart);
+    CALL_SITE_TIMER(releaseSiteStart);
+
+    struct StackChunk* chunk = stack->topChunk;
+
+    stack->topChunk  = chunk->prev;
+    stack->capacity -= STACK_CHUNK_CAPACITY;
+
+    if (--chunk->refs == 0)
+    {
+        // Reference of released chunk to the one below moves to stack
+        chunk->prev = NULL;
+
+        chunk_free(stack, stack->spareChunk);
+        stack->spareChunk = chunk;
+    }
+    else stack->topChunk->refs++;
+
+    STACK_STATS_ADD(stack, shrinks, 1);
+    STACK_STATS_LATENCY(stack, reallocLatency, releaseStart);
+    CALL_SITE_REALLOC(releaseSiteStart);
+}
+
+static void chunk_free(struct Stack* stack, struct StackChunk* chunk)
+{
+    if (chunk) STACK_RETIRE_BLOCK(stack, stack->allocator, chunk, sizeof(struct StackChunk));
+}
+
+/// @brief Replaces shared top chunk by private copy, returns top chunk or NULL if copy can't be allocated
+static struct StackChunk* chunk_own_top(struct Stack* stack)
+{
+    struct StackChunk* chunk = stack->topChunk;
+    if (chunk->refs == 1) return chunk;
+
+    STACK_STATS_TIMER(copyStart);
+    CALL_SITE_TIMER(copySiteStart);
+
+    struct StackChunk* copy = (struct StackChunk*) stack->allocator->allocate(stack->allocator, sizeof(struct StackChunk));
+    if (!copy) return NULL;
+
+    memcpy(copy, chunk, sizeof(struct StackChunk));
+
+    copy->refs = 1;
+    if (copy->prev) copy->prev->refs++;
+
+    chunk->refs--;
+    stack->topChunk = copy;
+
+    STACK_STATS_LATENCY(stack, reallocLatency, copyStart);
+    CALL_SITE_REALLOC(copySiteStart);
+
+    return copy;
+}
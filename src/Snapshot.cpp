@@ -0,0 +1,348 @@
+/**
+ * @file
+ * @brief Binary snapshots of stacks: stack_save writes header and contiguous buffer, stack_load maps file copy-on-write
+*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+#include "Verifier.h"
+
+static size_t snapshot_capacity(const struct Stack* stack);
+static void snapshot_gather(const struct Stack* stack, char* buffer, size_t capacity);
+static struct StackSnapshotHeader snapshot_header(const struct Stack* stack, size_t capacity, const char* buffer);
+static enum errorCode snapshot_check_header(const struct StackSnapshotHeader* header, size_t fileSize);
+static enum errorCode snapshot_map(const char* path, struct StackSnapshotHeader* header, char** map, size_t* mapSize);
+static enum errorCode snapshot_install(struct Stack* stack, const struct StackSnapshotHeader* header, char* map, size_t mapSize);
+
+enum errorCode stack_save(struct Stack* stack, const char* path, FILE* stream, const char* file, int line, const char* func)
+{
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+    if (no_ptr(stream, path, FILE_ERROR, file, func, line)) return FILE_ERROR;
+
+    #ifndef NO_DEBUG
+
+    if (stack->protection != PROTECTION_OFF)
+    {
+        if (stack_verify(stack, stream, file, line, func)) return stack->stackErrors;
+    }
+
+    #endif
+
+    size_t capacity = snapshot_capacity(stack);
+    size_t bytes    = stack_buffer_size(capacity);
+
+    // Contiguous buffer is written as it is, other storages are gathered into contiguous layout first
+    const char* buffer   = (const char*) stack->data;
+    char*       gathered = NULL;
+
+    if (stack->storage == STORAGE_SEGMENTED || stack->storage == STORAGE_GUARDED || stack->storage == STORAGE_INCREMENTAL)
+    {
+        gathered = (char*) calloc(bytes, 1);
+        if (no_ptr(stream, gathered, NO_MEMORY, file, func, line)) return NO_MEMORY;
+
+        snapshot_gather(stack, gathered, capacity);
+        buffer = gathered;
+    }
+
+    struct StackSnapshotHeader header = snapshot_header(stack, capacity, buffer);
+
+    FILE* out = fopen(path, "wb");
+
+    // Gap between header and page-aligned buffer is left as file hole
+    bool written = out && fwrite(&header, sizeof(header), 1, out) == 1
+                       && fseek(out, (long) header.dataOffset, SEEK_SET) == 0
+                       && fwrite(buffer, 1, bytes, out) == bytes;
+
+    if (out && fclose(out)) written = false;
+
+    free(gathered);
+
+    if (!written)
+    {
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, FILE_ERROR);
+
+        return FILE_ERROR;
+    }
+
+    return NO_ERRORS;
+}
+
+enum errorCode stack_load(struct Stack* stack, const char* path, FILE* stream, const char* file, int line, const char* func)
+{
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+    if (no_ptr(stream, path, FILE_ERROR, file, func, line)) return FILE_ERROR;
+
+    struct StackSnapshotHeader header = {};
+    char*  map     = NULL;
+    size_t mapSize = 0;
+
+    enum errorCode error = snapshot_map(path, &header, &map, &mapSize);
+
+    if (error)
+    {
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, error);
+
+        return error;
+    }
+
+    // Stack is constructed with one-element buffer, which is replaced by mapped one
+    error = stack_ctor(stack, 1, (enum protectionLevel) header.protection, STORAGE_CONTIGUOUS, NULL, stream, file, line, func);
+
+    if (error)
+    {
+        munmap(map, mapSize);
+        return error;
+    }
+
+    error = snapshot_install(stack, &header, map, mapSize);
+
+    // Half-built stack owns mapping and registration already, its hash tree is incomplete, so it isn't verified
+    if (error)
+    {
+        stack->stackErrors = (errorCode) (stack->stackErrors | error);
+
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, error);
+
+        stack->protection = PROTECTION_OFF;
+        stack_dtor(stack, stream, file, line, func);
+
+        return error;
+    }
+
+    #ifndef NO_DEBUG
+
+    if (stack->protection == PROTECTION_OFF) return NO_ERRORS;
+
+    return stack_verify(stack, stream, file, line, func);
+
+    #else
+
+    return NO_ERRORS;
+
+    #endif
+}
+
+void snapshot_dtor(struct Stack* stack)
+{
+    // Buffer starts dataOffset bytes after mapping, which ends with buffer
+    if (stack->data) STACK_RETIRE_MAP(stack, (char*) stack->data + stack_buffer_size(stack->capacity) - stack->reservedBytes, stack->reservedBytes);
+
+    stack->data          = NULL;
+    stack->reservedBytes = 0;
+}
+
+/// @brief Replaces buffer of constructed stack with mapped snapshot and hashes it
+static enum errorCode snapshot_install(struct Stack* stack, const struct StackSnapshotHeader* header, char* map, size_t mapSize)
+{
+    // Registered stack gets mapping in place of its buffer
+    STACK_WRITE_SCOPE(stack);
+
+    if (!stack_data_inline(stack)) STACK_RETIRE_BLOCK(stack, stack->allocator, stack->data, stack_buffer_size(stack->capacity));
+
+    stack->data          = (elem_t*) (map + header->dataOffset);
+    stack->size          = header->size;
+    stack->capacity      = header->capacity;
+    stack->storage       = STORAGE_SNAPSHOT;
+    stack->reservedBytes = mapSize;
+    stack->shrinkSize    = stack->growth->shrink_size(stack->growth, stack->capacity);
+
+    STACK_STATS_PEAK(stack);
+
+    #ifdef USE_HASH_PROTECTION
+
+    stack->hashBackend = (enum hashBackend) header->hashBackend;
+
+    if (stack->protection >= PROTECTION_HASH) return calculate_hash(stack);
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+/// @brief Capacity of written buffer: contiguous one keeps its capacity, gathered one gets size + 1 elements
+static size_t snapshot_capacity(const struct Stack* stack)
+{
+    if (stack->storage != STORAGE_SEGMENTED && stack->storage != STORAGE_GUARDED && stack->storage != STORAGE_INCREMENTAL)
+    {
+        return stack->capacity;
+    }
+
+    size_t capacity = stack->size + 1;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    while ((capacity * sizeof(elem_t)) % (sizeof(canary_t)) != 0) capacity++;
+
+    #endif
+
+    return capacity;
+}
+
+/// @brief Copies elements of segmented, guarded or incremental stack into zeroed buffer with data canaries and poison above top
+static void snapshot_gather(const struct Stack* stack, char* buffer, size_t capacity)
+{
+    #ifdef USE_CANARY_PROTECTION
+
+    elem_t* data = (elem_t*) ((canary_t*) buffer + 1);
+
+    *((canary_t*) buffer)            = CANARY_T_DEFAULT;
+    *((canary_t*) (data + capacity)) = CANARY_T_DEFAULT;
+
+    #else
+
+    elem_t* data = (elem_t*) buffer;
+
+    #endif
+
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        // Top chunk holds elements [capacity - STACK_CHUNK_CAPACITY, capacity)
+        size_t start = stack->capacity;
+
+        for (const struct StackChunk* chunk = stack->topChunk; chunk; chunk = chunk->prev)
+        {
+            start -= STACK_CHUNK_CAPACITY;
+            if (start >= stack->size) continue;
+
+            size_t count = stack->size - start;
+            if (count > STACK_CHUNK_CAPACITY) count = STACK_CHUNK_CAPACITY;
+
+            memcpy(data + start, chunk->data, count * sizeof(elem_t));
+        }
+    }
+    else if (stack->storage == STORAGE_INCREMENTAL)
+    {
+        incremental_gather(stack, data);
+    }
+    else
+    {
+        #ifdef USE_CANARY_PROTECTION
+        memcpy(data, (const canary_t*) stack->data + 1, stack->size * sizeof(elem_t));
+        #else
+        memcpy(data, stack->data, stack->size * sizeof(elem_t));
+        #endif
+    }
+
+    poison_fill(data + stack->size, capacity - stack->size);
+}
+
+static struct StackSnapshotHeader snapshot_header(const struct Stack* stack, size_t capacity, const char* buffer)
+{
+    struct StackSnapshotHeader header = {};
+
+    memcpy(header.magic, STACK_SNAPSHOT_MAGIC, sizeof(header.magic));
+
+    header.version    = STACK_SNAPSHOT_VERSION;
+    header.elemSize   = sizeof(elem_t);
+    header.protection = stack->protection;
+    header.storage    = stack->storage;
+    header.size       = stack->size;
+    header.capacity   = capacity;
+    header.dataBytes  = stack_buffer_size(capacity);
+
+    // Buffer starts on page border, so that loaded elements don't share page with header
+    header.dataOffset = (sizeof(header) + stack_page_size() - 1) / stack_page_size() * stack_page_size();
+
+    #ifdef USE_CANARY_PROTECTION
+    header.canarySize = sizeof(canary_t);
+    #endif
+
+    #ifdef USE_HASH_PROTECTION
+
+    header.hashSize    = sizeof(hash_t);
+    header.hashBackend = stack->hashBackend;
+    header.dataHash    = hash_bytes(stack->hashBackend, buffer, stack_buffer_size(capacity));
+    header.headerHash  = hash_bytes(stack->hashBackend, &header, sizeof(header));
+
+    #else
+
+    (void) buffer;
+
+    #endif
+
+    return header;
+}
+
+static enum errorCode snapshot_check_header(const struct StackSnapshotHeader* header, size_t fileSize)
+{
+    if (memcmp(header->magic, STACK_SNAPSHOT_MAGIC, sizeof(header->magic))) return FILE_ERROR;
+
+    if (header->version != STACK_SNAPSHOT_VERSION || header->elemSize != sizeof(elem_t)) return FILE_ERROR;
+
+    #ifdef USE_CANARY_PROTECTION
+    if (header->canarySize != sizeof(canary_t)) return FILE_ERROR;
+    #else
+    if (header->canarySize != 0) return FILE_ERROR;
+    #endif
+
+    if (header->protection > PROTECTION_PARANOID || header->size >= header->capacity) return FILE_ERROR;
+
+    if (header->dataBytes != stack_buffer_size(header->capacity) || header->dataOffset < sizeof(*header) ||
+        header->dataOffset % sizeof(elem_t) || header->dataOffset + header->dataBytes > fileSize) return FILE_ERROR;
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (header->hashSize != sizeof(hash_t) || !hash_backend_name((enum hashBackend) header->hashBackend)) return FILE_ERROR;
+
+    struct StackSnapshotHeader unhashed = *header;
+    unhashed.headerHash = 0;
+
+    if (hash_bytes((enum hashBackend) header->hashBackend, &unhashed, sizeof(unhashed)) != header->headerHash) return BAD_DATA_HASH;
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+/// @brief Checks header and maps file from its start to end of buffer(private, writable), checks data hash
+static enum errorCode snapshot_map(const char* path, struct StackSnapshotHeader* header, char** map, size_t* mapSize)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return FILE_ERROR;
+
+    struct stat fileStat = {};
+
+    if (fstat(fd, &fileStat) || pread(fd, header, sizeof(*header), 0) != (ssize_t) sizeof(*header))
+    {
+        close(fd);
+        return FILE_ERROR;
+    }
+
+    enum errorCode error = snapshot_check_header(header, (size_t) fileStat.st_size);
+
+    if (error)
+    {
+        close(fd);
+        return error;
+    }
+
+    *mapSize = header->dataOffset + header->dataBytes;
+    *map     = (char*) mmap(NULL, *mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    // Mapping stays valid after file is closed
+    close(fd);
+
+    if (*map == MAP_FAILED) return NO_MEMORY;
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (hash_bytes((enum hashBackend) header->hashBackend, *map + header->dataOffset, header->dataBytes) != header->dataHash)
+    {
+        munmap(*map, *mapSize);
+        return BAD_DATA_HASH;
+    }
+
+    #endif
+
+    return NO_ERRORS;
+}
@@ -4,41 +4,113 @@
 */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "CallSiteProfile.h"
 #include "Color_output.h"
 #include "Stack.h"
+#include "Verifier.h"
+
+/**
+ * @brief Function checks stack like stack_verify but may skip O(capacity) data hash recalculation
+ * @param [in] checkData Recalculate block hashes of data from the scratch
+*/
+static enum errorCode stack_check(struct Stack* stack, bool checkData, FILE* stream, const char* file, int line, const char* func);
+
+/// @brief Size of contiguous buffer prefix(left data canary and count elements) in bytes
+static size_t buffer_prefix_size(size_t count);
+
+/// @brief Pop shrink border of stack: 0 for segmented and inline data that can't shrink
+static size_t stack_shrink_size(const struct Stack* stack);
+
+/// @brief Drops reference of stack to its heap buffer, the last reference frees it(bufferRefs becomes NULL)
+static void buffer_release(struct Stack* stack);
+static elem_t* buffer_reallocate(struct Stack* stack, size_t capacity);
+
+/// @brief Gives stack private copy of heap buffer it shares with clones
+static enum errorCode stack_own_buffer(struct Stack* stack, FILE* stream, const char* file, int line, const char* func);
+
+/// @brief Clones stack whose storage can't share buffer by copying elements into new stack
+static enum errorCode stack_clone_copy(struct Stack* clone, struct Stack* stack, FILE* stream, const char* file, int line, const char* func);
+
+#ifndef NO_DEBUG
+
+/// @brief Push and pop verify stack themselves unless background verifier does it for them
+static bool stack_hot_check(const struct Stack* stack);
+
+/// @brief Push and pop verify hashes of blocks with elements [first, size) before they change them
+static enum errorCode stack_check_blocks(struct Stack* stack, size_t first, FILE* stream, const char* file, int line, const char* func);
+
+#endif
 
 enum errorCode stack_verify(struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    CALL_SITE_SCOPE(CALL_SITE_VERIFY, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
+    return stack_check(stack, true, stream, file, line, func);
+}
+
+static enum errorCode stack_check(struct Stack* stack, bool checkData, FILE* stream, const char* file, int line, const char* func)
 {
     if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
 
-    #ifdef USE_HASH_PROTECTION
+    if (stack_check_errors(stack, checkData) == NO_STACK_PTR) return NO_STACK_PTR;
 
-    hash_t oldStructHash = stack->structHash;
-    hash_t oldDataHash   = stack->dataHash;
+    if (stack->stackErrors) stack_dump(stream, stack, file, func, line, FULL, DUMP_DEFAULT);
 
-    if (calculate_hash(stack)) return NO_STACK_PTR;
+    return stack->stackErrors;
+}
 
-    if (stack->structHash != oldStructHash)
-    {
-        stack->stackErrors = (errorCode) (stack->stackErrors | BAD_STRUCT_HASH);
-    }
+enum errorCode stack_check_errors(struct Stack* stack, bool checkData)
+{
+    STACK_STATS_TIMER(verifyStart);
+    CALL_SITE_TIMER(verifySiteStart);
+
+    #ifdef USE_HASH_PROTECTION
 
-    if (stack->dataHash != oldDataHash)
+    if (stack->protection >= PROTECTION_HASH)
     {
-        stack->stackErrors = (errorCode) (stack->stackErrors | BAD_DATA_HASH);
+        if ((unsigned) stack->hashBackend >= HASH_BACKEND_COUNT)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | BAD_HASH_BACKEND);
+        }
+
+        hash_t oldStructHash = stack->structHash;
+
+        if (calculate_struct_hash(stack)) return NO_STACK_PTR;
+
+        if (stack->structHash != oldStructHash)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | BAD_STRUCT_HASH);
+        }
+
+        // Hash tree is only compared, so that stack_dump finds the same corrupted blocks
+        if (checkData || stack->protection == PROTECTION_PARANOID)
+        {
+            size_t corrupted = 0;
+
+            stack->stackErrors = (errorCode) (stack->stackErrors | hash_tree_verify(stack, &corrupted, NULL, 0));
+        }
     }
 
     #endif
 
-    if (!stack->data)
+    if (stack->storage == STORAGE_SEGMENTED)
     {
-        stack->stackErrors = (errorCode) (stack->stackErrors | NO_STACK_DATA_PTR);
+        stack->stackErrors = (errorCode) (stack->stackErrors | segmented_check(stack, checkData || stack->protection == PROTECTION_PARANOID));
     }
-
-    if (stack->size >= stack->capacity)
-    {      
-        stack->stackErrors =(errorCode) (stack->stackErrors | SIZE_OUT_OF_CAPACITY);
+    else
+    {
+        if (!stack->data)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | NO_STACK_DATA_PTR);
+        }
+
+        if (stack->size >= stack->capacity)
+        {      
+            stack->stackErrors =(errorCode) (stack->stackErrors | SIZE_OUT_OF_CAPACITY);
+        }
     }
 
     if (stack->size == SIZE_POISON_VAL)
@@ -53,38 +125,67 @@ enum errorCode stack_verify(struct Stack* stack, FILE* stream, const char* file,
 
     #ifdef USE_CANARY_PROTECTION
 
-    if (stack->leftCanary != CANARY_T_DEFAULT)
+    if (stack->protection >= PROTECTION_CANARY)
     {
-        stack->stackErrors = (errorCode) (stack->stackErrors | LEFT_CANARY_BAD_VALUE);
+        if (stack->leftCanary != CANARY_T_DEFAULT)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | LEFT_CANARY_BAD_VALUE);
+        }
+
+        if (stack->rightCanary != CANARY_T_DEFAULT)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | RIGHT_CANARY_BAD_VALUE);
+        }
+
+        // Guarded buffer has guard pages instead of data canaries
+        if (stack->storage != STORAGE_SEGMENTED && stack->storage != STORAGE_GUARDED && stack->data)
+        {
+            if (*((canary_t*) stack->data) != CANARY_T_DEFAULT)
+            {
+                stack->stackErrors = (errorCode) (stack->stackErrors | LEFT_DATA_CANARY_BAD_VALUE);
+            }
+
+            if (*((canary_t*) ((elem_t*) ((canary_t*) stack->data + 1) + stack->capacity)) != CANARY_T_DEFAULT)
+            {
+                stack->stackErrors = (errorCode) (stack->stackErrors | RIGHT_DATA_CANARY_BAD_VALUE);
+            }
+        }
     }
 
-    if (stack->rightCanary != CANARY_T_DEFAULT)
-    {
-        stack->stackErrors = (errorCode) (stack->stackErrors | RIGHT_CANARY_BAD_VALUE);
-    }
+    #endif
 
-    if (*((canary_t*) stack->data) != CANARY_T_DEFAULT)
+    if (stack->storage == STORAGE_INCREMENTAL)
     {
-        stack->stackErrors = (errorCode) (stack->stackErrors | LEFT_DATA_CANARY_BAD_VALUE);
+        stack->stackErrors = (errorCode) (stack->stackErrors | incremental_check(stack));
     }
 
-    stack->data = (elem_t*) (((canary_t*) stack->data) + 1);
-    if (*((canary_t*) (stack->data + stack->capacity)) != CANARY_T_DEFAULT)
+    #ifdef USE_POISON_CHECK
+
+    // Scan only when size and capacity can be trusted, window scan keeps push/pop O(1)
+    const int brokenBounds = NO_STACK_DATA_PTR | SIZE_OUT_OF_CAPACITY | SIZE_NOT_VALID | CAPACITY_NOT_VALID;
+
+    if (stack->protection >= PROTECTION_CANARY && !(stack->stackErrors & brokenBounds))
     {
-        stack->stackErrors = (errorCode) (stack->stackErrors | RIGHT_DATA_CANARY_BAD_VALUE);
+        if (stack_poison_find(stack, checkData || stack->protection == PROTECTION_PARANOID) != POISON_INTACT)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | POISON_OVERWRITTEN);
+        }
     }
-    stack->data = (elem_t*) (((canary_t*) stack->data) - 1);
 
     #endif
 
-    if (stack->stackErrors) stack_dump(stream, stack, file, func, line, FULL);
-
+    STACK_STATS_ADD(stack, verifies, 1);
+    STACK_STATS_LATENCY(stack, verifyLatency, verifyStart);
+    CALL_SITE_VERIFY(verifySiteStart);
 
     return stack->stackErrors;
 }
 
-enum errorCode stack_ctor(struct Stack* stack, size_t capacity, FILE* stream, const char* file, int line, const char* func)
+enum errorCode stack_ctor(struct Stack* stack, size_t capacity, enum protectionLevel protection, enum storageMode storage,
+                          struct StackAllocator* allocator, FILE* stream, const char* file, int line, const char* func)
 {
+    CALL_SITE_SCOPE(CALL_SITE_CTOR, file, line, func);
+
     #ifndef NO_DEBUG
 
     if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
@@ -98,67 +199,241 @@ enum errorCode stack_ctor(struct Stack* stack, size_t capacity, FILE* stream, co
 
     #endif
 
+    #ifdef USE_HASH_PROTECTION
+    stack->hashBackend = hash_backend_default();
+    #else
+    if (protection > PROTECTION_CANARY) protection = PROTECTION_CANARY;
+    #endif
+
+    // Snapshot storage is made only by stack_load from constructed stack
+    if (storage == STORAGE_SNAPSHOT) storage = STORAGE_CONTIGUOUS;
+
+    stack->protection = protection;
+    stack->storage    = storage;
+    stack->size       = 0;
+    stack->growth     = &GROWTH_DOUBLE;
+    stack->allocator  = allocator ? allocator : &STACK_HEAP_ALLOCATOR;
+    stack->topChunk      = NULL;
+    stack->spareChunk    = NULL;
+    stack->reservedBytes = 0;
+    stack->bufferRefs    = NULL;
+    stack->migration     = {};
+
+    #ifdef USE_HASH_PROTECTION
+    stack->hashTree     = NULL;
+    stack->hashLeaves   = 0;
+    stack->hashTreeRefs = NULL;
+    #endif
+
+    #ifdef USE_BACKGROUND_VERIFY
+    stack->watch = NULL;
+    #endif
+
+    if (storage == STORAGE_SEGMENTED)
+    {
+        if (segmented_ctor(stack))
+        {
+            #ifndef NO_DEBUG
+            PRINT_LINE(stream, file, func, line);
+            print_error(stream, NO_MEMORY);
+            #endif
+
+            return NO_MEMORY;
+        }
+
+        stack->shrinkSize = 0;
+    }
+    else
+    {
+        #ifdef USE_CANARY_PROTECTION
+
+        while ((capacity * sizeof(elem_t)) % (sizeof(canary_t)) != 0) capacity++;
+
+        #endif
+
+        switch (storage)
+        {
+            case STORAGE_MAPPED:
+                capacity = mapped_ctor(stack, capacity);
+                break;
+
+            case STORAGE_GUARDED:
+                capacity = guarded_ctor(stack, capacity);
+                break;
+
+            case STORAGE_CONTIGUOUS:
+
+                #ifdef USE_INLINE_BUFFER
+
+                if (capacity <= STACK_INLINE_CAPACITY)
+                {
+                    capacity    = STACK_INLINE_CAPACITY;
+                    stack->data = (elem_t*) &stack->inlineBuffer;
+                    break;
+                }
+
+                #endif
+
+                [[fallthrough]];
+
+            case STORAGE_INCREMENTAL:
+            case STORAGE_SEGMENTED:
+            case STORAGE_SNAPSHOT:
+            default:
+                stack->data = (elem_t*) stack->allocator->allocate(stack->allocator, stack_buffer_size(capacity));
+                break;
+        }
+
+        #ifndef NO_DEBUG
+
+        if (no_ptr(stream, stack->data, NO_MEMORY, file, func, line)) return NO_MEMORY;
+
+        #endif
+
+        stack->capacity   = capacity;
+        stack->shrinkSize = stack_shrink_size(stack);
+
+        if (storage == STORAGE_INCREMENTAL) stack->migration.poisoned = capacity;
+
+        #ifdef USE_CANARY_PROTECTION
+
+        stack->data = (elem_t*) ((canary_t*) stack->data + 1);
+
+        // Guarded buffer has guard pages in place of data canaries
+        if (storage != STORAGE_GUARDED)
+        {
+            *((canary_t*) stack->data - 1) = CANARY_T_DEFAULT;
+
+            *((canary_t*) (stack->data + stack->capacity)) = CANARY_T_DEFAULT;
+        }
+
+        #endif
+
+        if (protection >= PROTECTION_CANARY) poison_fill(stack->data, capacity);
+
+        #ifdef USE_CANARY_PROTECTION
+
+        stack->data = (elem_t*) ((canary_t*) stack->data - 1);
+
+        #endif
+    }
+
+    #ifdef USE_STACK_STATS
+
+    // Allocated before hashing, struct hash covers the pointer
+    stack->stats = (struct StackStats*) stack->allocator->allocate(stack->allocator, sizeof(struct StackStats));
+    if (stack->stats) *stack->stats = {};
+    STACK_STATS_PEAK(stack);
+
+    #endif
+
     #ifdef USE_CANARY_PROTECTION
 
-    while ((capacity * sizeof(elem_t)) % (sizeof(canary_t)) != 0) capacity++;
+    stack->leftCanary  = CANARY_T_DEFAULT;
+    stack->rightCanary = CANARY_T_DEFAULT;
+
+    #endif
 
-    stack->data = (elem_t*) calloc(capacity*sizeof(elem_t) + 2*sizeof(canary_t), sizeof(char));
+    // Verifier skips registered stack until hashes are calculated and ctor returns
+    STACK_REGISTER_SCOPE(stack);
 
-    #else
+    #ifdef USE_HASH_PROTECTION
 
-    stack->data = (elem_t*) calloc(capacity, sizeof(elem_t));
+    if (protection >= PROTECTION_HASH)
+    {
+        if (calculate_hash(stack)) return NO_STACK_PTR;
+    }
 
     #endif
-    
+
     #ifndef NO_DEBUG
 
-    if (no_ptr(stream, stack->data, NO_MEMORY, file, func, line)) return NO_MEMORY;
+    if (protection == PROTECTION_OFF) return NO_ERRORS;
 
-    #endif
+    return stack_verify(stack, stream, file, line, func);
 
-    stack->capacity = capacity;
-    stack->size     = 0;
+    #else
 
-    #ifdef USE_CANARY_PROTECTION
+    return NO_ERRORS;
 
-    stack->data = (elem_t*) ((canary_t*) stack->data + 1);
+    #endif
+}
 
-    *((canary_t*) stack->data - 1) = CANARY_T_DEFAULT;
+enum errorCode stack_clone(struct Stack* clone, struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    CALL_SITE_SCOPE(CALL_SITE_CLONE, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
+    #ifndef NO_DEBUG
 
-    *((canary_t*) (stack->data + stack->capacity)) = CANARY_T_DEFAULT;
+    if (no_ptr(stream, clone, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
 
-    for (size_t i = 0; i < capacity; i++)
+    if (stack->protection != PROTECTION_OFF)
     {
-        stack->data[i] = ELEM_T_POISON;
+        if (stack_check(stack, false, stream, file, line, func)) return stack->stackErrors;
     }
 
-    stack->data = (elem_t*) ((canary_t*) stack->data - 1);
+    #endif
 
-    #else
+    if (stack->storage == STORAGE_MAPPED || stack->storage == STORAGE_GUARDED || stack->storage == STORAGE_SNAPSHOT ||
+        stack->storage == STORAGE_INCREMENTAL)
+    {
+        return stack_clone_copy(clone, stack, stream, file, line, func);
+    }
+
+    bool shareBuffer = (stack->storage == STORAGE_CONTIGUOUS && !stack_data_inline(stack));
 
-    for (size_t i = 0; i < capacity; i++)
+    if (shareBuffer && !stack->bufferRefs)
     {
-        stack->data[i] = ELEM_T_POISON;
+        stack->bufferRefs = (size_t*) stack->allocator->allocate(stack->allocator, sizeof(size_t));
+        if (no_ptr(stream, stack->bufferRefs, NO_MEMORY, file, func, line)) return NO_MEMORY;
+
+        *stack->bufferRefs = 1;
     }
 
+    struct StackHomeland homeland = clone->stackHomeland;
+
+    *clone = *stack;
+
+    clone->stackHomeland = homeland;
+    clone->stackErrors   = NO_ERRORS;
+
+    // Slot of original is copied with struct, clone gets its own one
+    STACK_REGISTER_SCOPE(clone);
+
+    if (shareBuffer) ++*clone->bufferRefs;
+    else if (stack->storage == STORAGE_SEGMENTED) segmented_clone(clone);
+
+    #ifdef USE_INLINE_BUFFER
+    else clone->data = (elem_t*) &clone->inlineBuffer;
     #endif
-    
-    #ifdef USE_CANARY_PROTECTION
 
-    stack->leftCanary  = CANARY_T_DEFAULT;
-    stack->rightCanary = CANARY_T_DEFAULT;
+    #ifdef USE_STACK_STATS
+
+    clone->stats = (struct StackStats*) clone->allocator->allocate(clone->allocator, sizeof(struct StackStats));
+    if (clone->stats) *clone->stats = {};
+    STACK_STATS_PEAK(clone);
 
     #endif
 
     #ifdef USE_HASH_PROTECTION
 
-    if (calculate_hash(stack)) return NO_STACK_PTR;
+    // Data hash depends on elements only, so clone keeps it and shares hash tree; struct hashes cover new pointers
+    if (hash_tree_clone(clone, stack)) return NO_MEMORY;
+
+    if (stack->protection >= PROTECTION_HASH)
+    {
+        if (calculate_struct_hash(stack) || calculate_struct_hash(clone)) return NO_STACK_PTR;
+    }
 
     #endif
 
     #ifndef NO_DEBUG
 
-    return stack_verify(stack, stream, file, line, func);
+    if (clone->protection == PROTECTION_OFF) return NO_ERRORS;
+
+    return stack_check(clone, false, stream, file, line, func);
 
     #else
 
@@ -169,11 +444,20 @@ enum errorCode stack_ctor(struct Stack* stack, size_t capacity, FILE* stream, co
 
 enum errorCode stack_dtor(struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
 {
+    CALL_SITE_SCOPE(CALL_SITE_DTOR, file, line, func);
+
+    // Verifier can't reach stack once it is out of registry
+    STACK_UNREGISTER(stack);
+
     #ifndef NO_DEBUG
 
     if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
 
-    if (stack_verify(stack, stream, file, line, func) == NO_STACK_PTR) return NO_STACK_PTR;
+    if (stack->protection != PROTECTION_OFF)
+    {
+        if (stack_verify(stack, stream, file, line, func) == NO_STACK_PTR) return NO_STACK_PTR;
+    }
+    else if (!stack->data && !stack->topChunk) stack->stackErrors = (errorCode) (stack->stackErrors | NO_STACK_DATA_PTR);
 
     if ((stack->stackErrors & NO_STACK_DATA_PTR)) 
     {
@@ -183,7 +467,33 @@ enum errorCode stack_dtor(struct Stack* stack, FILE* stream, const char* file, i
 
     #endif
 
-    free(stack->data);
+    if (stack->storage == STORAGE_SEGMENTED) segmented_dtor(stack);
+    if (stack->storage == STORAGE_INCREMENTAL) incremental_dtor(stack);
+
+    if (stack->storage == STORAGE_MAPPED)
+    {
+        mapped_dtor(stack);
+    }
+    else if (stack->storage == STORAGE_GUARDED)
+    {
+        guarded_dtor(stack);
+    }
+    else if (stack->storage == STORAGE_SNAPSHOT)
+    {
+        snapshot_dtor(stack);
+    }
+    else if (stack->data && !stack_data_inline(stack))
+    {
+        buffer_release(stack);
+    }
+
+    #ifdef USE_STACK_STATS
+
+    if (stack->stats) stack->allocator->deallocate(stack->allocator, stack->stats, sizeof(struct StackStats));
+    stack->stats = NULL;
+
+    #endif
+
     stack->data                    = NULL;
     stack->size                    = SIZE_POISON_VAL;
     stack->capacity                = CAPACITY_POISON_VAL;
@@ -201,6 +511,8 @@ enum errorCode stack_dtor(struct Stack* stack, FILE* stream, const char* file, i
 
     #ifdef USE_HASH_PROTECTION
 
+    hash_tree_dtor(stack);
+
     stack->dataHash   = 0;
     stack->structHash = 0;
 
@@ -211,101 +523,209 @@ enum errorCode stack_dtor(struct Stack* stack, FILE* stream, const char* file, i
 
 enum errorCode stack_realloc(struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
 {
+    CALL_SITE_SCOPE(CALL_SITE_REALLOC, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
     #ifndef NO_DEBUG
 
     if (no_ptr(stream, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
 
-    if (stack_verify(stack, stream, file, line, func)) return stack->stackErrors;
-
     #endif
 
-    if (stack->size + 1 == stack->capacity)
+    size_t newCapacity = stack->capacity;
+
+    if (stack->size + 1 >= stack->capacity)
     {
-        stack->capacity *= REALLOC_COEF;
+        newCapacity = stack->growth->grow(stack->growth, stack->capacity);
     }
-    else if (stack->size <= (size_t) stack->capacity / (2 * REALLOC_COEF))
+    else if (stack->size <= stack->shrinkSize)
     {
-        stack->capacity /= REALLOC_COEF;
+        newCapacity = stack->growth->shrink(stack->growth, stack->capacity);
     }
 
-    while ((stack->capacity * sizeof(elem_t)) % (sizeof(canary_t)) != 0) stack->capacity++;
-
-    #ifdef USE_CANARY_PROTECTION
-
-    stack->data = (elem_t*) realloc(stack->data, stack->capacity * sizeof(elem_t) + 2 * sizeof(canary_t));
+    return stack_resize(stack, newCapacity, stream, file, line, func);
+}
 
-    stack->data = (elem_t*) ((canary_t*) stack->data + 1);
-    for (size_t i = stack->size; i < stack->capacity; i++)
-    {
-        stack->data[i] = ELEM_T_POISON;
-    }
-    
-    *((canary_t*) (stack->data + stack->capacity)) = CANARY_T_DEFAULT;
-    stack->data = (elem_t*) ((canary_t*) stack->data - 1);
+enum errorCode stack_resize(struct Stack* stack, size_t capacity, FILE* stream, const char* file, int line, const char* func)
+{
+    CALL_SITE_SCOPE(CALL_SITE_RESIZE, file, line, func);
+    STACK_WRITE_SCOPE(stack);
 
-    #else
+    #ifndef NO_DEBUG
 
-    stack->data = (elem_t*) realloc(stack->data, stack->capacity * sizeof(elem_t));
+    if (no_ptr(stream, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
 
-    for (size_t i = stack->size; i < stack->capacity; i++)
+    // Elements are moved, not changed: block of top is rechecked like on push and pop, paranoid check compares all
+    if (stack->protection != PROTECTION_OFF)
     {
-        stack->data[i] = ELEM_T_POISON;
+        if (stack_check(stack, false, stream, file, line, func)) return stack->stackErrors;
+        if (stack_check_blocks(stack, stack->size - 1, stream, file, line, func)) return stack->stackErrors;
     }
 
     #endif
 
-    #ifdef USE_HASH_PROTECTION
+    // Chunks are linked and unlinked by push and pop themselves
+    if (stack->storage == STORAGE_SEGMENTED) return NO_ERRORS;
 
-    if (calculate_hash(stack)) return NO_STACK_PTR;
+    if (capacity <= stack->size) capacity = stack->size + 1;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    while ((capacity * sizeof(elem_t)) % (sizeof(canary_t)) != 0) capacity++;
 
     #endif
 
-    #ifndef NO_DEBUG
+    STACK_STATS_TIMER(reallocStart);
+    CALL_SITE_TIMER(reallocSiteStart);
 
-    return stack_verify(stack, stream, file, line, func);
+    // Tail [size, poisonFrom) is poisoned already, only the rest of buffer needs it
+    size_t  poisonFrom = stack->capacity;
+    elem_t* newData    = NULL;
 
-    #else
+    switch (stack->storage)
+    {
+        // Mapped buffer never moves: pages are committed or released in place
+        case STORAGE_MAPPED:
+            capacity = mapped_commit(stack, capacity);
+            newData  = capacity ? stack->data : NULL;
+            break;
+
+        case STORAGE_GUARDED:
+            poisonFrom = stack->size;
+            newData    = guarded_resize(stack, &capacity);
+            break;
+
+        // Snapshot mapping is left for buffer of allocator, stack becomes contiguous
+        case STORAGE_SNAPSHOT:
+            poisonFrom = stack->size;
+            newData    = (elem_t*) stack->allocator->allocate(stack->allocator, stack_buffer_size(capacity));
+
+            if (newData)
+            {
+                memcpy(newData, stack->data, buffer_prefix_size(stack->size));
+
+                snapshot_dtor(stack);
+                stack->storage = STORAGE_CONTIGUOUS;
+            }
+
+            break;
+
+        // Explicit resize completes migration and moves buffer at once
+        case STORAGE_INCREMENTAL:
+            incremental_finish(stack);
+
+            newData = buffer_reallocate(stack, capacity);
+            break;
+
+        case STORAGE_CONTIGUOUS:
+        case STORAGE_SEGMENTED:
+        default:
+
+            #ifdef USE_INLINE_BUFFER
+
+            // Small capacity moves elements into struct
+            if (capacity <= STACK_INLINE_CAPACITY)
+            {
+                if (stack_data_inline(stack)) return NO_ERRORS;
+
+                capacity   = STACK_INLINE_CAPACITY;
+                poisonFrom = stack->size;
+                newData    = (elem_t*) &stack->inlineBuffer;
+
+                memcpy(newData, stack->data, buffer_prefix_size(stack->size));
+                buffer_release(stack);
+                break;
+            }
+
+            // Bigger capacity moves them out to allocator
+            if (stack_data_inline(stack))
+            {
+                poisonFrom = stack->size;
+                newData    = (elem_t*) stack->allocator->allocate(stack->allocator, stack_buffer_size(capacity));
+
+                if (newData) memcpy(newData, stack->data, buffer_prefix_size(stack->size));
+                break;
+            }
+
+            #endif
+
+            // Buffer shared with clones is left to them, resized copy is private
+            if (stack->bufferRefs)
+            {
+                poisonFrom = stack->size;
+                newData    = (elem_t*) stack->allocator->allocate(stack->allocator, stack_buffer_size(capacity));
+
+                if (newData)
+                {
+                    memcpy(newData, stack->data, buffer_prefix_size(stack->size));
+                    buffer_release(stack);
+                }
+
+                break;
+            }
+
+            newData = buffer_reallocate(stack, capacity);
+            break;
+    }
 
-    return NO_ERRORS;
+    if (!newData)
+    {
+        stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
 
-    #endif
-}
+        #ifdef USE_HASH_PROTECTION
+        if (stack->protection >= PROTECTION_HASH) calculate_struct_hash(stack);
+        #endif
 
-enum errorCode stack_push(struct Stack* stack, elem_t value, FILE* stream, const char* file, int line, const char* func)
-{
-    #ifndef NO_DEBUG
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, NO_MEMORY);
 
-    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+        return NO_MEMORY;
+    }
 
-    if (stack_verify(stack, stream, file, line, func)) return stack->stackErrors;
+    if      (capacity > stack->capacity) STACK_STATS_ADD(stack, grows,   1);
+    else if (capacity < stack->capacity) STACK_STATS_ADD(stack, shrinks, 1);
 
-    #endif
+    stack->data       = newData;
+    stack->capacity   = capacity;
+    stack->shrinkSize = stack_shrink_size(stack);
 
-    if (stack->size + 1 == stack->capacity)
-    {
-        enum errorCode err = stack_realloc(stack, stream, file, line, func);
-        if (err) return err;
-    }
+    if (stack->storage == STORAGE_INCREMENTAL) stack->migration.poisoned = capacity;
 
     #ifdef USE_CANARY_PROTECTION
     stack->data = (elem_t*) ((canary_t*) stack->data + 1);
     #endif
 
-    stack->data[stack->size++] = value;
+    if (stack->protection >= PROTECTION_CANARY && poisonFrom < stack->capacity)
+    {
+        poison_fill(stack->data + poisonFrom, stack->capacity - poisonFrom);
+    }
 
     #ifdef USE_CANARY_PROTECTION
+
+    if (stack->storage != STORAGE_GUARDED) *((canary_t*) (stack->data + stack->capacity)) = CANARY_T_DEFAULT;
     stack->data = (elem_t*) ((canary_t*) stack->data - 1);
+
     #endif
 
+    STACK_STATS_LATENCY(stack, reallocLatency, reallocStart);
+    CALL_SITE_REALLOC(reallocSiteStart);
+    STACK_STATS_PEAK(stack);
+
     #ifdef USE_HASH_PROTECTION
 
-    if (calculate_hash(stack)) return NO_STACK_PTR;
+    // Hash tree covers elements only, new buffer and capacity are in struct hash
+    if (stack->protection >= PROTECTION_HASH)
+    {
+        if (calculate_struct_hash(stack)) return NO_STACK_PTR;
+    }
 
     #endif
 
     #ifndef NO_DEBUG
 
-    return stack_verify(stack, stream, file, line, func);
+    if (stack->protection == PROTECTION_OFF) return NO_ERRORS;
+
+    return stack_check(stack, false, stream, file, line, func);
 
     #else
 
@@ -314,63 +734,717 @@ enum errorCode stack_push(struct Stack* stack, elem_t value, FILE* stream, const
     #endif
 }
 
-elem_t stack_pop(struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
+enum errorCode stack_trim(struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
 {
+    CALL_SITE_SCOPE(CALL_SITE_TRIM, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
     #ifndef NO_DEBUG
 
     if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
 
-    if (stack_verify(stack, stream, file, line, func)) return stack->stackErrors;
-
     #endif
 
-    if (stack->size == 0)
-    {
-        #ifndef NO_DEBUG
+    if (!stack->growth->allowTrim) return NO_ERRORS;
 
-        stack->stackErrors = (errorCode) (stack->stackErrors | EMPTY_STACK);
-        stack_dump(stream, stack, file, func, line, FULL);
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        segmented_trim(stack);
 
         #ifdef USE_HASH_PROTECTION
-
-        calculate_hash(stack);
-        
-        #endif
-
+        if (stack->protection >= PROTECTION_HASH) return calculate_struct_hash(stack);
         #endif
 
-        return ELEM_T_POISON;
+        return NO_ERRORS;
     }
 
-    if (stack->size <= (size_t) stack->capacity / 4)
-    {
-        if (stack_realloc(stack, stream, file, line, func)) return ELEM_T_POISON;
-    }
+    if (stack->size + 1 == stack->capacity) return NO_ERRORS;
+
+    return stack_resize(stack, stack->size + 1, stream, file, line, func);
+}
 
-    stack->size--;
+bool stack_data_inline(const struct Stack* stack)
+{
+    #ifdef USE_INLINE_BUFFER
+
+    return stack->data == (const elem_t*) &stack->inlineBuffer;
+
+    #else
+
+    (void) stack;
+    return false;
 
-    #ifdef USE_CANARY_PROTECTION
-    stack->data = (elem_t*) ((canary_t*) stack->data + 1);
     #endif
+}
 
-    elem_t ret = stack->data[stack->size];
-    stack->data[stack->size] = ELEM_T_POISON;
+size_t stack_poison_find(const struct Stack* stack, bool full)
+{
+    if (stack->storage == STORAGE_SEGMENTED) return segmented_poison_find(stack, full);
 
     #ifdef USE_CANARY_PROTECTION
-    stack->data = (elem_t*) ((canary_t*) stack->data - 1);
+    const elem_t* data = (const elem_t*) ((const canary_t*) stack->data + 1);
+    #else
+    const elem_t* data = stack->data;
+    #endif
+
+    // Tail of incremental stack above poisoned isn't filled by migration yet
+    size_t end   = (stack->storage == STORAGE_INCREMENTAL) ? stack->migration.poisoned : stack->capacity;
+    size_t count = end - stack->size;
+    if (!full && count > POISON_CHECK_WINDOW) count = POISON_CHECK_WINDOW;
+
+    size_t index = poison_find(data + stack->size, count);
+
+    return (index == count) ? POISON_INTACT : stack->size + index;
+}
+
+#ifndef NO_DEBUG
+
+static bool stack_hot_check(const struct Stack* stack)
+{
+    #ifdef USE_BACKGROUND_VERIFY
+    if (stack_watched(stack)) return false;
     #endif
 
+    return stack->protection != PROTECTION_OFF;
+}
+
+static enum errorCode stack_check_blocks(struct Stack* stack, size_t first, FILE* stream, const char* file, int line, const char* func)
+{
     #ifdef USE_HASH_PROTECTION
 
-    if (calculate_hash(stack)) return NO_STACK_PTR;
-    
+    // Paranoid check has compared the whole tree already
+    if (stack->protection != PROTECTION_HASH || !stack->size) return NO_ERRORS;
+
+    // Push into empty block changes nothing hashed. Blocks are visited from the top, so that cursor of segmented
+    // stack walks few chunks
+    for (size_t block = (stack->size - 1) / STACK_HASH_BLOCK + 1; block-- > first / STACK_HASH_BLOCK; )
+    {
+        if (hash_tree_verify_block(stack, block) == NO_ERRORS) continue;
+
+        stack->stackErrors = (errorCode) (stack->stackErrors | BAD_DATA_HASH);
+        stack_dump(stream, stack, file, func, line, FULL, DUMP_DEFAULT);
+
+        return stack->stackErrors;
+    }
+
+    #else
+
+    (void) stack;
+    (void) first;
+    (void) stream;
+    (void) file;
+    (void) line;
+    (void) func;
+
     #endif
 
-    #ifndef NO_DEBUG
+    return NO_ERRORS;
+}
 
-    if (stack_verify(stack, stream, file, line, func)) return ELEM_T_POISON;
+#endif
+
+static size_t buffer_prefix_size(size_t count)
+{
+    #ifdef USE_CANARY_PROTECTION
+    return sizeof(canary_t) + count * sizeof(elem_t);
+    #else
+    return count * sizeof(elem_t);
+    #endif
+}
+
+size_t stack_buffer_size(size_t capacity)
+{
+    #ifdef USE_CANARY_PROTECTION
+    return buffer_prefix_size(capacity) + sizeof(canary_t);
+    #else
+    return buffer_prefix_size(capacity);
+    #endif
+}
+
+static size_t stack_shrink_size(const struct Stack* stack)
+{
+    if (stack->storage == STORAGE_SEGMENTED || stack_data_inline(stack)) return 0;
+
+    // Shrink that keeps all committed pages would be repeated by every pop
+    if (stack->storage == STORAGE_MAPPED &&
+        mapped_fit_capacity(stack->growth->shrink(stack->growth, stack->capacity), true) >= stack->capacity) return 0;
+
+    if (stack->storage == STORAGE_GUARDED &&
+        guarded_fit_capacity(stack->growth->shrink(stack->growth, stack->capacity)) >= stack->capacity) return 0;
+
+    return stack->growth->shrink_size(stack->growth, stack->capacity);
+}
+
+static void buffer_release(struct Stack* stack)
+{
+    if (stack->bufferRefs)
+    {
+        size_t refs = --*stack->bufferRefs;
+
+        if (!refs) STACK_RETIRE_BLOCK(stack, stack->allocator, stack->bufferRefs, sizeof(size_t));
+        stack->bufferRefs = NULL;
+
+        if (refs) return;
+    }
+
+    STACK_RETIRE_BLOCK(stack, stack->allocator, stack->data, stack_buffer_size(stack->capacity));
+}
+
+/// @brief Reallocates own buffer, while verifier may read it old buffer is copied and retired instead of reallocated
+static elem_t* buffer_reallocate(struct Stack* stack, size_t capacity)
+{
+    size_t oldSize = stack_buffer_size(stack->capacity);
+    size_t newSize = stack_buffer_size(capacity);
+
+    if (!STACK_DEFERS_RELEASE(stack)) return (elem_t*) stack->allocator->reallocate(stack->allocator, stack->data, oldSize, newSize);
+
+    elem_t* newData = (elem_t*) stack->allocator->allocate(stack->allocator, newSize);
+
+    if (newData)
+    {
+        memcpy(newData, stack->data, (oldSize < newSize) ? oldSize : newSize);
+        STACK_RETIRE_BLOCK(stack, stack->allocator, stack->data, oldSize);
+    }
+
+    return newData;
+}
+
+static enum errorCode stack_own_buffer(struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    // The last holder keeps buffer, only reference count goes away
+    if (*stack->bufferRefs == 1)
+    {
+        STACK_RETIRE_BLOCK(stack, stack->allocator, stack->bufferRefs, sizeof(size_t));
+        stack->bufferRefs = NULL;
+
+        return NO_ERRORS;
+    }
+
+    STACK_STATS_TIMER(copyStart);
+    CALL_SITE_TIMER(copySiteStart);
+
+    elem_t* data = (elem_t*) stack->allocator->allocate(stack->allocator, stack_buffer_size(stack->capacity));
+
+    if (!data)
+    {
+        stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
+
+        #ifdef USE_HASH_PROTECTION
+        if (stack->protection >= PROTECTION_HASH) calculate_struct_hash(stack);
+        #endif
+
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, NO_MEMORY);
+
+        return NO_MEMORY;
+    }
+
+    memcpy(data, stack->data, stack_buffer_size(stack->capacity));
+
+    buffer_release(stack);
+    stack->data = data;
+
+    STACK_STATS_LATENCY(stack, reallocLatency, copyStart);
+    CALL_SITE_REALLOC(copySiteStart);
+
+    return NO_ERRORS;
+}
+
+static enum errorCode stack_clone_copy(struct Stack* clone, struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    // Snapshot mapping belongs to original, copy is ordinary contiguous stack
+    enum storageMode storage = (stack->storage == STORAGE_SNAPSHOT) ? STORAGE_CONTIGUOUS : stack->storage;
+
+    enum errorCode error = stack_ctor(clone, stack->capacity, stack->protection, storage, stack->allocator, stream, file, line, func);
+    if (error) return error;
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (clone->hashBackend != stack->hashBackend)
+    {
+        error = stack_set_hash_backend(clone, stack->hashBackend, stream, file, line, func);
+        if (error) return error;
+    }
+
+    #endif
+
+    error = stack_set_growth(clone, stack->growth);
+    if (error) return error;
+
+    #ifdef USE_CANARY_PROTECTION
+    const elem_t* data = (const elem_t*) ((const canary_t*) stack->data + 1);
+    #else
+    const elem_t* data = stack->data;
+    #endif
+
+    // Elements below pending are still in old buffer of incremental stack
+    size_t pending = stack->migration.pending;
+
+    if (pending)
+    {
+        #ifdef USE_CANARY_PROTECTION
+        const elem_t* oldData = (const elem_t*) ((const canary_t*) stack->migration.oldData + 1);
+        #else
+        const elem_t* oldData = stack->migration.oldData;
+        #endif
+
+        error = stack_push_n(clone, oldData, pending, stream, file, line, func);
+        if (error) return error;
+    }
+
+    return stack_push_n(clone, data + pending, stack->size - pending, stream, file, line, func);
+}
+
+enum errorCode stack_set_growth(struct Stack* stack, const struct GrowthStrategy* growth)
+{
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    STACK_WRITE_SCOPE(stack);
+
+    if (!growth) growth = &GROWTH_DOUBLE;
+
+    stack->growth     = growth;
+    stack->shrinkSize = stack_shrink_size(stack);
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (stack->protection >= PROTECTION_HASH) return calculate_struct_hash(stack);
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+enum errorCode stack_push(struct Stack* stack, elem_t value, FILE* stream, const char* file, int line, const char* func)
+{
+    CALL_SITE_SCOPE(CALL_SITE_PUSH, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    if (stack_hot_check(stack))
+    {
+        if (stack_check(stack, false, stream, file, line, func)) return stack->stackErrors;
+        if (stack_check_blocks(stack, stack->size, stream, file, line, func)) return stack->stackErrors;
+    }
+
+    #endif
+
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        if (segmented_push(stack, value))
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
+            return NO_MEMORY;
+        }
+    }
+    else if (stack->storage == STORAGE_INCREMENTAL)
+    {
+        if (incremental_push(stack, value))
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
+            return NO_MEMORY;
+        }
+    }
+    else
+    {
+        if (stack->size + 1 == stack->capacity)
+        {
+            enum errorCode err = stack_realloc(stack, stream, file, line, func);
+            if (err) return err;
+        }
+
+        if (stack->bufferRefs && stack_own_buffer(stack, stream, file, line, func)) return NO_MEMORY;
+
+        #ifdef USE_CANARY_PROTECTION
+        stack->data = (elem_t*) ((canary_t*) stack->data + 1);
+        #endif
+
+        stack->data[stack->size++] = value;
+
+        #ifdef USE_CANARY_PROTECTION
+        stack->data = (elem_t*) ((canary_t*) stack->data - 1);
+        #endif
+    }
+
+    STACK_STATS_ADD(stack, pushes, 1);
+    STACK_STATS_PEAK(stack);
+
+    if (stack->protection == PROTECTION_OFF) return NO_ERRORS;
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (stack->protection >= PROTECTION_HASH)
+    {
+        #ifdef USE_INCREMENTAL_HASH
+        enum errorCode error = hash_tree_add(stack, stack->size - 1, elem_hash(value, stack->size - 1));
+        #else
+        enum errorCode error = hash_tree_rehash(stack, stack->size - 1, stack->size);
+        #endif
+
+        if (error)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | error);
+            return error;
+        }
+
+        if (calculate_struct_hash(stack)) return NO_STACK_PTR;
+    }
+
+    #endif
+
+    #ifndef NO_DEBUG
+
+    if (!stack_hot_check(stack)) return NO_ERRORS;
+
+    return stack_check(stack, false, stream, file, line, func);
+
+    #else
+
+    return NO_ERRORS;
+
+    #endif
+}
+
+elem_t stack_pop(struct Stack* stack, FILE* stream, const char* file, int line, const char* func)
+{
+    CALL_SITE_SCOPE(CALL_SITE_POP, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    if (stack_hot_check(stack))
+    {
+        if (stack_check(stack, false, stream, file, line, func)) return stack->stackErrors;
+        if (stack_check_blocks(stack, stack->size - 1, stream, file, line, func)) return stack->stackErrors;
+    }
+
+    #endif
+
+    if (stack->size == 0)
+    {
+        #ifndef NO_DEBUG
+
+        stack->stackErrors = (errorCode) (stack->stackErrors | EMPTY_STACK);
+        stack_dump(stream, stack, file, func, line, FULL, DUMP_DEFAULT);
+
+        #ifdef USE_HASH_PROTECTION
+
+        if (stack->protection >= PROTECTION_HASH) calculate_struct_hash(stack);
+
+        #endif
+
+        #endif
+
+        return ELEM_T_POISON;
+    }
+
+    elem_t ret = ELEM_T_POISON;
+
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        ret = segmented_pop(stack);
+    }
+    else if (stack->storage == STORAGE_INCREMENTAL)
+    {
+        ret = incremental_pop(stack);
+    }
+    else
+    {
+        if (stack->size <= stack->shrinkSize)
+        {
+            if (stack_realloc(stack, stream, file, line, func)) return ELEM_T_POISON;
+        }
+
+        if (stack->bufferRefs && stack_own_buffer(stack, stream, file, line, func)) return ELEM_T_POISON;
+
+        stack->size--;
+
+        #ifdef USE_CANARY_PROTECTION
+        stack->data = (elem_t*) ((canary_t*) stack->data + 1);
+        #endif
+
+        ret = stack->data[stack->size];
+        if (stack->protection >= PROTECTION_CANARY) stack->data[stack->size] = ELEM_T_POISON;
+
+        #ifdef USE_CANARY_PROTECTION
+        stack->data = (elem_t*) ((canary_t*) stack->data - 1);
+        #endif
+    }
+
+    STACK_STATS_ADD(stack, pops, 1);
+
+    if (stack->protection == PROTECTION_OFF) return ret;
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (stack->protection >= PROTECTION_HASH)
+    {
+        #ifdef USE_INCREMENTAL_HASH
+        hash_tree_add(stack, stack->size, -elem_hash(ret, stack->size));
+        #else
+        hash_tree_rehash(stack, stack->size, stack->size + 1);
+        #endif
+
+        if (calculate_struct_hash(stack)) return NO_STACK_PTR;
+    }
+
+    #endif
+
+    #ifndef NO_DEBUG
+
+    if (stack_hot_check(stack) && stack_check(stack, false, stream, file, line, func)) return ELEM_T_POISON;
 
     #endif
 
     return ret;
-}
\ No newline at end of file
+}
+
+#ifdef STACK_INLINE_FAST_PATH
+
+enum errorCode stack_push_slow(struct Stack* stack, elem_t value)
+{
+    return stack_push(stack, value, stderr, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+}
+
+elem_t stack_pop_slow(struct Stack* stack)
+{
+    return stack_pop(stack, stdout, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+}
+
+#endif
+
+enum errorCode stack_push_n(struct Stack* stack, const elem_t* values, size_t count, FILE* stream, const char* file, int line, const char* func)
+{
+    CALL_SITE_SCOPE(CALL_SITE_PUSH_N, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    if (count && no_ptr(stream, values, NO_STACK_DATA_PTR, file, func, line)) return NO_STACK_DATA_PTR;
+
+    if (stack_hot_check(stack))
+    {
+        if (stack_check(stack, false, stream, file, line, func)) return stack->stackErrors;
+        if (stack_check_blocks(stack, stack->size, stream, file, line, func)) return stack->stackErrors;
+    }
+
+    #endif
+
+    if (!count) return NO_ERRORS;
+
+    size_t oldSize = stack->size;
+
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        if (segmented_push_n(stack, values, count))
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
+            return NO_MEMORY;
+        }
+    }
+    else if (stack->storage == STORAGE_INCREMENTAL)
+    {
+        if (incremental_push_n(stack, values, count))
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | NO_MEMORY);
+            return NO_MEMORY;
+        }
+    }
+    else
+    {
+        if (stack->size + count >= stack->capacity)
+        {
+            size_t newCapacity = stack->capacity;
+            while (stack->size + count >= newCapacity) newCapacity = stack->growth->grow(stack->growth, newCapacity);
+
+            enum errorCode err = stack_resize(stack, newCapacity, stream, file, line, func);
+            if (err) return err;
+        }
+
+        if (stack->bufferRefs && stack_own_buffer(stack, stream, file, line, func)) return NO_MEMORY;
+
+        #ifdef USE_CANARY_PROTECTION
+        elem_t* data = (elem_t*) ((canary_t*) stack->data + 1);
+        #else
+        elem_t* data = stack->data;
+        #endif
+
+        memcpy(data + stack->size, values, count * sizeof(elem_t));
+
+        stack->size += count;
+    }
+
+    STACK_STATS_ADD(stack, pushes, count);
+    STACK_STATS_PEAK(stack);
+
+    if (stack->protection == PROTECTION_OFF) return NO_ERRORS;
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (stack->protection >= PROTECTION_HASH)
+    {
+        enum errorCode error = NO_ERRORS;
+
+        #ifdef USE_INCREMENTAL_HASH
+
+        for (size_t i = 0; i < count && !error; i++)
+        {
+            error = hash_tree_add(stack, oldSize + i, elem_hash(values[i], oldSize + i));
+        }
+
+        #else
+
+        error = hash_tree_rehash(stack, oldSize, stack->size);
+
+        #endif
+
+        if (error)
+        {
+            stack->stackErrors = (errorCode) (stack->stackErrors | error);
+            return error;
+        }
+
+        if (calculate_struct_hash(stack)) return NO_STACK_PTR;
+    }
+
+    #else
+
+    (void) oldSize;
+
+    #endif
+
+    #ifndef NO_DEBUG
+
+    if (!stack_hot_check(stack)) return NO_ERRORS;
+
+    return stack_check(stack, false, stream, file, line, func);
+
+    #else
+
+    return NO_ERRORS;
+
+    #endif
+}
+
+enum errorCode stack_pop_n(struct Stack* stack, elem_t* values, size_t count, FILE* stream, const char* file, int line, const char* func)
+{
+    CALL_SITE_SCOPE(CALL_SITE_POP_N, file, line, func);
+    STACK_WRITE_SCOPE(stack);
+
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, stack, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    if (count && no_ptr(stream, values, NO_STACK_DATA_PTR, file, func, line)) return NO_STACK_DATA_PTR;
+
+    if (stack_hot_check(stack))
+    {
+        if (stack_check(stack, false, stream, file, line, func)) return stack->stackErrors;
+        if (stack_check_blocks(stack, ((count < stack->size) ? stack->size - count : 0), stream, file, line, func)) return stack->stackErrors;
+    }
+
+    #endif
+
+    if (!count) return NO_ERRORS;
+
+    if (count > stack->size)
+    {
+        #ifndef NO_DEBUG
+
+        stack->stackErrors = (errorCode) (stack->stackErrors | EMPTY_STACK);
+        stack_dump(stream, stack, file, func, line, FULL, DUMP_DEFAULT);
+
+        #ifdef USE_HASH_PROTECTION
+
+        if (stack->protection >= PROTECTION_HASH) calculate_struct_hash(stack);
+
+        #endif
+
+        #endif
+
+        return EMPTY_STACK;
+    }
+
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        segmented_pop_n(stack, values, count);
+    }
+    else if (stack->storage == STORAGE_INCREMENTAL)
+    {
+        incremental_pop_n(stack, values, count);
+    }
+    else
+    {
+        if (stack->bufferRefs && stack_own_buffer(stack, stream, file, line, func)) return NO_MEMORY;
+
+        #ifdef USE_CANARY_PROTECTION
+        elem_t* data = (elem_t*) ((canary_t*) stack->data + 1);
+        #else
+        elem_t* data = stack->data;
+        #endif
+
+        stack->size -= count;
+
+        memcpy(values, data + stack->size, count * sizeof(elem_t));
+
+        if (stack->protection >= PROTECTION_CANARY) poison_fill(data + stack->size, count);
+    }
+
+    STACK_STATS_ADD(stack, pops, count);
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (stack->protection >= PROTECTION_HASH)
+    {
+        #ifdef USE_INCREMENTAL_HASH
+
+        for (size_t i = 0; i < count; i++)
+        {
+            hash_tree_add(stack, stack->size + i, -elem_hash(values[i], stack->size + i));
+        }
+
+        #else
+
+        hash_tree_rehash(stack, stack->size, stack->size + count);
+
+        #endif
+
+        if (calculate_struct_hash(stack)) return NO_STACK_PTR;
+    }
+
+    #endif
+
+    // Segmented stack releases chunks and incremental one starts shrink migration in their own pop_n
+    if (stack->storage != STORAGE_SEGMENTED && stack->storage != STORAGE_INCREMENTAL && stack->size <= stack->shrinkSize)
+    {
+        size_t newCapacity = stack->capacity;
+        while (stack->size <= stack->growth->shrink_size(stack->growth, newCapacity))
+        {
+            size_t shrunk = stack->growth->shrink(stack->growth, newCapacity);
+            if (shrunk >= newCapacity) break;
+
+            newCapacity = shrunk;
+        }
+
+        return stack_resize(stack, newCapacity, stream, file, line, func);
+    }
+
+    #ifndef NO_DEBUG
+
+    if (!stack_hot_check(stack)) return NO_ERRORS;
+
+    return stack_check(stack, false, stream, file, line, func);
+
+    #else
+
+    return NO_ERRORS;
+
+    #endif
+}
@@ -0,0 +1,98 @@
+/**
+ * @file
+ * @brief Per-stack operation counters and latency histograms(compiled only with USE_STACK_STATS)
+*/
+#include <stdio.h>
+#include <time.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+#ifdef USE_STACK_STATS
+
+static size_t latency_bucket(unsigned long long ns);
+static void print_histogram(FILE* stream, const char* name, const struct StackLatencyHistogram* histogram);
+
+enum errorCode stack_stats(const struct Stack* stack, struct StackStats* stats)
+{
+    if (no_ptr(stderr, stack, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+    if (no_ptr(stderr, stats, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    if (!stack->stats)
+    {
+        *stats = {};
+        return NO_MEMORY;
+    }
+
+    *stats = *stack->stats;
+
+    return NO_ERRORS;
+}
+
+unsigned long long stack_stats_now()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (unsigned long long) time.tv_sec * 1000000000ull + (unsigned long long) time.tv_nsec;
+}
+
+void stack_stats_record(struct StackLatencyHistogram* histogram, unsigned long long start)
+{
+    unsigned long long ns = stack_stats_now() - start;
+
+    histogram->count++;
+    histogram->totalNs += ns;
+    if (ns > histogram->maxNs) histogram->maxNs = ns;
+
+    histogram->buckets[latency_bucket(ns)]++;
+}
+
+void print_stack_stats(FILE* stream, const struct StackStats* stats)
+{
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "stats");
+    fprintf(stream, ":\n");
+    fprintf(stream, "    pushes = %lu, pops = %lu, grows = %lu, shrinks = %lu, verifies = %lu\n",
+            stats->pushes, stats->pops, stats->grows, stats->shrinks, stats->verifies);
+    fprintf(stream, "    hashed bytes = %lu, peak size = %lu, peak capacity = %lu\n",
+            stats->hashedBytes, stats->peakSize, stats->peakCapacity);
+
+    print_histogram(stream, "verify",  &stats->verifyLatency);
+    print_histogram(stream, "hash",    &stats->hashLatency);
+    print_histogram(stream, "realloc", &stats->reallocLatency);
+}
+
+/// @brief Bucket i holds latencies in [2^i, 2^(i+1)) ns, the last one also holds everything above
+static size_t latency_bucket(unsigned long long ns)
+{
+    if (ns < 2) return 0;
+
+    size_t bucket = (size_t) (63 - __builtin_clzll(ns));
+
+    return (bucket < STACK_STATS_BUCKETS) ? bucket : STACK_STATS_BUCKETS - 1;
+}
+
+static void print_histogram(FILE* stream, const char* name, const struct StackLatencyHistogram* histogram)
+{
+    fprintf(stream, "    ");
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "%s latency", name);
+    fprintf(stream, ": ");
+
+    if (!histogram->count)
+    {
+        fprintf(stream, "no calls\n");
+        return;
+    }
+
+    fprintf(stream, "count = %lu, avg = %llu ns, max = %llu ns\n", histogram->count,
+            histogram->totalNs / histogram->count, histogram->maxNs);
+
+    for (size_t i = 0; i < STACK_STATS_BUCKETS; i++)
+    {
+        if (!histogram->buckets[i]) continue;
+
+        fprintf(stream, "        [%10llu, %10llu) ns: %lu\n", 1ull << i, 1ull << (i + 1), histogram->buckets[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,353 @@
+/**
+ * @file
+ * @brief Background verifier: registry of watched stacks, write scopes of stack functions and verifier thread
+*/
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <system_error>
+#include <thread>
+
+#include "Color_output.h"
+#include "Stack.h"
+#include "Verifier.h"
+
+#ifdef USE_BACKGROUND_VERIFY
+
+/// @brief Block released by writer while verifier could read it, freed by the next write scope that sees verifier gone
+struct StackRetired
+{
+    struct StackRetired*   next;
+    struct StackAllocator* allocator;   ///< Allocator of block(NULL - block is mapping)
+    void*                  block;
+    size_t                 size;
+};
+
+/// @brief Watch slot of registered stack
+struct StackWatch
+{
+    std::atomic<unsigned> sequence;     ///< Odd while write scope of stack is open
+    std::atomic<bool>     reading;      ///< Verifier may read stack through its copy of struct
+    bool                  deferring;    ///< Open write scope saw verifier reading, so it retires blocks instead of freeing
+    unsigned              depth;        ///< Nesting of write scopes(changed by thread working with stack)
+    enum errorCode        reported;     ///< Errors verifier already reported
+    struct StackRetired*  retired;      ///< Blocks waiting for verifier to stop reading(changed by thread working with stack)
+    struct Stack*         stack;        ///< Owner(NULL - free slot), changed under registryLock
+};
+
+static struct StackWatch  watchRegistry[STACK_WATCH_REGISTRY];
+static std::mutex         registryLock;     ///< Guards owners of slots and verifierStats, verifier holds it while it checks stack
+
+static std::thread             verifierThread;
+static std::mutex              verifierLock;            ///< Guards verifierStop
+static std::condition_variable verifierWake;            ///< Wakes sleeping verifier on stop
+static bool                    verifierStop = false;
+static bool                    verifierStopAtExit = false;
+
+static struct StackVerifierConfig verifierConfig = {};
+static struct StackVerifierStats  verifierStats  = {};
+
+static std::atomic<bool> verifierRunning(false);    ///< Constructed stacks are registered
+static std::atomic<bool> verifierOwnsChecks(false); ///< Push and pop of watched stacks skip verification
+
+static void verifier_loop();
+static void verifier_pass();
+static void verifier_check(struct StackWatch* watch);
+static void verifier_report(const struct Stack* stack, enum errorCode errors, const struct StackHomeland* homeland);
+static void watch_release(struct StackAllocator* allocator, void* block, size_t size);
+static void watch_drain(struct StackWatch* watch);
+
+enum errorCode stack_verifier_start(const struct StackVerifierConfig* config)
+{
+    if (no_ptr(stderr, config, NO_STACK_PTR, __FILE__, __func__, __LINE__)) return NO_STACK_PTR;
+
+    stack_verifier_stop();
+
+    // Joinable thread left at exit would terminate process
+    if (!verifierStopAtExit) verifierStopAtExit = !atexit(stack_verifier_stop);
+
+    verifierConfig = *config;
+    verifierStop   = false;
+
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+        verifierStats = {};
+    }
+
+    verifierOwnsChecks.store(!config->hotChecks);
+    verifierRunning.store(true);
+
+    try
+    {
+        verifierThread = std::thread(verifier_loop);
+    }
+    catch (const std::system_error&)
+    {
+        verifierRunning.store(false);
+        verifierOwnsChecks.store(false);
+
+        print_error(stderr, NO_MEMORY);
+        return NO_MEMORY;
+    }
+
+    return NO_ERRORS;
+}
+
+void stack_verifier_stop()
+{
+    if (!verifierThread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(verifierLock);
+        verifierStop = true;
+    }
+
+    verifierWake.notify_all();
+    verifierThread.join();
+
+    verifierRunning.store(false);
+    verifierOwnsChecks.store(false);
+}
+
+struct StackVerifierStats stack_verifier_stats()
+{
+    std::lock_guard<std::mutex> lock(registryLock);
+
+    return verifierStats;
+}
+
+bool stack_watched(const struct Stack* stack)
+{
+    return stack->watch && verifierOwnsChecks.load(std::memory_order_relaxed);
+}
+
+struct StackWriteScope stack_write_enter(struct Stack* stack)
+{
+    struct StackWatch* watch = stack ? stack->watch : NULL;
+
+    if (!watch || watch->depth++) return {watch};
+
+    // Counter becomes odd before writer looks at reading flag, verifier sets flag before it looks at counter,
+    // so verifier that isn't seen here sees odd counter and doesn't start reading until scope is closed
+    watch->sequence.fetch_add(1);
+    watch->deferring = watch->reading.load();
+
+    return {watch};
+}
+
+void stack_write_leave(struct StackWriteScope* scope)
+{
+    struct StackWatch* watch = scope->watch;
+
+    if (!watch || --watch->depth) return;
+
+    watch->sequence.fetch_add(1);
+    watch->deferring = false;
+
+    // Verifier that starts reading from now on copies struct without retired blocks
+    if (watch->retired && !watch->reading.load()) watch_drain(watch);
+}
+
+bool stack_defers_release(const struct Stack* stack)
+{
+    return stack->watch && stack->watch->deferring;
+}
+
+void stack_retire(struct Stack* stack, struct StackAllocator* allocator, void* block, size_t size)
+{
+    if (!block) return;
+
+    if (stack_defers_release(stack))
+    {
+        struct StackRetired* retired = (struct StackRetired*) calloc(1, sizeof(struct StackRetired));
+
+        if (retired)
+        {
+            *retired = {stack->watch->retired, allocator, block, size};
+            stack->watch->retired = retired;
+
+            return;
+        }
+
+        // Without memory for list block can be freed only when verifier is done with it
+        while (stack->watch->reading.load()) std::this_thread::yield();
+    }
+
+    watch_release(allocator, block, size);
+}
+
+struct StackWriteScope stack_watch_register(struct Stack* stack)
+{
+    stack->watch = NULL;
+
+    if (!verifierRunning.load()) return {NULL};
+
+    std::lock_guard<std::mutex> lock(registryLock);
+
+    struct StackWatch* free = NULL;
+
+    // Stack constructed again without dtor takes back its old slot
+    for (size_t i = 0; i < STACK_WATCH_REGISTRY; i++)
+    {
+        if (watchRegistry[i].stack == stack)
+        {
+            free = &watchRegistry[i];
+            break;
+        }
+
+        if (!free && !watchRegistry[i].stack) free = &watchRegistry[i];
+    }
+
+    if (!free) return {NULL};
+
+    // Verifier checks stacks under registryLock, so blocks left by old owner can go
+    watch_drain(free);
+
+    // Slot is published with open write scope, verifier skips it until ctor returns
+    if (free->sequence.load() % 2 == 0) free->sequence.fetch_add(1);
+
+    free->depth     = 1;
+    free->deferring = false;
+    free->stack     = stack;
+    free->reported  = NO_ERRORS;
+
+    stack->watch = free;
+
+    return {free};
+}
+
+void stack_watch_unregister(struct Stack* stack)
+{
+    if (!stack || !stack->watch) return;
+
+    std::lock_guard<std::mutex> lock(registryLock);
+
+    // Verifier checks stacks under registryLock, so it can't be reading this one
+    watch_drain(stack->watch);
+
+    if (stack->watch->stack == stack) stack->watch->stack = NULL;
+
+    stack->watch = NULL;
+}
+
+static void verifier_loop()
+{
+    std::unique_lock<std::mutex> wait(verifierLock);
+
+    while (!verifierStop)
+    {
+        wait.unlock();
+        verifier_pass();
+        wait.lock();
+
+        verifierWake.wait_for(wait, std::chrono::milliseconds(verifierConfig.periodMs), []{ return verifierStop; });
+    }
+}
+
+static void verifier_pass()
+{
+    // Lock is taken per slot, so that ctor and dtor of other stacks wait for one check at most
+    for (size_t i = 0; i < STACK_WATCH_REGISTRY; i++)
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+
+        if (watchRegistry[i].stack) verifier_check(&watchRegistry[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(registryLock);
+    verifierStats.passes++;
+}
+
+/**
+ * @brief Verifies copy of stack as seqlock reader(called under registryLock)
+ * @details Check runs when counter is even and its result counts only if counter didn't change meanwhile, otherwise
+ * it is retried. Writers don't wait: scopes that see reading flag retire blocks instead of freeing them, so copy of
+ * struct never points to released memory
+*/
+static void verifier_check(struct StackWatch* watch)
+{
+    watch->reading.store(true);
+
+    struct Stack   copy   = {};
+    enum errorCode errors = NO_ERRORS;
+
+    for (size_t spin = 0; ; spin++)
+    {
+        if (spin == STACK_VERIFY_SPIN)
+        {
+            watch->reading.store(false);
+            verifierStats.busy++;
+
+            return;
+        }
+
+        unsigned sequence = watch->sequence.load();
+
+        if (sequence % 2)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Verification writes errors and hashes into struct, live stack is left as it is. Torn copy isn't followed
+        copy = *watch->stack;
+        if (watch->sequence.load() != sequence) continue;
+
+        errors = stack_check_errors(&copy, true);
+
+        if (watch->sequence.load() == sequence) break;
+    }
+
+    watch->reading.store(false);
+
+    verifierStats.checks++;
+
+    if (errors & ~watch->reported)
+    {
+        watch->reported = (errorCode) (watch->reported | errors);
+        verifierStats.failures++;
+
+        verifier_report(watch->stack, errors, &copy.stackHomeland);
+    }
+}
+
+static void verifier_report(const struct Stack* stack, enum errorCode errors, const struct StackHomeland* homeland)
+{
+    if (verifierConfig.stream)
+    {
+        FILE* report = stack_report_begin(verifierConfig.stream);
+
+        color_fprintf(report, COLOR_RED, STYLE_BOLD, "Background verification failed\n");
+        print_homeland(report, stack, homeland);
+        print_error(report, errors);
+
+        stack_report_end(report);
+    }
+
+    if (verifierConfig.callback) verifierConfig.callback(stack, errors, homeland, verifierConfig.context);
+}
+
+static void watch_release(struct StackAllocator* allocator, void* block, size_t size)
+{
+    if (allocator) allocator->deallocate(allocator, block, size);
+    else           munmap(block, size);
+}
+
+/// @brief Frees retired blocks(called by thread working with stack, so that allocator isn't shared with verifier)
+static void watch_drain(struct StackWatch* watch)
+{
+    while (watch->retired)
+    {
+        struct StackRetired* retired = watch->retired;
+        watch->retired = retired->next;
+
+        watch_release(retired->allocator, retired->block, retired->size);
+        free(retired);
+    }
+}
+
+#endif
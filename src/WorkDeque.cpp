@@ -0,0 +1,384 @@
+/**
+ * @file
+ * @brief Chase-Lev work-stealing deque functions source
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Color_output.h"
+#include "WorkDeque.h"
+
+static struct DequeBuffer* buffer_alloc(struct WorkDeque* deque, size_t capacity);
+static void buffer_free(struct WorkDeque* deque, struct DequeBuffer* buffer);
+static struct DequeBuffer* buffer_grow(struct WorkDeque* deque, struct DequeBuffer* buffer, long long bottom, long long top);
+static elem_t* buffer_data(struct DequeBuffer* buffer);
+static elem_t buffer_load(struct DequeBuffer* buffer, long long index);
+static void buffer_store(struct DequeBuffer* buffer, long long index, elem_t value);
+static size_t round_capacity(size_t capacity);
+
+static void wdeque_set_error(struct WorkDeque* deque, enum errorCode error);
+static void wdeque_print_header(FILE* stream, const struct WorkDeque* deque, const char* file, const char* func, int line);
+
+enum errorCode wdeque_ctor(struct WorkDeque* deque, size_t capacity, enum protectionLevel protection, struct StackAllocator* allocator,
+                           FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, deque, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    if (capacity <= 0)
+    {
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, CAPACITY_NOT_VALID);
+        return CAPACITY_NOT_VALID;
+    }
+
+    #endif
+
+    deque->protection = (protection > PROTECTION_CANARY) ? PROTECTION_CANARY : protection;
+    deque->growth     = &GROWTH_DOUBLE;
+    deque->allocator  = allocator ? allocator : &STACK_HEAP_ALLOCATOR;
+
+    deque->top.store(0, std::memory_order_relaxed);
+    deque->bottom.store(0, std::memory_order_relaxed);
+    deque->stackErrors.store(NO_ERRORS, std::memory_order_relaxed);
+
+    #ifdef USE_CANARY_PROTECTION
+
+    deque->leftCanary  = CANARY_T_DEFAULT;
+    deque->rightCanary = CANARY_T_DEFAULT;
+
+    #endif
+
+    struct DequeBuffer* buffer = buffer_alloc(deque, round_capacity(capacity));
+    deque->buffer.store(buffer, std::memory_order_release);
+
+    if (!buffer)
+    {
+        wdeque_set_error(deque, NO_MEMORY);
+
+        #ifndef NO_DEBUG
+        PRINT_LINE(stream, file, func, line);
+        print_error(stream, NO_MEMORY);
+        #endif
+
+        return NO_MEMORY;
+    }
+
+    return NO_ERRORS;
+}
+
+enum errorCode wdeque_dtor(struct WorkDeque* deque, FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (wdeque_verify(deque, stream, file, line, func) == NO_STACK_PTR) return NO_STACK_PTR;
+
+    #endif
+
+    struct DequeBuffer* buffer = deque->buffer.exchange(NULL);
+    while (buffer)
+    {
+        struct DequeBuffer* prev = buffer->prev;
+        buffer_free(deque, buffer);
+        buffer = prev;
+    }
+
+    deque->top.store(0, std::memory_order_relaxed);
+    deque->bottom.store(0, std::memory_order_relaxed);
+
+    deque->stackHomeland.stackName = NULL;
+    deque->stackHomeland.file      = NULL;
+    deque->stackHomeland.function  = NULL;
+    deque->stackHomeland.line      = -1;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    deque->leftCanary  = CANARY_T_POISON;
+    deque->rightCanary = CANARY_T_POISON;
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+enum errorCode wdeque_verify(struct WorkDeque* deque, FILE* stream, const char* file, int line, const char* func)
+{
+    if (no_ptr(stream, deque, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    struct DequeBuffer* buffer = deque->buffer.load(std::memory_order_acquire);
+    if (!buffer) wdeque_set_error(deque, NO_STACK_DATA_PTR);
+
+    #ifdef USE_CANARY_PROTECTION
+
+    if (deque->protection >= PROTECTION_CANARY)
+    {
+        if (deque->leftCanary  != CANARY_T_DEFAULT) wdeque_set_error(deque, LEFT_CANARY_BAD_VALUE);
+        if (deque->rightCanary != CANARY_T_DEFAULT) wdeque_set_error(deque, RIGHT_CANARY_BAD_VALUE);
+
+        if (buffer)
+        {
+            const elem_t* data = buffer_data(buffer);
+
+            if (*((const canary_t*) data - 1) != CANARY_T_DEFAULT) wdeque_set_error(deque, LEFT_DATA_CANARY_BAD_VALUE);
+            if (*((const canary_t*) (data + buffer->capacity)) != CANARY_T_DEFAULT) wdeque_set_error(deque, RIGHT_DATA_CANARY_BAD_VALUE);
+        }
+    }
+
+    #endif
+
+    enum errorCode errors = (errorCode) deque->stackErrors.load(std::memory_order_relaxed);
+
+    // Elements may be changed by other threads, so only header is printed
+    if (errors) wdeque_print_header(stream, deque, file, func, line);
+
+    return errors;
+}
+
+enum errorCode wdeque_push(struct WorkDeque* deque, elem_t value, FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, deque, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    if (deque->protection != PROTECTION_OFF)
+    {
+        if (wdeque_verify(deque, stream, file, line, func)) return (errorCode) deque->stackErrors.load(std::memory_order_relaxed);
+    }
+
+    #endif
+
+    long long top    = deque->top.load(std::memory_order_relaxed);
+    long long bottom = deque->bottom.load(std::memory_order_acquire);
+
+    struct DequeBuffer* buffer = deque->buffer.load(std::memory_order_relaxed);
+
+    if (top - bottom >= (long long) buffer->capacity)
+    {
+        buffer = buffer_grow(deque, buffer, bottom, top);
+        if (!buffer)
+        {
+            wdeque_set_error(deque, NO_MEMORY);
+
+            #ifndef NO_DEBUG
+            PRINT_LINE(stream, file, func, line);
+            print_error(stream, NO_MEMORY);
+            #endif
+
+            return NO_MEMORY;
+        }
+    }
+
+    buffer_store(buffer, top, value);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    deque->top.store(top + 1, std::memory_order_relaxed);
+
+    return NO_ERRORS;
+}
+
+enum errorCode wdeque_pop(struct WorkDeque* deque, elem_t* value, FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, value, NO_STACK_DATA_PTR, file, func, line)) return NO_STACK_DATA_PTR;
+
+    if (deque->protection != PROTECTION_OFF)
+    {
+        if (wdeque_verify(deque, stream, file, line, func)) return (errorCode) deque->stackErrors.load(std::memory_order_relaxed);
+    }
+
+    #endif
+
+    *value = ELEM_T_POISON;
+
+    long long top = deque->top.load(std::memory_order_relaxed) - 1;
+    struct DequeBuffer* buffer = deque->buffer.load(std::memory_order_relaxed);
+
+    // Thieves must see decreased top before owner reads bottom
+    deque->top.store(top, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    long long bottom = deque->bottom.load(std::memory_order_relaxed);
+
+    if (bottom > top)
+    {
+        deque->top.store(top + 1, std::memory_order_relaxed);
+        return EMPTY_STACK;
+    }
+
+    elem_t ret = buffer_load(buffer, top);
+
+    if (bottom == top)
+    {
+        // Last element: race with thieves for it
+        bool won = deque->bottom.compare_exchange_strong(bottom, bottom + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        deque->top.store(top + 1, std::memory_order_relaxed);
+
+        if (!won) return EMPTY_STACK;
+    }
+    else if (deque->protection >= PROTECTION_CANARY) buffer_store(buffer, top, ELEM_T_POISON);
+
+    *value = ret;
+
+    return NO_ERRORS;
+}
+
+enum errorCode wdeque_steal(struct WorkDeque* deque, elem_t* value, FILE* stream, const char* file, int line, const char* func)
+{
+    #ifndef NO_DEBUG
+
+    if (no_ptr(stream, value, NO_STACK_DATA_PTR, file, func, line)) return NO_STACK_DATA_PTR;
+
+    if (deque->protection != PROTECTION_OFF)
+    {
+        if (wdeque_verify(deque, stream, file, line, func)) return (errorCode) deque->stackErrors.load(std::memory_order_relaxed);
+    }
+
+    #endif
+
+    *value = ELEM_T_POISON;
+
+    while (true)
+    {
+        long long bottom = deque->bottom.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long top = deque->top.load(std::memory_order_acquire);
+
+        if (bottom >= top) return EMPTY_STACK;
+
+        struct DequeBuffer* buffer = deque->buffer.load(std::memory_order_acquire);
+        elem_t ret = buffer_load(buffer, bottom);
+
+        if (deque->bottom.compare_exchange_strong(bottom, bottom + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            *value = ret;
+            return NO_ERRORS;
+        }
+    }
+}
+
+enum errorCode wdeque_dump(FILE* stream, const struct WorkDeque* deque, const char* file, const char* func, int line)
+{
+    if (no_ptr(stream, deque, NO_STACK_PTR, file, func, line)) return NO_STACK_PTR;
+
+    wdeque_print_header(stream, deque, file, func, line);
+
+    struct DequeBuffer* buffer = deque->buffer.load(std::memory_order_acquire);
+    if (!buffer) return NO_STACK_DATA_PTR;
+
+    long long top    = deque->top.load(std::memory_order_relaxed);
+    long long bottom = deque->bottom.load(std::memory_order_relaxed);
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "bottom");
+    fprintf(stream, " = %lld\n", bottom);
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "top");
+    fprintf(stream, " = %lld\n", top);
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "capacity");
+    fprintf(stream, " = %lu\n", buffer->capacity);
+
+    for (long long i = bottom; i < top; i++)
+    {
+        color_putc(stream, COLOR_CYAN, STYLE_BOLD, (i + 1 == top) ? '>' : '*');
+        color_putc(stream, COLOR_YELLOW, STYLE_BOLD, '[');
+        fprintf(stream, "%lld", i);
+        color_putc(stream, COLOR_YELLOW, STYLE_BOLD, ']');
+        fprintf(stream, " = %d\n", buffer_load(buffer, i));
+    }
+
+    return NO_ERRORS;
+}
+
+/// @brief Allocates buffer with canaries, free elements are poisoned with PROTECTION_CANARY
+static struct DequeBuffer* buffer_alloc(struct WorkDeque* deque, size_t capacity)
+{
+    size_t size = sizeof(struct DequeBuffer) + stack_buffer_size(capacity);
+
+    struct DequeBuffer* buffer = (struct DequeBuffer*) deque->allocator->allocate(deque->allocator, size);
+    if (!buffer) return NULL;
+
+    buffer->capacity = capacity;
+    buffer->prev     = NULL;
+
+    elem_t* data = buffer_data(buffer);
+
+    #ifdef USE_CANARY_PROTECTION
+
+    *((canary_t*) data - 1)              = CANARY_T_DEFAULT;
+    *((canary_t*) (data + capacity))     = CANARY_T_DEFAULT;
+
+    #endif
+
+    if (deque->protection >= PROTECTION_CANARY) poison_fill(data, capacity);
+
+    return buffer;
+}
+
+static void buffer_free(struct WorkDeque* deque, struct DequeBuffer* buffer)
+{
+    deque->allocator->deallocate(deque->allocator, buffer, sizeof(struct DequeBuffer) + stack_buffer_size(buffer->capacity));
+}
+
+/// @brief Copies elements to bigger buffer and publishes it, old buffer is kept for thieves reading it
+static struct DequeBuffer* buffer_grow(struct WorkDeque* deque, struct DequeBuffer* buffer, long long bottom, long long top)
+{
+    struct DequeBuffer* newBuffer = buffer_alloc(deque, round_capacity(deque->growth->grow(deque->growth, buffer->capacity)));
+    if (!newBuffer) return NULL;
+
+    for (long long i = bottom; i < top; i++) buffer_store(newBuffer, i, buffer_load(buffer, i));
+
+    newBuffer->prev = buffer;
+    deque->buffer.store(newBuffer, std::memory_order_release);
+
+    return newBuffer;
+}
+
+static elem_t* buffer_data(struct DequeBuffer* buffer)
+{
+    #ifdef USE_CANARY_PROTECTION
+    return (elem_t*) ((canary_t*) (buffer + 1) + 1);
+    #else
+    return (elem_t*) (buffer + 1);
+    #endif
+}
+
+static elem_t buffer_load(struct DequeBuffer* buffer, long long index)
+{
+    return __atomic_load_n(buffer_data(buffer) + ((size_t) index & (buffer->capacity - 1)), __ATOMIC_RELAXED);
+}
+
+static void buffer_store(struct DequeBuffer* buffer, long long index, elem_t value)
+{
+    __atomic_store_n(buffer_data(buffer) + ((size_t) index & (buffer->capacity - 1)), value, __ATOMIC_RELAXED);
+}
+
+/// @brief Rounds capacity up to power of two(indexes are masked)
+static size_t round_capacity(size_t capacity)
+{
+    size_t rounded = 2;
+    while (rounded < capacity) rounded <<= 1;
+
+    return rounded;
+}
+
+static void wdeque_set_error(struct WorkDeque* deque, enum errorCode error)
+{
+    deque->stackErrors.fetch_or(error, std::memory_order_relaxed);
+}
+
+static void wdeque_print_header(FILE* stream, const struct WorkDeque* deque, const char* file, const char* func, int line)
+{
+    PRINT_LINE(stream, file, func, line);
+    print_error(stream, (errorCode) deque->stackErrors.load(std::memory_order_relaxed));
+    print_homeland(stream, deque, &deque->stackHomeland);
+
+    #ifdef USE_CANARY_PROTECTION
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "left canary");
+    fprintf(stream, " = %llx\n", deque->leftCanary);
+
+    color_fprintf(stream, COLOR_PURPLE, STYLE_BOLD, "right canary");
+    fprintf(stream, " = %llx\n", deque->rightCanary);
+
+    #endif
+}
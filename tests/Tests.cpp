@@ -4,14 +4,52 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include "CallSiteProfile.h"
 #include "Color_output.h"
+#include "ConcurrentStack.h"
+#include "Logger.h"
 #include "Stack.h"
+#include "Verifier.h"
+#include "WorkDeque.h"
 
 enum errorCode ctor_test(Stack* stack, FILE* stream);
 enum errorCode push_test(Stack* stack, FILE* stream);
 enum errorCode pop_test(Stack* stack, FILE* stream);
 enum errorCode dtor_test(Stack* stack, FILE* stream);
+enum errorCode hash_test(FILE* stream);
+enum errorCode hash_backend_test(FILE* stream);
+enum errorCode hash_tree_test(FILE* stream);
+enum errorCode poison_test(FILE* stream);
+enum errorCode protection_test(FILE* stream);
+enum errorCode bulk_test(FILE* stream);
+enum errorCode growth_test(FILE* stream);
+enum errorCode segmented_test(FILE* stream);
+enum errorCode mapped_test(FILE* stream);
+enum errorCode guarded_test(FILE* stream);
+enum errorCode snapshot_test(FILE* stream);
+enum errorCode clone_test(FILE* stream);
+enum errorCode incremental_test(FILE* stream);
+enum errorCode inline_test(FILE* stream);
+enum errorCode arena_test(FILE* stream);
+enum errorCode concurrent_test(FILE* stream);
+enum errorCode deque_test(FILE* stream);
+#ifdef USE_STACK_STATS
+enum errorCode stats_test(FILE* stream);
+#endif
+#ifdef USE_CALL_SITE_PROFILE
+enum errorCode call_site_test(FILE* stream);
+#endif
+#ifdef USE_BACKGROUND_VERIFY
+enum errorCode verifier_test(FILE* stream);
+#endif
+enum errorCode dump_test(FILE* stream);
+enum errorCode dump_format_test(FILE* stream);
 
 
 int main()
@@ -33,6 +71,54 @@ enum errorCode test_driver(FILE* stream)
 
     if (dtor_test(&stk, stream)) return stk.stackErrors;
 
+    if (hash_test(stream)) return BAD_DATA_HASH;
+
+    if (hash_backend_test(stream)) return BAD_DATA_HASH;
+
+    if (hash_tree_test(stream)) return BAD_DATA_HASH;
+
+    if (poison_test(stream)) return BAD_DATA_HASH;
+
+    if (protection_test(stream)) return BAD_DATA_HASH;
+
+
+    if (bulk_test(stream)) return BAD_DATA_HASH;
+
+    if (growth_test(stream)) return BAD_DATA_HASH;
+
+    if (segmented_test(stream)) return BAD_DATA_HASH;
+
+    if (mapped_test(stream)) return BAD_DATA_HASH;
+    if (guarded_test(stream)) return BAD_DATA_HASH;
+    if (snapshot_test(stream)) return BAD_DATA_HASH;
+    if (clone_test(stream)) return BAD_DATA_HASH;
+
+    if (incremental_test(stream)) return BAD_DATA_HASH;
+
+    if (inline_test(stream)) return BAD_DATA_HASH;
+
+    if (arena_test(stream)) return BAD_DATA_HASH;
+
+    if (concurrent_test(stream)) return BAD_DATA_HASH;
+
+    if (deque_test(stream)) return BAD_DATA_HASH;
+
+    #ifdef USE_STACK_STATS
+    if (stats_test(stream)) return BAD_DATA_HASH;
+    #endif
+
+    #ifdef USE_CALL_SITE_PROFILE
+    if (call_site_test(stream)) return BAD_DATA_HASH;
+    #endif
+
+    #ifdef USE_BACKGROUND_VERIFY
+    if (verifier_test(stream)) return BAD_DATA_HASH;
+    #endif
+
+    if (dump_test(stream)) return BAD_DATA_HASH;
+
+    if (dump_format_test(stream)) return BAD_DATA_HASH;
+
     color_fprintf(stream, COLOR_GREEN, STYLE_BOLD, "Test successfull!\n");
 
     return NO_ERRORS;
@@ -99,3 +185,2104 @@ enum errorCode dtor_test(Stack* stack, FILE* stream)
 
     return NO_ERRORS;
 }
+
+/// @brief Opens /dev/null for dumps of deliberately broken stacks, fallback is returned if it can't be opened
+static FILE* null_stream_open(FILE* fallback)
+{
+    FILE* null = fopen("/dev/null", "w");
+
+    return null ? null : fallback;
+}
+
+/// @brief Closes stream of null_stream_open unless it is fallback
+static void null_stream_close(FILE* null, FILE* fallback)
+{
+    if (null != fallback) fclose(null);
+}
+
+/// @brief Clears errors of deliberate corruption once it is undone and rehashes stack, so that it verifies again
+static void reset_after_corruption(Stack* stack)
+{
+    stack->stackErrors = NO_ERRORS;
+
+    #ifdef USE_HASH_PROTECTION
+    if (stack->protection >= PROTECTION_HASH) calculate_hash(stack);
+    #endif
+}
+
+enum errorCode hash_test(FILE* stream)
+{
+    #ifdef USE_HASH_PROTECTION
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 10);
+
+    for (int i = 0; i < 100; i++) STACK_PUSH(&stk, i);
+    for (int i = 0; i < 50;  i++) STACK_POP(&stk);
+
+    if (STACK_VERIFY(&stk))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Hash test failed(valid stack marked as corrupted)!\n");
+
+        return stk.stackErrors;
+    }
+
+    #ifdef USE_CANARY_PROTECTION
+    ((elem_t*) ((canary_t*) stk.data + 1))[7] = 7777;
+    #else
+    stk.data[7] = 7777;
+    #endif
+
+    FILE* dumpStream = null_stream_open(stream);
+    errorCode err = stack_verify(&stk, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    null_stream_close(dumpStream, stream);
+
+    if (!(err & BAD_DATA_HASH))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Hash test failed(corrupted data wasn't detected)!\n");
+
+        return BAD_DATA_HASH;
+    }
+
+    #ifdef USE_CANARY_PROTECTION
+    ((elem_t*) ((canary_t*) stk.data + 1))[7] = 7;
+    #else
+    stk.data[7] = 7;
+    #endif
+    reset_after_corruption(&stk);
+
+    STACK_DTOR(&stk);
+
+    #else
+
+    (void) stream;
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+enum errorCode hash_backend_test(FILE* stream)
+{
+    #ifdef USE_HASH_PROTECTION
+
+    if (hash_bytes(HASH_CRC32C, "123456789", 9) != 0xE3069283)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Hash backend test failed(wrong crc32c check value)!\n");
+
+        return BAD_DATA_HASH;
+    }
+
+    unsigned char bytes[100] = {};
+    for (size_t i = 0; i < sizeof(bytes); i++) bytes[i] = (unsigned char) (i * 37 + 11);
+
+    for (size_t backend = 0; backend < HASH_BACKEND_COUNT; backend++)
+    {
+        for (size_t size = 0; size <= sizeof(bytes); size++)
+        {
+            hash_t hash = hash_bytes((enum hashBackend) backend, bytes, size);
+
+            hash_backend_portable(true);
+            hash_t portableHash = hash_bytes((enum hashBackend) backend, bytes, size);
+            hash_backend_portable(false);
+
+            if (hash != portableHash)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Hash backend test failed(%s and portable %s differ on %lu bytes)!\n",
+                        hash_backend_isa((enum hashBackend) backend), hash_backend_name((enum hashBackend) backend), size);
+
+                return BAD_DATA_HASH;
+            }
+
+            if (size && hash_bytes((enum hashBackend) backend, bytes, size - 1) == hash)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Hash backend test failed(%s ignores byte %lu)!\n", hash_backend_name((enum hashBackend) backend), size - 1);
+
+                return BAD_DATA_HASH;
+            }
+        }
+    }
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 100);
+
+    for (int i = 0; i < 50; i++) STACK_PUSH(&stk, i);
+
+    for (size_t backend = 0; backend < HASH_BACKEND_COUNT; backend++)
+    {
+        if (STACK_SET_HASH(&stk, (enum hashBackend) backend) || STACK_VERIFY(&stk))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Hash backend test failed(stack with %s hash marked as corrupted)!\n", hash_backend_name((enum hashBackend) backend));
+
+            return stk.stackErrors ? stk.stackErrors : BAD_STRUCT_HASH;
+        }
+    }
+
+    FILE* dumpStream = null_stream_open(stream);
+
+    stk.hashBackend = HASH_DJB2;
+    errorCode mismatch = stack_verify(&stk, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    stk.stackErrors = NO_ERRORS;
+
+    stk.hashBackend = (enum hashBackend) HASH_BACKEND_COUNT;
+    errorCode unknown = stack_verify(&stk, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    stk.stackErrors = NO_ERRORS;
+
+    null_stream_close(dumpStream, stream);
+
+    if (!(mismatch & BAD_STRUCT_HASH) || !(unknown & BAD_HASH_BACKEND))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Hash backend test failed(stack verified with wrong backend)!\n");
+
+        return BAD_STRUCT_HASH;
+    }
+
+    stk.hashBackend = HASH_CRC32C;
+    reset_after_corruption(&stk);
+
+    STACK_DTOR(&stk);
+
+    #else
+
+    (void) stream;
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+#ifdef USE_HASH_PROTECTION
+
+/// @brief Element of stack of any storage, hash tree test corrupts it in place
+static elem_t* hash_tree_element(Stack* stack, size_t index)
+{
+    if (stack->storage == STORAGE_SEGMENTED)
+    {
+        size_t start = stack->capacity;
+
+        for (struct StackChunk* chunk = stack->topChunk; chunk; chunk = chunk->prev)
+        {
+            start -= STACK_CHUNK_CAPACITY;
+            if (index >= start) return &chunk->data[index - start];
+        }
+
+        return NULL;
+    }
+
+    // Elements below pending are still in old buffer of incremental stack
+    elem_t* data = (index < stack->migration.pending) ? stack->migration.oldData : stack->data;
+
+    #ifdef USE_CANARY_PROTECTION
+    data = (elem_t*) ((canary_t*) data + 1);
+    #endif
+
+    return data + index;
+}
+
+/// @brief Looks for line in dump
+static bool hash_tree_dump_has(FILE* dump, const char* expected)
+{
+    char line[256] = "";
+
+    rewind(dump);
+
+    while (fgets(line, sizeof(line), dump))
+    {
+        if (strstr(line, expected)) return true;
+    }
+
+    return false;
+}
+
+#endif
+
+enum errorCode hash_tree_test(FILE* stream)
+{
+    #ifdef USE_HASH_PROTECTION
+
+    // Threads hash blocks of big stacks even on one-core machine
+    stack_hash_threads(3);
+
+    const enum storageMode storages[] = {STORAGE_CONTIGUOUS, STORAGE_SEGMENTED, STORAGE_INCREMENTAL};
+
+    const size_t count   = STACK_HASH_BLOCK * STACK_HASH_PARALLEL * 2 + 5;
+    const size_t block   = 37;
+    const size_t corrupt = STACK_HASH_BLOCK * block + 3;
+
+    char expected[64] = "";
+    snprintf(expected, sizeof(expected), "block %lu: elements [%lu, %lu)", block, STACK_HASH_BLOCK * block, STACK_HASH_BLOCK * (block + 1));
+
+    for (size_t storage = 0; storage < sizeof(storages) / sizeof(storages[0]); storage++)
+    {
+        Stack stk = {};
+        STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, storages[storage]);
+
+        for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+
+        // Root kept by pushes is root of tree hashed from the scratch by threads
+        hash_t dataHash = stk.dataHash;
+        calculate_hash(&stk);
+
+        if (stk.dataHash != dataHash || STACK_VERIFY(&stk))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Hash tree test failed(valid stack of storage %d marked as corrupted)!\n", (int) storages[storage]);
+
+            return BAD_DATA_HASH;
+        }
+
+        elem_t* element = hash_tree_element(&stk, corrupt);
+        *element = -1;
+
+        FILE* dump = tmpfile();
+        errorCode err = stack_verify(&stk, dump ? dump : stream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+
+        size_t blocks[2] = {};
+        size_t corrupted = 0;
+        hash_tree_verify(&stk, &corrupted, blocks, 2);
+
+        bool dumped = !dump || hash_tree_dump_has(dump, expected);
+        if (dump) fclose(dump);
+
+        if (!(err & BAD_DATA_HASH) || corrupted != 1 || blocks[0] != block || !dumped)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Hash tree test failed(storage %d: %lu corrupted blocks, first %lu, dumped %d)!\n",
+                    (int) storages[storage], corrupted, blocks[0], dumped);
+
+            return BAD_DATA_HASH;
+        }
+
+        // Failed verification keeps hash tree, so restored element matches it again
+        *element = (elem_t) corrupt;
+        stk.stackErrors = NO_ERRORS;
+
+        if (STACK_VERIFY(&stk))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Hash tree test failed(restored element of storage %d not accepted)!\n", (int) storages[storage]);
+
+            return BAD_DATA_HASH;
+        }
+
+        #ifndef NO_DEBUG
+
+        // Push checks block of top before adding to it
+        element = hash_tree_element(&stk, count - 2);
+        *element = -1;
+
+        dump = tmpfile();
+        err  = stack_push(&stk, 0, dump ? dump : stream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+        if (dump) fclose(dump);
+
+        *element = (elem_t) (count - 2);
+        stk.stackErrors = NO_ERRORS;
+
+        if (!(err & BAD_DATA_HASH) || stk.size != count || STACK_VERIFY(&stk))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Hash tree test failed(push over corrupted top block of storage %d not stopped)!\n", (int) storages[storage]);
+
+            return BAD_DATA_HASH;
+        }
+
+        #endif
+
+        for (size_t i = 0; i < count; i++) STACK_POP(&stk);
+
+        if (stk.dataHash || STACK_VERIFY(&stk))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Hash tree test failed(empty stack of storage %d has data hash)!\n", (int) storages[storage]);
+
+            return BAD_DATA_HASH;
+        }
+
+        STACK_DTOR(&stk);
+    }
+
+    stack_hash_threads(STACK_HASH_THREADS_AUTO);
+
+    #else
+
+    (void) stream;
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+enum errorCode poison_test(FILE* stream)
+{
+    elem_t elements[200] = {};
+
+    for (size_t count = 0; count <= 200; count++)
+    {
+        for (size_t broken = 0; broken <= count; broken++)
+        {
+            poison_fill(elements, count);
+            if (broken < count) elements[broken] = 0;
+
+            if (poison_find(elements, count) != broken)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Poison test failed(element %lu of %lu not found)!\n", broken, count);
+
+                return POISON_OVERWRITTEN;
+            }
+        }
+    }
+
+    #ifdef USE_POISON_CHECK
+
+    const enum storageMode storages[] = {STORAGE_CONTIGUOUS, STORAGE_SEGMENTED, STORAGE_MAPPED, STORAGE_GUARDED, STORAGE_INCREMENTAL};
+    const size_t capacities[] = {10, 100};
+
+    FILE* dumpStream = null_stream_open(stream);
+
+    for (size_t storage = 0; storage < sizeof(storages) / sizeof(storages[0]); storage++)
+    {
+        for (size_t cap = 0; cap < 2; cap++)
+        {
+            Stack stk = {};
+            STACK_CTOR_EX(&stk, capacities[cap], PROTECTION_CANARY, storages[storage]);
+
+            for (int i = 0; i < 5; i++) STACK_PUSH(&stk, i);
+
+            elem_t* data = (storages[storage] == STORAGE_SEGMENTED) ? stk.topChunk->data :
+            #ifdef USE_CANARY_PROTECTION
+                           (elem_t*) ((canary_t*) stk.data + 1);
+            #else
+                           stk.data;
+            #endif
+
+            // Stray write right above top is caught by push(without NO_DEBUG), farther one by full verification
+            data[6] = 6;
+            errorCode pushErr = stack_push(&stk, 5, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+            data[6] = ELEM_T_POISON;
+            reset_after_corruption(&stk);
+
+            data[stk.capacity - 1] = 7;
+            errorCode verifyErr = stack_verify(&stk, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+            data[stk.capacity - 1] = ELEM_T_POISON;
+            reset_after_corruption(&stk);
+
+            #ifdef NO_DEBUG
+            pushErr = POISON_OVERWRITTEN;
+            #endif
+
+            if (!(pushErr & POISON_OVERWRITTEN) || !(verifyErr & POISON_OVERWRITTEN) || STACK_VERIFY(&stk))
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Poison test failed(write above top wasn't detected, capacity %lu)!\n", stk.capacity);
+
+                null_stream_close(dumpStream, stream);
+                return POISON_OVERWRITTEN;
+            }
+
+            STACK_DTOR(&stk);
+        }
+    }
+
+    null_stream_close(dumpStream, stream);
+
+    #endif
+
+    return NO_ERRORS;
+}
+
+enum errorCode protection_test(FILE* stream)
+{
+    const enum protectionLevel levels[] = {PROTECTION_OFF, PROTECTION_CANARY, PROTECTION_HASH, PROTECTION_PARANOID};
+
+    for (size_t level = 0; level < sizeof(levels) / sizeof(levels[0]); level++)
+    {
+        Stack stk = {};
+        STACK_CTOR_PROTECTED(&stk, 4, levels[level]);
+
+        for (int i = 0; i < 300; i++)
+        {
+            if (STACK_PUSH(&stk, i))
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Protection test failed on push(level %lu)!\n", level);
+
+                return stk.stackErrors;
+            }
+        }
+
+        for (int i = 299; i >= 0; i--)
+        {
+            if (STACK_POP(&stk) != i)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Protection test failed on pop(level %lu)!\n", level);
+
+                return stk.stackErrors;
+            }
+        }
+
+        if (STACK_DTOR(&stk)) return stk.stackErrors;
+    }
+
+    return NO_ERRORS;
+}
+
+enum errorCode bulk_test(FILE* stream)
+{
+    Stack stk = {};
+    STACK_CTOR(&stk, 2);
+
+    static elem_t values[1000] = {};
+    for (int i = 0; i < 1000; i++) values[i] = i;
+
+    if (STACK_PUSH_N(&stk, values, 1000)) return stk.stackErrors;
+    if (STACK_PUSH(&stk, 1000))           return stk.stackErrors;
+
+    if (STACK_POP(&stk) != 1000 || STACK_VERIFY(&stk))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Bulk test failed(push after push_n)!\n");
+
+        return stk.stackErrors;
+    }
+
+    static elem_t popped[1000] = {};
+    if (STACK_POP_N(&stk, popped, 600)) return stk.stackErrors;
+    if (STACK_POP_N(&stk, popped + 600, 400)) return stk.stackErrors;
+
+    for (int i = 0; i < 400; i++)
+    {
+        if (popped[i + 600] != i || popped[i] != i + 400)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Bulk test failed(wrong popped values)!\n");
+
+            return BAD_DATA_HASH;
+        }
+    }
+
+    if (STACK_VERIFY(&stk) || stk.size != 0) return stk.stackErrors;
+
+    FILE* dumpStream = null_stream_open(stream);
+    errorCode err = stack_pop_n(&stk, popped, 1, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    null_stream_close(dumpStream, stream);
+
+    if (err != EMPTY_STACK)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Bulk test failed(pop from empty stack)!\n");
+
+        return BAD_DATA_HASH;
+    }
+
+    reset_after_corruption(&stk);
+
+    return STACK_DTOR(&stk);
+}
+
+enum errorCode growth_test(FILE* stream)
+{
+    const struct GrowthStrategy custom = GROWTH_GEOMETRIC("x3", 3, 1, 9);
+    const struct GrowthStrategy* strategies[] = {&GROWTH_DOUBLE, &GROWTH_ONE_AND_HALF, &GROWTH_HYSTERESIS,
+                                                 &GROWTH_NEVER_SHRINK, &GROWTH_TRIM_ONLY, &custom};
+
+    for (size_t i = 0; i < sizeof(strategies) / sizeof(strategies[0]); i++)
+    {
+        Stack stk = {};
+        STACK_CTOR(&stk, 1);
+        if (stack_set_growth(&stk, strategies[i])) return stk.stackErrors;
+
+        for (int j = 0; j < 1000; j++) STACK_PUSH(&stk, j);
+
+        size_t fullCapacity = stk.capacity;
+
+        for (int j = 999; j >= 100; j--)
+        {
+            if (STACK_POP(&stk) != j)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Growth test failed(strategy %s)!\n", strategies[i]->name);
+
+                return stk.stackErrors;
+            }
+        }
+
+        bool autoShrink = strategies[i]->shrinkDivisor != 0;
+        if (autoShrink != (stk.capacity < fullCapacity)) return CAPACITY_NOT_VALID;
+
+        if (STACK_TRIM(&stk)) return stk.stackErrors;
+
+        // Capacity may be rounded up to canary alignment
+        if (strategies[i]->allowTrim != (stk.capacity <= stk.size + 2))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Growth test failed(trim with strategy %s)!\n", strategies[i]->name);
+
+            return CAPACITY_NOT_VALID;
+        }
+
+        if (STACK_DTOR(&stk)) return stk.stackErrors;
+    }
+
+    return NO_ERRORS;
+}
+
+enum errorCode segmented_test(FILE* stream)
+{
+    Stack stk = {};
+    STACK_CTOR_EX(&stk, 1, PROTECTION_PARANOID, STORAGE_SEGMENTED);
+
+    const int count = 3 * STACK_CHUNK_CAPACITY + 100;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (STACK_PUSH(&stk, i)) return stk.stackErrors;
+    }
+
+    if (stk.capacity != 4 * STACK_CHUNK_CAPACITY) return CAPACITY_NOT_VALID;
+
+    // Pushes and pops around chunk border must not reallocate or move elements
+    for (int i = 0; i < 100; i++)
+    {
+        if (STACK_POP(&stk) != count - 1 - i) return BAD_DATA_HASH;
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        STACK_PUSH(&stk, -i);
+        STACK_POP(&stk);
+    }
+
+    static elem_t popped[2 * STACK_CHUNK_CAPACITY] = {};
+    if (STACK_POP_N(&stk, popped, 2 * STACK_CHUNK_CAPACITY)) return stk.stackErrors;
+
+    for (int i = 0; i < 2 * (int) STACK_CHUNK_CAPACITY; i++)
+    {
+        if (popped[i] != (int) STACK_CHUNK_CAPACITY + i)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Segmented test failed(wrong popped values)!\n");
+
+            return BAD_DATA_HASH;
+        }
+    }
+
+    if (STACK_PUSH_N(&stk, popped, 2 * STACK_CHUNK_CAPACITY)) return stk.stackErrors;
+
+    FILE* dumpStream = null_stream_open(stream);
+    errorCode err = stack_dump(dumpStream, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_TEXT);
+    null_stream_close(dumpStream, stream);
+
+    if (err) return err;
+
+    for (int i = 3 * (int) STACK_CHUNK_CAPACITY - 1; i >= 0; i--)
+    {
+        if (STACK_POP(&stk) != i || STACK_VERIFY(&stk))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Segmented test failed(pop %d)!\n", i);
+
+            return stk.stackErrors ? stk.stackErrors : BAD_DATA_HASH;
+        }
+    }
+
+    if (stk.capacity != STACK_CHUNK_CAPACITY || !stk.spareChunk) return CAPACITY_NOT_VALID;
+
+    if (STACK_TRIM(&stk) || stk.spareChunk) return stk.stackErrors;
+
+    return STACK_DTOR(&stk);
+}
+
+enum errorCode mapped_test(FILE* stream)
+{
+    Stack stk = {};
+    STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, STORAGE_MAPPED);
+
+    if (!stk.data || stk.reservedBytes < STACK_MAPPED_RESERVE) return NO_MEMORY;
+
+    const elem_t* data          = stk.data;
+    const size_t  startCapacity = stk.capacity;
+    const int     count         = 200000;
+
+    stack_set_huge_pages(&stk, true);
+
+    // Growth commits pages in place: buffer never moves
+    for (int i = 0; i < count; i++)
+    {
+        if (STACK_PUSH(&stk, i)) return stk.stackErrors;
+    }
+
+    if (stk.data != data || stk.capacity <= (size_t) count || STACK_VERIFY(&stk))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Mapped test failed(buffer moved or capacity %lu too small)!\n", stk.capacity);
+
+        return stk.stackErrors ? stk.stackErrors : NO_STACK_DATA_PTR;
+    }
+
+    static elem_t popped[STACK_CHUNK_CAPACITY] = {};
+    if (STACK_POP_N(&stk, popped, STACK_CHUNK_CAPACITY)) return stk.stackErrors;
+    if (STACK_PUSH_N(&stk, popped, STACK_CHUNK_CAPACITY)) return stk.stackErrors;
+
+    // Shrinking releases pages down to the first one, elements stay in place
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (STACK_POP(&stk) != i)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Mapped test failed(pop %d)!\n", i);
+
+            return stk.stackErrors ? stk.stackErrors : BAD_DATA_HASH;
+        }
+    }
+
+    if (stk.data != data || stk.capacity != startCapacity)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Mapped test failed(capacity %lu after shrink, %lu at start)!\n", stk.capacity, startCapacity);
+
+        return CAPACITY_NOT_VALID;
+    }
+
+    FILE* dumpStream = null_stream_open(stream);
+    errorCode err = stack_dump(dumpStream, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_TEXT);
+    null_stream_close(dumpStream, stream);
+
+    if (err) return err;
+
+    return STACK_DTOR(&stk);
+}
+
+enum errorCode guarded_test(FILE* stream)
+{
+    Stack stk = {};
+    STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, STORAGE_GUARDED);
+
+    if (!stk.data) return NO_MEMORY;
+
+    // Capacity fills whole pages, growth moves elements into new guarded buffer
+    for (int i = 0; i < 5000; i++)
+    {
+        if (STACK_PUSH(&stk, i)) return stk.stackErrors;
+    }
+
+    for (int i = 4999; i >= 0; i--)
+    {
+        if (STACK_POP(&stk) != i)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Guarded test failed(pop %d)!\n", i);
+
+            return stk.stackErrors ? stk.stackErrors : BAD_DATA_HASH;
+        }
+    }
+
+    if ((stk.capacity * sizeof(elem_t)) % stack_page_size() != 0 || STACK_DTOR(&stk))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Guarded test failed(capacity %lu isn't whole pages)!\n", stk.capacity);
+
+        return CAPACITY_NOT_VALID;
+    }
+
+    // Write one element past capacity faults in child, handler dumps the stack to the pipe
+    int pipeEnds[2] = {};
+    if (pipe(pipeEnds)) return NO_ERRORS;
+
+    fflush(stream);
+    pid_t child = fork();
+    if (child < 0) return NO_ERRORS;
+
+    if (child == 0)
+    {
+        close(pipeEnds[0]);
+        dup2(pipeEnds[1], STDERR_FILENO);
+
+        Stack overflowed = {};
+        STACK_CTOR_EX(&overflowed, 10, PROTECTION_DEFAULT, STORAGE_GUARDED);
+        STACK_PUSH(&overflowed, 1);
+
+        #ifdef USE_CANARY_PROTECTION
+        volatile elem_t* data = (elem_t*) ((canary_t*) overflowed.data + 1);
+        #else
+        volatile elem_t* data = overflowed.data;
+        #endif
+
+        data[overflowed.capacity] = 1;
+
+        _exit(0);
+    }
+
+    close(pipeEnds[1]);
+
+    static char output[4096] = {};
+    size_t length = 0;
+    ssize_t got   = 0;
+
+    while (length < sizeof(output) - 1 && (got = read(pipeEnds[0], output + length, sizeof(output) - 1 - length)) > 0)
+    {
+        length += (size_t) got;
+    }
+
+    close(pipeEnds[0]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    if ((WIFEXITED(status) && WEXITSTATUS(status) == 0) || !strstr(output, "overflow at") || !strstr(output, "overflowed")
+        || !strstr(output, "[0] = 1\n"))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Guarded test failed(overflow wasn't caught or dumped)!\n%s", output);
+
+        return BAD_DATA_HASH;
+    }
+
+    return NO_ERRORS;
+}
+
+/// @brief Saves stack of storage to path and checks stack loaded back, both stacks are destroyed on every path
+static enum errorCode snapshot_round_trip(FILE* stream, const char* path, enum storageMode storage, int count)
+{
+    Stack saved = {};
+    STACK_CTOR_EX(&saved, 10, PROTECTION_DEFAULT, storage);
+
+    for (int i = 0; i < count; i++) STACK_PUSH(&saved, i);
+
+    enum errorCode error = STACK_SAVE(&saved, path);
+    if (error && !saved.stackErrors) error = FILE_ERROR;
+
+    if (STACK_DTOR(&saved) || error) return error ? error : saved.stackErrors;
+
+    // Loaded buffer is file mapping until the first resize
+    Stack loaded = {};
+    STACK_LOAD(&loaded, path);
+
+    if (loaded.stackErrors || loaded.storage != STORAGE_SNAPSHOT || loaded.size != (size_t) count)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Snapshot test failed(storage %d wasn't loaded)!\n", (int) storage);
+
+        error = loaded.stackErrors ? loaded.stackErrors : FILE_ERROR;
+    }
+
+    while (!error && loaded.size < loaded.capacity - 1) STACK_PUSH(&loaded, (elem_t) loaded.size);
+    if (!error && loaded.storage != STORAGE_SNAPSHOT) error = BAD_DATA_HASH;
+
+    if (!error) STACK_PUSH(&loaded, (elem_t) loaded.size);
+
+    for (int i = (int) loaded.size - 1; !error && i >= 0; i--)
+    {
+        if (STACK_POP(&loaded) == i) continue;
+
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Snapshot test failed(pop %d of storage %d)!\n", i, (int) storage);
+
+        error = loaded.stackErrors ? loaded.stackErrors : BAD_DATA_HASH;
+    }
+
+    if (!error && loaded.storage != STORAGE_CONTIGUOUS) error = BAD_DATA_HASH;
+
+    // Failed load leaves nothing mapped, loaded stack is unmapped by its destructor
+    if (loaded.data && STACK_DTOR(&loaded) && !error) error = loaded.stackErrors;
+
+    return error;
+}
+
+enum errorCode snapshot_test(FILE* stream)
+{
+    const enum storageMode storages[] = {STORAGE_CONTIGUOUS, STORAGE_SEGMENTED, STORAGE_GUARDED, STORAGE_INCREMENTAL};
+    const int              count      = 3000;
+
+    char path[] = "/tmp/stack_snapshot_test_XXXXXX";
+
+    int descriptor = mkstemp(path);
+    if (descriptor < 0) return FILE_ERROR;
+
+    close(descriptor);
+
+    enum errorCode error = NO_ERRORS;
+
+    for (size_t storage = 0; !error && storage < sizeof(storages) / sizeof(storages[0]); storage++)
+    {
+        error = snapshot_round_trip(stream, path, storages[storage], count);
+    }
+
+    #ifdef USE_HASH_PROTECTION
+
+    // Flipped element makes snapshot rejected
+    FILE* snapshot = error ? NULL : fopen(path, "r+b");
+    if (snapshot)
+    {
+        struct StackSnapshotHeader header = {};
+        elem_t value = 0;
+
+        if (fread(&header, sizeof(header), 1, snapshot) == 1 && !fseek(snapshot, (long) header.dataOffset + 64, SEEK_SET) &&
+            fread(&value, sizeof(value), 1, snapshot) == 1 && !fseek(snapshot, (long) header.dataOffset + 64, SEEK_SET))
+        {
+            value ^= 1;
+            fwrite(&value, sizeof(value), 1, snapshot);
+        }
+
+        fclose(snapshot);
+
+        FILE* errorStream = null_stream_open(stream);
+        Stack corrupted   = {};
+
+        errorCode err = stack_load(&corrupted, path, errorStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+
+        // Rejected snapshot stays mapped in constructed stack
+        if (corrupted.data) stack_dtor(&corrupted, errorStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+
+        null_stream_close(errorStream, stream);
+
+        if (err != BAD_DATA_HASH)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Snapshot test failed(corrupted snapshot wasn't rejected, error %d)!\n", (int) err);
+
+            error = BAD_DATA_HASH;
+        }
+    }
+
+    #endif
+
+    unlink(path);
+
+    return error;
+}
+
+enum errorCode clone_test(FILE* stream)
+{
+    const enum storageMode storages[] = {STORAGE_CONTIGUOUS, STORAGE_SEGMENTED, STORAGE_MAPPED, STORAGE_GUARDED, STORAGE_INCREMENTAL};
+    const int              counts[]   = {10, 5000};
+
+    for (size_t storage = 0; storage < sizeof(storages) / sizeof(storages[0]); storage++)
+    {
+        for (size_t countIndex = 0; countIndex < sizeof(counts) / sizeof(counts[0]); countIndex++)
+        {
+            const int count = counts[countIndex];
+
+            Stack stk = {};
+            STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, storages[storage]);
+
+            for (int i = 0; i < count; i++) STACK_PUSH(&stk, i);
+
+            Stack clone = {};
+            STACK_CLONE(&clone, &stk);
+
+            if (clone.stackErrors || clone.size != stk.size)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Clone test failed(storage %d, %d elements)!\n", (int) storages[storage], count);
+
+                return clone.stackErrors ? clone.stackErrors : BAD_DATA_HASH;
+            }
+
+            // Contiguous heap buffer and segmented chunks are shared until the first write
+            bool shared = (storages[storage] == STORAGE_SEGMENTED) ? clone.topChunk == stk.topChunk :
+                          (storages[storage] == STORAGE_CONTIGUOUS && count > (int) STACK_INLINE_CAPACITY) ? clone.data == stk.data : true;
+
+            // Hash tree of stack that isn't copied element by element is shared too
+            #ifdef USE_HASH_PROTECTION
+            if ((storages[storage] == STORAGE_SEGMENTED || storages[storage] == STORAGE_CONTIGUOUS) &&
+                clone.hashTree != stk.hashTree) shared = false;
+            #endif
+
+            // Clone backtracks below the chunk border and goes another way, original keeps its elements
+            for (int i = 0; i < count / 2 + 1; i++) STACK_POP(&clone);
+            for (int i = count / 2 - 1; i < count; i++) STACK_PUSH(&clone, -i);
+
+            Stack second = {};
+            STACK_CLONE(&second, &clone);
+
+            bool intact = shared;
+
+            for (int i = count - 1; i >= 0; i--)
+            {
+                elem_t expected = (i >= count / 2 - 1) ? -i : i;
+
+                if (STACK_POP(&stk) != i || STACK_POP(&second) != expected) intact = false;
+            }
+
+            if (!intact || STACK_VERIFY(&clone) || STACK_DTOR(&stk) || STACK_DTOR(&second))
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Clone test failed(storage %d, %d elements: %s)!\n", (int) storages[storage], count,
+                        shared ? "elements changed" : "buffer wasn't shared");
+
+                return BAD_DATA_HASH;
+            }
+
+            // The last holder of shared buffer owns it
+            STACK_PUSH(&clone, 1);
+
+            #ifdef USE_HASH_PROTECTION
+            if (clone.hashTreeRefs) return BAD_DATA_HASH;
+            #endif
+
+            if (STACK_POP(&clone) != 1 || clone.bufferRefs || STACK_DTOR(&clone)) return BAD_DATA_HASH;
+        }
+    }
+
+    return NO_ERRORS;
+}
+
+enum errorCode incremental_test(FILE* stream)
+{
+    Stack stk = {};
+    STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, STORAGE_INCREMENTAL);
+
+    const int count   = 100000;
+    bool      checked = false;
+
+    for (int i = 0; i < count; i++)
+    {
+        size_t capacity = stk.capacity;
+        size_t pending  = stk.migration.pending;
+
+        if (STACK_PUSH(&stk, i)) return stk.stackErrors;
+
+        // Growing push leaves all elements but one step in old buffer, other pushes move one step at most
+        if (stk.capacity != capacity) pending = (size_t) i;
+
+        if (pending - stk.migration.pending > STACK_MIGRATE_STEP)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Incremental test failed(push %d moved %lu elements)!\n", i, pending - stk.migration.pending);
+
+            return SIZE_OUT_OF_CAPACITY;
+        }
+
+        if (checked || stk.migration.pending < 3000) continue;
+
+        checked = true;
+
+        // Stack in the middle of migration is dumped, verified in full, cloned and popped across buffer border
+        FILE* dumpStream = null_stream_open(stream);
+
+        errorCode dumpErr   = stack_dump(dumpStream, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_TEXT);
+        errorCode canaryErr = LEFT_DATA_CANARY_BAD_VALUE;
+
+        #ifdef USE_CANARY_PROTECTION
+
+        canary_t* oldCanary = (canary_t*) stk.migration.oldData;
+
+        *oldCanary = 0;
+        canaryErr  = stack_verify(&stk, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+        *oldCanary = CANARY_T_DEFAULT;
+
+        reset_after_corruption(&stk);
+
+        #endif
+
+        null_stream_close(dumpStream, stream);
+
+        if (dumpErr || !(canaryErr & LEFT_DATA_CANARY_BAD_VALUE))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Incremental test failed(dump or check of old buffer canary)!\n");
+
+            return LEFT_DATA_CANARY_BAD_VALUE;
+        }
+
+        Stack clone = {};
+        STACK_CLONE(&clone, &stk);
+
+        static elem_t popped[2000] = {};
+        size_t border = stk.migration.pending;
+
+        if (STACK_VERIFY(&stk) || STACK_POP_N(&stk, popped, 2000) || stk.migration.pending >= border ||
+            STACK_PUSH_N(&stk, popped, 2000))
+        {
+            return stk.stackErrors ? stk.stackErrors : SIZE_OUT_OF_CAPACITY;
+        }
+
+        for (int j = i; j >= 0; j--)
+        {
+            if (STACK_POP(&clone) != j)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Incremental test failed(clone pop %d)!\n", j);
+
+                return clone.stackErrors ? clone.stackErrors : BAD_DATA_HASH;
+            }
+        }
+
+        if (STACK_DTOR(&clone)) return BAD_DATA_HASH;
+    }
+
+    if (!checked || STACK_VERIFY(&stk)) return stk.stackErrors ? stk.stackErrors : SIZE_OUT_OF_CAPACITY;
+
+    // Pops read elements left in old buffer of shrink migrations
+    for (int i = count - 1; i >= 0; i--)
+    {
+        size_t capacity = stk.capacity;
+        size_t pending  = stk.migration.pending;
+
+        if (STACK_POP(&stk) != i || (stk.capacity == capacity && pending - stk.migration.pending > STACK_MIGRATE_STEP + 1))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Incremental test failed(pop %d)!\n", i);
+
+            return stk.stackErrors ? stk.stackErrors : BAD_DATA_HASH;
+        }
+    }
+
+    if (stk.capacity > (size_t) count / 16 || STACK_TRIM(&stk) || stk.migration.oldData || STACK_VERIFY(&stk))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Incremental test failed(capacity %lu after pops)!\n", stk.capacity);
+
+        return CAPACITY_NOT_VALID;
+    }
+
+    if (STACK_DTOR(&stk)) return BAD_DATA_HASH;
+
+    // Slow growth leaves few pushes for migration, step grows so that it still ends before the next growth
+    const struct GrowthStrategy slow = GROWTH_GEOMETRIC("x1.05", 21, 20, 0);
+
+    STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, STORAGE_INCREMENTAL);
+    stack_set_growth(&stk, &slow);
+
+    static elem_t values[64] = {};
+
+    const int slowCount = 20000 / 64 * 64;
+
+    // Odd blocks are pushed by one push_n(it completes migration itself before growth), even blocks element by element
+    for (int i = 0; i < slowCount; i++)
+    {
+        size_t capacity  = stk.capacity;
+        bool   migrating = stk.migration.oldData || stk.migration.poisoned < stk.capacity;
+        bool   bulk      = (i / 64) % 2;
+
+        if (bulk) for (int j = 0; j < 64; j++) values[j] = i + j;
+
+        if ((bulk ? STACK_PUSH_N(&stk, values, 64) : STACK_PUSH(&stk, i)) || (!bulk && stk.capacity != capacity && migrating))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Incremental test failed(growth at %lu found migration unfinished)!\n", stk.size);
+
+            return SIZE_OUT_OF_CAPACITY;
+        }
+
+        if (bulk) i += 63;
+    }
+
+    for (int i = slowCount - 1; i >= 0; i--)
+    {
+        if (STACK_POP(&stk) != i)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Incremental test failed(slow growth pop %d)!\n", i);
+
+            return BAD_DATA_HASH;
+        }
+    }
+
+    return STACK_DTOR(&stk);
+}
+
+enum errorCode inline_test(FILE* stream)
+{
+    #ifdef USE_INLINE_BUFFER
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+
+    if (!stack_data_inline(&stk) || stk.capacity != STACK_INLINE_CAPACITY) return NO_STACK_DATA_PTR;
+
+    for (int i = 0; i + 1 < (int) STACK_INLINE_CAPACITY; i++)
+    {
+        if (STACK_PUSH(&stk, i)) return stk.stackErrors;
+    }
+
+    if (!stack_data_inline(&stk)) return NO_STACK_DATA_PTR;
+
+    // Next push spills data to heap, pops move it back
+    for (int i = (int) STACK_INLINE_CAPACITY - 1; i < 100; i++)
+    {
+        if (STACK_PUSH(&stk, i)) return stk.stackErrors;
+    }
+
+    if (stack_data_inline(&stk)) return NO_STACK_DATA_PTR;
+
+    for (int i = 99; i >= 0; i--)
+    {
+        if (STACK_POP(&stk) != i || STACK_VERIFY(&stk))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Inline test failed(pop %d)!\n", i);
+
+            return stk.stackErrors ? stk.stackErrors : BAD_DATA_HASH;
+        }
+    }
+
+    if (!stack_data_inline(&stk)) return NO_STACK_DATA_PTR;
+
+    #ifdef USE_CANARY_PROTECTION
+
+    STACK_PUSH(&stk, 1);
+    stk.inlineBuffer.rightCanary = 0;
+
+    FILE* dumpStream = null_stream_open(stream);
+    errorCode err = stack_verify(&stk, dumpStream, __FILE__, __LINE__, __PRETTY_FUNCTION__);
+    null_stream_close(dumpStream, stream);
+
+    if (!(err & RIGHT_DATA_CANARY_BAD_VALUE))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Inline test failed(inline canary corruption wasn't detected)!\n");
+
+        return BAD_DATA_HASH;
+    }
+
+    stk.inlineBuffer.rightCanary = CANARY_T_DEFAULT;
+    reset_after_corruption(&stk);
+
+    #endif
+
+    return STACK_DTOR(&stk);
+
+    #else
+
+    (void) stream;
+    return NO_ERRORS;
+
+    #endif
+}
+
+enum errorCode arena_test(FILE* stream)
+{
+    StackArena arena = {};
+    if (stack_arena_ctor(&arena)) return NO_STACK_PTR;
+
+    // Array of stacks is bigger than maximum object size of debug build
+    const size_t stacksCount = 32;
+
+    Stack* stacks = (Stack*) calloc(stacksCount, sizeof(Stack));
+    if (!stacks) return NO_MEMORY;
+
+    for (size_t i = 0; i < stacksCount; i++)
+    {
+        enum storageMode storage = (i % 8 == 7) ? STORAGE_SEGMENTED : STORAGE_CONTIGUOUS;
+        STACK_CTOR_ALLOC(&stacks[i], 1, PROTECTION_DEFAULT, storage, &arena.allocator);
+
+        for (int j = 0; j < (int) (i * i * 8); j++)
+        {
+            if (STACK_PUSH(&stacks[i], j)) return stacks[i].stackErrors;
+        }
+    }
+
+    // Half of stacks are destructed one by one, their blocks are reused by new pushes
+    for (size_t i = 0; i < stacksCount; i += 2)
+    {
+        if (STACK_DTOR(&stacks[i])) return stacks[i].stackErrors;
+    }
+
+    for (size_t i = 0; i < stacksCount; i += 2)
+    {
+        STACK_CTOR_ARENA(&stacks[i], 1, &arena);
+
+        for (int j = 0; j < (int) (i * 8); j++)
+        {
+            if (STACK_PUSH(&stacks[i], j)) return stacks[i].stackErrors;
+        }
+    }
+
+    // Freed block is the first one given for the same size class
+    Stack stk = {};
+    STACK_CTOR_ARENA(&stk, 100, &arena);
+    elem_t* data = stk.data;
+
+    if (STACK_DTOR(&stk)) return stk.stackErrors;
+    STACK_CTOR_ARENA(&stk, 100, &arena);
+
+    if (stk.data != data)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Arena test failed(freed block wasn't reused)!\n");
+
+        return NO_MEMORY;
+    }
+
+    for (size_t i = 1; i < stacksCount; i += 2)
+    {
+        for (int j = (int) (i * i * 8) - 1; j >= 0; j--)
+        {
+            if (STACK_POP(&stacks[i]) != j)
+            {
+                color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+                fprintf(stream, "Arena test failed(wrong popped value in stack %lu)!\n", i);
+
+                return stacks[i].stackErrors ? stacks[i].stackErrors : BAD_DATA_HASH;
+            }
+        }
+
+        if (STACK_VERIFY(&stacks[i])) return stacks[i].stackErrors;
+    }
+
+    free(stacks);
+
+    // All stacks are released together with arena
+    if (stack_arena_dtor(&arena) || arena.reserved || arena.used) return NO_MEMORY;
+
+    return NO_ERRORS;
+}
+
+/// @brief Pushes count values and pops every second one, adds popped values to popSum
+static void concurrent_worker(ConcurrentStack* stack, int first, int count, long long* popSum)
+{
+    for (int i = 0; i < count; i++)
+    {
+        CSTACK_PUSH(stack, first + i);
+
+        elem_t value = 0;
+        if (i % 2 && CSTACK_POP(stack, &value) == NO_ERRORS) *popSum += value;
+    }
+}
+
+enum errorCode concurrent_test(FILE* stream)
+{
+    ConcurrentStack stk = {};
+    CSTACK_CTOR(&stk);
+
+    elem_t value = 0;
+    if (CSTACK_POP(&stk, &value) != EMPTY_STACK || value != ELEM_T_POISON) return EMPTY_STACK;
+
+    const int threadsCount = 4;
+    const int count        = 20000;
+
+    std::thread threads[threadsCount];
+    long long   popSums[threadsCount] = {};
+
+    for (int i = 0; i < threadsCount; i++)
+    {
+        threads[i] = std::thread(concurrent_worker, &stk, i * count, count, &popSums[i]);
+    }
+
+    long long sum = 0;
+    for (int i = 0; i < threadsCount; i++)
+    {
+        threads[i].join();
+        sum += popSums[i];
+    }
+
+    while (CSTACK_POP(&stk, &value) == NO_ERRORS) sum += value;
+
+    long long expected = (long long) threadsCount * count * (threadsCount * count - 1) / 2;
+
+    if (sum != expected || CSTACK_VERIFY(&stk))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Concurrent test failed(sum of popped values %lld, expected %lld)!\n", sum, expected);
+
+        return BAD_DATA_HASH;
+    }
+
+    // Stack order in one thread
+    for (int i = 0; i < 100; i++) CSTACK_PUSH(&stk, i);
+    for (int i = 99; i >= 50; i--)
+    {
+        if (CSTACK_POP(&stk, &value) || value != i) return BAD_DATA_HASH;
+    }
+
+    if (CSTACK_DTOR(&stk)) return BAD_DATA_HASH;
+
+    // Workers have exited, nothing holds hazard pointers, so their retired nodes are freed as well
+    if (cstack_retired_count())
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Concurrent test failed(%lu retired nodes left after destruction)!\n", cstack_retired_count());
+
+        return NO_MEMORY;
+    }
+
+    return NO_ERRORS;
+}
+
+/// @brief Steals until owner is done and deque is empty, marks stolen values
+static void deque_thief(WorkDeque* deque, std::atomic<bool>* done, std::atomic<char>* seen)
+{
+    elem_t value = 0;
+
+    while (true)
+    {
+        bool finished = done->load();
+
+        if (WDEQUE_STEAL(deque, &value) == NO_ERRORS) seen[value]++;
+        else if (finished) break;
+    }
+}
+
+enum errorCode deque_test(FILE* stream)
+{
+    WorkDeque deque = {};
+    WDEQUE_CTOR(&deque, 3);
+
+    elem_t value = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        if (WDEQUE_PUSH(&deque, i)) return BAD_DATA_HASH;
+    }
+
+    // Owner end is LIFO, thief end is FIFO
+    for (int i = 999; i >= 500; i--)
+    {
+        if (WDEQUE_POP(&deque, &value) || value != i) return BAD_DATA_HASH;
+    }
+    for (int i = 0; i < 500; i++)
+    {
+        if (WDEQUE_STEAL(&deque, &value) || value != i) return BAD_DATA_HASH;
+    }
+
+    if (WDEQUE_POP(&deque, &value) != EMPTY_STACK || WDEQUE_STEAL(&deque, &value) != EMPTY_STACK) return EMPTY_STACK;
+
+    // Every value is taken exactly once by owner or by one of thieves
+    const int count        = 8000;
+    const int thievesCount = 3;
+
+    static std::atomic<char> seen[count] = {};
+    std::atomic<bool> done(false);
+
+    std::thread thieves[thievesCount];
+    for (int i = 0; i < thievesCount; i++) thieves[i] = std::thread(deque_thief, &deque, &done, seen);
+
+    for (int i = 0; i < count; i++)
+    {
+        WDEQUE_PUSH(&deque, i);
+        if (i % 3 == 0 && WDEQUE_POP(&deque, &value) == NO_ERRORS) seen[value]++;
+    }
+
+    while (WDEQUE_POP(&deque, &value) == NO_ERRORS) seen[value]++;
+
+    done.store(true);
+    for (int i = 0; i < thievesCount; i++) thieves[i].join();
+
+    for (int i = 0; i < count; i++)
+    {
+        if (seen[i] != 1)
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Deque test failed(value %d taken %d times)!\n", i, (int) seen[i]);
+
+            return BAD_DATA_HASH;
+        }
+    }
+
+    if (WDEQUE_VERIFY(&deque)) return BAD_DATA_HASH;
+
+    return WDEQUE_DTOR(&deque);
+}
+
+#ifdef USE_STACK_STATS
+
+enum errorCode stats_test(FILE* stream)
+{
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+
+    for (elem_t i = 0; i < 1000; i++) STACK_PUSH(&stk, i);
+    for (elem_t i = 0; i < 1000; i++) STACK_POP(&stk);
+
+    struct StackStats stats = {};
+    stack_stats(&stk, &stats);
+
+    if (stats.pushes != 1000 || stats.pops != 1000 || stats.peakSize != 1000 || stats.peakCapacity <= 1000 ||
+        !stats.grows || !stats.shrinks || stats.reallocLatency.count != stats.grows + stats.shrinks)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Stats test failed(pushes %lu, pops %lu, peak size %lu, peak capacity %lu, grows %lu, shrinks %lu)!\n",
+                stats.pushes, stats.pops, stats.peakSize, stats.peakCapacity, stats.grows, stats.shrinks);
+
+        STACK_DTOR(&stk);
+        return BAD_DATA_HASH;
+    }
+
+    #ifndef NO_DEBUG
+
+    if ((PROTECTION_DEFAULT != PROTECTION_OFF && !stats.verifies) || stats.verifyLatency.count != stats.verifies)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Stats test failed(%lu verifies, %lu measured)!\n", stats.verifies, stats.verifyLatency.count);
+
+        STACK_DTOR(&stk);
+        return BAD_DATA_HASH;
+    }
+
+    #endif
+
+    #ifdef USE_HASH_PROTECTION
+
+    if (stats.hashedBytes < 1000 * sizeof(struct Stack) || !stats.hashLatency.count)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Stats test failed(%lu bytes hashed)!\n", stats.hashedBytes);
+
+        STACK_DTOR(&stk);
+        return BAD_DATA_HASH;
+    }
+
+    // Full rehash is one latency sample, its struct hash isn't recorded separately
+    size_t hashes = stats.hashLatency.count;
+
+    calculate_hash(&stk);
+    stack_stats(&stk, &stats);
+
+    if (stats.hashLatency.count != hashes + 1)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Stats test failed(full rehash recorded %lu hash latencies)!\n", stats.hashLatency.count - hashes);
+
+        STACK_DTOR(&stk);
+        return BAD_DATA_HASH;
+    }
+
+    #endif
+
+    FILE* dump = tmpfile();
+    if (dump)
+    {
+        stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_TEXT);
+        rewind(dump);
+
+        static char text[4096] = "";
+        size_t length = fread(text, 1, sizeof(text) - 1, dump);
+        text[length] = '\0';
+        fclose(dump);
+
+        if (!strstr(text, "pushes = 1000"))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Stats test failed(full dump has no counters)!\n");
+
+            STACK_DTOR(&stk);
+            return BAD_DATA_HASH;
+        }
+    }
+
+    STACK_DTOR(&stk);
+
+    if (stack_stats(&stk, &stats) != NO_MEMORY || stats.pushes)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Stats test failed(destructed stack has counters)!\n");
+
+        return BAD_DATA_HASH;
+    }
+
+    elem_t values[STACK_CHUNK_CAPACITY] = {};
+    for (size_t i = 0; i < STACK_CHUNK_CAPACITY; i++) values[i] = (elem_t) i;
+
+    STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, STORAGE_SEGMENTED);
+    for (int i = 0; i < 3; i++) STACK_PUSH_N(&stk, values, STACK_CHUNK_CAPACITY);
+    for (int i = 0; i < 3; i++) STACK_POP_N(&stk, values, STACK_CHUNK_CAPACITY);
+
+    stack_stats(&stk, &stats);
+    STACK_DTOR(&stk);
+
+    if (stats.pushes != 3 * STACK_CHUNK_CAPACITY || stats.pops != 3 * STACK_CHUNK_CAPACITY || stats.grows != 2 || stats.shrinks != 2 ||
+        stats.peakCapacity != 3 * STACK_CHUNK_CAPACITY)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Stats test failed(segmented: %lu grows, %lu shrinks, peak capacity %lu)!\n",
+                stats.grows, stats.shrinks, stats.peakCapacity);
+
+        return BAD_DATA_HASH;
+    }
+
+    return NO_ERRORS;
+}
+
+#endif
+
+#ifdef USE_CALL_SITE_PROFILE
+
+static const int CALL_SITE_WORKER_LINE = __LINE__ + 6;
+
+static void call_site_worker(int count)
+{
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+    for (elem_t i = 0; i < count; i++) STACK_PUSH(&stk, i);
+    STACK_DTOR(&stk);
+}
+
+enum errorCode call_site_test(FILE* stream)
+{
+    call_site_reset();
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 1);
+
+    const int pushLine = __LINE__ + 1;
+    for (elem_t i = 0; i < 1000; i++) STACK_PUSH(&stk, i);
+    const int popLine = __LINE__ + 1;
+    for (elem_t i = 0; i < 1000; i++) STACK_POP(&stk);
+
+    STACK_DTOR(&stk);
+
+    struct CallSite sites[8] = {};
+    size_t count = call_site_snapshot(sites, 8, CALL_SITE_BY_CALLS);
+
+    const struct CallSite* push = NULL;
+    const struct CallSite* pop  = NULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (sites[i].line == pushLine) push = &sites[i];
+        if (sites[i].line == popLine)  pop  = &sites[i];
+    }
+
+    // Realloc and resize called by push and pop are nested scopes and don't get sites of their own
+    if (count != 4 || !push || !pop || push->calls != 1000 || pop->calls != 1000 || push->op != CALL_SITE_PUSH ||
+        !push->reallocs || !pop->reallocs || push->totalNs < push->reallocNs || sites[0].calls < sites[count - 1].calls)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Call-site test failed(%lu sites, push %lu calls %lu reallocs, pop %lu calls %lu reallocs)!\n", count,
+                push ? push->calls : 0, push ? push->reallocs : 0, pop ? pop->calls : 0, pop ? pop->reallocs : 0);
+
+        return BAD_DATA_HASH;
+    }
+
+    #ifndef NO_DEBUG
+
+    if (PROTECTION_DEFAULT != PROTECTION_OFF && !push->verifyNs)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Call-site test failed(verification time of push isn't counted)!\n");
+
+        return BAD_DATA_HASH;
+    }
+
+    #endif
+
+    // Threads update counters of one site concurrently, none of calls may be lost
+    call_site_reset();
+
+    const int threadsCount = 4;
+    std::thread threads[threadsCount];
+
+    for (int i = 0; i < threadsCount; i++) threads[i] = std::thread(call_site_worker, 2000);
+    for (int i = 0; i < threadsCount; i++) threads[i].join();
+
+    count = call_site_snapshot(sites, 8, CALL_SITE_BY_CALLS);
+    push  = NULL;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (sites[i].line == CALL_SITE_WORKER_LINE) push = &sites[i];
+    }
+
+    if (!push || push->calls != threadsCount * 2000)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Call-site test failed(%lu calls of %d threads counted instead of %d)!\n",
+                push ? push->calls : 0, threadsCount, threadsCount * 2000);
+
+        return BAD_DATA_HASH;
+    }
+
+    FILE* report = tmpfile();
+    if (report)
+    {
+        call_site_report(report, CALL_SITE_BY_REALLOCS, 0);
+        rewind(report);
+
+        static char text[4096] = "";
+        size_t length = fread(text, 1, sizeof(text) - 1, report);
+        text[length] = '\0';
+        fclose(report);
+
+        if (!strstr(text, __FILE__) || !strstr(text, "push"))
+        {
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Call-site test failed(report has no call sites)!\n");
+
+            return BAD_DATA_HASH;
+        }
+    }
+
+    call_site_reset();
+
+    return NO_ERRORS;
+}
+
+#endif
+
+#ifdef USE_BACKGROUND_VERIFY
+
+/// @brief Failures seen by verifier_callback
+struct VerifierTestReport
+{
+    std::atomic<size_t> failures;   ///< Callback calls
+    enum errorCode      errors;     ///< Errors of last call
+    const char*         stackName;  ///< Homeland name of last failed stack
+};
+
+static void verifier_callback(const struct Stack* stack, enum errorCode errors, const struct StackHomeland* homeland, void* context)
+{
+    struct VerifierTestReport* report = (struct VerifierTestReport*) context;
+
+    (void) stack;
+
+    report->errors    = errors;
+    report->stackName = homeland->stackName;
+    report->failures.fetch_add(1);
+}
+
+/// @brief Grows stack to count elements and pops it back rounds times, so that buffers are reallocated under verifier
+static void verifier_worker(Stack* stack, int count, int rounds)
+{
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int i = 0; i < count; i++) STACK_PUSH(stack, i);
+        for (int i = 0; i < count; i++) STACK_POP(stack);
+    }
+}
+
+/// @brief Waits until verifier completes passes more passes, false after 5 seconds
+static bool verifier_wait(size_t passes)
+{
+    size_t target = stack_verifier_stats().passes + passes;
+
+    for (int i = 0; i < 5000; i++)
+    {
+        if (stack_verifier_stats().passes >= target) return true;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return false;
+}
+
+enum errorCode verifier_test(FILE* stream)
+{
+    static struct VerifierTestReport report = {};
+    report.failures.store(0);
+
+    FILE* failures = tmpfile();
+    if (!failures) return FILE_ERROR;
+
+    const struct StackVerifierConfig config = {1, false, failures, verifier_callback, &report};
+
+    if (stack_verifier_start(&config)) return NO_MEMORY;
+
+    Stack contiguous  = {};
+    Stack incremental = {};
+    Stack segmented   = {};
+    Stack guarded     = {};
+    Stack broken      = {};
+
+    STACK_CTOR(&contiguous, 1);
+    STACK_CTOR_EX(&incremental, 1, PROTECTION_DEFAULT, STORAGE_INCREMENTAL);
+    STACK_CTOR_EX(&segmented, 1, PROTECTION_DEFAULT, STORAGE_SEGMENTED);
+    STACK_CTOR_EX(&guarded, 1, PROTECTION_DEFAULT, STORAGE_GUARDED);
+    STACK_CTOR(&broken, 1);
+
+    for (elem_t i = 0; i < 100; i++) STACK_PUSH(&broken, i);
+
+    // Writers reallocate, free and unmap buffers while verifier reads them without waiting for it: results of reads
+    // that overlap operation are dropped, released memory is retired until verifier is done
+    std::thread first(verifier_worker, &contiguous, 3000, 20);
+    std::thread second(verifier_worker, &incremental, 3000, 20);
+    std::thread third(verifier_worker, &segmented, 3000, 20);
+    std::thread fourth(verifier_worker, &guarded, 3000, 20);
+
+    first.join();
+    second.join();
+    third.join();
+    fourth.join();
+
+    if (!verifier_wait(2) || report.failures.load() || !stack_watched(&contiguous) || !stack_verifier_stats().checks)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Verifier test failed(%lu failures on valid stacks, %lu checks)!\n", report.failures.load(),
+                stack_verifier_stats().checks);
+
+        return BAD_DATA_HASH;
+    }
+
+    // Capacity cut down to size is caught in every build(buffer is still read within its bounds)
+    size_t capacity = broken.capacity;
+
+    {
+        STACK_WRITE_SCOPE(&broken);
+        broken.capacity = broken.size;
+    }
+
+    bool caught = verifier_wait(2) && report.failures.load() == 1 && (report.errors & SIZE_OUT_OF_CAPACITY) &&
+                  !strcmp(report.stackName, "&broken");
+
+    // Errors are reported once
+    bool once = verifier_wait(2) && report.failures.load() == 1;
+
+    {
+        STACK_WRITE_SCOPE(&broken);
+        broken.capacity = capacity;
+    }
+
+    stack_verifier_stop();
+
+    fseek(failures, 0, SEEK_END);
+    bool printed = ftell(failures) > 0;
+    fclose(failures);
+
+    if (!caught || !once || !printed || stack_watched(&broken))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Verifier test failed(broken stack: caught %d, reported once %d, printed %d)!\n", caught, once, printed);
+
+        return BAD_DATA_HASH;
+    }
+
+    STACK_DTOR(&broken);
+    STACK_DTOR(&guarded);
+    STACK_DTOR(&segmented);
+    STACK_DTOR(&incremental);
+    STACK_DTOR(&contiguous);
+
+    return NO_ERRORS;
+}
+
+#endif
+
+/// @brief Dumps stack count times(threads of rate limit test)
+static void dump_repeat_worker(FILE* dump, const Stack* stack, int count)
+{
+    for (int i = 0; i < count; i++) stack_dump(dump, stack, __FILE__, __PRETTY_FUNCTION__, __LINE__, SHORT, DUMP_TEXT);
+}
+
+/// @brief Counts lines of dump containing expected
+static size_t dump_count(FILE* dump, const char* expected)
+{
+    char line[256] = "";
+    size_t count = 0;
+
+    rewind(dump);
+
+    while (fgets(line, sizeof(line), dump))
+    {
+        if (strstr(line, expected)) count++;
+    }
+
+    return count;
+}
+
+enum errorCode dump_test(FILE* stream)
+{
+    const size_t count = 10;
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 1000);
+
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+
+    FILE* dump = tmpfile();
+    if (!dump) return FILE_ERROR;
+
+    // Poison above top of FULL dump takes one line, element at top keeps its marker
+    stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_TEXT);
+
+    char expected[64] = "";
+    snprintf(expected, sizeof(expected), "[%lu..%lu] = POISON(%lu elements)", count + 1, stk.capacity - 1, stk.capacity - count - 1);
+
+    size_t collapsed = dump_count(dump, expected);
+    size_t top       = dump_count(dump, ">[10] = POISON");
+    size_t elements  = dump_count(dump, "] = ");
+
+    fclose(dump);
+
+    if (stk.protection >= PROTECTION_CANARY && (collapsed != 1 || top != 1 || elements != count + 2))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Dump test failed(poison run printed %lu times, %lu element lines)!\n", collapsed, elements);
+
+        return BAD_DATA_HASH;
+    }
+
+    // Repeated dumps of stack with the same errors are skipped during period
+    dump = tmpfile();
+    if (!dump) return FILE_ERROR;
+
+    stack_dump_limit(200);
+    stk.stackErrors = EMPTY_STACK;
+
+    for (int i = 0; i < 5; i++) stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, SHORT, DUMP_TEXT);
+
+    size_t limited = dump_count(dump, "size = ");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, SHORT, DUMP_TEXT);
+
+    size_t suppressed = dump_count(dump, "4 identical dumps of this stack suppressed");
+
+    fclose(dump);
+
+    if (limited != 1 || suppressed != 1)
+    {
+        stack_dump_limit(0);
+        reset_after_corruption(&stk);
+
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Dump test failed(%lu of 5 repeated dumps printed, suppressed reported %lu times)!\n", limited, suppressed);
+
+        return BAD_DATA_HASH;
+    }
+
+    // Threads dumping the same stack together lose no skipped dump
+    dump = tmpfile();
+    if (!dump) return FILE_ERROR;
+
+    stack_dump_limit(500);
+
+    std::thread repeaters[4];
+    for (size_t i = 0; i < 4; i++) repeaters[i] = std::thread(dump_repeat_worker, dump, &stk, 50);
+    for (size_t i = 0; i < 4; i++) repeaters[i].join();
+
+    limited = dump_count(dump, "size = ");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(550));
+    stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, SHORT, DUMP_TEXT);
+
+    suppressed = dump_count(dump, "199 identical dumps of this stack suppressed");
+
+    stack_dump_limit(0);
+    reset_after_corruption(&stk);
+
+    fclose(dump);
+
+    if (limited != 1 || suppressed != 1)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Dump test failed(%lu of 200 concurrent repeated dumps printed, %lu skipped ones reported)!\n",
+                limited, suppressed);
+
+        return BAD_DATA_HASH;
+    }
+
+    // Logger thread writes every report handed to it
+    dump = tmpfile();
+    if (!dump) return FILE_ERROR;
+
+    const struct StackLoggerConfig config = {NULL};
+    if (stack_logger_start(&config)) return NO_MEMORY;
+
+    for (int i = 0; i < 20; i++) stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_TEXT);
+
+    stack_logger_flush();
+    struct StackLoggerStats stats = stack_logger_stats();
+
+    stack_logger_stop();
+
+    size_t logged = dump_count(dump, "Stack: ");
+
+    fclose(dump);
+
+    if (stats.posted != 20 || stats.written != 20 || stats.dropped || logged != 20)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Dump test failed(logger posted %lu, wrote %lu, dropped %lu, %lu dumps in file)!\n",
+                stats.posted, stats.written, stats.dropped, logged);
+
+        return BAD_DATA_HASH;
+    }
+
+    STACK_DTOR(&stk);
+
+    return NO_ERRORS;
+}
+
+/// @brief Decodes binary records of dump into text, returns NULL if decoder rejects them
+static FILE* dump_format_decode(FILE* dump)
+{
+    FILE* text = tmpfile();
+    if (!text) return NULL;
+
+    rewind(dump);
+
+    if (stack_dump_decode(dump, text))
+    {
+        fclose(text);
+        return NULL;
+    }
+
+    return text;
+}
+
+/// @brief Reads whole dump into null-terminated string(JSON object takes one long line)
+static char* dump_format_read(FILE* dump)
+{
+    fseek(dump, 0, SEEK_END);
+    long bytes = ftell(dump);
+    if (bytes < 0) return NULL;
+
+    char* text = (char*) calloc((size_t) bytes + 1, 1);
+    if (!text) return NULL;
+
+    rewind(dump);
+
+    if (fread(text, 1, (size_t) bytes, dump) != (size_t) bytes)
+    {
+        free(text);
+        return NULL;
+    }
+
+    return text;
+}
+
+enum errorCode dump_format_test(FILE* stream)
+{
+    const size_t count = 10;
+
+    Stack stk = {};
+    STACK_CTOR(&stk, 1000);
+
+    for (size_t i = 0; i < count; i++) STACK_PUSH(&stk, (elem_t) i);
+
+    bool poisoned = stk.protection >= PROTECTION_CANARY;
+
+    // Binary record: header, strings, literal run of elements and one run for poison above them
+    FILE* dump = tmpfile();
+    if (!dump) return FILE_ERROR;
+
+    errorCode err = stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_BINARY);
+
+    struct StackDumpHeader header = {};
+    rewind(dump);
+    bool read = fread(&header, sizeof(header), 1, dump) == 1;
+
+    fseek(dump, 0, SEEK_END);
+    long bytes = ftell(dump);
+
+    if (err || !read || memcmp(header.magic, STACK_DUMP_MAGIC, sizeof(header.magic)) || header.size != count ||
+        header.elements != stk.capacity || header.recordBytes != (unsigned long long) bytes || (poisoned && header.runs != 2))
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Dump format test failed(binary record of %ld bytes, %llu runs, %llu elements)!\n",
+                bytes, header.runs, header.elements);
+
+        return BAD_DATA_HASH;
+    }
+
+    // Decoder prints record as text dump does
+    FILE* text = dump_format_decode(dump);
+
+    char expected[64] = "";
+    snprintf(expected, sizeof(expected), "[%lu..%lu] = POISON(%lu elements)", count + 1, stk.capacity - 1, stk.capacity - count - 1);
+
+    bool decoded = text && dump_count(text, "*[9] = 9") == 1 && dump_count(text, "&stk") == 1 &&
+                   (!poisoned || (dump_count(text, expected) == 1 && dump_count(text, ">[10] = POISON") == 1));
+
+    if (text) fclose(text);
+
+    // Truncated record is rejected
+    FILE* truncated = tmpfile();
+    bool rejected = false;
+
+    if (truncated)
+    {
+        char buffer[256] = "";
+
+        rewind(dump);
+        size_t part = fread(buffer, 1, sizeof(header) + 8, dump);
+        fwrite(buffer, 1, part, truncated);
+
+        text = dump_format_decode(truncated);
+        rejected = !text;
+
+        if (text) fclose(text);
+        fclose(truncated);
+    }
+
+    fclose(dump);
+
+    if (!decoded || !rejected)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Dump format test failed(record decoded %d, truncated record rejected %d)!\n", decoded, rejected);
+
+        return BAD_DATA_HASH;
+    }
+
+    // JSON object has elements with poison run and errors by name
+    dump = tmpfile();
+    if (!dump) return FILE_ERROR;
+
+    stk.stackErrors = EMPTY_STACK;
+    stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL, DUMP_JSON);
+    reset_after_corruption(&stk);
+
+    snprintf(expected, sizeof(expected), "\"elements\": [0, 1, 2, 3, 4, 5, 6, 7, 8, 9, {\"poison\": %lu}]}", stk.capacity - count);
+
+    char* object = dump_format_read(dump);
+
+    bool json = object && !strncmp(object, "{\"stack\": ", 10) && strstr(object, "\"name\": \"&stk\"") &&
+                strstr(object, "\"errors\": [\"EMPTY_STACK\"]") && (!poisoned || strstr(object, expected));
+
+    free(object);
+    fclose(dump);
+
+    if (!json)
+    {
+        color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+        fprintf(stream, "Dump format test failed(JSON object doesn't match stack)!\n");
+
+        return BAD_DATA_HASH;
+    }
+
+    STACK_DTOR(&stk);
+
+    // Elements of every storage survive binary round trip, dumps made with DUMP_DEFAULT use format set for them
+    const enum storageMode storages[] = {STORAGE_CONTIGUOUS, STORAGE_SEGMENTED, STORAGE_INCREMENTAL};
+    const size_t elements = STACK_CHUNK_CAPACITY * 3 + 7;
+
+    stack_dump_format(DUMP_BINARY);
+
+    for (size_t storage = 0; storage < sizeof(storages) / sizeof(storages[0]); storage++)
+    {
+        STACK_CTOR_EX(&stk, 1, PROTECTION_DEFAULT, storages[storage]);
+
+        for (size_t i = 0; i < elements; i++) STACK_PUSH(&stk, (elem_t) i);
+
+        dump = tmpfile();
+        if (!dump) return FILE_ERROR;
+
+        stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, SHORT, DUMP_DEFAULT);
+        stack_dump(dump, &stk, __FILE__, __PRETTY_FUNCTION__, __LINE__, FULL,  DUMP_DEFAULT);
+
+        text = dump_format_decode(dump);
+        fclose(dump);
+
+        snprintf(expected, sizeof(expected), "*[%lu] = %lu", elements - 1, elements - 1);
+
+        size_t below = text ? dump_count(text, "*[") : 0;
+        size_t last  = text ? dump_count(text, expected) : 0;
+
+        if (text) fclose(text);
+
+        if (below != 2 * elements || last != 2)
+        {
+            stack_dump_format(DUMP_TEXT);
+
+            color_fprintf(stream, COLOR_RED, STYLE_BOLD, "Error: ");
+            fprintf(stream, "Dump format test failed(storage %d: %lu elements decoded from two records of %lu)!\n",
+                    (int) storages[storage], below, elements);
+
+            return BAD_DATA_HASH;
+        }
+
+        STACK_DTOR(&stk);
+    }
+
+    stack_dump_format(DUMP_TEXT);
+
+    return NO_ERRORS;
+}
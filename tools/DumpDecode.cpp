@@ -0,0 +1,48 @@
+/**
+ * @file
+ * @brief Offline decoder of binary stack dumps: prints records of files(or of stdin) as text dumps
+*/
+
+#include <stdio.h>
+
+#include "Color_output.h"
+#include "Stack.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        enum errorCode error = stack_dump_decode(stdin, stdout);
+        if (error) print_error(stderr, error);
+
+        return error ? 1 : 0;
+    }
+
+    int status = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE* in = fopen(argv[i], "rb");
+
+        if (!in)
+        {
+            fprintf(stderr, "Can't open %s\n", argv[i]);
+            status = 1;
+
+            continue;
+        }
+
+        enum errorCode error = stack_dump_decode(in, stdout);
+
+        if (error)
+        {
+            fprintf(stderr, "%s: ", argv[i]);
+            print_error(stderr, error);
+            status = 1;
+        }
+
+        fclose(in);
+    }
+
+    return status;
+}